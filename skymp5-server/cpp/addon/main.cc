@@ -1,15 +1,20 @@
 #include "AsyncSaveStorage.h"
+#include "ChangeFormJournal.h"
+#include "ChunkReferenceIndex.h"
 #include "EspmGameObject.h"
 #include "FileDatabase.h"
 #include "FormCallbacks.h"
 #include "GamemodeApi.h"
+#include "LmdbDatabase.h"
 #include "MigrationDatabase.h"
 #include "MongoDatabase.h"
 #include "MpFormGameObject.h"
+#include "NavMeshIndex.h"
 #include "Networking.h"
 #include "NetworkingCombined.h"
 #include "NetworkingMock.h"
 #include "PartOne.h"
+#include "PreloadCompressedFields.h"
 #include "ScriptStorage.h"
 #include "formulas/TES5DamageFormula.h"
 #include <JsEngine.h>
@@ -273,23 +278,96 @@ std::shared_ptr<IDatabase> CreateDatabase(
     return std::make_shared<MongoDatabase>(databaseUri, databaseName);
   }
 
+  if (databaseDriver == "lmdb") {
+    auto databaseName = settings.count("databaseName")
+      ? settings["databaseName"].get<std::string>()
+      : std::string("world_lmdb");
+
+    auto mapSize = settings.count("databaseMapSize")
+      ? settings["databaseMapSize"].get<size_t>()
+      : LmdbDatabase::kDefaultMapSize;
+
+    logger->info("Using lmdb with name '" + databaseName + "'");
+    return std::make_shared<LmdbDatabase>(databaseName, logger, mapSize);
+  }
+
   if (databaseDriver == "migration") {
     auto from = settings.at("databaseOld");
     auto to = settings.at("databaseNew");
     auto oldDatabase = CreateDatabase(from, logger);
     auto newDatabase = CreateDatabase(to, logger);
-    return std::make_shared<MigrationDatabase>(newDatabase, oldDatabase);
+
+    if (!settings.value("migrationBulkCopy", false)) {
+      return std::make_shared<MigrationDatabase>(newDatabase, oldDatabase);
+    }
+
+    auto batchSize = settings.value(
+      "migrationBatchSize", MigrationDatabase::kDefaultBulkCopyBatchSize);
+    auto onProgress = [logger](const MigrationDatabase::Progress& progress) {
+      logger->info("Migration: {} change forms copied, {} skipped",
+                   progress.numCopied, progress.numSkipped);
+    };
+    return std::make_shared<MigrationDatabase>(newDatabase, oldDatabase,
+                                               batchSize, onProgress);
   }
 
   throw std::runtime_error("Unrecognized databaseDriver: " + databaseDriver);
 }
 
+SaveScheduler::Settings CreateSaveSchedulerSettings(
+  const nlohmann::json& settings)
+{
+  SaveScheduler::Settings res;
+
+  auto it = settings.find("saveScheduler");
+  if (it == settings.end()) {
+    return res;
+  }
+
+  auto& j = *it;
+  res.maxRecordsPerBatch = j.value("maxRecordsPerBatch", size_t(0));
+  res.maxBytesPerBatch = j.value("maxBytesPerBatch", size_t(0));
+  res.minBatchInterval =
+    std::chrono::milliseconds(j.value("minBatchIntervalMs", 0));
+
+  const char* priorityNames[SaveScheduler::kNumPriorities] = {
+    "playerCharacter", "interactive", "cosmetic"
+  };
+  auto maxStaleness = j.find("maxStalenessMs");
+  if (maxStaleness != j.end()) {
+    for (size_t i = 0; i < SaveScheduler::kNumPriorities; ++i) {
+      if (maxStaleness->count(priorityNames[i])) {
+        res.maxStaleness[i] = std::chrono::milliseconds(
+          maxStaleness->at(priorityNames[i]).get<int>());
+      }
+    }
+  }
+  return res;
+}
+
 std::shared_ptr<ISaveStorage> CreateSaveStorage(
   std::shared_ptr<IDatabase> db, std::shared_ptr<spdlog::logger> logger)
 {
   return std::make_shared<AsyncSaveStorage>(db, logger);
 }
 
+std::shared_ptr<ChangeFormJournal> CreateChangeFormJournal(
+  const nlohmann::json& settings, std::shared_ptr<spdlog::logger> logger)
+{
+  auto it = settings.find("changeFormJournal");
+  if (it == settings.end()) {
+    return nullptr;
+  }
+
+  auto& j = *it;
+  auto path = j.value("path", std::string("world_journal.jsonl"));
+  auto syncInterval = std::chrono::milliseconds(j.value(
+    "syncIntervalMs", ChangeFormJournal::kDefaultSyncInterval.count()));
+
+  logger->info("Using change form journal '{}'", path);
+  return std::make_shared<ChangeFormJournal>(path, logger, syncInterval);
+}
+
 static std::shared_ptr<spdlog::logger>& GetLogger()
 {
   static auto g_logger = spdlog::stdout_color_mt("console");
@@ -363,7 +441,21 @@ ScampServer::ScampServer(const Napi::CallbackInfo& info)
     auto scriptStorage = std::make_shared<DirectoryScriptStorage>(
       (espm::fs::path(dataDir) / "scripts").string());
 
-    auto espm = new espm::Loader(pluginPaths);
+    espm::fs::path espmIndexCacheDir;
+    if (serverSettings["espmIndexCacheDir"].is_string()) {
+      espmIndexCacheDir =
+        static_cast<std::string>(serverSettings["espmIndexCacheDir"]);
+      logger->info("Using espm index cache dir '{}'",
+                   espmIndexCacheDir.string());
+    }
+
+    auto espm = new espm::Loader(pluginPaths, nullptr,
+                                 espm::Loader::BufferType::MappedBuffer, 0,
+                                 espmIndexCacheDir);
+    for (auto& [fileName, usage] : espm->GetIndexMemoryUsage()) {
+      logger->info("espm index of '{}' takes {} KB", fileName,
+                   usage.GetTotal() / 1024);
+    }
     auto realServer = Networking::CreateServer(
       static_cast<uint32_t>(port), static_cast<uint32_t>(maxConnections));
     server = Networking::CreateCombinedServer({ realServer, serverMock });
@@ -371,6 +463,56 @@ ScampServer::ScampServer(const Napi::CallbackInfo& info)
     partOne->SetDamageFormula(std::make_unique<TES5DamageFormula>());
     partOne->worldState.AttachScriptStorage(scriptStorage);
     partOne->AttachEspm(espm);
+
+    if (serverSettings["espmCacheSizeMb"].is_number_unsigned()) {
+      const size_t maxBytes =
+        serverSettings["espmCacheSizeMb"].get<size_t>() * 1024 * 1024;
+      partOne->worldState.GetEspmCache().SetMaxBytes(maxBytes);
+      espm->GetBrowser().GetCache().SetMaxBytes(maxBytes);
+      logger->info("espm cache size is limited to {} bytes", maxBytes);
+    }
+
+    if (serverSettings["espmPreloadTypes"].is_array()) {
+      std::vector<std::string> types;
+      for (auto& type : serverSettings["espmPreloadTypes"]) {
+        types.push_back(static_cast<std::string>(type));
+      }
+      size_t maxBytes = 0;
+      if (serverSettings["espmPreloadMaxMb"].is_number_unsigned()) {
+        maxBytes =
+          serverSettings["espmPreloadMaxMb"].get<size_t>() * 1024 * 1024;
+      }
+      auto was = std::chrono::steady_clock::now();
+      // Other espm caches of the server look up fields in the browser cache
+      // before decompressing
+      const size_t numBytes = espm::PreloadCompressedFields(
+        espm->GetBrowser(), types, espm->GetBrowser().GetCache(), maxBytes);
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - was)
+                  .count();
+      logger->info("Preloaded {} bytes of compressed records in {} ms",
+                   numBytes, ms);
+    }
+
+    {
+      // Built here rather than when the first player loads a chunk
+      auto was = std::chrono::steady_clock::now();
+      auto& chunkReferenceIndex = partOne->worldState.GetChunkReferenceIndex();
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - was)
+                  .count();
+      logger->info("Indexed {} loadable references in {} ms",
+                   chunkReferenceIndex.GetNumReferences(), ms);
+    }
+
+    if (serverSettings["navMeshValidation"].is_boolean() &&
+        serverSettings["navMeshValidation"].get<bool>()) {
+      auto& navMeshIndex = partOne->worldState.GetNavMeshIndex();
+      partOne->worldState.SetNavMeshValidationEnabled(true);
+      logger->info("Movement is validated against {} navmesh triangles",
+                   navMeshIndex.GetNumTriangles());
+    }
+
     this->serverSettings = serverSettings;
     this->logger = logger;
 
@@ -383,6 +525,11 @@ ScampServer::ScampServer(const Napi::CallbackInfo& info)
       logger->info("'{}' will be relooted every {} ms", recordType, timeMs);
     }
 
+    partOne->worldState.SetSaveSchedulerSettings(
+      CreateSaveSchedulerSettings(serverSettings));
+    partOne->worldState.SetLoadChangeFormsOnDemand(
+      serverSettings.value("loadChangeFormsOnDemand", false));
+
     auto res = RunScript(Env(),
                          "let require = global.require || "
                          "global.process.mainModule.constructor._load; let "
@@ -399,7 +546,8 @@ Napi::Value ScampServer::AttachSaveStorage(const Napi::CallbackInfo& info)
 {
   try {
     partOne->AttachSaveStorage(
-      CreateSaveStorage(CreateDatabase(serverSettings, logger), logger));
+      CreateSaveStorage(CreateDatabase(serverSettings, logger), logger),
+      CreateChangeFormJournal(serverSettings, logger));
   } catch (std::exception& e) {
     throw Napi::Error::New(info.Env(), (std::string)e.what());
   }
@@ -776,12 +924,12 @@ JsValue GetJsObjectFromPapyrusObject(
 JsValue GetJsValueFromPapyrusValue(
   const VarValue& value, const std::vector<std::string>& espmFilenames)
 {
-  if (value.promise) {
+  if (value.GetPromise()) {
     auto promiseCallback = JsValue::Function(
       [value, espmFilenames](const JsFunctionArguments& args) {
         auto& resolve = args[1];
 
-        value.promise->Then([resolve, espmFilenames](const VarValue& v) {
+        value.GetPromise()->Then([resolve, espmFilenames](const VarValue& v) {
           resolve.Call({ JsValue::Undefined(),
                          GetJsValueFromPapyrusValue(v, espmFilenames) });
         });
@@ -819,13 +967,14 @@ JsValue GetJsValueFromPapyrusValue(
     case VarValue::kType_IntArray:
     case VarValue::kType_FloatArray:
     case VarValue::kType_BoolArray: {
-      if (value.pArray == nullptr)
+      auto elements = value.GetArray();
+      if (elements == nullptr)
         return JsValue::Null();
-      auto arr = JsValue::Array(value.pArray->size());
+      auto arr = JsValue::Array(elements->size());
       int n = static_cast<int>(arr.GetProperty("length"));
       for (int i = 0; i < n; ++i) {
         arr.SetProperty(
-          i, GetJsValueFromPapyrusValue(value.pArray->at(i), espmFilenames));
+          i, GetJsValueFromPapyrusValue(elements->at(i), espmFilenames));
       }
       return arr;
     }
@@ -866,19 +1015,19 @@ VarValue GetPapyrusValueFromJsValue(const JsValue& v, bool treatNumberAsInt,
       if (arr.GetProperty("length").ToString() == "0") {
         // Treat zero-length arrays as kType_ObjectArray ("none array")
         VarValue papyrusArray(VarValue::kType_ObjectArray);
-        papyrusArray.pArray.reset(new std::vector<VarValue>);
+        papyrusArray.SetArray(std::vector<VarValue>());
         return papyrusArray;
       }
 
-      auto arrayContents = std::make_shared<std::vector<VarValue>>();
+      std::vector<VarValue> arrayContents;
       uint8_t type = ~0;
 
       int n = static_cast<int>(arr.GetProperty("length"));
       for (int i = 0; i < n; ++i) {
-        arrayContents->push_back(GetPapyrusValueFromJsValue(
+        arrayContents.push_back(GetPapyrusValueFromJsValue(
           arr.GetProperty(i), treatNumberAsInt, wst));
 
-        auto extractedType = arrayContents->back().GetType();
+        auto extractedType = arrayContents.back().GetType();
         if (type == static_cast<uint8_t>(~0)) {
           type = extractedType;
         } else if (extractedType != type) {
@@ -889,7 +1038,7 @@ VarValue GetPapyrusValueFromJsValue(const JsValue& v, bool treatNumberAsInt,
 
       VarValue papyrusArray(
         ActivePexInstance::GetArrayTypeByElementType(type));
-      papyrusArray.pArray = arrayContents;
+      papyrusArray.SetArray(std::move(arrayContents));
 
       return papyrusArray;
     }
@@ -897,19 +1046,20 @@ VarValue GetPapyrusValueFromJsValue(const JsValue& v, bool treatNumberAsInt,
       bool isPromise =
         v.GetProperty("then").GetType() == JsValue::Type::Function;
       if (isPromise) {
-        VarValue res = VarValue::None();
-        res.promise = std::make_shared<Viet::Promise<VarValue>>();
+        Viet::Promise<VarValue> promise;
+        VarValue res(promise);
 
         auto then = v.GetProperty("then");
 
         auto wst_ = &wst;
-        then.Call(
-          { v, JsValue::Function([res, wst_](const JsFunctionArguments& args) {
-              bool treatNumberAsInt = false;
-              res.promise->Resolve(
-                GetPapyrusValueFromJsValue(args[1], treatNumberAsInt, *wst_));
-              return JsValue::Undefined();
-            }) });
+        auto onResolved =
+          JsValue::Function([promise, wst_](const JsFunctionArguments& args) {
+            bool treatNumberAsInt = false;
+            promise.Resolve(
+              GetPapyrusValueFromJsValue(args[1], treatNumberAsInt, *wst_));
+            return JsValue::Undefined();
+          });
+        then.Call({ v, onResolved });
         // TODO: catch/reject?
 
         return res;
@@ -0,0 +1,123 @@
+#include <SyntheticPlugins.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+namespace {
+const char* const kUsage = R"(Usage: espm_generator <outDir> [options]
+
+Writes Synthetic.esm and override plugins SyntheticOverride<N>.esp having
+Synthetic.esm as the master. Output depends on options only.
+
+Options:
+  --worldspaces <n>          Worldspaces in the master (1)
+  --cells-per-side <n>       Exterior cells per worldspace side (8)
+  --references-per-cell <n>  References per cell and plugin (32)
+  --items <n>                MISC records per plugin (256)
+  --statics <n>              STAT records per plugin (64)
+  --leveled-lists <n>        LVLI records per plugin (64)
+  --containers <n>           CONT records per plugin (64)
+  --recipes <n>              COBJ records per plugin (128)
+  --compressed-items <n>     Items written compressed (64)
+  --no-navmeshes             Don't write NAVM records
+  --overrides <n>            Override plugins (0)
+  --override-percent <n>     Master records overridden by each plugin (10)
+  --seed <n>                 Random seed (0)
+)";
+
+uint32_t ParseNumber(const std::string& option, const char* str)
+{
+  char* end = nullptr;
+  const unsigned long res = strtoul(str, &end, 10);
+  if (!*str || *end || res > UINT32_MAX) {
+    throw std::runtime_error("Bad value of " + option + ": " + str);
+  }
+  return static_cast<uint32_t>(res);
+}
+
+void WriteFile(const std::filesystem::path& path,
+               const std::vector<char>& content)
+{
+  std::ofstream f(path, std::ios::binary);
+  f.write(content.data(), content.size());
+  if (!f) {
+    throw std::runtime_error("Unable to write " + path.string());
+  }
+  std::cout << path.string() << ": " << content.size() << " bytes"
+            << std::endl;
+}
+
+int Run(int argc, char* argv[])
+{
+  if (argc < 2 || !strcmp(argv[1], "--help")) {
+    std::cout << kUsage;
+    return argc < 2 ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  espm::SyntheticPluginSettings settings;
+  uint32_t numOverrides = 0;
+  uint32_t overridePercent = 10;
+
+  const std::map<std::string, uint32_t*> numberOptions = {
+    { "--worldspaces", &settings.numWorldspaces },
+    { "--cells-per-side", &settings.numCellsPerSide },
+    { "--references-per-cell", &settings.numReferencesPerCell },
+    { "--items", &settings.numItems },
+    { "--statics", &settings.numStatics },
+    { "--leveled-lists", &settings.numLeveledLists },
+    { "--containers", &settings.numContainers },
+    { "--recipes", &settings.numRecipes },
+    { "--compressed-items", &settings.numCompressedItems },
+    { "--overrides", &numOverrides },
+    { "--override-percent", &overridePercent },
+    { "--seed", &settings.seed }
+  };
+
+  for (int i = 2; i < argc; ++i) {
+    const std::string option = argv[i];
+    if (option == "--no-navmeshes") {
+      settings.navMeshes = false;
+      continue;
+    }
+    auto it = numberOptions.find(option);
+    if (it == numberOptions.end()) {
+      throw std::runtime_error("Unknown option " + option);
+    }
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value of " + option);
+    }
+    *it->second = ParseNumber(option, argv[++i]);
+  }
+
+  const std::filesystem::path outDir = argv[1];
+  std::filesystem::create_directories(outDir);
+
+  const std::string masterName = "Synthetic.esm";
+  WriteFile(outDir / masterName, espm::GenerateSyntheticMaster(settings));
+
+  for (uint32_t i = 1; i <= numOverrides; ++i) {
+    auto pluginSettings = settings;
+    pluginSettings.seed = settings.seed + i;
+    WriteFile(outDir / ("SyntheticOverride" + std::to_string(i) + ".esp"),
+              espm::GenerateSyntheticOverride(pluginSettings, masterName,
+                                              settings, overridePercent));
+  }
+  return EXIT_SUCCESS;
+}
+}
+
+int main(int argc, char* argv[])
+{
+  try {
+    return Run(argc, argv);
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -3,6 +3,7 @@
 #include <fmt/format.h>
 #include <sparsepp/spp.h>
 #include <string>
+#include <vector>
 
 #include "Combiner.h"
 
@@ -13,13 +14,71 @@ struct Source
   std::unique_ptr<espm::IdMapping> toComb, toRaw;
 };
 
+// Record added or overridden by a source file. Entries of one combined id
+// form a chain from the last file in the load order to the first one
+struct IndexEntry
+{
+  static constexpr uint32_t kNoPrev = ~0u;
+
+  espm::RecordHeader* rec = nullptr;
+  uint32_t prev = kNoPrev;
+  uint8_t fileIdx = 0;
+};
+
 struct espm::CombineBrowser::Impl
 {
   espm::CompressedFieldsCache cache;
+  espm::DecodedRecordsCache decodedRecordsCache{ &cache };
 
   std::array<Source, 256> sources;
   size_t numSources = 0;
 
+  // Built by Combine. Combined form id => index of the last entry
+  spp::sparse_hash_map<uint32_t, uint32_t> lastEntryById;
+  std::vector<IndexEntry> indexEntries;
+
+  void BuildIndex()
+  {
+    size_t numRecords = 0;
+    for (size_t i = 0; i < numSources; ++i) {
+      numRecords += sources[i].br->GetNumRecords();
+    }
+
+    lastEntryById.clear();
+    indexEntries.clear();
+    indexEntries.reserve(numRecords);
+
+    for (size_t i = 0; i < numSources; ++i) {
+      auto& src = sources[i];
+      src.br->ForEachRecord([&](RecordHeader* rec) {
+        const uint32_t combFormId = GetMappedId(rec->GetId(), *src.toComb);
+        if (combFormId >= 0xff000000) {
+          return;
+        }
+        const auto entryIdx = static_cast<uint32_t>(indexEntries.size());
+        auto [it, inserted] = lastEntryById.emplace(combFormId, entryIdx);
+        IndexEntry entry;
+        entry.rec = rec;
+        entry.fileIdx = static_cast<uint8_t>(i);
+        if (!inserted) {
+          entry.prev = it->second;
+          it->second = entryIdx;
+        }
+        indexEntries.push_back(entry);
+      });
+    }
+  }
+
+  // Returns nullptr if no file has a record with such id
+  const IndexEntry* FindLastEntry(uint32_t combFormId) const noexcept
+  {
+    auto it = lastEntryById.find(combFormId);
+    if (it == lastEntryById.end()) {
+      return nullptr;
+    }
+    return &indexEntries[it->second];
+  }
+
   // returns index of sources array or -1 if not found
   int GetFileIndex(const char* fileName) const noexcept
   {
@@ -69,8 +128,7 @@ std::unique_ptr<espm::CombineBrowser> espm::Combiner::Combine()
     if (!tes4) {
       throw CombineError(src.fileName + " doesn't have TES4 record");
     }
-    espm::CompressedFieldsCache dummyCache;
-    const auto masters = tes4->GetData(dummyCache).masters;
+    const auto masters = tes4->GetData(pImpl->cache).masters;
 
     auto toComb = std::make_unique<IdMapping>();
     toComb->fill(0xff);
@@ -92,6 +150,8 @@ std::unique_ptr<espm::CombineBrowser> espm::Combiner::Combine()
     src.toRaw = std::move(toRaw);
   }
 
+  pImpl->BuildIndex();
+
   std::unique_ptr<espm::CombineBrowser> res(new espm::CombineBrowser);
   res->pImpl = pImpl;
   return res;
@@ -108,39 +168,40 @@ uint32_t espm::BrowserInfo::ToGlobalId(uint32_t rawId) const noexcept
 espm::LookupResult espm::CombineBrowser::LookupById(
   uint32_t combFormId) const noexcept
 {
-  RecordHeader* resRec = nullptr;
-  uint8_t resFileIdx = 0;
-  for (size_t i = 0; i < pImpl->numSources; ++i) {
-    auto& src = pImpl->sources[i];
-    const uint32_t rawFormId = espm::GetMappedId(combFormId, *src.toRaw);
-    if (rawFormId >= 0xff000000)
-      continue;
-    auto rec = src.br->LookupById(rawFormId);
-    if (rec) {
-      resRec = rec;
-      resFileIdx = (uint8_t)i;
-    }
-  }
-  return resRec ? LookupResult(this, resRec, resFileIdx) : LookupResult();
+  auto entry = pImpl->FindLastEntry(combFormId);
+  return entry ? LookupResult(this, entry->rec, entry->fileIdx)
+               : LookupResult();
 }
 
 std::vector<espm::LookupResult> espm::CombineBrowser::LookupByIdAll(
   uint32_t combFormId) const noexcept
 {
+  std::vector<const IndexEntry*> chain;
+  auto entry = pImpl->FindLastEntry(combFormId);
+  while (entry) {
+    chain.push_back(entry);
+    entry = entry->prev == IndexEntry::kNoPrev
+      ? nullptr
+      : &pImpl->indexEntries[entry->prev];
+  }
+
   std::vector<espm::LookupResult> res;
-  for (size_t i = 0; i < pImpl->numSources; ++i) {
-    auto& src = pImpl->sources[i];
-    const uint32_t rawFormId = espm::GetMappedId(combFormId, *src.toRaw);
-    if (rawFormId >= 0xff000000)
-      continue;
-    auto rec = src.br->LookupById(rawFormId);
-    if (rec) {
-      res.push_back({ this, rec, static_cast<uint8_t>(i) });
-    }
+  res.reserve(chain.size());
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    res.push_back({ this, (*it)->rec, (*it)->fileIdx });
   }
   return res;
 }
 
+void espm::CombineBrowser::ForEachRecord(
+  const std::function<void(const LookupResult&)>& f) const
+{
+  for (auto& [combFormId, entryIdx] : pImpl->lastEntryById) {
+    auto& entry = pImpl->indexEntries[entryIdx];
+    f(LookupResult(this, entry.rec, entry.fileIdx));
+  }
+}
+
 std::pair<espm::RecordHeader**, size_t> espm::CombineBrowser::FindNavMeshes(
   uint32_t worldSpaceId, espm::CellOrGridPos cellOrGridPos) const noexcept
 {
@@ -159,21 +220,21 @@ std::pair<espm::RecordHeader**, size_t> espm::CombineBrowser::FindNavMeshes(
   return { nullptr, 0 };
 }
 
-std::vector<const std::vector<espm::RecordHeader*>*>
+std::vector<const espm::RecordRange*>
 espm::CombineBrowser::GetRecordsByType(const char* type) const
 {
-  std::vector<const std::vector<espm::RecordHeader*>*> res;
+  std::vector<const espm::RecordRange*> res;
   for (size_t i = 0; i < pImpl->numSources; ++i) {
     res.push_back(&pImpl->sources[i].br->GetRecordsByType(type));
   }
   return res;
 }
 
-std::vector<const std::vector<espm::RecordHeader*>*>
+std::vector<const espm::RecordRange*>
 espm::CombineBrowser::GetRecordsAtPos(uint32_t cellOrWorld, int16_t cellX,
                                       int16_t cellY) const
 {
-  std::vector<const std::vector<espm::RecordHeader*>*> res;
+  std::vector<const espm::RecordRange*> res;
   for (size_t i = 0; i < pImpl->numSources; ++i) {
     res.push_back(
       &pImpl->sources[i].br->GetRecordsAtPos(cellOrWorld, cellX, cellY));
@@ -202,9 +263,15 @@ espm::CompressedFieldsCache& espm::CombineBrowser::GetCache() const noexcept
   return pImpl->cache;
 }
 
+espm::DecodedRecordsCache& espm::CombineBrowser::GetDecodedRecordsCache()
+  const noexcept
+{
+  return pImpl->decodedRecordsCache;
+}
+
 namespace espm {
 
-const GroupStack& CombineBrowser::GetParentGroupsEnsured(
+GroupStack CombineBrowser::GetParentGroupsEnsured(
   const RecordHeader* rec) const
 {
   for (size_t i = 0; i < pImpl->numSources; ++i) {
@@ -217,8 +284,7 @@ const GroupStack& CombineBrowser::GetParentGroupsEnsured(
     "espm::CombineBrowser: no browsers know record id={:#x}", rec->GetId()));
 }
 
-const std::vector<void*>& CombineBrowser::GetSubsEnsured(
-  const GroupHeader* group) const
+GroupSubs CombineBrowser::GetSubsEnsured(const GroupHeader* group) const
 {
   for (size_t i = 0; i < pImpl->numSources; ++i) {
     const auto result = pImpl->sources[i].br->GetSubsOptional(group);
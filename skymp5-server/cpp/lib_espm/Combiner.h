@@ -2,10 +2,12 @@
 
 #include <cassert>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <stdexcept>
 #include <string>
 
+#include "DecodedRecordsCache.h"
 #include "GroupUtils.h"
 #include "espm.h"
 
@@ -54,13 +56,17 @@ public:
   // Returns a record for each file adding/editing record with such id
   std::vector<LookupResult> LookupByIdAll(uint32_t formId) const noexcept;
 
+  // Visits the record from the last file in the load order for every id, in
+  // no particular order
+  void ForEachRecord(const std::function<void(const LookupResult&)>& f) const;
+
   std::pair<espm::RecordHeader**, size_t> FindNavMeshes(
     uint32_t worldSpaceId, espm::CellOrGridPos cellOrGridPos) const noexcept;
 
-  std::vector<const std::vector<espm::RecordHeader*>*> GetRecordsByType(
+  std::vector<const espm::RecordRange*> GetRecordsByType(
     const char* type) const;
 
-  std::vector<const std::vector<espm::RecordHeader*>*> GetRecordsAtPos(
+  std::vector<const espm::RecordRange*> GetRecordsAtPos(
     uint32_t cellOrWorld, int16_t cellX, int16_t cellY) const;
 
   // Returns nullptr on failure
@@ -68,11 +74,15 @@ public:
   const espm::IdMapping* GetRawMapping(size_t fileIndex) const noexcept;
 
   // CompressedFieldsCache is not logically related to Combiner, this method is
-  // added for usability
+  // added for usability. Use it instead of temporary caches, so records are
+  // not decompressed again on every call
   espm::CompressedFieldsCache& GetCache() const noexcept;
 
-  const GroupStack& GetParentGroupsEnsured(const RecordHeader* rec) const;
-  const std::vector<void*>& GetSubsEnsured(const GroupHeader* group) const;
+  // Prefer it over GetData(GetCache()) for record types it supports
+  espm::DecodedRecordsCache& GetDecodedRecordsCache() const noexcept;
+
+  GroupStack GetParentGroupsEnsured(const RecordHeader* rec) const;
+  GroupSubs GetSubsEnsured(const GroupHeader* group) const;
 
 private:
   struct Impl;
@@ -0,0 +1,76 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sparsepp/spp.h>
+#include <tuple>
+#include <type_traits>
+
+#include "espm.h"
+
+namespace espm {
+
+// Memoizes GetData results of records. Plugin files never change at runtime,
+// so each record is decoded once and later lookups are a hash lookup.
+// Thread-safe. Returned references are valid for the lifetime of the cache
+template <class... RecordTs>
+class BasicDecodedRecordsCache
+{
+public:
+  template <class RecordT>
+  static constexpr bool kIsSupported =
+    (std::is_same_v<RecordT, RecordTs> || ...);
+
+  // Fields preloaded into 'parent' are not decompressed again, see
+  // CompressedFieldsCache
+  explicit BasicDecodedRecordsCache(CompressedFieldsCache* parent = nullptr)
+    : compressedFieldsCache(0, parent)
+  {
+  }
+
+  template <class RecordT>
+  const typename RecordT::Data& GetData(const RecordT* rec)
+  {
+    static_assert(kIsSupported<RecordT>);
+
+    auto& table = std::get<Table<RecordT>>(tables);
+    {
+      std::shared_lock l(table.m);
+      auto it = table.data.find(rec);
+      if (it != table.data.end()) {
+        return *it->second;
+      }
+    }
+
+    // Decoding outside the lock, another thread may insert the same record
+    // meanwhile, then its result is used
+    auto data = std::make_unique<const typename RecordT::Data>(
+      rec->GetData(compressedFieldsCache));
+
+    std::unique_lock l(table.m);
+    auto [it, inserted] = table.data.emplace(rec, std::move(data));
+    return *it->second;
+  }
+
+private:
+  template <class RecordT>
+  struct Table
+  {
+    std::shared_mutex m;
+    spp::sparse_hash_map<const RecordT*,
+                         std::unique_ptr<const typename RecordT::Data>>
+      data;
+  };
+
+  // Decoded data may point to decompressed fields, so this cache must never
+  // evict
+  CompressedFieldsCache compressedFieldsCache;
+
+  std::tuple<Table<RecordTs>...> tables;
+};
+
+using DecodedRecordsCache =
+  BasicDecodedRecordsCache<NPC_, RACE, WEAP, ARMO, COBJ, LVLI, CONT, FLOR,
+                           TREE, MGEF, ENCH>;
+
+}
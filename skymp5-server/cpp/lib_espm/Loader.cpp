@@ -2,43 +2,88 @@
 
 #include "AllocatedBuffer.h"
 #include "MappedBuffer.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
 
 namespace espm {
 
 Loader::Loader(const fs::path& dataDir, const std::vector<fs::path>& fileNames,
-               OnProgress onProgress, BufferType bufferType_)
-  : Loader(MakeFilePaths(dataDir, fileNames), onProgress, bufferType_)
+               OnProgress onProgress, BufferType bufferType_,
+               size_t numThreads, const fs::path& indexCacheDir_)
+  : Loader(MakeFilePaths(dataDir, fileNames), onProgress, bufferType_,
+           numThreads, indexCacheDir_)
 {
 }
 
 Loader::Loader(const std::vector<fs::path>& filePaths_, OnProgress onProgress,
-               BufferType bufferType_)
+               BufferType bufferType_, size_t numThreads,
+               const fs::path& indexCacheDir_)
   : filePaths(filePaths_)
   , bufferType(bufferType_)
+  , indexCacheDir(indexCacheDir_)
 {
-  for (const auto& p : filePaths) {
-    entries.emplace_back();
-    auto& entry = entries.back();
-
-    const auto was = std::chrono::steady_clock::now();
-    entry.buffer = MakeBuffer(p);
-    entry.fileName = p.filename().string();
-    const auto end = std::chrono::steady_clock::now();
-    const std::chrono::duration<float> elapsedTime = end - was;
-    entry.readDuration = elapsedTime.count();
-    entry.size = entry.buffer->GetLength();
-
-    const auto was1 = std::chrono::steady_clock::now();
-    entry.browser.reset(
-      new espm::Browser(entry.buffer->GetData(), entry.buffer->GetLength()));
-    const auto end1 = std::chrono::steady_clock::now();
-    const std::chrono::duration<float> elapsedTime1 = end1 - was1;
-    entry.parseDuration = elapsedTime1.count();
-    if (onProgress) {
-      onProgress(entry.fileName.string(), entry.readDuration,
-                 entry.parseDuration, entry.size);
+  if (!indexCacheDir.empty()) {
+    fs::create_directories(indexCacheDir);
+  }
+
+  entries.resize(filePaths.size());
+
+  // Browsers are independent of each other until Combine, so files are
+  // parsed concurrently. Each worker takes the next unparsed file
+  std::vector<std::promise<void>> loaded(entries.size());
+  std::atomic<size_t> nextEntry = 0;
+  std::atomic<bool> failed = false;
+
+  auto work = [&] {
+    while (!failed) {
+      const size_t i = nextEntry++;
+      if (i >= entries.size()) {
+        break;
+      }
+      try {
+        LoadEntry(filePaths[i], entries[i]);
+        loaded[i].set_value();
+      } catch (...) {
+        failed = true;
+        loaded[i].set_exception(std::current_exception());
+      }
+    }
+  };
+
+  if (numThreads == 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  numThreads = std::min(numThreads, entries.size());
+
+  std::vector<std::thread> threads;
+  auto joinThreads = [&] {
+    for (auto& thread : threads) {
+      thread.join();
     }
+    threads.clear();
+  };
+
+  try {
+    for (size_t i = 0; i < numThreads; ++i) {
+      threads.emplace_back(work);
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+      loaded[i].get_future().get();
+      auto& entry = entries[i];
+      if (onProgress) {
+        onProgress(entry.fileName.string(), entry.readDuration,
+                   entry.parseDuration, entry.size);
+      }
+    }
+  } catch (...) {
+    failed = true;
+    joinThreads();
+    throw;
   }
+  joinThreads();
+
   combiner = std::make_unique<espm::Combiner>();
   for (auto& entry : entries) {
     const auto fileName = entry.fileName.string();
@@ -64,18 +109,31 @@ std::vector<std::string> Loader::GetFileNames() const noexcept
 
 std::map<std::string, Loader::FileInfo> Loader::GetFilesInfo() const
 {
+  std::lock_guard l(filesInfoMutex);
   std::map<std::string, FileInfo> res;
 
   for (const auto& entry : entries) {
-    auto hash =
-      CalculateHashcode(entry.buffer->GetData(), entry.buffer->GetLength());
+    if (!entry.crc32) {
+      entry.crc32 =
+        CalculateHashcode(entry.buffer->GetData(), entry.buffer->GetLength());
+    }
     res.emplace(entry.fileName.string(),
-                FileInfo{ hash, entry.buffer->GetLength() });
+                FileInfo{ *entry.crc32, entry.buffer->GetLength() });
   }
 
   return res;
 }
 
+std::map<std::string, espm::Browser::MemoryUsage>
+Loader::GetIndexMemoryUsage() const
+{
+  std::map<std::string, espm::Browser::MemoryUsage> res;
+  for (const auto& entry : entries) {
+    res.emplace(entry.fileName.string(), entry.browser->GetMemoryUsage());
+  }
+  return res;
+}
+
 std::vector<fs::path> Loader::MakeFilePaths(
   const fs::path& dataDir, const std::vector<fs::path>& fileNames)
 {
@@ -86,6 +144,123 @@ std::vector<fs::path> Loader::MakeFilePaths(
   return res;
 }
 
+void Loader::LoadEntry(const fs::path& filePath, Entry& entry) const
+{
+  const auto was = std::chrono::steady_clock::now();
+  entry.buffer = MakeBuffer(filePath);
+  entry.fileName = filePath.filename().string();
+  const auto end = std::chrono::steady_clock::now();
+  const std::chrono::duration<float> elapsedTime = end - was;
+  entry.readDuration = elapsedTime.count();
+  entry.size = entry.buffer->GetLength();
+
+  const auto was1 = std::chrono::steady_clock::now();
+  if (indexCacheDir.empty()) {
+    entry.browser.reset(
+      new espm::Browser(entry.buffer->GetData(), entry.buffer->GetLength()));
+  } else {
+    LoadBrowserWithIndexCache(filePath, entry);
+  }
+  const auto end1 = std::chrono::steady_clock::now();
+  const std::chrono::duration<float> elapsedTime1 = end1 - was1;
+  entry.parseDuration = elapsedTime1.count();
+}
+
+void Loader::LoadBrowserWithIndexCache(const fs::path& filePath,
+                                       Entry& entry) const
+{
+  const auto data = entry.buffer->GetData();
+  const auto length = entry.buffer->GetLength();
+  entry.crc32 = GetCrc32WithCache(filePath, entry);
+
+  const auto fileName = entry.fileName.string();
+  const auto cachePath = indexCacheDir /
+    fmt::format("{}.{}.{:08x}.idx", fileName, length, *entry.crc32);
+
+  if (fs::exists(cachePath)) {
+    try {
+      AllocatedBuffer index(cachePath);
+      entry.browser.reset(new espm::Browser(data, length, index.GetData(),
+                                            index.GetLength()));
+      return;
+    } catch (std::exception&) {
+      // The cache file is damaged, parse and overwrite it
+    }
+  }
+
+  entry.browser.reset(new espm::Browser(data, length));
+
+  // The cache only speeds up the next start, failing to update it is fine
+  std::error_code ec;
+  for (auto& p : fs::directory_iterator(indexCacheDir, ec)) {
+    // <fileName>.<size>.<crc32>.idx
+    const auto name = p.path().filename().string();
+    const auto prefix = fileName + ".";
+    const bool isStale = !name.compare(0, prefix.size(), prefix) &&
+      p.path().extension() == ".idx" &&
+      std::count(name.begin() + prefix.size(), name.end(), '.') == 2;
+    if (isStale) {
+      fs::remove(p.path(), ec);
+    }
+  }
+
+  const auto index = entry.browser->SaveIndex();
+  auto tmpPath = cachePath;
+  tmpPath += ".tmp";
+  {
+    std::ofstream f(tmpPath, std::ios::binary);
+    f.write(index.data(), index.size());
+    if (!f) {
+      return;
+    }
+  }
+  fs::rename(tmpPath, cachePath, ec);
+}
+
+// <fileName>.crc32 keeps "<size> <modification time> <crc32>" of the file,
+// so unchanged files aren't hashed on every start
+uint32_t Loader::GetCrc32WithCache(const fs::path& filePath,
+                                   const Entry& entry) const
+{
+  const auto data = entry.buffer->GetData();
+  const auto length = entry.buffer->GetLength();
+  const auto cachePath = indexCacheDir / (entry.fileName.string() + ".crc32");
+
+  std::error_code ec;
+  const auto modificationTime = static_cast<long long>(
+    fs::last_write_time(filePath, ec).time_since_epoch().count());
+  if (ec) {
+    return CalculateHashcode(data, length);
+  }
+
+  {
+    std::ifstream f(cachePath);
+    uintmax_t cachedLength = 0;
+    long long cachedModificationTime = 0;
+    uint32_t crc32 = 0;
+    if (f >> cachedLength >> cachedModificationTime >> std::hex >> crc32 &&
+        cachedLength == length &&
+        cachedModificationTime == modificationTime) {
+      return crc32;
+    }
+  }
+
+  const uint32_t crc32 = CalculateHashcode(data, length);
+
+  // The cache only speeds up the next start, failing to update it is fine
+  auto tmpPath = cachePath;
+  tmpPath += ".tmp";
+  {
+    std::ofstream f(tmpPath);
+    f << fmt::format("{} {} {:08x}\n", length, modificationTime, crc32);
+    if (!f) {
+      return crc32;
+    }
+  }
+  fs::rename(tmpPath, cachePath, ec);
+  return crc32;
+}
+
 std::unique_ptr<IBuffer> Loader::MakeBuffer(const fs::path& filePath) const
 {
   switch (bufferType) {
@@ -4,6 +4,8 @@
 #include <fstream>
 #include <functional>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <sstream>
 
 namespace espm {
@@ -28,13 +30,22 @@ public:
   using OnProgress = std::function<void(std::string fileName, float readDur,
                                         float parseDur, uintmax_t fileSize)>;
 
+  // Files are read and parsed on 'numThreads' threads, 0 means one thread
+  // per hardware thread. onProgress is called on the calling thread, in load
+  // order.
+  // If 'indexCacheDir' is not empty, indices of parsed files are saved there
+  // and reused on the next start instead of parsing files that haven't
+  // changed (same size and CRC32). CRC32s are saved there too and reused for
+  // files with the same size and modification time
   Loader(const fs::path& dataDir, const std::vector<fs::path>& fileNames,
          OnProgress onProgress = nullptr,
-         BufferType bufferType_ = BufferType::MappedBuffer);
+         BufferType bufferType_ = BufferType::MappedBuffer,
+         size_t numThreads = 0, const fs::path& indexCacheDir = {});
 
   Loader(const std::vector<fs::path>& filePaths_,
          OnProgress onProgress = nullptr,
-         BufferType bufferType_ = BufferType::MappedBuffer);
+         BufferType bufferType_ = BufferType::MappedBuffer,
+         size_t numThreads = 0, const fs::path& indexCacheDir = {});
 
   const espm::CombineBrowser& GetBrowser() const noexcept;
 
@@ -46,20 +57,33 @@ public:
     size_t size = 0;
   };
 
+  // CRC32s are computed on the first call unless known from loading
   std::map<std::string, FileInfo> GetFilesInfo() const;
 
+  // Heap usage of espm::Browser indices of each plugin
+  std::map<std::string, espm::Browser::MemoryUsage> GetIndexMemoryUsage()
+    const;
+
 private:
   std::vector<fs::path> MakeFilePaths(const fs::path& dataDir,
                                       const std::vector<fs::path>& fileNames);
 
   std::unique_ptr<IBuffer> MakeBuffer(const fs::path& filePath) const;
 
+  struct Entry;
+  void LoadEntry(const fs::path& filePath, Entry& entry) const;
+  void LoadBrowserWithIndexCache(const fs::path& filePath,
+                                 Entry& entry) const;
+  uint32_t GetCrc32WithCache(const fs::path& filePath,
+                             const Entry& entry) const;
+
   struct Entry
   {
     std::unique_ptr<IBuffer> buffer;
     std::unique_ptr<espm::Browser> browser;
 
     uintmax_t size = 0;
+    mutable std::optional<uint32_t> crc32;
     fs::path fileName = "";
     float readDuration = 0;
     float parseDuration = 0;
@@ -70,6 +94,8 @@ private:
   std::unique_ptr<espm::CombineBrowser> combineBrowser;
   std::vector<fs::path> filePaths;
   BufferType bufferType;
+  fs::path indexCacheDir;
+  mutable std::mutex filesInfoMutex;
 };
 
 template <class EspmProvider>
@@ -92,8 +118,10 @@ Type GetRecordType(uint32_t formId, EspmProvider* espmProvider)
   return lookupResult.rec->GetType();
 }
 
+// Returns a reference to memoized data for record types supported by
+// DecodedRecordsCache, a new object otherwise
 template <class RecordT, class EspmProvider>
-typename RecordT::Data GetData(uint32_t formId, EspmProvider* espmProvider)
+decltype(auto) GetData(uint32_t formId, EspmProvider* espmProvider)
 {
   if (!espmProvider) {
     throw std::runtime_error("Unable to find record without EspmProvider");
@@ -101,9 +129,6 @@ typename RecordT::Data GetData(uint32_t formId, EspmProvider* espmProvider)
 
   auto& espmLoader = espmProvider->GetEspm();
 
-  // That's why espmProvider is non-const: cache is mutable
-  espm::CompressedFieldsCache& espmCache = espmProvider->GetEspmCache();
-
   const espm::LookupResult lookupResult =
     espmLoader.GetBrowser().LookupById(formId);
 
@@ -119,7 +144,14 @@ typename RecordT::Data GetData(uint32_t formId, EspmProvider* espmProvider)
                   RecordT::kType, lookupResult.rec->GetType().ToString()));
   }
 
-  return convertedRecord->GetData(espmCache);
+  if constexpr (DecodedRecordsCache::kIsSupported<RecordT>) {
+    return espmLoader.GetBrowser().GetDecodedRecordsCache().GetData(
+      convertedRecord);
+  } else {
+    // That's why espmProvider is non-const: cache is mutable
+    espm::CompressedFieldsCache& espmCache = espmProvider->GetEspmCache();
+    return convertedRecord->GetData(espmCache);
+  }
 }
 
 } // namespace espm
@@ -0,0 +1,112 @@
+#include "PluginWriter.h"
+#include "ZlibUtils.h"
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+constexpr uint32_t kCompressed = 0x00040000;
+constexpr size_t kRecordHeaderSize = 24;
+}
+
+void espm::PluginWriter::BeginRecord(const char* type, uint32_t id,
+                                     uint32_t flags)
+{
+  recordStart = buf.size();
+  Write(type, 4);
+  WriteInt<uint32_t>(0); // dataSize, patched by EndRecord
+  WriteInt<uint32_t>(flags);
+  WriteInt<uint32_t>(id);
+  WriteInt<uint32_t>(0); // revision
+  WriteInt<uint16_t>(44);
+  WriteInt<uint16_t>(0);
+  ++numRecords;
+}
+
+void espm::PluginWriter::EndRecord()
+{
+  const auto dataSize =
+    static_cast<uint32_t>(buf.size() - recordStart - kRecordHeaderSize);
+  memcpy(&buf[recordStart + 4], &dataSize, sizeof(dataSize));
+}
+
+void espm::PluginWriter::WriteField(const char* type, const void* data,
+                                    uint32_t size)
+{
+  if (size > std::numeric_limits<uint16_t>::max()) {
+    Write("XXXX", 4);
+    WriteInt<uint16_t>(sizeof(size));
+    WriteInt<uint32_t>(size);
+    Write(type, 4);
+    WriteInt<uint16_t>(0);
+  } else {
+    Write(type, 4);
+    WriteInt<uint16_t>(static_cast<uint16_t>(size));
+  }
+  Write(data, size);
+}
+
+void espm::PluginWriter::WriteStringField(const char* type, const char* str)
+{
+  WriteField(type, str, static_cast<uint32_t>(strlen(str) + 1));
+}
+
+void espm::PluginWriter::WriteCompressedRecord(
+  const char* type, uint32_t id, uint32_t flags,
+  const PluginWriter& fieldsWriter)
+{
+  auto& fields = fieldsWriter.buf;
+
+  // Incompressible input grows by a few bytes per 16KB block
+  std::vector<char> compressed(fields.size() + fields.size() / 1000 + 128);
+  compressed.resize(ZlibCompress(fields.data(), fields.size(),
+                                 compressed.data(), compressed.size()));
+
+  BeginRecord(type, id, flags | kCompressed);
+  WriteInt<uint32_t>(static_cast<uint32_t>(fields.size()));
+  Write(compressed.data(), compressed.size());
+  EndRecord();
+}
+
+void espm::PluginWriter::BeginGroup(uint32_t label, GroupType groupType)
+{
+  groupStarts.push_back(buf.size());
+  Write("GRUP", 4);
+  WriteInt<uint32_t>(0); // groupSize, patched by EndGroup
+  WriteInt<uint32_t>(label);
+  WriteInt<uint32_t>(static_cast<uint32_t>(groupType));
+  WriteInt<uint64_t>(0);
+}
+
+void espm::PluginWriter::EndGroup()
+{
+  if (groupStarts.empty()) {
+    throw std::runtime_error("PluginWriter: EndGroup without BeginGroup");
+  }
+  const auto groupStart = groupStarts.back();
+  groupStarts.pop_back();
+  const auto groupSize = static_cast<uint32_t>(buf.size() - groupStart);
+  memcpy(&buf[groupStart + 4], &groupSize, sizeof(groupSize));
+}
+
+void espm::PluginWriter::Append(const PluginWriter& other)
+{
+  Write(other.buf.data(), other.buf.size());
+  numRecords += other.numRecords;
+}
+
+const std::vector<char>& espm::PluginWriter::GetBuffer() const noexcept
+{
+  return buf;
+}
+
+uint32_t espm::PluginWriter::GetNumRecords() const noexcept
+{
+  return numRecords;
+}
+
+void espm::PluginWriter::Write(const void* data, size_t size)
+{
+  auto p = reinterpret_cast<const char*>(data);
+  buf.insert(buf.end(), p, p + size);
+}
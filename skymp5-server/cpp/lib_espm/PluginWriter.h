@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "espm.h"
+
+namespace espm {
+
+// Serializes records and groups in the layout Browser parses
+class PluginWriter
+{
+public:
+  void BeginRecord(const char* type, uint32_t id, uint32_t flags = 0);
+  void EndRecord();
+
+  // Fields over 64KB are preceded by an XXXX field holding their size
+  void WriteField(const char* type, const void* data, uint32_t size);
+
+  template <class T>
+  void WriteField(const char* type, const T& value)
+  {
+    WriteField(type, &value, sizeof(value));
+  }
+
+  // Zero-terminated
+  void WriteStringField(const char* type, const char* str);
+
+  // Fields of the record are written by 'fieldsWriter' beforehand
+  void WriteCompressedRecord(const char* type, uint32_t id, uint32_t flags,
+                             const PluginWriter& fieldsWriter);
+
+  void BeginGroup(uint32_t label, GroupType groupType);
+  void EndGroup();
+
+  // Copies records and groups written by 'other'
+  void Append(const PluginWriter& other);
+
+  const std::vector<char>& GetBuffer() const noexcept;
+
+  // Number of records written, TES4 writes it to HEDR
+  uint32_t GetNumRecords() const noexcept;
+
+private:
+  void Write(const void* data, size_t size);
+
+  template <class T>
+  void WriteInt(T v)
+  {
+    Write(&v, sizeof(v));
+  }
+
+  std::vector<char> buf;
+  size_t recordStart = 0;
+  std::vector<size_t> groupStarts;
+  uint32_t numRecords = 0;
+};
+
+}
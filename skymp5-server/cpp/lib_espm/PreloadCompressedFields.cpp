@@ -0,0 +1,67 @@
+#include "PreloadCompressedFields.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace espm {
+
+size_t PreloadCompressedFields(const CombineBrowser& br,
+                               const std::vector<std::string>& types,
+                               CompressedFieldsCache& cache, size_t maxBytes,
+                               size_t numThreads)
+{
+  // Overridden records are never accessed, so they are not preloaded
+  std::vector<const RecordHeader*> records;
+  br.ForEachRecord([&](const LookupResult& lookupRes) {
+    auto type = lookupRes.rec->GetType();
+    if (std::any_of(types.begin(), types.end(),
+                    [&](const std::string& t) { return type == t.data(); })) {
+      records.push_back(lookupRes.rec);
+    }
+  });
+
+  std::atomic<size_t> nextRecord = 0;
+  std::atomic<size_t> numBytes = 0;
+  std::atomic<bool> failed = false;
+  std::exception_ptr exception;
+  std::mutex exceptionMutex;
+
+  auto work = [&] {
+    while (!failed && (maxBytes == 0 || numBytes < maxBytes)) {
+      const size_t i = nextRecord++;
+      if (i >= records.size()) {
+        break;
+      }
+      try {
+        numBytes += PreloadFields_(records[i], cache);
+      } catch (...) {
+        std::lock_guard l(exceptionMutex);
+        if (!failed.exchange(true)) {
+          exception = std::current_exception();
+        }
+      }
+    }
+  };
+
+  if (numThreads == 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  numThreads = std::min(numThreads, records.size());
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < numThreads; ++i) {
+    threads.emplace_back(work);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+  return numBytes;
+}
+
+}
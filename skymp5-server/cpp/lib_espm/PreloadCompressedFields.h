@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Combiner.h"
+
+namespace espm {
+
+// Decompresses fields of compressed records of 'types' into 'cache' using
+// worker threads, so later accesses don't pay for decompression. Preloaded
+// fields are pinned: they are never evicted and don't count toward the cache
+// size limit. Caches created with 'cache' as their parent use them too.
+// Stops after 'maxBytes' bytes were decompressed. 0 means no limit and one
+// thread per hardware thread respectively.
+// Returns the number of decompressed bytes. Throws std::runtime_error if a
+// record can't be decompressed
+size_t PreloadCompressedFields(const CombineBrowser& br,
+                               const std::vector<std::string>& types,
+                               CompressedFieldsCache& cache,
+                               size_t maxBytes = 0, size_t numThreads = 0);
+
+}
@@ -0,0 +1,605 @@
+#include "SyntheticPlugins.h"
+#include "PluginWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <stdexcept>
+
+namespace {
+constexpr uint32_t kMasterFile = 0x1;
+constexpr int32_t kCellSize = 4096;
+
+// Exterior cells are grouped into blocks of 32x32 and sub-blocks of 8x8 cells
+constexpr int32_t kBlockSize = 32;
+constexpr int32_t kSubBlockSize = 8;
+
+using espm::GroupType;
+using espm::PluginWriter;
+using espm::SyntheticPluginLayout;
+using espm::SyntheticPluginSettings;
+
+// std::uniform_*_distribution results differ between standard libraries,
+// plugins must not
+class Random
+{
+public:
+  explicit Random(uint32_t seed)
+    : engine(seed)
+  {
+  }
+
+  uint32_t Next(uint32_t n) { return n ? engine() % n : 0; }
+
+  float NextFloat(float max)
+  {
+    return static_cast<float>(engine() % 65536) / 65536.f * max;
+  }
+
+  bool NextPercent(uint32_t percent) { return Next(100) < percent; }
+
+  uint32_t NextElement(const std::vector<uint32_t>& elements)
+  {
+    return NextElement(elements, elements.size());
+  }
+
+  // One of the first 'count' elements
+  uint32_t NextElement(const std::vector<uint32_t>& elements, size_t count)
+  {
+    return count ? elements[Next(static_cast<uint32_t>(count))] : 0;
+  }
+
+private:
+  std::mt19937 engine;
+};
+
+uint32_t MakeLabel(const char* type)
+{
+  uint32_t res;
+  memcpy(&res, type, sizeof(res));
+  return res;
+}
+
+uint32_t MakeGridLabel(int32_t x, int32_t y)
+{
+  return static_cast<uint16_t>(y) |
+    (static_cast<uint32_t>(static_cast<uint16_t>(x)) << 16);
+}
+
+int32_t FloorDiv(int32_t a, int32_t b)
+{
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+std::string MakeEditorId(const char* prefix, uint32_t id)
+{
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%06X", id & 0x00ffffff);
+  return prefix + std::string(buf);
+}
+
+std::vector<uint32_t> MakeIds(uint32_t first, uint32_t count)
+{
+  std::vector<uint32_t> res(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    res[i] = first + i;
+  }
+  return res;
+}
+
+void Concat(std::vector<uint32_t>& to, const std::vector<uint32_t>& from)
+{
+  to.insert(to.end(), from.begin(), from.end());
+}
+
+void WriteItemFields(PluginWriter& w, uint32_t id, const char* name,
+                     Random& random)
+{
+  w.WriteStringField("EDID", MakeEditorId("SynthItem", id).data());
+  w.WriteStringField(
+    "MODL", ("Clutter\\Synthetic\\" + MakeEditorId("", id) + ".nif").data());
+  w.WriteStringField("FULL", name);
+  struct
+  {
+    uint32_t value;
+    float weight;
+  } data = { random.Next(500), random.NextFloat(10.f) };
+  w.WriteField("DATA", data);
+}
+
+void WriteItem(PluginWriter& w, uint32_t id, const char* name,
+               bool compressed, Random& random)
+{
+  if (compressed) {
+    PluginWriter fields;
+    WriteItemFields(fields, id, name, random);
+    w.WriteCompressedRecord("MISC", id, 0, fields);
+  } else {
+    w.BeginRecord("MISC", id);
+    WriteItemFields(w, id, name, random);
+    w.EndRecord();
+  }
+}
+
+void WriteStatic(PluginWriter& w, uint32_t id)
+{
+  w.BeginRecord("STAT", id);
+  w.WriteStringField("EDID", MakeEditorId("SynthStatic", id).data());
+  w.WriteField("OBND", espm::ObjectBounds{ { -64, -64, 0 }, { 64, 64, 128 } });
+  w.WriteStringField(
+    "MODL",
+    ("Architecture\\Synthetic\\" + MakeEditorId("", id) + ".nif").data());
+  w.EndRecord();
+}
+
+// The first 'numLists' of 'lists' may be referenced. They must not reference
+// the list being written, directly or not
+void WriteLeveledList(PluginWriter& w, uint32_t id,
+                      const std::vector<uint32_t>& items,
+                      const std::vector<uint32_t>& lists, size_t numLists,
+                      Random& random)
+{
+  w.BeginRecord("LVLI", id);
+  w.WriteStringField("EDID", MakeEditorId("SynthLeveledList", id).data());
+  w.WriteField("LVLD", static_cast<uint8_t>(random.Next(30)));
+  w.WriteField("LVLF", static_cast<uint8_t>(random.Next(4)));
+
+  const auto numEntries = static_cast<uint8_t>(1 + random.Next(8));
+  w.WriteField("LLCT", numEntries);
+  for (uint8_t i = 0; i < numEntries; ++i) {
+    const bool nested = numLists > 0 && random.NextPercent(25);
+    struct
+    {
+      uint32_t level;
+      uint32_t formId;
+      uint32_t count;
+    } entry = { 1 + random.Next(50),
+                nested ? random.NextElement(lists, numLists)
+                       : random.NextElement(items),
+                1 + random.Next(5) };
+    w.WriteField("LVLO", entry);
+  }
+  w.EndRecord();
+}
+
+void WriteContainer(PluginWriter& w, uint32_t id,
+                    const std::vector<uint32_t>& items,
+                    const std::vector<uint32_t>& lists, Random& random)
+{
+  w.BeginRecord("CONT", id);
+  w.WriteStringField("EDID", MakeEditorId("SynthContainer", id).data());
+  w.WriteStringField("FULL", "Chest");
+
+  const uint32_t numObjects = 1 + random.Next(8);
+  w.WriteField("COCT", numObjects);
+  for (uint32_t i = 0; i < numObjects; ++i) {
+    const bool leveled = !lists.empty() && random.NextPercent(50);
+    espm::CONT::ContainerObject object;
+    object.formId = random.NextElement(leveled ? lists : items);
+    object.count = 1 + random.Next(10);
+    w.WriteField("CNTO", object);
+  }
+  w.EndRecord();
+}
+
+void WriteRecipe(PluginWriter& w, uint32_t id,
+                 const std::vector<uint32_t>& items, uint32_t workbenchKeyword,
+                 Random& random)
+{
+  w.BeginRecord("COBJ", id);
+  w.WriteStringField("EDID", MakeEditorId("SynthRecipe", id).data());
+
+  const uint32_t numInputs = 1 + random.Next(4);
+  w.WriteField("COCT", numInputs);
+  for (uint32_t i = 0; i < numInputs; ++i) {
+    espm::COBJ::InputObject input;
+    input.formId = random.NextElement(items);
+    input.count = 1 + random.Next(3);
+    w.WriteField("CNTO", input);
+  }
+  w.WriteField("CNAM", random.NextElement(items));
+  w.WriteField("BNAM", workbenchKeyword);
+  w.WriteField("NAM1", static_cast<uint16_t>(1 + random.Next(2)));
+  w.EndRecord();
+}
+
+// A flat grid of triangles covering the cell
+void WriteNavMesh(PluginWriter& w, uint32_t id, uint32_t worldId, int32_t x,
+                  int32_t y, Random& random)
+{
+  constexpr int kVerticesPerSide = 5;
+  constexpr float kStep = kCellSize / (kVerticesPerSide - 1);
+
+  std::vector<char> nvnm;
+  auto append = [&](const void* data, size_t size) {
+    auto p = reinterpret_cast<const char*>(data);
+    nvnm.insert(nvnm.end(), p, p + size);
+  };
+
+  espm::CellOrGridPos gridPos;
+  gridPos.pos.x = static_cast<int16_t>(x);
+  gridPos.pos.y = static_cast<int16_t>(y);
+  const uint32_t header[4] = { 12, 0, worldId, gridPos.cellId };
+  append(header, sizeof(header));
+
+  std::vector<float> vertices;
+  for (int j = 0; j < kVerticesPerSide; ++j) {
+    for (int i = 0; i < kVerticesPerSide; ++i) {
+      vertices.push_back(x * kCellSize + i * kStep);
+      vertices.push_back(y * kCellSize + j * kStep);
+      vertices.push_back(random.NextFloat(64.f));
+    }
+  }
+
+  std::vector<espm::NAVM::Triangle> triangles;
+  auto addTriangle = [&](int a, int b, int c) {
+    espm::NAVM::Triangle triangle;
+    triangle.vertices[0] = static_cast<int16_t>(a);
+    triangle.vertices[1] = static_cast<int16_t>(b);
+    triangle.vertices[2] = static_cast<int16_t>(c);
+    std::fill(std::begin(triangle.edges), std::end(triangle.edges), -1);
+    triangles.push_back(triangle);
+  };
+  for (int j = 0; j + 1 < kVerticesPerSide; ++j) {
+    for (int i = 0; i + 1 < kVerticesPerSide; ++i) {
+      const int v = j * kVerticesPerSide + i;
+      addTriangle(v, v + 1, v + kVerticesPerSide + 1);
+      addTriangle(v, v + kVerticesPerSide + 1, v + kVerticesPerSide);
+    }
+  }
+
+  const auto numVertices = static_cast<int32_t>(vertices.size() / 3);
+  append(&numVertices, sizeof(numVertices));
+  append(vertices.data(), vertices.size() * sizeof(float));
+  const auto numTriangles = static_cast<int32_t>(triangles.size());
+  append(&numTriangles, sizeof(numTriangles));
+  append(triangles.data(), triangles.size() * sizeof(espm::NAVM::Triangle));
+
+  w.BeginRecord("NAVM", id);
+  w.WriteField("NVNM", nvnm.data(), static_cast<uint32_t>(nvnm.size()));
+  w.EndRecord();
+}
+
+void WriteReference(PluginWriter& w, uint32_t id, uint32_t baseId, int32_t x,
+                    int32_t y, Random& random)
+{
+  w.BeginRecord("REFR", id);
+  w.WriteField("NAME", baseId);
+  if (random.NextPercent(12)) {
+    w.WriteField("XSCL", 0.5f + random.NextFloat(1.f));
+  }
+  espm::REFR::LocationalData loc;
+  loc.pos[0] = x * kCellSize + random.NextFloat(kCellSize);
+  loc.pos[1] = y * kCellSize + random.NextFloat(kCellSize);
+  loc.pos[2] = random.NextFloat(256.f);
+  loc.rotRadians[0] = loc.rotRadians[1] = 0;
+  loc.rotRadians[2] = random.NextFloat(6.2831853f);
+  w.WriteField("DATA", loc);
+  w.EndRecord();
+}
+
+void WriteCell(PluginWriter& w, uint32_t id, int32_t x, int32_t y)
+{
+  w.BeginRecord("CELL", id);
+  w.WriteField("DATA", static_cast<uint16_t>(0));
+  const int32_t grid[3] = { x, y, 0 };
+  w.WriteField("XCLC", grid);
+  w.EndRecord();
+}
+
+// Calls 'writeCell' for cells in [min, max] x [min, max] grouped into blocks
+// and sub-blocks
+void WriteWorldChildren(PluginWriter& w, uint32_t worldId, int32_t min,
+                        int32_t max,
+                        const std::function<void(int32_t, int32_t)>& writeCell)
+{
+  w.BeginGroup(worldId, GroupType::WORLD_CHILDREN);
+  const int32_t minBlock = FloorDiv(min, kBlockSize);
+  const int32_t maxBlock = FloorDiv(max, kBlockSize);
+  constexpr int32_t kSubBlocksPerBlock = kBlockSize / kSubBlockSize;
+  for (int32_t by = minBlock; by <= maxBlock; ++by) {
+    for (int32_t bx = minBlock; bx <= maxBlock; ++bx) {
+      w.BeginGroup(MakeGridLabel(bx, by), GroupType::EXTERIOR_CELL_BLOCK);
+      auto subBlockRange = [&](int32_t block) {
+        return std::make_pair(
+          std::max(block * kSubBlocksPerBlock, FloorDiv(min, kSubBlockSize)),
+          std::min(block * kSubBlocksPerBlock + kSubBlocksPerBlock - 1,
+                   FloorDiv(max, kSubBlockSize)));
+      };
+      const auto [minSy, maxSy] = subBlockRange(by);
+      const auto [minSx, maxSx] = subBlockRange(bx);
+      for (int32_t sy = minSy; sy <= maxSy; ++sy) {
+        for (int32_t sx = minSx; sx <= maxSx; ++sx) {
+          w.BeginGroup(MakeGridLabel(sx, sy),
+                       GroupType::EXTERIOR_CELL_SUBBLOCK);
+          const int32_t maxY = std::min(sy * kSubBlockSize + 7, max);
+          const int32_t maxX = std::min(sx * kSubBlockSize + 7, max);
+          for (int32_t y = std::max(sy * kSubBlockSize, min); y <= maxY;
+               ++y) {
+            for (int32_t x = std::max(sx * kSubBlockSize, min); x <= maxX;
+                 ++x) {
+              writeCell(x, y);
+            }
+          }
+          w.EndGroup();
+        }
+      }
+      w.EndGroup();
+    }
+  }
+  w.EndGroup();
+}
+
+std::vector<char> WritePlugin(const PluginWriter& body, uint32_t flags,
+                              const std::vector<std::string>& masters,
+                              uint32_t nextObjectId)
+{
+  PluginWriter w;
+  w.BeginRecord("TES4", 0, flags);
+  espm::TES4::Header header;
+  header.version = 1.7f;
+  header.numRecords = static_cast<int32_t>(body.GetNumRecords());
+  header.nextObjectId = nextObjectId & 0x00ffffff;
+  w.WriteField("HEDR", header);
+  w.WriteStringField("CNAM", "espm_generator");
+  for (auto& master : masters) {
+    w.WriteStringField("MAST", master.data());
+    w.WriteField("DATA", static_cast<uint64_t>(0));
+  }
+  w.EndRecord();
+  w.Append(body);
+  return w.GetBuffer();
+}
+
+// Records of the master to override, if any
+struct Overrides
+{
+  const SyntheticPluginSettings* masterSettings = nullptr;
+  const SyntheticPluginLayout* masterLayout = nullptr;
+  uint32_t percent = 0;
+};
+
+std::vector<char> Generate(const SyntheticPluginSettings& settings,
+                           const std::vector<std::string>& masters,
+                           const Overrides& overrides)
+{
+  Random random(settings.seed);
+
+  const uint32_t fileIndex = static_cast<uint32_t>(masters.size());
+  const SyntheticPluginLayout layout(settings, fileIndex,
+                                     overrides.masterSettings);
+  const SyntheticPluginSettings noRecords = [] {
+    SyntheticPluginSettings res;
+    res.numWorldspaces = res.numCellsPerSide = res.numReferencesPerCell = 0;
+    res.numItems = res.numStatics = res.numLeveledLists = 0;
+    res.numContainers = res.numRecipes = res.numCompressedItems = 0;
+    return res;
+  }();
+  const auto& masterSettings =
+    overrides.masterSettings ? *overrides.masterSettings : noRecords;
+  const auto masterLayout = overrides.masterLayout
+    ? *overrides.masterLayout
+    : SyntheticPluginLayout(noRecords);
+
+  auto masterItems = MakeIds(masterLayout.firstItem, masterSettings.numItems);
+  auto masterLists =
+    MakeIds(masterLayout.firstLeveledList, masterSettings.numLeveledLists);
+  auto items = masterItems;
+  Concat(items, MakeIds(layout.firstItem, settings.numItems));
+  auto lists = masterLists;
+
+  auto bases = items;
+  Concat(bases, MakeIds(masterLayout.firstStatic, masterSettings.numStatics));
+  Concat(bases, MakeIds(layout.firstStatic, settings.numStatics));
+  Concat(bases,
+         MakeIds(masterLayout.firstContainer, masterSettings.numContainers));
+  Concat(bases, MakeIds(layout.firstContainer, settings.numContainers));
+
+  PluginWriter body;
+
+  body.BeginGroup(MakeLabel("KYWD"), GroupType::TOP);
+  body.BeginRecord("KYWD", layout.workbenchKeyword);
+  body.WriteStringField("EDID", "SynthCraftingWorkbench");
+  body.EndRecord();
+  body.EndGroup();
+
+  body.BeginGroup(MakeLabel("MISC"), GroupType::TOP);
+  for (uint32_t i = 0; i < masterSettings.numItems; ++i) {
+    if (random.NextPercent(overrides.percent)) {
+      WriteItem(body, masterItems[i], "Overridden item",
+                i < masterSettings.numCompressedItems, random);
+    }
+  }
+  for (uint32_t i = 0; i < settings.numItems; ++i) {
+    WriteItem(body, layout.firstItem + i, "Item",
+              i < settings.numCompressedItems, random);
+  }
+  body.EndGroup();
+
+  body.BeginGroup(MakeLabel("STAT"), GroupType::TOP);
+  for (uint32_t i = 0; i < settings.numStatics; ++i) {
+    WriteStatic(body, layout.firstStatic + i);
+  }
+  body.EndGroup();
+
+  // Lists reference lists written before them only, so there are no cycles
+  body.BeginGroup(MakeLabel("LVLI"), GroupType::TOP);
+  for (uint32_t i = 0; i < masterSettings.numLeveledLists; ++i) {
+    if (random.NextPercent(overrides.percent)) {
+      WriteLeveledList(body, masterLists[i], masterItems, masterLists, i,
+                       random);
+    }
+  }
+  for (uint32_t i = 0; i < settings.numLeveledLists; ++i) {
+    WriteLeveledList(body, layout.firstLeveledList + i, items, lists,
+                     lists.size(), random);
+    lists.push_back(layout.firstLeveledList + i);
+  }
+  body.EndGroup();
+
+  body.BeginGroup(MakeLabel("CONT"), GroupType::TOP);
+  for (uint32_t i = 0; i < masterSettings.numContainers; ++i) {
+    if (random.NextPercent(overrides.percent)) {
+      WriteContainer(body, masterLayout.firstContainer + i, items, lists,
+                     random);
+    }
+  }
+  for (uint32_t i = 0; i < settings.numContainers; ++i) {
+    WriteContainer(body, layout.firstContainer + i, items, lists, random);
+  }
+  body.EndGroup();
+
+  body.BeginGroup(MakeLabel("COBJ"), GroupType::TOP);
+  for (uint32_t i = 0; i < masterSettings.numRecipes; ++i) {
+    if (random.NextPercent(overrides.percent)) {
+      WriteRecipe(body, masterLayout.firstRecipe + i, items,
+                  masterLayout.workbenchKeyword, random);
+    }
+  }
+  for (uint32_t i = 0; i < settings.numRecipes; ++i) {
+    WriteRecipe(body, layout.firstRecipe + i, items, layout.workbenchKeyword,
+                random);
+  }
+  body.EndGroup();
+
+  // Override plugins place references into cells of the master
+  const bool ownWorlds = overrides.masterSettings == nullptr;
+  const auto& worldSettings = ownWorlds ? settings : masterSettings;
+  const auto& worldLayout = ownWorlds ? layout : masterLayout;
+  const int32_t min = worldLayout.GetMinCellCoord();
+  const int32_t max =
+    min + static_cast<int32_t>(worldSettings.numCellsPerSide) - 1;
+
+  body.BeginGroup(MakeLabel("WRLD"), GroupType::TOP);
+  for (uint32_t world = 0; world < worldSettings.numWorldspaces; ++world) {
+    const uint32_t worldId = worldLayout.GetWorldId(world);
+    body.BeginRecord("WRLD", worldId);
+    body.WriteStringField("EDID",
+                          ("SynthWorld" + std::to_string(world)).data());
+    body.EndRecord();
+
+    WriteWorldChildren(body, worldId, min, max, [&](int32_t x, int32_t y) {
+      const uint32_t cellId = worldLayout.GetCellId(world, x, y);
+      WriteCell(body, cellId, x, y);
+      body.BeginGroup(cellId, GroupType::CELL_CHILDREN);
+      body.BeginGroup(cellId, GroupType::CELL_TEMPORARY_CHILDREN);
+      if (ownWorlds && settings.navMeshes) {
+        WriteNavMesh(body, layout.GetNavMeshId(world, x, y), worldId, x, y,
+                     random);
+      }
+      for (uint32_t i = 0; i < masterSettings.numReferencesPerCell; ++i) {
+        if (random.NextPercent(overrides.percent)) {
+          WriteReference(body, masterLayout.GetReferenceId(world, x, y, i),
+                         random.NextElement(bases), x, y, random);
+        }
+      }
+      for (uint32_t i = 0; i < settings.numReferencesPerCell; ++i) {
+        WriteReference(body, layout.GetReferenceId(world, x, y, i),
+                       random.NextElement(bases), x, y, random);
+      }
+      body.EndGroup();
+      body.EndGroup();
+    });
+  }
+  body.EndGroup();
+
+  return WritePlugin(body, masters.empty() ? kMasterFile : 0, masters,
+                     layout.end);
+}
+}
+
+espm::SyntheticPluginLayout::SyntheticPluginLayout(
+  const SyntheticPluginSettings& settings, uint32_t fileIndex,
+  const SyntheticPluginSettings* masterSettings)
+{
+  const auto& worldSettings = masterSettings ? *masterSettings : settings;
+  numCellsPerSide = worldSettings.numCellsPerSide;
+  numReferencesPerCell = settings.numReferencesPerCell;
+
+  const uint64_t numCells = static_cast<uint64_t>(
+                              worldSettings.numWorldspaces) *
+    numCellsPerSide * numCellsPerSide;
+  const bool ownWorlds = masterSettings == nullptr;
+
+  uint64_t next = 0x800;
+  auto allocate = [&](uint64_t count) {
+    const uint64_t res = next;
+    next += count;
+    if (next > 0x00ffffff) {
+      throw std::runtime_error(
+        "SyntheticPluginLayout: too many records for a single plugin");
+    }
+    return (fileIndex << 24) | static_cast<uint32_t>(res);
+  };
+
+  workbenchKeyword = allocate(1);
+  firstItem = allocate(settings.numItems);
+  firstStatic = allocate(settings.numStatics);
+  firstLeveledList = allocate(settings.numLeveledLists);
+  firstContainer = allocate(settings.numContainers);
+  firstRecipe = allocate(settings.numRecipes);
+  firstWorld = allocate(ownWorlds ? settings.numWorldspaces : 0);
+  firstCell = allocate(ownWorlds ? numCells : 0);
+  firstNavMesh = allocate(ownWorlds && settings.navMeshes ? numCells : 0);
+  firstReference = allocate(numCells * numReferencesPerCell);
+  end = allocate(0);
+}
+
+uint32_t espm::SyntheticPluginLayout::GetWorldId(uint32_t world) const
+  noexcept
+{
+  return firstWorld + world;
+}
+
+uint32_t espm::SyntheticPluginLayout::GetCellId(uint32_t world, int32_t x,
+                                                 int32_t y) const noexcept
+{
+  return firstCell + GetCellIndex(world, x, y);
+}
+
+uint32_t espm::SyntheticPluginLayout::GetNavMeshId(uint32_t world, int32_t x,
+                                                    int32_t y) const noexcept
+{
+  return firstNavMesh + GetCellIndex(world, x, y);
+}
+
+uint32_t espm::SyntheticPluginLayout::GetReferenceId(uint32_t world,
+                                                      int32_t x, int32_t y,
+                                                      uint32_t i) const
+  noexcept
+{
+  return firstReference + GetCellIndex(world, x, y) * numReferencesPerCell +
+    i;
+}
+
+int32_t espm::SyntheticPluginLayout::GetMinCellCoord() const noexcept
+{
+  return -static_cast<int32_t>(numCellsPerSide / 2);
+}
+
+uint32_t espm::SyntheticPluginLayout::GetCellIndex(uint32_t world, int32_t x,
+                                                    int32_t y) const noexcept
+{
+  const int32_t min = GetMinCellCoord();
+  return (world * numCellsPerSide + static_cast<uint32_t>(y - min)) *
+    numCellsPerSide +
+    static_cast<uint32_t>(x - min);
+}
+
+std::vector<char> espm::GenerateSyntheticMaster(
+  const SyntheticPluginSettings& settings)
+{
+  return Generate(settings, {}, Overrides());
+}
+
+std::vector<char> espm::GenerateSyntheticOverride(
+  const SyntheticPluginSettings& settings, const std::string& masterName,
+  const SyntheticPluginSettings& masterSettings, uint32_t overridePercent)
+{
+  const SyntheticPluginLayout masterLayout(masterSettings);
+  Overrides overrides;
+  overrides.masterSettings = &masterSettings;
+  overrides.masterLayout = &masterLayout;
+  overrides.percent = overridePercent;
+  return Generate(settings, { masterName }, overrides);
+}
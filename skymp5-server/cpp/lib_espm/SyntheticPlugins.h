@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace espm {
+
+// Plugins resembling game data in structure, for tests and benchmarks that
+// can't rely on Skyrim.esm. Output depends on settings only
+struct SyntheticPluginSettings
+{
+  uint32_t numWorldspaces = 1;
+
+  // Worldspaces are square grids of exterior cells centered at (0, 0)
+  uint32_t numCellsPerSide = 8;
+
+  uint32_t numReferencesPerCell = 32;
+  uint32_t numItems = 256;
+  uint32_t numStatics = 64;
+  uint32_t numLeveledLists = 64;
+  uint32_t numContainers = 64;
+  uint32_t numRecipes = 128;
+
+  // The first 'numCompressedItems' items are written as compressed records
+  uint32_t numCompressedItems = 64;
+
+  // One NAVM per cell
+  bool navMeshes = true;
+
+  uint32_t seed = 0;
+};
+
+// Form ids of records of a generated plugin as seen by the plugin itself
+class SyntheticPluginLayout
+{
+public:
+  // 'masterSettings' must be passed for plugins generated by
+  // GenerateSyntheticOverride, they place references into the master's cells
+  // and have no worldspaces of their own
+  explicit SyntheticPluginLayout(
+    const SyntheticPluginSettings& settings, uint32_t fileIndex = 0,
+    const SyntheticPluginSettings* masterSettings = nullptr);
+
+  uint32_t GetWorldId(uint32_t world) const noexcept;
+  uint32_t GetCellId(uint32_t world, int32_t x, int32_t y) const noexcept;
+  uint32_t GetNavMeshId(uint32_t world, int32_t x, int32_t y) const noexcept;
+  uint32_t GetReferenceId(uint32_t world, int32_t x, int32_t y,
+                          uint32_t i) const noexcept;
+
+  // Cells of each worldspace have coordinates in [min, min + numCellsPerSide)
+  int32_t GetMinCellCoord() const noexcept;
+
+  uint32_t workbenchKeyword = 0;
+  uint32_t firstItem = 0;
+  uint32_t firstStatic = 0;
+  uint32_t firstLeveledList = 0;
+  uint32_t firstContainer = 0;
+  uint32_t firstRecipe = 0;
+  uint32_t firstWorld = 0;
+  uint32_t firstCell = 0;
+  uint32_t firstNavMesh = 0;
+  uint32_t firstReference = 0;
+  uint32_t end = 0;
+
+private:
+  uint32_t GetCellIndex(uint32_t world, int32_t x, int32_t y) const noexcept;
+
+  uint32_t numCellsPerSide = 0;
+  uint32_t numReferencesPerCell = 0;
+};
+
+std::vector<char> GenerateSyntheticMaster(
+  const SyntheticPluginSettings& settings);
+
+// Plugin with the single master 'masterName' generated with
+// 'masterSettings'. Overrides 'overridePercent' percents of the master's
+// records and adds records described by 'settings'. New references are
+// placed into the master's cells, worldspace settings of 'settings' are
+// ignored
+std::vector<char> GenerateSyntheticOverride(
+  const SyntheticPluginSettings& settings, const std::string& masterName,
+  const SyntheticPluginSettings& masterSettings, uint32_t overridePercent);
+
+}
@@ -18,7 +18,9 @@ inline void ZlibDecompress(const void* in, size_t inSize, void* out,
 
   inflateInit(&infstream);
 
-  int res = inflate(&infstream, Z_NO_FLUSH);
+  // The output buffer fits everything, so Z_FINISH lets zlib inflate in one
+  // step without maintaining the sliding window
+  int res = inflate(&infstream, Z_FINISH);
   if (res < Z_OK)
     throw std::runtime_error("inflate() failed with code " +
                              std::to_string(res));
@@ -1,12 +1,18 @@
 #include "ZlibUtils.h"
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <fmt/format.h>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sparsepp/spp.h>
+#include <thread>
 
 #include "GroupUtils.h"
 #include "espm.h"
@@ -73,19 +79,215 @@ const std::map<std::string, uint32_t> kCorrectHashcode{
 
 namespace espm {
 
+struct FieldIndexEntry
+{
+  uint32_t type = 0;
+
+  // Relative to the beginning of the (decompressed) fields
+  uint32_t offset = 0;
+
+  uint32_t size = 0;
+
+  friend bool operator<(const FieldIndexEntry& lhs, const FieldIndexEntry& rhs)
+  {
+    return std::tie(lhs.type, lhs.offset) < std::tie(rhs.type, rhs.offset);
+  }
+};
+
+// Sorted by type, then by offset
+using FieldIndex = std::vector<FieldIndexEntry>;
+
 struct CompressedFieldsCache::Impl
 {
+  static constexpr size_t kNumShards = 16;
+
+  using Value = std::shared_ptr<std::vector<uint8_t>>;
+  using FieldIndexPtr = std::shared_ptr<const FieldIndex>;
+
+  // Either member may be missing: uncompressed records have field indices
+  // only, and fields may be decompressed again after the entry was evicted
   struct Entry
   {
-    std::shared_ptr<std::vector<uint8_t>> decompressedFieldsHolder;
+    Value decompressedFieldsHolder;
+    FieldIndexPtr fieldIndex;
+    size_t numBytes = 0;
+
+    // Pinned entries are not in the LRU list
+    bool pinned = false;
+    std::list<const RecordHeader*>::iterator lruIt;
   };
 
-  spp::sparse_hash_map<const RecordHeader*, Entry> data;
+  struct Shard
+  {
+    std::mutex m;
+    spp::sparse_hash_map<const RecordHeader*, Entry> data;
+
+    // Most recently used first
+    std::list<const RecordHeader*> lru;
+
+    // Bytes of pinned entries are not included
+    size_t numBytes = 0;
+    size_t numPinnedBytes = 0;
+
+    // Freed by ReleaseEvicted since callers may still use them
+    std::vector<Value> evicted;
+  };
+
+  std::array<Shard, kNumShards> shards;
+  CompressedFieldsCache* parent = nullptr;
+  std::atomic<size_t> maxBytes = 0;
+  std::atomic<uint64_t> numHits = 0, numMisses = 0, numEvictions = 0;
+
+  Shard& GetShard(const RecordHeader* rec)
+  {
+    const auto h =
+      reinterpret_cast<uintptr_t>(rec) * uint64_t(0x9e3779b97f4a7c15);
+    return shards[(h >> 32) % kNumShards];
+  }
+
+  // Lookups on behalf of child caches are not counted
+  Value Find(const RecordHeader* rec, bool countStats = true)
+  {
+    auto& shard = GetShard(rec);
+    std::lock_guard l(shard.m);
+    auto it = shard.data.find(rec);
+    if (it == shard.data.end() || !it->second.decompressedFieldsHolder) {
+      numMisses += countStats;
+      return nullptr;
+    }
+    numHits += countStats;
+    MarkUsed(shard, it->second);
+    return it->second.decompressedFieldsHolder;
+  }
+
+  // Returns the value inserted by another thread if there is one
+  Value Insert(const RecordHeader* rec, Value value, bool pin = false)
+  {
+    auto& shard = GetShard(rec);
+    std::lock_guard l(shard.m);
+    auto& entry = Touch(shard, rec);
+    if (pin) {
+      Pin(shard, entry);
+    }
+    if (entry.decompressedFieldsHolder) {
+      return entry.decompressedFieldsHolder;
+    }
+    entry.decompressedFieldsHolder = value;
+    AddBytes(shard, entry, value->size());
+    EvictIfNeeded(shard);
+    return value;
+  }
+
+  // Returns false if there are no decompressed fields to pin
+  bool Pin(const RecordHeader* rec)
+  {
+    auto& shard = GetShard(rec);
+    std::lock_guard l(shard.m);
+    auto it = shard.data.find(rec);
+    if (it == shard.data.end() || !it->second.decompressedFieldsHolder) {
+      return false;
+    }
+    Pin(shard, it->second);
+    return true;
+  }
+
+  void Pin(Shard& shard, Entry& entry)
+  {
+    if (entry.pinned) {
+      return;
+    }
+    entry.pinned = true;
+    shard.lru.erase(entry.lruIt);
+    shard.numBytes -= entry.numBytes;
+    shard.numPinnedBytes += entry.numBytes;
+  }
+
+  FieldIndexPtr FindFieldIndex(const RecordHeader* rec)
+  {
+    auto& shard = GetShard(rec);
+    std::lock_guard l(shard.m);
+    auto it = shard.data.find(rec);
+    if (it == shard.data.end() || !it->second.fieldIndex) {
+      return nullptr;
+    }
+    MarkUsed(shard, it->second);
+    return it->second.fieldIndex;
+  }
+
+  // Returns the index inserted by another thread if there is one
+  FieldIndexPtr InsertFieldIndex(const RecordHeader* rec, FieldIndexPtr index)
+  {
+    auto& shard = GetShard(rec);
+    std::lock_guard l(shard.m);
+    auto& entry = Touch(shard, rec);
+    if (entry.fieldIndex) {
+      return entry.fieldIndex;
+    }
+    entry.fieldIndex = index;
+    AddBytes(shard, entry, index->size() * sizeof(FieldIndexEntry));
+    EvictIfNeeded(shard);
+    return index;
+  }
+
+  // Finds or creates an entry and makes it the most recently used one
+  Entry& Touch(Shard& shard, const RecordHeader* rec)
+  {
+    auto [it, inserted] = shard.data.emplace(rec, Entry());
+    if (inserted) {
+      shard.lru.push_front(rec);
+      it->second.lruIt = shard.lru.begin();
+    } else {
+      MarkUsed(shard, it->second);
+    }
+    return it->second;
+  }
+
+  void MarkUsed(Shard& shard, Entry& entry)
+  {
+    if (!entry.pinned) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, entry.lruIt);
+    }
+  }
+
+  void AddBytes(Shard& shard, Entry& entry, size_t numBytes)
+  {
+    entry.numBytes += numBytes;
+    (entry.pinned ? shard.numPinnedBytes : shard.numBytes) += numBytes;
+  }
+
+  // The most recently used entry is kept even if it alone exceeds the limit
+  void EvictIfNeeded(Shard& shard)
+  {
+    const size_t max = maxBytes;
+    if (max == 0) {
+      return;
+    }
+    const size_t maxShardBytes = std::max<size_t>(max / kNumShards, 1);
+    while (shard.numBytes > maxShardBytes && shard.lru.size() > 1) {
+      auto it = shard.data.find(shard.lru.back());
+      shard.numBytes -= it->second.numBytes;
+      if (it->second.decompressedFieldsHolder) {
+        shard.evicted.push_back(
+          std::move(it->second.decompressedFieldsHolder));
+      }
+      shard.data.erase(it);
+      shard.lru.pop_back();
+      ++numEvictions;
+    }
+  }
 };
 
 CompressedFieldsCache::CompressedFieldsCache()
+  : CompressedFieldsCache(0)
+{
+}
+
+CompressedFieldsCache::CompressedFieldsCache(size_t maxBytes,
+                                             CompressedFieldsCache* parent)
   : pImpl(new Impl)
 {
+  pImpl->maxBytes = maxBytes;
+  pImpl->parent = parent;
 }
 
 CompressedFieldsCache::~CompressedFieldsCache()
@@ -93,6 +295,61 @@ CompressedFieldsCache::~CompressedFieldsCache()
   delete pImpl;
 }
 
+void CompressedFieldsCache::SetMaxBytes(size_t maxBytes)
+{
+  pImpl->maxBytes = maxBytes;
+  for (auto& shard : pImpl->shards) {
+    std::lock_guard l(shard.m);
+    pImpl->EvictIfNeeded(shard);
+  }
+}
+
+size_t CompressedFieldsCache::GetMaxBytes() const noexcept
+{
+  return pImpl->maxBytes;
+}
+
+CompressedFieldsCache::Stats CompressedFieldsCache::GetStats() const
+{
+  Stats res;
+  res.numHits = pImpl->numHits;
+  res.numMisses = pImpl->numMisses;
+  res.numEvictions = pImpl->numEvictions;
+  for (auto& shard : pImpl->shards) {
+    std::lock_guard l(shard.m);
+    res.numEntries += shard.data.size();
+    res.numBytes += shard.numBytes + shard.numPinnedBytes;
+    res.numPinnedBytes += shard.numPinnedBytes;
+    for (auto& value : shard.evicted) {
+      res.numEvictedBytes += value->size();
+    }
+  }
+  return res;
+}
+
+void CompressedFieldsCache::ReleaseEvicted()
+{
+  for (auto& shard : pImpl->shards) {
+    std::vector<Impl::Value> evicted;
+    {
+      std::lock_guard l(shard.m);
+      evicted.swap(shard.evicted);
+    }
+  }
+}
+
+void CompressedFieldsCache::Clear()
+{
+  for (auto& shard : pImpl->shards) {
+    std::lock_guard l(shard.m);
+    shard.data.clear();
+    shard.lru.clear();
+    shard.numBytes = 0;
+    shard.numPinnedBytes = 0;
+    shard.evicted.clear();
+  }
+}
+
 #pragma pack(push, 1)
 struct FieldHeader
 {
@@ -102,9 +359,41 @@ struct FieldHeader
 static_assert(sizeof(FieldHeader) == 6);
 #pragma pack(pop)
 
+// Chunks are hashed concurrently and their CRC32s combined. Hardware CRC32
+// instructions implement CRC-32C, a different polynomial, so zlib does the
+// hashing itself
 uint32_t CalculateHashcode(const void* readBuffer, size_t length)
 {
-  return ZlibGetCRC32Checksum(readBuffer, length);
+  constexpr size_t kMinChunkSize = 8 * 1024 * 1024;
+  constexpr size_t kMaxChunkSize = 1024 * 1024 * 1024; // Fits z_off_t
+
+  const size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t numChunks =
+    std::max(std::min(numThreads, length / kMinChunkSize),
+             length / kMaxChunkSize + 1);
+  if (numChunks < 2) {
+    return ZlibGetCRC32Checksum(readBuffer, length);
+  }
+
+  auto p = static_cast<const char*>(readBuffer);
+  const size_t chunkSize = length / numChunks;
+  auto getChunkSize = [&](size_t i) {
+    return i + 1 == numChunks ? length - chunkSize * i : chunkSize;
+  };
+
+  std::vector<std::future<uLong>> chunkHashes;
+  for (size_t i = 1; i < numChunks; ++i) {
+    chunkHashes.push_back(std::async(std::launch::async, [=] {
+      return ZlibGetCRC32Checksum(p + chunkSize * i, getChunkSize(i));
+    }));
+  }
+
+  auto hash = ZlibGetCRC32Checksum(p, chunkSize);
+  for (size_t i = 1; i < numChunks; ++i) {
+    hash = crc32_combine(hash, chunkHashes[i - 1].get(),
+                         static_cast<z_off_t>(getChunkSize(i)));
+  }
+  return static_cast<uint32_t>(hash);
 }
 
 uint32_t GetCorrectHashcode(const std::string& fileName)
@@ -150,16 +439,6 @@ enum RecordFlags : uint32_t
   REFR_BultiBound = 0x80000000,
 };
 
-namespace espm {
-struct GroupDataInternal
-{
-  // Records and GRUPs
-  // Pointing to type (record type or "GRUP"), it's RecordHeader/GroupHeader -
-  // 4 bytes
-  std::vector<void*> subs;
-};
-}
-
 bool espm::GroupHeader::GetXY(int16_t& outX, int16_t& outY) const noexcept
 {
   if (grType == GroupType::EXTERIOR_CELL_BLOCK ||
@@ -249,35 +528,83 @@ uint32_t espm::RecordHeader::GetId() const noexcept
 class espm::RecordHeaderAccess
 {
 public:
-  template <class T>
-  static void IterateFields(const espm::RecordHeader* rec, const T& f,
-                            espm::CompressedFieldsCache& compressedFieldsCache)
+  // Sets [outBegin, outEnd) to the fields of 'rec'. Decompressed fields are
+  // kept alive by 'outHolder' even if another thread evicts them from the
+  // cache
+  static void GetFields(const espm::RecordHeader* rec,
+                        espm::CompressedFieldsCache& compressedFieldsCache,
+                        std::shared_ptr<std::vector<uint8_t>>& outHolder,
+                        const int8_t*& outBegin, const int8_t*& outEnd)
   {
     const int8_t* ptr = ((int8_t*)rec) + sizeof(*rec);
-    const int8_t* endPtr = ptr + rec->GetFieldsSizeSum();
-    uint32_t fiDataSizeOverride = 0;
+    outBegin = ptr;
+    outEnd = ptr + rec->GetFieldsSizeSum();
 
-    if (rec->flags & RecordFlags::Compressed) {
-      auto& decompressedFieldsHolder =
-        compressedFieldsCache.pImpl->data[rec].decompressedFieldsHolder;
-      if (!decompressedFieldsHolder) {
+    if (!(rec->flags & RecordFlags::Compressed)) {
+      return;
+    }
 
-        const uint32_t* decompSize = reinterpret_cast<const uint32_t*>(ptr);
-        ptr += sizeof(uint32_t);
+    auto& cacheImpl = *compressedFieldsCache.pImpl;
+    outHolder = cacheImpl.Find(rec);
+    if (!outHolder) {
+      if (cacheImpl.parent) {
+        outHolder = cacheImpl.parent->pImpl->Find(rec, false);
+      }
+      outHolder =
+        cacheImpl.Insert(rec, outHolder ? outHolder : Decompress(rec));
+    }
 
-        auto out = std::make_shared<std::vector<uint8_t>>();
-        out->resize(*decompSize);
+    outBegin = reinterpret_cast<int8_t*>(outHolder->data());
+    outEnd = reinterpret_cast<int8_t*>(outHolder->data() + outHolder->size());
+  }
 
-        const auto inSize = rec->GetFieldsSizeSum() - sizeof(uint32_t);
-        ZlibDecompress(ptr, inSize, out->data(), out->size());
+  static std::shared_ptr<std::vector<uint8_t>> Decompress(
+    const espm::RecordHeader* rec)
+  {
+    const int8_t* ptr = ((int8_t*)rec) + sizeof(*rec);
 
-        decompressedFieldsHolder = out;
-      }
+    const uint32_t* decompSize = reinterpret_cast<const uint32_t*>(ptr);
+    ptr += sizeof(uint32_t);
 
-      ptr = reinterpret_cast<int8_t*>(decompressedFieldsHolder->data());
-      endPtr = reinterpret_cast<int8_t*>(decompressedFieldsHolder->data() +
-                                         decompressedFieldsHolder->size());
+    auto out = std::make_shared<std::vector<uint8_t>>();
+    out->resize(*decompSize);
+
+    const auto inSize = rec->GetFieldsSizeSum() - sizeof(uint32_t);
+    ZlibDecompress(ptr, inSize, out->data(), out->size());
+    return out;
+  }
+
+  static size_t PreloadFields(
+    const espm::RecordHeader* rec,
+    espm::CompressedFieldsCache& compressedFieldsCache)
+  {
+    if (!(rec->flags & RecordFlags::Compressed)) {
+      return 0;
+    }
+    auto& cacheImpl = *compressedFieldsCache.pImpl;
+    if (cacheImpl.Pin(rec)) {
+      return 0;
     }
+    auto out = Decompress(rec);
+    return cacheImpl.Insert(rec, out, true) == out ? out->size() : 0;
+  }
+
+  template <class T>
+  static void IterateFields(const espm::RecordHeader* rec, const T& f,
+                            espm::CompressedFieldsCache& compressedFieldsCache)
+  {
+    std::shared_ptr<std::vector<uint8_t>> decompressedFieldsHolder;
+    const int8_t *begin, *end;
+    GetFields(rec, compressedFieldsCache, decompressedFieldsHolder, begin,
+              end);
+    IterateFields(begin, end, f);
+  }
+
+  template <class T>
+  static void IterateFields(const int8_t* ptr, const int8_t* endPtr,
+                            const T& f)
+  {
+    uint32_t fiDataSizeOverride = 0;
 
     while (ptr < endPtr) {
       const auto fiHeader = (FieldHeader*)ptr;
@@ -293,6 +620,41 @@ public:
       f(fiHeader->type, fiDataSize, fiData);
     }
   }
+
+  template <class T>
+  static void FindFields(const espm::RecordHeader* rec, const char* type,
+                         espm::CompressedFieldsCache& compressedFieldsCache,
+                         const T& f)
+  {
+    std::shared_ptr<std::vector<uint8_t>> decompressedFieldsHolder;
+    const int8_t *begin, *end;
+    GetFields(rec, compressedFieldsCache, decompressedFieldsHolder, begin,
+              end);
+
+    auto& cacheImpl = *compressedFieldsCache.pImpl;
+    auto index = cacheImpl.FindFieldIndex(rec);
+    if (!index) {
+      auto newIndex = std::make_shared<FieldIndex>();
+      IterateFields(
+        begin, end,
+        [&](const char* fieldType, uint32_t size, const char* data) {
+          FieldIndexEntry entry;
+          memcpy(&entry.type, fieldType, sizeof(entry.type));
+          entry.offset = static_cast<uint32_t>(data - (const char*)begin);
+          entry.size = size;
+          newIndex->push_back(entry);
+        });
+      std::sort(newIndex->begin(), newIndex->end());
+      index = cacheImpl.InsertFieldIndex(rec, newIndex);
+    }
+
+    FieldIndexEntry key;
+    memcpy(&key.type, type, sizeof(key.type));
+    auto it = std::lower_bound(index->begin(), index->end(), key);
+    for (; it != index->end() && it->type == key.type; ++it) {
+      f(espm::FieldRef{ (const char*)begin + it->offset, it->size });
+    }
+  }
 };
 
 void espm::IterateFields_(const espm::RecordHeader* rec,
@@ -302,18 +664,40 @@ void espm::IterateFields_(const espm::RecordHeader* rec,
   espm::RecordHeaderAccess::IterateFields(rec, f, compressedFieldsCache);
 }
 
+size_t espm::PreloadFields_(const espm::RecordHeader* rec,
+                            espm::CompressedFieldsCache& compressedFieldsCache)
+{
+  return espm::RecordHeaderAccess::PreloadFields(rec, compressedFieldsCache);
+}
+
+espm::FieldRef espm::RecordHeader::FindField(
+  const char* type, espm::CompressedFieldsCache& compressedFieldsCache) const
+{
+  FieldRef res;
+  espm::RecordHeaderAccess::FindFields(
+    this, type, compressedFieldsCache, [&](const FieldRef& field) {
+      if (!res.data) {
+        res = field;
+      }
+    });
+  return res;
+}
+
+std::vector<espm::FieldRef> espm::RecordHeader::FindFields(
+  const char* type, espm::CompressedFieldsCache& compressedFieldsCache) const
+{
+  std::vector<FieldRef> res;
+  espm::RecordHeaderAccess::FindFields(
+    this, type, compressedFieldsCache,
+    [&](const FieldRef& field) { res.push_back(field); });
+  return res;
+}
+
 const char* espm::RecordHeader::GetEditorId(
   espm::CompressedFieldsCache& compressedFieldsCache) const noexcept
 {
-  const char* result = "";
-  espm::RecordHeaderAccess::IterateFields(
-    this,
-    [&](const char* type, uint32_t dataSize, const char* data) {
-      if (!memcmp(type, "EDID", 4))
-        result = data;
-    },
-    compressedFieldsCache);
-  return result;
+  auto edid = FindField("EDID", compressedFieldsCache);
+  return edid ? edid.data : "";
 }
 
 namespace {
@@ -420,22 +804,19 @@ void espm::RecordHeader::GetScriptData(
 {
   ScriptData res;
 
-  espm::RecordHeaderAccess::IterateFields(
-    this,
-    [&](const char* type, uint32_t dataSize, const char* data) {
-      if (!memcmp(type, "VMAD", 4)) {
-        res.version = *reinterpret_cast<const uint16_t*>(data);
-        res.objFormat = *reinterpret_cast<const uint16_t*>(
-          (reinterpret_cast<const uint8_t*>(data) + 2));
-        const uint16_t scriptCount = *reinterpret_cast<const uint16_t*>(
-          (reinterpret_cast<const uint8_t*>(data) + 4));
-
-        auto p = reinterpret_cast<const uint8_t*>(data) + 6;
-        res.scripts.resize(scriptCount);
-        FillScriptArray(p, res.scripts, res.objFormat);
-      }
-    },
-    compressedFieldsCache);
+  espm::RecordHeaderAccess::FindFields(
+    this, "VMAD", compressedFieldsCache, [&](const FieldRef& vmad) {
+      const char* data = vmad.data;
+      res.version = *reinterpret_cast<const uint16_t*>(data);
+      res.objFormat = *reinterpret_cast<const uint16_t*>(
+        (reinterpret_cast<const uint8_t*>(data) + 2));
+      const uint16_t scriptCount = *reinterpret_cast<const uint16_t*>(
+        (reinterpret_cast<const uint8_t*>(data) + 4));
+
+      auto p = reinterpret_cast<const uint8_t*>(data) + 6;
+      res.scripts.resize(scriptCount);
+      FillScriptArray(p, res.scripts, res.objFormat);
+    });
 
   *out = res;
 }
@@ -444,20 +825,21 @@ std::vector<uint32_t> espm::RecordHeader::GetKeywordIds(
   espm::CompressedFieldsCache& compressedFieldsCache) const noexcept
 {
   std::vector<uint32_t> res;
+
   uint32_t count = 0;
 
-  espm::RecordHeaderAccess::IterateFields(
-    this,
-    [&](const char* type, uint32_t dataSize, const char* data) {
-      if (!memcmp(type, "KSIZ", 4)) {
-        count = *reinterpret_cast<const uint32_t*>(data);
-      }
-      if (!memcmp(type, "KWDA", 4)) {
-        for (uint32_t i = 0; i < count; ++i)
-          res.push_back(reinterpret_cast<const uint32_t*>(data)[i]);
-      }
-    },
-    compressedFieldsCache);
+  // Copying inside callbacks keeps decompressed fields alive meanwhile
+  espm::RecordHeaderAccess::FindFields(
+    this, "KSIZ", compressedFieldsCache, [&](const FieldRef& ksiz) {
+      count = *reinterpret_cast<const uint32_t*>(ksiz.data);
+    });
+  if (count > 0) {
+    espm::RecordHeaderAccess::FindFields(
+      this, "KWDA", compressedFieldsCache, [&](const FieldRef& kwda) {
+        auto ids = reinterpret_cast<const uint32_t*>(kwda.data);
+        res.assign(ids, ids + count);
+      });
+  }
 
   return res;
 }
@@ -478,61 +860,218 @@ uint32_t espm::RecordHeader::GetFieldsSizeSum() const noexcept
   return *(uint32_t*)ptr;
 }
 
+namespace {
+constexpr uint32_t kNoGroup = ~0u;
+
+template <class T>
+size_t GetHeapSize(const std::vector<T>& v)
+{
+  return v.capacity() * sizeof(T);
+}
+
+// Approximation, sparsepp keeps values densely and a few bits per bucket
+template <class Map>
+size_t GetHeapSize(const Map& map)
+{
+  return map.size() * sizeof(typename Map::value_type) +
+    map.bucket_count() / 4;
+}
+}
+
 struct espm::Browser::Impl
 {
-  Impl() { objectReferences.reserve(100'000); }
+  // Records and groups are referenced by 32-bit offsets in the file rather
+  // than pointers. Nothing is stored per record except its id and the
+  // indices it belongs to: parent groups are found by searching the record
+  // offset in sorted group offsets, subs of a group are walked in the file
+  struct Group
+  {
+    // In groupStacks, the group itself goes last
+    uint32_t stackBegin = 0;
+    uint32_t stackSize = 0;
+  };
 
   char* buf = nullptr;
   size_t length = 0;
 
   size_t pos = 0;
   uint32_t fiDataSizeOverride = 0;
-  spp::sparse_hash_map<uint32_t, RecordHeader*> recById;
+  spp::sparse_hash_map<uint32_t, uint32_t> recOffsetById;
   spp::sparse_hash_map<uint64_t, std::vector<RecordHeader*>> navmeshes;
-  spp::sparse_hash_map<uint64_t, std::vector<RecordHeader*>>
-    cellOrWorldChildren;
-  spp::sparse_hash_map<const GroupHeader*, const GroupDataInternal*>
-    groupDataByGroupPtr;
-  spp::sparse_hash_map<const RecordHeader*, const GroupStack*>
-    groupStackByRecordPtr;
-  std::vector<RecordHeader*> objectReferences;
-  std::vector<RecordHeader*> constructibleObjects;
-
-  GroupStack grStack;
-  std::vector<std::unique_ptr<GroupStack>> grStackCopies;
-  std::vector<std::unique_ptr<GroupDataInternal>> grDataHolder;
-
-  CompressedFieldsCache dummyCache;
-
-  // may return null
-  const GroupStack* GetParentGroupsOptional(const RecordHeader* rec) const
+
+  // In file order, so parents go first
+  std::vector<uint32_t> groupOffsets;
+  std::vector<Group> groups;
+  std::vector<uint32_t> groupStacks;
+
+  // References by chunk are collected as key-offset pairs, then sorted by
+  // key into a flat array. Ranges point into childOffsets
+  std::vector<std::pair<uint64_t, uint32_t>> pendingChildren;
+  std::vector<uint32_t> childOffsets;
+  spp::sparse_hash_map<uint64_t, RecordRange> cellOrWorldChildren;
+
+  std::vector<uint32_t> objectReferences;
+  std::vector<uint32_t> constructibleObjects;
+  RecordRange objectReferencesRange;
+  RecordRange constructibleObjectsRange;
+
+  // Used while parsing only, the limit keeps memory usage low on big files
+  std::unique_ptr<CompressedFieldsCache> dummyCache =
+    std::make_unique<CompressedFieldsCache>(16 * 1024 * 1024);
+
+  uint32_t ToOffset(const void* p) const noexcept
   {
-    const auto it = groupStackByRecordPtr.find(rec);
-    if (it == groupStackByRecordPtr.end()) {
-      return nullptr;
+    return static_cast<uint32_t>(static_cast<const char*>(p) - buf);
+  }
+
+  bool Contains(const void* p) const noexcept
+  {
+    auto ptr = static_cast<const char*>(p);
+    return ptr >= buf && ptr < buf + length;
+  }
+
+  // Groups are preceded by "GRUP" and the size including the header
+  size_t GetGroupEnd(uint32_t groupOffset) const noexcept
+  {
+    uint32_t groupSize;
+    memcpy(&groupSize, buf + groupOffset - 4, sizeof(groupSize));
+    return size_t(groupOffset) - 8 + groupSize;
+  }
+
+  std::optional<size_t> FindGroup(const void* p) const noexcept
+  {
+    if (!Contains(p)) {
+      return std::nullopt;
     }
-    return it->second;
+    const uint32_t offset = ToOffset(p);
+    auto it =
+      std::lower_bound(groupOffsets.begin(), groupOffsets.end(), offset);
+    if (it == groupOffsets.end() || *it != offset) {
+      return std::nullopt;
+    }
+    return it - groupOffsets.begin();
   }
 
-  // may return null
-  const std::vector<void*>* GetSubsOptional(const GroupHeader* rec) const
+  // The innermost group containing a record starts before it, as do its
+  // nested groups that end before the record. So it's the last group
+  // starting before the record or one of that group's parents
+  std::optional<GroupStack> FindParentGroups(const void* p) const noexcept
   {
-    const auto it = groupDataByGroupPtr.find(rec);
-    if (it == groupDataByGroupPtr.end()) {
-      return nullptr;
+    if (!Contains(p)) {
+      return std::nullopt;
+    }
+    const uint32_t offset = ToOffset(p);
+    auto it =
+      std::lower_bound(groupOffsets.begin(), groupOffsets.end(), offset);
+    if (it == groupOffsets.begin()) {
+      return std::nullopt;
+    }
+    const auto& group = groups[it - groupOffsets.begin() - 1];
+    const uint32_t* stack = groupStacks.data() + group.stackBegin;
+    for (uint32_t n = group.stackSize; n > 0; --n) {
+      if (offset < GetGroupEnd(stack[n - 1])) {
+        return GroupStack(buf, stack, stack + n);
+      }
+    }
+    return std::nullopt;
+  }
+
+  uint32_t AddGroup(const GroupHeader* grHeader, uint32_t parentIdx)
+  {
+    Group group;
+    group.stackBegin = static_cast<uint32_t>(groupStacks.size());
+    if (parentIdx != kNoGroup) {
+      const auto parent = groups[parentIdx];
+      for (uint32_t i = 0; i < parent.stackSize; ++i) {
+        groupStacks.push_back(groupStacks[parent.stackBegin + i]);
+      }
     }
-    return &it->second->subs;
+    groupStacks.push_back(ToOffset(grHeader));
+    group.stackSize =
+      static_cast<uint32_t>(groupStacks.size()) - group.stackBegin;
+
+    groupOffsets.push_back(ToOffset(grHeader));
+    groups.push_back(group);
+    return static_cast<uint32_t>(groups.size() - 1);
+  }
+
+  GroupSubs GetGroupSubs(uint32_t groupOffset) const noexcept
+  {
+    return GroupSubs(buf + groupOffset + sizeof(GroupHeader),
+                     buf + GetGroupEnd(groupOffset));
+  }
+
+  void AddRecord(const RecordHeader* recHeader)
+  {
+    recOffsetById[recHeader->id] = ToOffset(recHeader);
+
+    auto t = recHeader->GetType();
+    if (t == "REFR" || t == "ACHR") {
+      objectReferences.push_back(ToOffset(recHeader));
+    }
+    if (t == "COBJ") {
+      constructibleObjects.push_back(ToOffset(recHeader));
+    }
+  }
+
+  void AddChild(uint64_t key, const RecordHeader* recHeader)
+  {
+    pendingChildren.push_back({ key, ToOffset(recHeader) });
+  }
+
+  RecordRange MakeRange(const std::vector<uint32_t>& offsets) const noexcept
+  {
+    return RecordRange(buf, offsets.data(), offsets.data() + offsets.size());
+  }
+
+  // Builds ranges, nothing may be added after
+  void Finish()
+  {
+    std::stable_sort(
+      pendingChildren.begin(), pendingChildren.end(),
+      [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    childOffsets.reserve(pendingChildren.size());
+    for (auto& [key, offset] : pendingChildren) {
+      childOffsets.push_back(offset);
+    }
+    for (size_t i = 0; i < pendingChildren.size();) {
+      size_t j = i + 1;
+      while (j < pendingChildren.size() &&
+             pendingChildren[j].first == pendingChildren[i].first) {
+        ++j;
+      }
+      cellOrWorldChildren[pendingChildren[i].first] = RecordRange(
+        buf, childOffsets.data() + i, childOffsets.data() + j);
+      i = j;
+    }
+    pendingChildren.clear();
+    pendingChildren.shrink_to_fit();
+
+    for (auto v : { &groupOffsets, &groupStacks, &objectReferences,
+                    &constructibleObjects }) {
+      v->shrink_to_fit();
+    }
+    groups.shrink_to_fit();
+    objectReferencesRange = MakeRange(objectReferences);
+    constructibleObjectsRange = MakeRange(constructibleObjects);
   }
 };
 
 espm::Browser::Browser(const void* fileContent, size_t length)
   : pImpl(new Impl)
 {
+  std::unique_ptr<Impl> implGuard(pImpl);
+  if (length > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("espm::Browser: files over 4GB not supported");
+  }
+
   pImpl->buf = (char*)fileContent;
   pImpl->length = length;
-  while (ReadAny(nullptr))
+  while (ReadAny(kNoGroup))
     ;
-  pImpl->dummyCache.pImpl->data.clear();
+  pImpl->dummyCache.reset();
+  pImpl->Finish();
+  implGuard.release();
 }
 
 espm::Browser::~Browser()
@@ -540,12 +1079,233 @@ espm::Browser::~Browser()
   delete pImpl;
 }
 
+namespace {
+constexpr char kIndexMagic[8] = { 'E', 'S', 'P', 'M', 'I', 'D', 'X', '2' };
+
+class IndexWriter
+{
+public:
+  template <class T>
+  void Put(T v)
+  {
+    auto p = reinterpret_cast<const char*>(&v);
+    buf.insert(buf.end(), p, p + sizeof(T));
+  }
+
+  std::vector<char> buf;
+};
+
+class IndexReader
+{
+public:
+  IndexReader(const char* data_, size_t length_)
+    : data(data_)
+    , length(length_)
+  {
+  }
+
+  template <class T>
+  T Get()
+  {
+    if (length - pos < sizeof(T)) {
+      throw std::runtime_error("espm::Browser: index is truncated");
+    }
+    T v;
+    memcpy(&v, data + pos, sizeof(T));
+    pos += sizeof(T);
+    return v;
+  }
+
+  bool AtEnd() const noexcept { return pos == length; }
+
+private:
+  const char* const data;
+  const size_t length;
+  size_t pos = 0;
+};
+}
+
+espm::Browser::Browser(const void* fileContent, size_t length,
+                       const void* index, size_t indexLength)
+  : pImpl(new Impl)
+{
+  std::unique_ptr<Impl> implGuard(pImpl);
+  if (length > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("espm::Browser: files over 4GB not supported");
+  }
+
+  pImpl->buf = (char*)fileContent;
+  pImpl->length = length;
+  pImpl->pos = length;
+
+  IndexReader r(static_cast<const char*>(index), indexLength);
+
+  char magic[sizeof(kIndexMagic)];
+  for (auto& ch : magic) {
+    ch = r.Get<char>();
+  }
+  if (memcmp(magic, kIndexMagic, sizeof(magic)) != 0) {
+    throw std::runtime_error("espm::Browser: bad index signature");
+  }
+  if (r.Get<uint64_t>() != length) {
+    throw std::runtime_error("espm::Browser: index is for another file");
+  }
+
+  // Headers are preceded by type and data size (8 bytes)
+  auto getPtr = [&](size_t sizeBefore, size_t sizeAfter) {
+    const auto offset = r.Get<uint64_t>();
+    if (offset < sizeBefore || offset > length ||
+        length - offset < sizeAfter) {
+      throw std::runtime_error("espm::Browser: bad offset in index");
+    }
+    return pImpl->buf + offset;
+  };
+  auto getRecord = [&] {
+    return reinterpret_cast<RecordHeader*>(getPtr(8, sizeof(RecordHeader)));
+  };
+  auto getRecords = [&](std::vector<uint32_t>& offsets) {
+    const auto numRecords = r.Get<uint64_t>();
+    for (uint64_t i = 0; i < numRecords; ++i) {
+      offsets.push_back(pImpl->ToOffset(getRecord()));
+    }
+  };
+
+  // Lookups of parent groups rely on groups being sorted and having sizes
+  // within the file
+  const auto numGroups = r.Get<uint64_t>();
+  for (uint64_t i = 0; i < numGroups; ++i) {
+    const auto grHeader =
+      reinterpret_cast<GroupHeader*>(getPtr(8, sizeof(GroupHeader)));
+    const auto parentIdx = r.Get<uint32_t>();
+    if (parentIdx != kNoGroup && parentIdx >= i) {
+      throw std::runtime_error("espm::Browser: bad parent group in index");
+    }
+    pImpl->AddGroup(grHeader, parentIdx);
+
+    auto& offsets = pImpl->groupOffsets;
+    if (offsets.size() > 1 && offsets.back() <= offsets[offsets.size() - 2]) {
+      throw std::runtime_error("espm::Browser: unordered groups in index");
+    }
+    const auto end = pImpl->GetGroupEnd(offsets.back());
+    if (end > length || end < offsets.back() + sizeof(GroupHeader)) {
+      throw std::runtime_error("espm::Browser: bad group size");
+    }
+  }
+
+  const auto numRecords = r.Get<uint64_t>();
+  pImpl->recOffsetById.reserve(numRecords);
+  for (uint64_t i = 0; i < numRecords; ++i) {
+    const auto recHeader = getRecord();
+    pImpl->recOffsetById[recHeader->id] = pImpl->ToOffset(recHeader);
+  }
+  getRecords(pImpl->objectReferences);
+  getRecords(pImpl->constructibleObjects);
+
+  const auto numNavMeshKeys = r.Get<uint64_t>();
+  for (uint64_t i = 0; i < numNavMeshKeys; ++i) {
+    auto& records = pImpl->navmeshes[r.Get<uint64_t>()];
+    const auto numValues = r.Get<uint32_t>();
+    records.reserve(numValues);
+    for (uint32_t j = 0; j < numValues; ++j) {
+      records.push_back(getRecord());
+    }
+  }
+
+  const auto numChildKeys = r.Get<uint64_t>();
+  for (uint64_t i = 0; i < numChildKeys; ++i) {
+    const auto key = r.Get<uint64_t>();
+    const auto numValues = r.Get<uint32_t>();
+    for (uint32_t j = 0; j < numValues; ++j) {
+      pImpl->AddChild(key, getRecord());
+    }
+  }
+
+  if (!r.AtEnd()) {
+    throw std::runtime_error("espm::Browser: unexpected data in index");
+  }
+
+  pImpl->Finish();
+  implGuard.release();
+}
+
 espm::RecordHeader* espm::Browser::LookupById(uint32_t formId) const noexcept
 {
-  auto it = pImpl->recById.find(formId);
-  if (it == pImpl->recById.end())
+  auto it = pImpl->recOffsetById.find(formId);
+  if (it == pImpl->recOffsetById.end())
     return nullptr;
-  return it->second;
+  return reinterpret_cast<RecordHeader*>(pImpl->buf + it->second);
+}
+
+void espm::Browser::ForEachRecord(
+  const std::function<void(RecordHeader*)>& f) const
+{
+  for (auto& [id, offset] : pImpl->recOffsetById) {
+    f(reinterpret_cast<RecordHeader*>(pImpl->buf + offset));
+  }
+}
+
+size_t espm::Browser::GetNumRecords() const noexcept
+{
+  return pImpl->recOffsetById.size();
+}
+
+std::vector<char> espm::Browser::SaveIndex() const
+{
+  IndexWriter w;
+  for (auto ch : kIndexMagic) {
+    w.Put(ch);
+  }
+  w.Put<uint64_t>(pImpl->length);
+
+  auto putOffset = [&](uint32_t offset) { w.Put<uint64_t>(offset); };
+  auto putPtr = [&](const void* p) { putOffset(pImpl->ToOffset(p)); };
+  auto putRecords = [&](const RecordRange& records) {
+    w.Put<uint64_t>(records.size());
+    for (auto rec : records) {
+      putPtr(rec);
+    }
+  };
+
+  // Groups are stored in the order of reading, so parents go first
+  auto& groups = pImpl->groups;
+  w.Put<uint64_t>(groups.size());
+  for (size_t i = 0; i < groups.size(); ++i) {
+    const uint32_t* stack = pImpl->groupStacks.data() + groups[i].stackBegin;
+    const auto stackSize = groups[i].stackSize;
+    putOffset(pImpl->groupOffsets[i]);
+    w.Put<uint32_t>(stackSize > 1
+                      ? static_cast<uint32_t>(*pImpl->FindGroup(
+                          pImpl->buf + stack[stackSize - 2]))
+                      : kNoGroup);
+  }
+
+  // Only records winning over duplicates of their ids
+  w.Put<uint64_t>(pImpl->recOffsetById.size());
+  for (auto& [id, offset] : pImpl->recOffsetById) {
+    putOffset(offset);
+  }
+  putRecords(pImpl->objectReferencesRange);
+  putRecords(pImpl->constructibleObjectsRange);
+
+  w.Put<uint64_t>(pImpl->navmeshes.size());
+  for (auto& [key, values] : pImpl->navmeshes) {
+    w.Put<uint64_t>(key);
+    w.Put<uint32_t>(static_cast<uint32_t>(values.size()));
+    for (auto rec : values) {
+      putPtr(rec);
+    }
+  }
+
+  w.Put<uint64_t>(pImpl->cellOrWorldChildren.size());
+  for (auto& [key, values] : pImpl->cellOrWorldChildren) {
+    w.Put<uint64_t>(key);
+    w.Put<uint32_t>(static_cast<uint32_t>(values.size()));
+    for (auto rec : values) {
+      putPtr(rec);
+    }
+  }
+
+  return std::move(w.buf);
 }
 
 std::pair<espm::RecordHeader**, size_t> espm::Browser::FindNavMeshes(
@@ -559,26 +1319,26 @@ std::pair<espm::RecordHeader**, size_t> espm::Browser::FindNavMeshes(
   }
 }
 
-const std::vector<espm::RecordHeader*>& espm::Browser::GetRecordsByType(
+const espm::RecordRange& espm::Browser::GetRecordsByType(
   const char* type) const
 {
   if (!strcmp(type, "REFR")) {
-    return pImpl->objectReferences;
+    return pImpl->objectReferencesRange;
   }
   if (!strcmp(type, "COBJ")) {
-    return pImpl->constructibleObjects;
+    return pImpl->constructibleObjectsRange;
   }
   throw std::runtime_error(
     "GetRecordsByType currently supports only REFR and COBJ records");
 }
 
-const std::vector<espm::RecordHeader*>& espm::Browser::GetRecordsAtPos(
+const espm::RecordRange& espm::Browser::GetRecordsAtPos(
   uint32_t cellOrWorld, int16_t cellX, int16_t cellY) const
 {
   const auto it =
     pImpl->cellOrWorldChildren.find(RefrKey(cellOrWorld, cellX, cellY));
   if (it == pImpl->cellOrWorldChildren.end()) {
-    const static std::vector<espm::RecordHeader*> g_defaultValue{};
+    const static espm::RecordRange g_defaultValue{};
     return g_defaultValue;
   }
   return it->second;
@@ -586,14 +1346,13 @@ const std::vector<espm::RecordHeader*>& espm::Browser::GetRecordsAtPos(
 
 namespace espm {
 
-const GroupStack* Browser::GetParentGroupsOptional(
+std::optional<GroupStack> Browser::GetParentGroupsOptional(
   const RecordHeader* rec) const
 {
-  return pImpl->GetParentGroupsOptional(rec);
+  return pImpl->FindParentGroups(rec);
 }
 
-const GroupStack& Browser::GetParentGroupsEnsured(
-  const RecordHeader* rec) const
+GroupStack Browser::GetParentGroupsEnsured(const RecordHeader* rec) const
 {
   const auto opt = GetParentGroupsOptional(rec);
   if (!opt) {
@@ -602,14 +1361,16 @@ const GroupStack& Browser::GetParentGroupsEnsured(
   return *opt;
 }
 
-const std::vector<void*>* Browser::GetSubsOptional(
+std::optional<GroupSubs> Browser::GetSubsOptional(
   const GroupHeader* group) const
 {
-  return pImpl->GetSubsOptional(group);
+  if (!pImpl->FindGroup(group)) {
+    return std::nullopt;
+  }
+  return pImpl->GetGroupSubs(pImpl->ToOffset(group));
 }
 
-const std::vector<void*>& Browser::GetSubsEnsured(
-  const GroupHeader* group) const
+GroupSubs Browser::GetSubsEnsured(const GroupHeader* group) const
 {
   const auto opt = GetSubsOptional(group);
   if (!opt) {
@@ -618,9 +1379,26 @@ const std::vector<void*>& Browser::GetSubsEnsured(
   return *opt;
 }
 
+Browser::MemoryUsage Browser::GetMemoryUsage() const noexcept
+{
+  MemoryUsage res;
+  res.ids = GetHeapSize(pImpl->recOffsetById);
+  res.groups = GetHeapSize(pImpl->groupOffsets) +
+    GetHeapSize(pImpl->groups) + GetHeapSize(pImpl->groupStacks);
+  res.recordsByType = GetHeapSize(pImpl->objectReferences) +
+    GetHeapSize(pImpl->constructibleObjects);
+  res.recordsByPos = GetHeapSize(pImpl->navmeshes) +
+    GetHeapSize(pImpl->cellOrWorldChildren) +
+    GetHeapSize(pImpl->childOffsets);
+  for (auto& [key, records] : pImpl->navmeshes) {
+    res.recordsByPos += GetHeapSize(records);
+  }
+  return res;
+}
+
 } // namespace espm
 
-bool espm::Browser::ReadAny(const GroupStack* parentGrStack)
+bool espm::Browser::ReadAny(uint32_t parentGroupIdx)
 {
   if (pImpl->pos >= pImpl->length) {
     return false;
@@ -635,58 +1413,40 @@ bool espm::Browser::ReadAny(const GroupStack* parentGrStack)
   if (isGrup) {
     // Read group header
     const auto grHeader = (GroupHeader*)(pImpl->buf + pImpl->pos);
-
-    auto grData = new GroupDataInternal;
-    pImpl->grDataHolder.emplace_back(grData);
-    pImpl->groupDataByGroupPtr.emplace(grHeader, grData);
+    const auto groupIdx = pImpl->AddGroup(grHeader, parentGroupIdx);
 
     pImpl->pos += sizeof(GroupHeader);
     const size_t end = pImpl->pos + *pDataSize - 24;
 
-    pImpl->grStack.push_back(grHeader);
-    auto p = new GroupStack(pImpl->grStack);
-    pImpl->grStackCopies.emplace_back(p);
     while (pImpl->pos < end) {
-      auto nextSub = &pImpl->buf[pImpl->pos];
-      if (ReadAny(p)) {
-        grData->subs.push_back(nextSub);
-      }
+      ReadAny(groupIdx);
     }
-    pImpl->grStack.pop_back();
   } else {
     // Read record header
     const auto recHeader =
       reinterpret_cast<RecordHeader*>(pImpl->buf + pImpl->pos);
-    pImpl->groupStackByRecordPtr.emplace(recHeader, parentGrStack);
-
-    pImpl->recById[recHeader->id] = recHeader;
+    pImpl->AddRecord(recHeader);
 
     auto t = recHeader->GetType();
     if (t == "REFR" || t == "ACHR") {
-      pImpl->objectReferences.push_back(recHeader);
       const auto refr = reinterpret_cast<REFR*>(recHeader);
 
-      CompressedFieldsCache dummyCache;
-      const auto data = refr->GetData(dummyCache);
+      const auto data = refr->GetData(*pImpl->dummyCache);
 
       if (data.loc) {
         const int16_t x = static_cast<int16_t>(data.loc->pos[0] / 4096);
         const int16_t y = static_cast<int16_t>(data.loc->pos[1] / 4096);
         const auto cellOrWorld = GetWorldOrCell(*this, refr);
-        const RefrKey refrKey(cellOrWorld, x, y);
-        pImpl->cellOrWorldChildren[refrKey].push_back(refr);
+        pImpl->AddChild(RefrKey(cellOrWorld, x, y), refr);
       }
     }
 
-    if (recHeader->GetType() == "COBJ")
-      pImpl->constructibleObjects.push_back(recHeader);
-
     if (recHeader->GetType() == "NAVM") {
       auto nvnm = reinterpret_cast<NAVM*>(recHeader);
 
       auto& v = pImpl->navmeshes[NavMeshKey(
-        nvnm->GetData(pImpl->dummyCache).worldSpaceId,
-        nvnm->GetData(pImpl->dummyCache).cellOrGridPos)];
+        nvnm->GetData(*pImpl->dummyCache).worldSpaceId,
+        nvnm->GetData(*pImpl->dummyCache).cellOrGridPos)];
       v.push_back(nvnm);
     }
 
@@ -869,12 +1629,38 @@ espm::NAVM::Data espm::NAVM::GetData(
   espm::RecordHeaderAccess::IterateFields(
     this,
     [&](const char* type, uint32_t dataSize, const char* data) {
-      if (!memcmp(type, "NVNM", 4)) {
+      // Header followed by the number of vertices and vertices themselves.
+      // Malformed fields are ignored rather than read out of bounds
+      constexpr uint32_t kVerticesOffset = 20;
+      if (!memcmp(type, "NVNM", 4) && dataSize >= kVerticesOffset) {
+        const auto numVertices = *reinterpret_cast<const int32_t*>(
+          (reinterpret_cast<const uint8_t*>(data) + 16));
+        const int64_t maxVertices = (dataSize - kVerticesOffset) /
+          sizeof(std::array<float, 3>);
+        if (numVertices < 0 || numVertices > maxVertices) {
+          return;
+        }
+
         result.worldSpaceId = *reinterpret_cast<const uint32_t*>(
           (reinterpret_cast<const uint8_t*>(data) + 8));
         result.cellOrGridPos = *reinterpret_cast<const CellOrGridPos*>(
           (reinterpret_cast<const uint8_t*>(data) + 12));
         result.vertices.reset(new Vertices(data));
+
+        // Triangles follow vertices
+        auto numTrianglesPtr =
+          reinterpret_cast<const char*>(result.vertices->end());
+        const char* dataEnd = data + dataSize;
+        if (numTrianglesPtr + sizeof(int32_t) <= dataEnd) {
+          auto trianglesPtr = numTrianglesPtr + sizeof(int32_t);
+          const auto numTriangles =
+            *reinterpret_cast<const int32_t*>(numTrianglesPtr);
+          const int64_t maxTriangles =
+            (dataEnd - trianglesPtr) / sizeof(Triangle);
+          result.numTriangles = static_cast<uint32_t>(
+            std::clamp<int64_t>(numTriangles, 0, maxTriangles));
+          result.triangles = reinterpret_cast<const Triangle*>(trianglesPtr);
+        }
       }
     },
     compressedFieldsCache);
@@ -1,9 +1,12 @@
 #pragma once
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <cstring> // memcmp
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <set>
 #include <string>
@@ -13,14 +16,59 @@
 #pragma pack(push, 1)
 
 namespace espm {
+// Keeps decompressed fields of compressed records. Thread-safe.
+// If the cache is limited, least recently used entries are evicted. Memory of
+// evicted entries is freed by ReleaseEvicted, so pointers to fields of
+// compressed records (i.e. returned by GetData) stay valid until the next
+// ReleaseEvicted call and must not be stored for longer. WorldState calls it
+// once per tick. Preloaded entries (see PreloadCompressedFields) are pinned:
+// they are never evicted and don't count towards the limit
 class CompressedFieldsCache
 {
 public:
+  struct Stats
+  {
+    // Lookups of decompressed fields, field index lookups are not counted
+    uint64_t numHits = 0;
+    uint64_t numMisses = 0;
+    uint64_t numEvictions = 0;
+    size_t numEntries = 0;
+    size_t numBytes = 0;
+
+    // Part of numBytes taken by pinned entries
+    size_t numPinnedBytes = 0;
+
+    // Evicted, but not freed by ReleaseEvicted yet
+    size_t numEvictedBytes = 0;
+  };
+
+  // Unlimited
   CompressedFieldsCache();
+
+  // 0 means unlimited. Fields missing in the cache are looked up in 'parent'
+  // before decompressing, found ones are shared rather than copied. The
+  // parent must outlive the cache
+  explicit CompressedFieldsCache(size_t maxBytes,
+                                 CompressedFieldsCache* parent = nullptr);
+
   ~CompressedFieldsCache();
 
+  void SetMaxBytes(size_t maxBytes);
+  size_t GetMaxBytes() const noexcept;
+
+  Stats GetStats() const;
+
+  // Invalidates pointers to fields of entries evicted so far
+  void ReleaseEvicted();
+
+  void Clear();
+
   struct Impl;
   Impl* const pImpl;
+
+private:
+  CompressedFieldsCache(const CompressedFieldsCache&) = delete;
+  void operator=(const CompressedFieldsCache&) = delete;
 };
 
 union CellOrGridPos
@@ -38,37 +86,221 @@ class RecordHeader;
 class ScriptData;
 struct Effects;
 
-using GroupStack = std::vector<espm::GroupHeader*>;
+// Pointers into a plugin file stored as 32-bit offsets from its beginning
+template <class T>
+class OffsetRange
+{
+public:
+  class Iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T*;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T**;
+    using reference = T*;
+
+    Iterator(char* base_, const uint32_t* p_)
+      : base(base_)
+      , p(p_)
+    {
+    }
+
+    T* operator*() const noexcept
+    {
+      return static_cast<T*>(static_cast<void*>(base + *p));
+    }
+
+    Iterator& operator++() noexcept
+    {
+      ++p;
+      return *this;
+    }
+
+    bool operator==(const Iterator& rhs) const noexcept
+    {
+      return p == rhs.p;
+    }
+    bool operator!=(const Iterator& rhs) const noexcept
+    {
+      return p != rhs.p;
+    }
+
+  private:
+    char* base;
+    const uint32_t* p;
+  };
+
+  OffsetRange() = default;
+
+  OffsetRange(char* base_, const uint32_t* begin_, const uint32_t* end_)
+    : base(base_)
+    , beginPtr(begin_)
+    , endPtr(end_)
+  {
+  }
+
+  Iterator begin() const noexcept { return Iterator(base, beginPtr); }
+  Iterator end() const noexcept { return Iterator(base, endPtr); }
+  size_t size() const noexcept { return endPtr - beginPtr; }
+  bool empty() const noexcept { return beginPtr == endPtr; }
+  T* operator[](size_t i) const noexcept
+  {
+    return *Iterator(base, beginPtr + i);
+  }
+  T* back() const noexcept { return (*this)[size() - 1]; }
+
+  bool operator==(const OffsetRange& rhs) const noexcept
+  {
+    return std::equal(begin(), end(), rhs.begin(), rhs.end());
+  }
+  bool operator!=(const OffsetRange& rhs) const noexcept
+  {
+    return !(*this == rhs);
+  }
+
+private:
+  char* base = nullptr;
+  const uint32_t* beginPtr = nullptr;
+  const uint32_t* endPtr = nullptr;
+};
+
+// Groups containing a record, from the outermost one
+using GroupStack = OffsetRange<GroupHeader>;
+
+// Records of a type, of a chunk, etc.
+using RecordRange = OffsetRange<RecordHeader>;
+
+// Records and groups of a group. Point to the type (record type or "GRUP"),
+// i.e. RecordHeader/GroupHeader - 8 bytes. Not stored anywhere, iterating
+// walks the group's content in the file
+class GroupSubs
+{
+public:
+  class Iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = void*;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void**;
+    using reference = void*;
+
+    explicit Iterator(char* p_)
+      : p(p_)
+    {
+    }
+
+    void* operator*() const noexcept { return p; }
+
+    // Both a record and a group are followed by the size of data, which
+    // doesn't include the record header and does include the group one
+    Iterator& operator++() noexcept
+    {
+      uint32_t dataSize;
+      memcpy(&dataSize, p + 4, sizeof(dataSize));
+      p += memcmp(p, "GRUP", 4) ? 24 + dataSize : dataSize;
+      return *this;
+    }
+
+    bool operator==(const Iterator& rhs) const noexcept
+    {
+      return p == rhs.p;
+    }
+    bool operator!=(const Iterator& rhs) const noexcept
+    {
+      return p != rhs.p;
+    }
+
+  private:
+    char* p;
+  };
+
+  GroupSubs() = default;
+
+  GroupSubs(char* begin_, char* end_)
+    : beginPtr(begin_)
+    , endPtr(end_)
+  {
+  }
+
+  Iterator begin() const noexcept { return Iterator(beginPtr); }
+  Iterator end() const noexcept { return Iterator(endPtr); }
+  bool empty() const noexcept { return beginPtr == endPtr; }
+
+  bool operator==(const GroupSubs& rhs) const noexcept
+  {
+    return beginPtr == rhs.beginPtr && endPtr == rhs.endPtr;
+  }
+  bool operator!=(const GroupSubs& rhs) const noexcept
+  {
+    return !(*this == rhs);
+  }
+
+private:
+  char* beginPtr = nullptr;
+  char* endPtr = nullptr;
+};
 
 class Browser
 {
 public:
   Browser(const void* fileContent, size_t length);
+
+  // Restores indices saved by SaveIndex instead of parsing the file.
+  // Throws std::runtime_error if the index is malformed or made for a file
+  // of a different size
+  Browser(const void* fileContent, size_t length, const void* index,
+          size_t indexLength);
+
   ~Browser();
 
+  // Serializes indices built while parsing. Pointers are stored as offsets
+  // in the file, so the index is only valid for the same file content
+  std::vector<char> SaveIndex() const;
+
   RecordHeader* LookupById(uint32_t formId) const noexcept;
 
+  // Visits every record with a unique id, in no particular order
+  void ForEachRecord(const std::function<void(RecordHeader*)>& f) const;
+  size_t GetNumRecords() const noexcept;
+
   std::pair<espm::RecordHeader**, size_t> FindNavMeshes(
     uint32_t worldSpaceId, CellOrGridPos cellOrGridPos) const noexcept;
 
-  const std::vector<espm::RecordHeader*>& GetRecordsByType(
-    const char* type) const;
+  const RecordRange& GetRecordsByType(const char* type) const;
+
+  const RecordRange& GetRecordsAtPos(uint32_t cellOrWorld, int16_t cellX,
+                                     int16_t cellY) const;
 
-  const std::vector<espm::RecordHeader*>& GetRecordsAtPos(uint32_t cellOrWorld,
-                                                          int16_t cellX,
-                                                          int16_t cellY) const;
+  std::optional<GroupStack> GetParentGroupsOptional(
+    const RecordHeader* rec) const;
+  GroupStack GetParentGroupsEnsured(const RecordHeader* rec) const;
 
-  const GroupStack* GetParentGroupsOptional(const RecordHeader* rec) const;
-  const GroupStack& GetParentGroupsEnsured(const RecordHeader* rec) const;
+  std::optional<GroupSubs> GetSubsOptional(const GroupHeader* group) const;
+  GroupSubs GetSubsEnsured(const GroupHeader* group) const;
 
-  const std::vector<void*>* GetSubsOptional(const GroupHeader* group) const;
-  const std::vector<void*>& GetSubsEnsured(const GroupHeader* group) const;
+  // Approximate heap usage of indices, in bytes
+  struct MemoryUsage
+  {
+    size_t ids = 0;
+    size_t groups = 0;
+    size_t recordsByType = 0;
+    size_t recordsByPos = 0;
+
+    size_t GetTotal() const noexcept
+    {
+      return ids + groups + recordsByType + recordsByPos;
+    }
+  };
+
+  MemoryUsage GetMemoryUsage() const noexcept;
 
 private:
   struct Impl;
   Impl* const pImpl;
 
-  bool ReadAny(const GroupStack* parentGrStack);
+  bool ReadAny(uint32_t parentGroupIdx);
 
   Browser(const Browser&) = delete;
   void operator=(const Browser&) = delete;
@@ -183,6 +415,14 @@ private:
 
 class RecordHeaderAccess;
 
+struct FieldRef
+{
+  const char* data = nullptr;
+  uint32_t size = 0;
+
+  explicit operator bool() const noexcept { return data != nullptr; }
+};
+
 class RecordHeader
 {
   friend class espm::Browser;
@@ -198,6 +438,16 @@ public:
   std::vector<uint32_t> GetKeywordIds(
     espm::CompressedFieldsCache& compressedFieldsCache) const noexcept;
 
+  // Fields are looked up in an index that is built on the first call for
+  // the record and is kept in 'compressedFieldsCache' along with the
+  // decompressed fields. 'type' is a 4-character field type like "EDID".
+  // Returned pointers stay valid as described for CompressedFieldsCache
+  FieldRef FindField(const char* type,
+                     espm::CompressedFieldsCache& compressedFieldsCache) const;
+  std::vector<FieldRef> FindFields(
+    const char* type,
+    espm::CompressedFieldsCache& compressedFieldsCache) const;
+
   Type GetType() const noexcept;
 
   // Please use for tests only
@@ -412,7 +662,7 @@ static_assert(sizeof(LVLI::Entry) == 18);
 class NAVM : public RecordHeader
 {
 public:
-  static constexpr auto kType = "NVNM";
+  static constexpr auto kType = "NAVM";
 
   class Vertices
   {
@@ -428,16 +678,28 @@ public:
     const void* nvnmField;
   };
 
+  struct Triangle
+  {
+    // Indices in vertices
+    int16_t vertices[3] = { 0, 0, 0 };
+    int16_t edges[3] = { 0, 0, 0 };
+    uint16_t flags = 0;
+    uint16_t coverFlags = 0;
+  };
+
   struct Data
   {
     std::unique_ptr<Vertices> vertices;
     uint32_t worldSpaceId = 0;
     CellOrGridPos cellOrGridPos = { 0 };
+    const Triangle* triangles = nullptr;
+    uint32_t numTriangles = 0;
   };
 
   Data GetData(CompressedFieldsCache& compressedFieldsCache) const noexcept;
 };
 static_assert(sizeof(REFR) == sizeof(RecordHeader));
+static_assert(sizeof(NAVM::Triangle) == 16);
 
 class FLST : public RecordHeader
 {
@@ -579,6 +841,12 @@ void IterateFields_(const espm::RecordHeader* rec,
                     const espm::IterateFieldsCallback& f,
                     espm::CompressedFieldsCache& compressedFieldsCache);
 
+// Decompresses fields of a compressed record into the cache in advance and
+// pins them. Returns the size of decompressed fields or 0 if the record is
+// not compressed or its fields are already cached
+size_t PreloadFields_(const espm::RecordHeader* rec,
+                      espm::CompressedFieldsCache& compressedFieldsCache);
+
 struct Script
 {
   std::string scriptName;
@@ -1038,6 +1306,7 @@ static_assert(sizeof(INGR) == sizeof(RecordHeader));
 }
 
 namespace espm {
+// zlib CRC32. Buffers of several megabytes are hashed on multiple threads
 uint32_t CalculateHashcode(const void* readBuffer, size_t length);
 uint32_t GetCorrectHashcode(const std::string& fileName);
 }
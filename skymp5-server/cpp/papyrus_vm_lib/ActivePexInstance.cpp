@@ -3,7 +3,9 @@
 #include "VirtualMachine.h"
 #include <algorithm>
 #include <cctype> // tolower
+#include <cstring>
 #include <functional>
+#include <iterator>
 #include <sstream>
 #include <stdexcept>
 
@@ -48,25 +50,18 @@ std::shared_ptr<ActivePexInstance> ActivePexInstance::FillParentInstance(
                                            this->sourcePex.source);
 }
 
-FunctionInfo ActivePexInstance::GetFunctionByName(const char* name,
-                                                  std::string stateName) const
+const FunctionInfo* ActivePexInstance::GetFunctionByName(
+  const char* name, const std::string& stateName) const
 {
+  auto pex = sourcePex.fn();
 
-  FunctionInfo function;
-  for (auto& object : sourcePex.fn()->objectTable) {
-    for (auto& state : object.states) {
-      if (state.name == stateName) {
-        for (auto& func : state.functions) {
-          if (!Utils::stricmp(func.name.data(), name)) {
-            function = func.function;
-            function.valid = true;
-            return function;
-          }
-        }
-      }
-    }
+  auto state = pex->functionsByState.find(stateName);
+  if (state == pex->functionsByState.end()) {
+    return nullptr;
   }
-  return function;
+
+  auto it = state->second.find(name);
+  return it != state->second.end() ? it->second : nullptr;
 }
 
 std::string ActivePexInstance::GetActiveStateName() const
@@ -175,29 +170,30 @@ VarValue CastToString(const VarValue& var)
 VarValue GetElementsArrayAtString(const VarValue& array, uint8_t type)
 {
   std::string returnValue = "[";
+  auto& elements = *array.GetArray();
 
-  for (size_t i = 0; i < array.pArray->size(); ++i) {
+  for (size_t i = 0; i < elements.size(); ++i) {
     switch (type) {
       case VarValue::kType_ObjectArray: {
-        auto object = (static_cast<IGameObject*>((*array.pArray)[i]));
+        auto object = (static_cast<IGameObject*>(elements[i]));
         returnValue += object ? object->GetStringID() : "None";
         break;
       }
 
       case VarValue::kType_StringArray:
-        returnValue += (const char*)((*array.pArray)[i]);
+        returnValue += (const char*)(elements[i]);
         break;
 
       case VarValue::kType_IntArray:
-        returnValue += std::to_string((int)((*array.pArray)[i]));
+        returnValue += std::to_string((int)(elements[i]));
         break;
 
       case VarValue::kType_FloatArray:
-        returnValue += std::to_string((double)((*array.pArray)[i]));
+        returnValue += std::to_string((double)(elements[i]));
         break;
 
       case VarValue::kType_BoolArray: {
-        VarValue& temp = ((*array.pArray)[i]);
+        VarValue& temp = (elements[i]);
         returnValue += (const char*)(CastToString(temp));
         break;
       }
@@ -205,7 +201,7 @@ VarValue GetElementsArrayAtString(const VarValue& array, uint8_t type)
         assert(false);
     }
 
-    if (i < array.pArray->size() - 1)
+    if (i < elements.size() - 1)
       returnValue += ", ";
     else
       returnValue += "]";
@@ -217,458 +213,684 @@ VarValue GetElementsArrayAtString(const VarValue& array, uint8_t type)
 struct ActivePexInstance::ExecutionContext
 {
   std::shared_ptr<StackIdHolder> stackIdHolder;
-  std::vector<FunctionCode::Instruction> instructions;
-  std::shared_ptr<std::vector<Local>> locals;
-  bool needReturn = false;
-  bool needJump = false;
-  int jumpStep = 0;
+  std::shared_ptr<const FunctionCode> code;
+  std::vector<VarValue> locals;
   VarValue returnValue = VarValue::None();
   size_t line = 0;
 };
 
-std::vector<VarValue> GetArgsForCall(uint8_t op,
-                                     const std::vector<VarValue*>& opcodeArgs)
-{
-  std::vector<VarValue> argsForCall;
-  if (opcodeArgs.size() > 4) {
-    for (size_t i = 4; i < opcodeArgs.size(); ++i) {
-      argsForCall.push_back(*opcodeArgs[i]);
-    }
-  }
-  if (op == FunctionCode::kOp_CallParent && opcodeArgs.size() > 3) {
-    for (size_t i = 3; i < opcodeArgs.size(); ++i) {
-      argsForCall.push_back(*opcodeArgs[i]);
-    }
-  }
-  return argsForCall;
-}
-
 bool ActivePexInstance::EnsureCallResultIsSynchronous(
   const VarValue& callResult, ExecutionContext* ctx)
 {
-  if (!callResult.promise)
+  auto promise = callResult.GetPromise();
+  if (!promise)
     return true;
 
   Viet::Promise<VarValue> currentFnPr;
 
-  auto ctxCopy = *ctx;
-  callResult.promise->Then([this, ctxCopy, currentFnPr](VarValue v) {
-    auto ctxCopy_ = ctxCopy;
-    ctxCopy_.line++;
-    auto res = ExecuteAll(ctxCopy_, v);
+  // The frame is suspended, so its state is moved rather than copied.
+  // Pointers to locals stay valid since the vector keeps its storage
+  auto suspended = std::make_shared<ExecutionContext>(std::move(*ctx));
+  promise->Then([this, suspended, currentFnPr](VarValue v) {
+    suspended->line++;
+    auto res = ExecuteAll(*suspended, v);
 
-    if (res.promise)
-      res.promise->Then(currentFnPr);
+    if (auto resPromise = res.GetPromise())
+      resPromise->Then(currentFnPr);
     else
       currentFnPr.Resolve(res);
   });
 
-  ctx->needReturn = true;
   ctx->returnValue = VarValue(currentFnPr);
   return false;
 }
 
-void ActivePexInstance::ExecuteOpCode(ExecutionContext* ctx, uint8_t op,
-                                      const std::vector<VarValue*>& args)
+std::vector<VarValue> ActivePexInstance::GetCallArguments(
+  ExecutionContext& ctx, const FunctionCode::Instruction& instruction,
+  size_t first)
 {
-  auto argsForCall = GetArgsForCall(op, args);
-
-  switch (op) {
-    case OpcodesImplementation::Opcodes::op_Nop:
-      break;
-    case OpcodesImplementation::Opcodes::op_iAdd:
-    case OpcodesImplementation::Opcodes::op_fAdd:
-      *args[0] = *args[1] + (*args[2]);
-      break;
-    case OpcodesImplementation::Opcodes::op_iSub:
-    case OpcodesImplementation::Opcodes::op_fSub:
-      *args[0] = *args[1] - (*args[2]);
-      break;
-    case OpcodesImplementation::Opcodes::op_iMul:
-    case OpcodesImplementation::Opcodes::op_fMul:
-      *args[0] = *args[1] * (*args[2]);
-      break;
-    case OpcodesImplementation::Opcodes::op_iDiv:
-    case OpcodesImplementation::Opcodes::op_fDiv:
-      *args[0] = *args[1] / (*args[2]);
-      break;
-    case OpcodesImplementation::Opcodes::op_iMod:
-      *args[0] = *args[1] % (*args[2]);
-      break;
-    case OpcodesImplementation::Opcodes::op_Not:
-      *args[0] = !(*args[1]);
-      break;
-    case OpcodesImplementation::Opcodes::op_iNeg:
-      *args[0] = *args[1] * VarValue(-1);
-      break;
-    case OpcodesImplementation::Opcodes::op_fNeg:
-      *args[0] = *args[1] * VarValue(-1.0f);
-      break;
-    case OpcodesImplementation::Opcodes::op_Assign:
-      *args[0] = *args[1];
-      break;
-    case OpcodesImplementation::Opcodes::op_Cast:
-      switch ((*args[0]).GetType()) {
-        case VarValue::kType_Object: {
-          auto to = args[0];
-          auto from = IsSelfStr(*args[1]) ? &activeInstanceOwner : args[1];
-          CastObjectToObject(to, from, *ctx->locals);
-        } break;
-        case VarValue::kType_Integer:
-          *args[0] = (*args[1]).CastToInt();
-          break;
-        case VarValue::kType_Float:
-          *args[0] = (*args[1]).CastToFloat();
-          break;
-        case VarValue::kType_Bool:
-          *args[0] = (*args[1]).CastToBool();
-          break;
-        case VarValue::kType_String:
-          *args[0] = CastToString(*args[1]);
-          break;
-        default:
-          // assert(0);
-          // Triggered by some array stuff in SkyMP, not sure this is OK
-          *args[0] = (*args[1]);
-          break;
-      }
-      break;
-    case OpcodesImplementation::op_Cmp_eq:
-      *args[0] = VarValue((*args[1]) == (*args[2]));
-      break;
-    case OpcodesImplementation::Opcodes::op_Cmp_lt:
-      *args[0] = VarValue(*args[1] < *args[2]);
-      break;
-    case OpcodesImplementation::Opcodes::op_Cmp_le:
-      *args[0] = VarValue(*args[1] <= *args[2]);
-      break;
-    case OpcodesImplementation::Opcodes::op_Cmp_gt:
-      *args[0] = VarValue(*args[1] > *args[2]);
-      break;
-    case OpcodesImplementation::Opcodes::op_Cmp_ge:
-      *args[0] = VarValue(*args[1] >= *args[2]);
-      break;
-    case OpcodesImplementation::Opcodes::op_Jmp:
-      ctx->jumpStep = (int)(*args[0]) - 1;
-      ctx->needJump = true;
-      break;
-    case OpcodesImplementation::Opcodes::op_Jmpt:
-      if ((bool)(*args[0])) {
-        ctx->jumpStep = (int)(*args[1]) - 1;
-        ctx->needJump = true;
-      }
-      break;
-    case OpcodesImplementation::Opcodes::op_Jmpf:
-      if ((bool)(!(*args[0]))) {
-        ctx->jumpStep = (int)(*args[1]) - 1;
-        ctx->needJump = true;
-      }
-      break;
-    case OpcodesImplementation::Opcodes::op_CallParent: {
-      auto parentName =
-        parentInstance ? parentInstance->GetSourcePexName() : "";
-      try {
-        auto gameObject = static_cast<IGameObject*>(activeInstanceOwner);
-        auto res = parentVM->CallMethod(gameObject, (const char*)(*args[0]),
-                                        argsForCall);
-        if (EnsureCallResultIsSynchronous(res, ctx))
-          *args[1] = res;
-      } catch (std::exception& e) {
-        if (auto handler = parentVM->GetExceptionHandler())
-          handler({ e.what(), sourcePex.fn()->source });
-        else
-          throw;
-      }
-    } break;
-    case OpcodesImplementation::Opcodes::op_CallMethod: {
-      VarValue* object = IsSelfStr(*args[1]) ? &activeInstanceOwner : args[1];
-
-      // BYOHRelationshipAdoptionPetDoorTrigger
-      if (args[0]->GetType() != VarValue::kType_String &&
-          args[0]->GetType() != VarValue::kType_Identifier)
-        throw std::runtime_error("Anomally in CallMethod. String expected");
-
-      std::string functionName = (const char*)(*args[0]);
-      static const std::string nameOnBeginState = "onBeginState";
-      static const std::string nameOnEndState = "onEndState";
-      try {
-        if (functionName == nameOnBeginState ||
-            functionName == nameOnEndState) {
-          parentVM->SendEvent(this, functionName.c_str(), argsForCall);
-          break;
-        } else {
-          auto nullableGameObject = static_cast<IGameObject*>(*object);
-          auto res =
-            parentVM->CallMethod(nullableGameObject, functionName.c_str(),
-                                 argsForCall, ctx->stackIdHolder);
-          if (EnsureCallResultIsSynchronous(res, ctx))
-            *args[2] = res;
-        }
-      } catch (std::exception& e) {
-        if (auto handler = parentVM->GetExceptionHandler())
-          handler({ e.what(), sourcePex.fn()->source });
-        else
-          throw;
-      }
-    } break;
-    case OpcodesImplementation::Opcodes::op_CallStatic: {
-      const char* className = (const char*)(*args[0]);
-      const char* functionName = (const char*)(*args[1]);
-      try {
-        auto res = parentVM->CallStatic(className, functionName, argsForCall,
-                                        ctx->stackIdHolder);
-        if (EnsureCallResultIsSynchronous(res, ctx))
-          *args[2] = res;
-      } catch (std::exception& e) {
-        if (auto handler = parentVM->GetExceptionHandler())
-          handler({ e.what(), sourcePex.fn()->source });
-        else
-          throw;
-      }
-    } break;
-    case OpcodesImplementation::Opcodes::op_Return:
-      ctx->returnValue = *args[0];
-      ctx->needReturn = true;
-      break;
-    case OpcodesImplementation::Opcodes::op_StrCat:
-      *args[0] = OpcodesImplementation::StrCat(
-        *args[1], *args[2], this->sourcePex.fn()->stringTable);
-      break;
-    case OpcodesImplementation::Opcodes::op_PropGet:
-      // PropGet/Set seems to work only in very simple cases covered by unit
-      // tests
-      if (args[1] != nullptr) {
-        std::string nameProperty = (const char*)*args[0];
-        auto object = static_cast<IGameObject*>(
-          IsSelfStr(*args[1]) ? activeInstanceOwner : *args[1]);
-        if (!object)
-          object = static_cast<IGameObject*>(activeInstanceOwner);
-        if (object && object->activePexInstances.size() > 0) {
-          auto inst = object->activePexInstances.back();
-          Object::PropInfo* runProperty =
-            GetProperty(*inst, nameProperty, Object::PropInfo::kFlags_Read);
-          if (runProperty != nullptr) {
-            *args[2] = inst->StartFunction(runProperty->readHandler,
-                                           argsForCall, ctx->stackIdHolder);
-          }
-        }
-      } else
-        assert(false);
-      break;
-    case OpcodesImplementation::Opcodes::op_PropSet:
-      if (args[1] != nullptr) {
-        argsForCall.push_back(*args[2]);
-        std::string nameProperty = (const char*)*args[0];
-        auto object = static_cast<IGameObject*>(
-          IsSelfStr(*args[1]) ? activeInstanceOwner : *args[1]);
-        if (!object)
-          object = static_cast<IGameObject*>(activeInstanceOwner);
-        if (object && object->activePexInstances.size() > 0) {
-          auto inst = object->activePexInstances.back();
-          Object::PropInfo* runProperty =
-            GetProperty(*inst, nameProperty, Object::PropInfo::kFlags_Write);
-          if (runProperty != nullptr) {
-            inst->StartFunction(runProperty->writeHandler, argsForCall,
-                                ctx->stackIdHolder);
-          }
-        }
-      } else
-        assert(false);
-      break;
-    case OpcodesImplementation::Opcodes::op_Array_Create:
-      (*args[0]).pArray = std::make_shared<std::vector<VarValue>>();
-      if ((int32_t)(*args[1]) > 0) {
-        (*args[0]).pArray->resize((int32_t)(*args[1]));
-        uint8_t type = GetArrayElementType((*args[0]).GetType());
-        for (auto& element : *(*args[0]).pArray) {
-          element = VarValue(type);
-        }
-      } else
-        assert(0);
-      break;
-    case OpcodesImplementation::Opcodes::op_Array_Length:
-      if ((*args[1]).pArray != nullptr) {
-        if ((*args[0]).GetType() == VarValue::kType_Integer) {
-          *args[0] = VarValue((int32_t)(*args[1]).pArray->size());
-        } else if ((*args[0]).GetType() == VarValue::kType_Float) {
-          *args[0] = VarValue((double)(*args[1]).pArray->size());
-        }
-      } else
-        *args[0] = VarValue((int32_t)0);
-      break;
-    case OpcodesImplementation::Opcodes::op_Array_GetElement:
-      if ((*args[1]).pArray != nullptr) {
-        *args[0] = (*args[1]).pArray->at((int32_t)(*args[2]));
-      } else {
-        *args[0] = VarValue::None();
-      }
-      break;
-    case OpcodesImplementation::Opcodes::op_Array_SetElement:
-      if ((*args[0]).pArray != nullptr) {
-        (*args[0]).pArray->at((int32_t)(*args[1])) = *args[2];
-      } else
-        assert(0);
-      break;
-    case OpcodesImplementation::Opcodes::op_Array_FindElement:
-      OpcodesImplementation::ArrayFindElement(*args[0], *args[1], *args[2],
-                                              *args[3]);
-      break;
-    case OpcodesImplementation::Opcodes::op_Array_RfindElement:
-      OpcodesImplementation::ArrayRFindElement(*args[0], *args[1], *args[2],
-                                               *args[3]);
-      break;
-    default:
-      assert(0);
+  std::vector<VarValue> arguments;
+  for (size_t i = first; i < instruction.args.size(); ++i) {
+    arguments.push_back(*GetOperandValue(ctx, instruction, i));
   }
+  return arguments;
 }
 
-std::shared_ptr<std::vector<ActivePexInstance::Local>>
-ActivePexInstance::MakeLocals(FunctionInfo& function,
-                              std::vector<VarValue>& arguments)
+bool ActivePexInstance::CallMethod(
+  ExecutionContext& ctx, const FunctionCode::Instruction& instruction)
 {
-  auto locals = std::make_shared<std::vector<Local>>();
+  auto& functionNameValue = *GetOperandValue(ctx, instruction, 0);
+  auto object = GetOperandValue(ctx, instruction, 1);
+  if (IsSelfStr(*object))
+    object = &activeInstanceOwner;
+
+  // BYOHRelationshipAdoptionPetDoorTrigger
+  if (functionNameValue.GetType() != VarValue::kType_String &&
+      functionNameValue.GetType() != VarValue::kType_Identifier)
+    throw std::runtime_error("Anomally in CallMethod. String expected");
+
+  // The method name, the object, the result and the number of arguments
+  // precede arguments
+  auto arguments = GetCallArguments(ctx, instruction, 4);
+
+  std::string functionName = (const char*)functionNameValue;
+  static const std::string nameOnBeginState = "onBeginState";
+  static const std::string nameOnEndState = "onEndState";
+  try {
+    if (functionName == nameOnBeginState || functionName == nameOnEndState) {
+      parentVM->SendEvent(this, functionName.c_str(), arguments);
+      return true;
+    }
+    auto nullableGameObject = static_cast<IGameObject*>(*object);
+    auto res = parentVM->CallMethod(nullableGameObject, functionName.c_str(),
+                                    arguments, ctx.stackIdHolder);
+    if (!EnsureCallResultIsSynchronous(res, &ctx))
+      return false;
+    *GetOperandValue(ctx, instruction, 2) = res;
+  } catch (std::exception& e) {
+    if (auto handler = parentVM->GetExceptionHandler())
+      handler({ e.what(), sourcePex.fn()->source });
+    else
+      throw;
+  }
+  return true;
+}
 
-  // Fill with function locals
-  for (auto& var : function.locals) {
-    VarValue temp = VarValue(GetTypeByName(var.type));
-    temp.objectType = var.type;
-    locals->push_back({ var.name, temp });
+bool ActivePexInstance::CallParent(
+  ExecutionContext& ctx, const FunctionCode::Instruction& instruction)
+{
+  // The method name, the result and the number of arguments precede
+  // arguments
+  auto arguments = GetCallArguments(ctx, instruction, 3);
+  try {
+    auto gameObject = static_cast<IGameObject*>(activeInstanceOwner);
+    auto res = parentVM->CallMethod(
+      gameObject, (const char*)*GetOperandValue(ctx, instruction, 0),
+      arguments);
+    if (!EnsureCallResultIsSynchronous(res, &ctx))
+      return false;
+    *GetOperandValue(ctx, instruction, 1) = res;
+  } catch (std::exception& e) {
+    if (auto handler = parentVM->GetExceptionHandler())
+      handler({ e.what(), sourcePex.fn()->source });
+    else
+      throw;
   }
+  return true;
+}
 
-  // Fill with function args
-  for (size_t i = 0; i < arguments.size(); ++i) {
-    VarValue temp = arguments[i];
-    temp.objectType = function.params[i].type;
+bool ActivePexInstance::CallStatic(
+  ExecutionContext& ctx, const FunctionCode::Instruction& instruction)
+{
+  const char* className = (const char*)*GetOperandValue(ctx, instruction, 0);
+  const char* functionName =
+    (const char*)*GetOperandValue(ctx, instruction, 1);
 
-    locals->push_back({ function.params[i].name, temp });
-    assert(locals->back().second.GetType() == arguments[i].GetType());
+  // The class name, the function name, the result and the number of
+  // arguments precede arguments
+  auto arguments = GetCallArguments(ctx, instruction, 4);
+  try {
+    auto res = parentVM->CallStatic(className, functionName, arguments,
+                                    ctx.stackIdHolder);
+    if (!EnsureCallResultIsSynchronous(res, &ctx))
+      return false;
+    *GetOperandValue(ctx, instruction, 2) = res;
+  } catch (std::exception& e) {
+    if (auto handler = parentVM->GetExceptionHandler())
+      handler({ e.what(), sourcePex.fn()->source });
+    else
+      throw;
   }
+  return true;
+}
 
-  // ?
-  for (size_t i = arguments.size(); i < function.params.size(); ++i) {
-    const auto& var_ = function.params[i];
+// PropGet/Set seems to work only in very simple cases covered by unit tests
+void ActivePexInstance::GetPropertyValue(
+  ExecutionContext& ctx, const FunctionCode::Instruction& instruction)
+{
+  auto& owner = *GetOperandValue(ctx, instruction, 1);
+  std::string nameProperty =
+    (const char*)*GetOperandValue(ctx, instruction, 0);
+  auto object =
+    static_cast<IGameObject*>(IsSelfStr(owner) ? activeInstanceOwner : owner);
+  if (!object)
+    object = static_cast<IGameObject*>(activeInstanceOwner);
+  if (object && object->activePexInstances.size() > 0) {
+    auto inst = object->activePexInstances.back();
+    Object::PropInfo* runProperty =
+      GetProperty(*inst, nameProperty, Object::PropInfo::kFlags_Read);
+    if (runProperty != nullptr) {
+      std::vector<VarValue> arguments;
+      *GetOperandValue(ctx, instruction, 2) = inst->StartFunction(
+        runProperty->readHandler, arguments, ctx.stackIdHolder);
+    }
+  }
+}
 
-    VarValue temp = VarValue(GetTypeByName(var_.type));
-    temp.objectType = var_.type;
+void ActivePexInstance::SetPropertyValue(
+  ExecutionContext& ctx, const FunctionCode::Instruction& instruction)
+{
+  auto& owner = *GetOperandValue(ctx, instruction, 1);
+  std::vector<VarValue> arguments = { *GetOperandValue(ctx, instruction, 2) };
+  std::string nameProperty =
+    (const char*)*GetOperandValue(ctx, instruction, 0);
+  auto object =
+    static_cast<IGameObject*>(IsSelfStr(owner) ? activeInstanceOwner : owner);
+  if (!object)
+    object = static_cast<IGameObject*>(activeInstanceOwner);
+  if (object && object->activePexInstances.size() > 0) {
+    auto inst = object->activePexInstances.back();
+    Object::PropInfo* runProperty =
+      GetProperty(*inst, nameProperty, Object::PropInfo::kFlags_Write);
+    if (runProperty != nullptr) {
+      inst->StartFunction(runProperty->writeHandler, arguments,
+                          ctx.stackIdHolder);
+    }
+  }
+}
 
-    locals->push_back({ var_.name, temp });
+std::vector<VarValue> ActivePexInstance::MakeLocals(
+  const FunctionInfo& function, std::vector<VarValue>& arguments)
+{
+  auto& initialLocals = function.code->initialLocals;
+  const size_t firstParam = function.locals.size();
+
+  std::vector<VarValue> locals;
+  locals.reserve(initialLocals.size());
+
+  for (size_t i = 0; i < initialLocals.size(); ++i) {
+    const size_t argumentIdx = i - firstParam;
+    if (i >= firstParam && argumentIdx < arguments.size() &&
+        argumentIdx < function.params.size()) {
+      locals.push_back(arguments[argumentIdx]);
+      locals.back().objectTypeId = initialLocals[i].objectTypeId;
+    } else {
+      locals.push_back(initialLocals[i]);
+    }
   }
 
+  auto findLocal = [&](const char* name) -> VarValue* {
+    size_t slot = 0;
+    for (auto* vars : { &function.locals, &function.params }) {
+      for (auto& var : *vars) {
+        if (var.name == name) {
+          return &locals[slot];
+        }
+        ++slot;
+      }
+    }
+    return nullptr;
+  };
+
   // Dereference identifiers
-  for (auto& var : *locals) {
-    var.second = GetIndentifierValue(*locals, var.second);
+  for (auto& var : locals) {
+    auto name = static_cast<const char*>(var);
+    if (var.GetType() == VarValue::kType_Identifier && name) {
+      auto local = strcmp(name, "self") ? findLocal(name) : nullptr;
+      var = local ? *local : GetVariableValueByName(name);
+    }
   }
 
   return locals;
 }
 
-// Basically, makes vector<VarValue *> from vector<VarValue>
-std::vector<std::pair<uint8_t, std::vector<VarValue*>>>
-ActivePexInstance::TransformInstructions(
-  std::vector<FunctionCode::Instruction>& instructions,
-  std::shared_ptr<std::vector<Local>> locals)
+VarValue* ActivePexInstance::GetOperandValue(
+  ExecutionContext& ctx, const FunctionCode::Instruction& instruction,
+  size_t i)
 {
-  std::vector<std::pair<uint8_t, std::vector<VarValue*>>> opCode;
-  for (size_t i = 0; i < instructions.size(); ++i) {
-
-    std::pair<uint8_t, std::vector<VarValue*>> temp;
-    temp.first = instructions[i].op;
+  auto& operand = instruction.operands[i];
+  switch (operand.kind) {
+    case FunctionCode::Operand::kConstant:
+      // FunctionCompiler guarantees that constants are never written to
+      return const_cast<VarValue*>(&instruction.args[i]);
+    case FunctionCode::Operand::kSelf:
+      return &activeInstanceOwner;
+    case FunctionCode::Operand::kLocal:
+      return &ctx.locals[operand.index];
+    case FunctionCode::Operand::kIdentifier:
+      return &GetIdentifierValue(ctx.code->identifiers, operand.index);
+  }
+  throw std::runtime_error("Unknown operand kind");
+}
 
-    for (size_t j = 0; j < instructions[i].args.size(); ++j) {
-      temp.second.push_back(&instructions[i].args[j]);
-    }
-    opCode.push_back(temp);
+VarValue& ActivePexInstance::GetIdentifierValue(
+  const std::shared_ptr<const std::vector<std::string>>& identifiers,
+  uint32_t index)
+{
+  // Scripts may be hot reloaded, then functions of the new version have
+  // another table
+  if (identifierValuesOwner != identifiers) {
+    identifierValuesOwner = identifiers;
+    identifierValues.assign(identifiers->size(), nullptr);
   }
 
-  // Dereference identifiers
-  for (auto& [opcodeId, opcodeArgs] : opCode) {
-    size_t dereferenceStart;
-    switch (opcodeId) {
-      case OpcodesImplementation::Opcodes::op_CallMethod:
-        // Do not dereference functionName
-        dereferenceStart = 1;
-        break;
-      case OpcodesImplementation::Opcodes::op_CallStatic:
-        // Do not dereference className and functionName
-        dereferenceStart = 2;
-        break;
-      case OpcodesImplementation::Opcodes::op_CallParent:
-        // TODO?
-        dereferenceStart = 0;
-        break;
-      default:
-        dereferenceStart = 0;
-        break;
-    }
-    for (size_t i = dereferenceStart; i < opcodeArgs.size(); ++i) {
-      auto& arg = opcodeArgs[i];
-      arg = &(GetIndentifierValue(*locals, *arg));
-    }
+  auto& value = identifierValues[index];
+  if (value) {
+    return *value;
   }
 
-  return opCode;
+  auto& res = GetVariableValueByName((*identifiers)[index]);
+
+  // Not cached since the exception handler is invoked on every failure
+  if (&res == &noneVar) {
+    return res;
+  }
+  value = &res;
+  return res;
 }
 
+// Handlers are dispatched with computed goto where the compiler supports it.
+// Each handler then ends with its own indirect jump, which is easier on
+// branch prediction than the single jump of a switch
+#if defined(__GNUC__)
+#  define PAPYRUS_COMPUTED_GOTO
+#endif
+
 VarValue ActivePexInstance::ExecuteAll(
   ExecutionContext& ctx, std::optional<VarValue> previousCallResult)
 {
-  auto pipex = sourcePex.fn();
+  using namespace OpcodesImplementation;
 
-  auto opCode = TransformInstructions(ctx.instructions, ctx.locals);
+  auto& instructions = ctx.code->instructions;
+  const FunctionCode::Instruction* instruction = nullptr;
 
   if (previousCallResult) {
-    int i = ctx.line - 1;
-    size_t resultIdx =
-      opCode[i].first == OpcodesImplementation::Opcodes::op_CallParent ? 1 : 2;
+    auto& callInstruction = instructions[ctx.line - 1];
+    size_t resultIdx = callInstruction.op == Opcodes::op_CallParent ? 1 : 2;
 
-    *opCode[i].second[resultIdx] = *previousCallResult;
+    *GetOperandValue(ctx, callInstruction, resultIdx) = *previousCallResult;
   }
 
-  assert(opCode.size() == ctx.instructions.size());
-
-  for (; ctx.line < opCode.size(); ++ctx.line) {
-    auto& [op, args] = opCode[ctx.line];
-    ExecuteOpCode(&ctx, op, args);
-
-    if (ctx.needReturn) {
-      ctx.needReturn = false;
+  auto arg = [&](size_t i) -> VarValue& {
+    return *GetOperandValue(ctx, *instruction, i);
+  };
+
+  // Fast paths below bypass VarValue operators for primitive values. They
+  // must leave values exactly as the operators would
+  auto isPrimitive = [](const VarValue& v) {
+    return (v.type == VarValue::kType_Integer ||
+            v.type == VarValue::kType_Float ||
+            v.type == VarValue::kType_Bool) &&
+      !v.payload;
+  };
+  auto bothInts = [](const VarValue& a, const VarValue& b) {
+    return a.type == VarValue::kType_Integer &&
+      b.type == VarValue::kType_Integer;
+  };
+  auto setInt = [&](VarValue& var, int32_t value) {
+    var.data.i = value;
+    var.type = VarValue::kType_Integer;
+    var.ResetPayload();
+  };
+  auto setBool = [&](VarValue& var, bool value) {
+    var.data.b = value;
+    var.type = VarValue::kType_Bool;
+    var.ResetPayload();
+  };
+  auto toInt = [](const VarValue& v) {
+    return v.type == VarValue::kType_Integer ? v.data.i : static_cast<int>(v);
+  };
+  auto toBool = [](const VarValue& v) {
+    return v.type == VarValue::kType_Bool ? v.data.b : static_cast<bool>(v);
+  };
+  auto compare = [&](uint8_t op, const VarValue& a, const VarValue& b) {
+    if (bothInts(a, b)) {
+      switch (op) {
+        case Opcodes::op_Cmp_eq:
+          return a.data.i == b.data.i;
+        case Opcodes::op_Cmp_lt:
+          return a.data.i < b.data.i;
+        case Opcodes::op_Cmp_le:
+          return a.data.i <= b.data.i;
+        case Opcodes::op_Cmp_gt:
+          return a.data.i > b.data.i;
+        default:
+          return a.data.i >= b.data.i;
+      }
+    }
+    switch (op) {
+      case Opcodes::op_Cmp_eq:
+        return a == b;
+      case Opcodes::op_Cmp_lt:
+        return a < b;
+      case Opcodes::op_Cmp_le:
+        return a <= b;
+      case Opcodes::op_Cmp_gt:
+        return a > b;
+      default:
+        return a >= b;
+    }
+  };
+
+#define PAPYRUS_FETCH()                                                       \
+  if (ctx.line >= instructions.size()) {                                      \
+    return ctx.returnValue;                                                   \
+  }                                                                           \
+  instruction = &instructions[ctx.line]
+
+#ifdef PAPYRUS_COMPUTED_GOTO
+#  define PAPYRUS_HANDLER(op) handler_##op:
+#  define PAPYRUS_DISPATCH()                                                  \
+    PAPYRUS_FETCH();                                                          \
+    goto* kHandlers[instruction->handler]
+
+  // Indexed by handlers, see Opcodes
+  static const void* const kHandlers[] = {
+    &&handler_op_Nop,
+    &&handler_op_iAdd,
+    &&handler_op_fAdd,
+    &&handler_op_iSub,
+    &&handler_op_fSub,
+    &&handler_op_iMul,
+    &&handler_op_fMul,
+    &&handler_op_iDiv,
+    &&handler_op_fDiv,
+    &&handler_op_iMod,
+    &&handler_op_Not,
+    &&handler_op_iNeg,
+    &&handler_op_fNeg,
+    &&handler_op_Assign,
+    &&handler_op_Cast,
+    &&handler_op_Cmp_eq,
+    &&handler_op_Cmp_lt,
+    &&handler_op_Cmp_le,
+    &&handler_op_Cmp_gt,
+    &&handler_op_Cmp_ge,
+    &&handler_op_Jmp,
+    &&handler_op_Jmpt,
+    &&handler_op_Jmpf,
+    &&handler_op_CallMethod,
+    &&handler_op_CallParent,
+    &&handler_op_CallStatic,
+    &&handler_op_Return,
+    &&handler_op_StrCat,
+    &&handler_op_PropGet,
+    &&handler_op_PropSet,
+    &&handler_op_Array_Create,
+    &&handler_op_Array_Length,
+    &&handler_op_Array_GetElement,
+    &&handler_op_Array_SetElement,
+    &&handler_op_Array_FindElement,
+    &&handler_op_Array_RfindElement,
+    &&handler_op_Cmp_Jmp,
+  };
+  static_assert(std::size(kHandlers) == Opcodes::_HandlersEnd);
+
+  PAPYRUS_DISPATCH();
+#else
+#  define PAPYRUS_HANDLER(op) case Opcodes::op:
+#  define PAPYRUS_DISPATCH() continue
+
+  for (;;) {
+    PAPYRUS_FETCH();
+    switch (instruction->handler) {
+#endif
+
+#define PAPYRUS_NEXT()                                                        \
+  ++ctx.line;                                                                 \
+  PAPYRUS_DISPATCH()
+
+  PAPYRUS_HANDLER(op_Nop)
+  {
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_iAdd)
+  PAPYRUS_HANDLER(op_fAdd)
+  {
+    auto& a = arg(1);
+    auto& b = arg(2);
+    if (bothInts(a, b)) {
+      setInt(arg(0), a.data.i + b.data.i);
+    } else {
+      arg(0) = a + b;
+    }
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_iSub)
+  PAPYRUS_HANDLER(op_fSub)
+  {
+    auto& a = arg(1);
+    auto& b = arg(2);
+    if (bothInts(a, b)) {
+      setInt(arg(0), a.data.i - b.data.i);
+    } else {
+      arg(0) = a - b;
+    }
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_iMul)
+  PAPYRUS_HANDLER(op_fMul)
+  {
+    arg(0) = arg(1) * arg(2);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_iDiv)
+  PAPYRUS_HANDLER(op_fDiv)
+  {
+    arg(0) = arg(1) / arg(2);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_iMod)
+  {
+    arg(0) = arg(1) % arg(2);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Not)
+  {
+    arg(0) = !arg(1);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_iNeg)
+  {
+    arg(0) = arg(1) * VarValue(-1);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_fNeg)
+  {
+    arg(0) = arg(1) * VarValue(-1.0f);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Assign)
+  {
+    auto& value = arg(1);
+    auto& result = arg(0);
+    if (isPrimitive(value)) {
+      result.data = value.data;
+      result.type = value.type;
+      result.ResetPayload();
+    } else {
+      result = value;
+    }
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Cast)
+  {
+    auto& result = arg(0);
+    auto& value = arg(1);
+    switch (result.GetType()) {
+      case VarValue::kType_Object:
+        CastObjectToObject(&result,
+                           IsSelfStr(value) ? &activeInstanceOwner : &value);
+        break;
+      case VarValue::kType_Integer:
+        result = value.CastToInt();
+        break;
+      case VarValue::kType_Float:
+        result = value.CastToFloat();
+        break;
+      case VarValue::kType_Bool:
+        result = value.CastToBool();
+        break;
+      case VarValue::kType_String:
+        result = CastToString(value);
+        break;
+      default:
+        // assert(0);
+        // Triggered by some array stuff in SkyMP, not sure this is OK
+        result = value;
+        break;
+    }
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Cmp_eq)
+  PAPYRUS_HANDLER(op_Cmp_lt)
+  PAPYRUS_HANDLER(op_Cmp_le)
+  PAPYRUS_HANDLER(op_Cmp_gt)
+  PAPYRUS_HANDLER(op_Cmp_ge)
+  {
+    setBool(arg(0), compare(instruction->op, arg(1), arg(2)));
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Jmp)
+  {
+    ctx.line += toInt(arg(0));
+    PAPYRUS_DISPATCH();
+  }
+  PAPYRUS_HANDLER(op_Jmpt)
+  {
+    ctx.line += toBool(arg(0)) ? toInt(arg(1)) : 1;
+    PAPYRUS_DISPATCH();
+  }
+  PAPYRUS_HANDLER(op_Jmpf)
+  {
+    ctx.line += toBool(arg(0)) ? 1 : toInt(arg(1));
+    PAPYRUS_DISPATCH();
+  }
+  PAPYRUS_HANDLER(op_Cmp_Jmp)
+  {
+    // The comparison result is still stored, the code may read it later
+    const bool value = compare(instruction->op, arg(1), arg(2));
+    setBool(arg(0), value);
+
+    instruction = &instructions[++ctx.line];
+    const bool jumpIfTrue = instruction->op == Opcodes::op_Jmpt;
+    ctx.line += value == jumpIfTrue ? toInt(arg(1)) : 1;
+    PAPYRUS_DISPATCH();
+  }
+  PAPYRUS_HANDLER(op_CallMethod)
+  {
+    if (!CallMethod(ctx, *instruction))
+      return ctx.returnValue;
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_CallParent)
+  {
+    if (!CallParent(ctx, *instruction))
       return ctx.returnValue;
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_CallStatic)
+  {
+    if (!CallStatic(ctx, *instruction))
+      return ctx.returnValue;
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Return)
+  {
+    ctx.returnValue = arg(0);
+    return ctx.returnValue;
+  }
+  PAPYRUS_HANDLER(op_StrCat)
+  {
+    arg(0) = StrCat(arg(1), arg(2), sourcePex.fn()->stringTable);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_PropGet)
+  {
+    GetPropertyValue(ctx, *instruction);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_PropSet)
+  {
+    SetPropertyValue(ctx, *instruction);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Array_Create)
+  {
+    auto& array = arg(0);
+    auto size = toInt(arg(1));
+    std::vector<VarValue> elements;
+    if (size > 0) {
+      uint8_t type = GetArrayElementType(array.GetType());
+      elements.resize(size, VarValue(type));
+    } else
+      assert(0);
+    array.SetArray(std::move(elements));
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Array_Length)
+  {
+    auto& result = arg(0);
+    auto& array = arg(1);
+    if (auto elements = array.GetArray()) {
+      if (result.GetType() == VarValue::kType_Integer) {
+        result = VarValue((int32_t)elements->size());
+      } else if (result.GetType() == VarValue::kType_Float) {
+        result = VarValue((double)elements->size());
+      }
+    } else
+      result = VarValue((int32_t)0);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Array_GetElement)
+  {
+    auto& result = arg(0);
+    auto& array = arg(1);
+    if (auto elements = array.GetArray()) {
+      result = elements->at(toInt(arg(2)));
+    } else {
+      result = VarValue::None();
     }
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Array_SetElement)
+  {
+    auto& array = arg(0);
+    if (auto elements = array.GetArray()) {
+      elements->at(toInt(arg(1))) = arg(2);
+    } else
+      assert(0);
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Array_FindElement)
+  {
+    ArrayFindElement(arg(0), arg(1), arg(2), arg(3));
+    PAPYRUS_NEXT();
+  }
+  PAPYRUS_HANDLER(op_Array_RfindElement)
+  {
+    ArrayRFindElement(arg(0), arg(1), arg(2), arg(3));
+    PAPYRUS_NEXT();
+  }
 
-    if (ctx.needJump) {
-      ctx.needJump = false;
-      ctx.line += ctx.jumpStep;
+#ifndef PAPYRUS_COMPUTED_GOTO
+      default:
+        // FunctionCompiler never produces other handlers
+        assert(0);
+        PAPYRUS_NEXT();
     }
   }
-  return ctx.returnValue;
+#endif
+
+#undef PAPYRUS_NEXT
+#undef PAPYRUS_DISPATCH
+#undef PAPYRUS_HANDLER
+#undef PAPYRUS_FETCH
 }
 
 VarValue ActivePexInstance::StartFunction(
-  FunctionInfo& function, std::vector<VarValue>& arguments,
+  const FunctionInfo& function, std::vector<VarValue>& arguments,
   std::shared_ptr<StackIdHolder> stackIdHolder)
 {
   if (!stackIdHolder)
     throw std::runtime_error("An empty stackIdHolder passed to StartFunction");
-  auto locals = MakeLocals(function, arguments);
-  ExecutionContext ctx{ stackIdHolder, function.code.instructions, locals };
+  if (!function.code)
+    return VarValue::None();
+  ExecutionContext ctx{ stackIdHolder, function.code,
+                        MakeLocals(function, arguments) };
   return ExecuteAll(ctx);
 }
 
-VarValue& ActivePexInstance::GetIndentifierValue(
-  std::vector<Local>& locals, VarValue& value, bool treatStringsAsIdentifiers)
-{
-  if (auto valueAsString = static_cast<const char*>(value)) {
-    if (treatStringsAsIdentifiers &&
-        value.GetType() == VarValue::kType_String) {
-      return GetVariableValueByName(&locals, valueAsString);
-    }
-    if (value.GetType() == VarValue::kType_Identifier) {
-      return GetVariableValueByName(&locals, valueAsString);
-    }
-  }
-  return value;
-}
-
 uint8_t ActivePexInstance::GetTypeByName(std::string typeRef)
 {
 
@@ -778,11 +1000,10 @@ uint8_t ActivePexInstance::GetArrayTypeByElementType(uint8_t type)
 }
 
 void ActivePexInstance::CastObjectToObject(VarValue* result,
-                                           VarValue* scriptToCastOwner,
-                                           std::vector<Local>& locals)
+                                           VarValue* scriptToCastOwner)
 {
-  std::string objectToCastTypeName = scriptToCastOwner->objectType;
-  const std::string& resultTypeName = result->objectType;
+  std::string objectToCastTypeName = scriptToCastOwner->GetObjectType();
+  const std::string& resultTypeName = result->GetObjectType();
 
   if (scriptToCastOwner->GetType() != VarValue::kType_Object ||
       *scriptToCastOwner == VarValue::None()) {
@@ -858,21 +1079,13 @@ bool ActivePexInstance::HasChild(ActivePexInstance* script,
   return false;
 }
 
-VarValue& ActivePexInstance::GetVariableValueByName(std::vector<Local>* locals,
-                                                    std::string name)
+VarValue& ActivePexInstance::GetVariableValueByName(const std::string& name)
 {
 
   if (name == "self") {
     return activeInstanceOwner;
   }
 
-  if (locals)
-    for (auto& var : *locals) {
-      if (var.first == name) {
-        return var.second;
-      }
-    }
-
   try {
     if (variables)
       if (auto var =
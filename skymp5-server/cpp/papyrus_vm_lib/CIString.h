@@ -1,6 +1,7 @@
 #pragma once
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -40,9 +41,14 @@ struct CIHash
 {
   size_t operator()(const CIString& keyval) const
   {
-    std::string keyCopy({ keyval.begin(), keyval.end() });
-    std::transform(keyCopy.begin(), keyCopy.end(), keyCopy.begin(), tolower);
-    return std::hash<std::string>()(keyCopy);
+    // FNV-1a of lowercase characters, hashing must not allocate since it's
+    // done on every Papyrus call
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : keyval) {
+      hash ^= static_cast<uint64_t>(tolower(static_cast<unsigned char>(c)));
+      hash *= 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
   }
 };
 
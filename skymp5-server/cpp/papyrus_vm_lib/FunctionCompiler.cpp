@@ -0,0 +1,170 @@
+#include "FunctionCompiler.h"
+#include "OpcodesImplementation.h"
+#include <cstring>
+
+namespace {
+size_t GetDereferenceStart(uint8_t op)
+{
+  switch (op) {
+    case OpcodesImplementation::Opcodes::op_CallMethod:
+      // Do not dereference functionName
+      return 1;
+    case OpcodesImplementation::Opcodes::op_CallStatic:
+      // Do not dereference className and functionName
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+// Index of the argument the instruction writes to if any
+std::optional<size_t> GetResultIndex(uint8_t op)
+{
+  using namespace OpcodesImplementation;
+  switch (op) {
+    case Opcodes::op_iAdd:
+    case Opcodes::op_fAdd:
+    case Opcodes::op_iSub:
+    case Opcodes::op_fSub:
+    case Opcodes::op_iMul:
+    case Opcodes::op_fMul:
+    case Opcodes::op_iDiv:
+    case Opcodes::op_fDiv:
+    case Opcodes::op_iMod:
+    case Opcodes::op_Not:
+    case Opcodes::op_iNeg:
+    case Opcodes::op_fNeg:
+    case Opcodes::op_Assign:
+    case Opcodes::op_Cast:
+    case Opcodes::op_Cmp_eq:
+    case Opcodes::op_Cmp_lt:
+    case Opcodes::op_Cmp_le:
+    case Opcodes::op_Cmp_gt:
+    case Opcodes::op_Cmp_ge:
+    case Opcodes::op_StrCat:
+    case Opcodes::op_Array_Create:
+    case Opcodes::op_Array_Length:
+    case Opcodes::op_Array_GetElement:
+      return 0;
+    case Opcodes::op_CallParent:
+    case Opcodes::op_Array_FindElement:
+    case Opcodes::op_Array_RfindElement:
+      return 1;
+    case Opcodes::op_CallMethod:
+    case Opcodes::op_CallStatic:
+    case Opcodes::op_PropGet:
+      return 2;
+    default:
+      return std::nullopt;
+  }
+}
+
+bool IsComparison(uint8_t op)
+{
+  return op >= OpcodesImplementation::Opcodes::op_Cmp_eq &&
+    op <= OpcodesImplementation::Opcodes::op_Cmp_ge;
+}
+
+bool IsConditionalJump(uint8_t op)
+{
+  return op == OpcodesImplementation::Opcodes::op_Jmpt ||
+    op == OpcodesImplementation::Opcodes::op_Jmpf;
+}
+
+bool IsSameLocal(const FunctionCode::Operand& a,
+                 const FunctionCode::Operand& b)
+{
+  return a.kind == FunctionCode::Operand::kLocal &&
+    b.kind == FunctionCode::Operand::kLocal && a.index == b.index;
+}
+
+uint8_t GetHandler(const FunctionCode& code, size_t i)
+{
+  auto& instruction = code.instructions[i];
+
+  // Unknown opcodes used to be ignored
+  if (instruction.op > OpcodesImplementation::Opcodes::op_Array_RfindElement) {
+    return OpcodesImplementation::Opcodes::op_Nop;
+  }
+
+  // Jump targets are unaffected: the jump keeps its own handler
+  if (IsComparison(instruction.op) && i + 1 < code.instructions.size()) {
+    auto& next = code.instructions[i + 1];
+    if (IsConditionalJump(next.op) && instruction.operands.size() == 3 &&
+        next.operands.size() == 2 &&
+        IsSameLocal(instruction.operands[0], next.operands[0])) {
+      return OpcodesImplementation::Opcodes::op_Cmp_Jmp;
+    }
+  }
+
+  return instruction.op;
+}
+}
+
+std::shared_ptr<const FunctionCode> FunctionCompiler::Compile(
+  const FunctionInfo& function, FunctionCode code)
+{
+  // Must match the order of locals in ActivePexInstance::MakeLocals
+  std::unordered_map<std::string, uint32_t> localSlots;
+  for (auto* vars : { &function.locals, &function.params }) {
+    for (auto& var : *vars) {
+      // The first local with the name wins like it did with lookups by name
+      localSlots.emplace(var.name, code.initialLocals.size());
+
+      VarValue initialValue(ActivePexInstance::GetTypeByName(var.type));
+      initialValue.SetObjectType(var.type);
+      code.initialLocals.push_back(initialValue);
+    }
+  }
+
+  code.identifiers = identifiers;
+
+  for (auto& instruction : code.instructions) {
+    auto& operands = instruction.operands;
+    operands.assign(instruction.args.size(), FunctionCode::Operand());
+
+    for (size_t i = GetDereferenceStart(instruction.op);
+         i < instruction.args.size(); ++i) {
+      auto& arg = instruction.args[i];
+      auto name = static_cast<const char*>(arg);
+      if (arg.GetType() != VarValue::kType_Identifier || !name) {
+        continue;
+      }
+
+      if (!strcmp(name, "self")) {
+        operands[i].kind = FunctionCode::Operand::kSelf;
+      } else if (auto it = localSlots.find(name); it != localSlots.end()) {
+        operands[i].kind = FunctionCode::Operand::kLocal;
+        operands[i].index = it->second;
+      } else {
+        operands[i].kind = FunctionCode::Operand::kIdentifier;
+        operands[i].index = GetIdentifierIndex(name);
+      }
+    }
+
+    // Code is shared between frames, so constants must stay constant
+    auto resultIndex = GetResultIndex(instruction.op);
+    if (resultIndex && *resultIndex < operands.size() &&
+        operands[*resultIndex].kind == FunctionCode::Operand::kConstant) {
+      operands[*resultIndex].kind = FunctionCode::Operand::kLocal;
+      operands[*resultIndex].index = code.initialLocals.size();
+      code.initialLocals.push_back(instruction.args[*resultIndex]);
+    }
+  }
+
+  for (size_t i = 0; i < code.instructions.size(); ++i) {
+    code.instructions[i].handler = GetHandler(code, i);
+  }
+
+  return std::make_shared<const FunctionCode>(std::move(code));
+}
+
+uint32_t FunctionCompiler::GetIdentifierIndex(const char* name)
+{
+  auto [it, inserted] = identifierIndices.emplace(
+    name, static_cast<uint32_t>(identifiers->size()));
+  if (inserted) {
+    identifiers->push_back(name);
+  }
+  return it->second;
+}
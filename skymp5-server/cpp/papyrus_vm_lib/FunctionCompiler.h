@@ -0,0 +1,24 @@
+#pragma once
+#include "Structures.h"
+#include <unordered_map>
+
+// Prepares code of functions for execution once when a script is loaded.
+// Identifier arguments are resolved to locals slots, 'self' or indices in
+// FunctionCode::identifiers, so the interpreter never looks identifiers up
+// by name. Comparisons followed by a conditional jump on their result are
+// fused into a single op_Cmp_Jmp handler. Functions compiled by one compiler
+// share the identifiers table, Reader uses a compiler per script
+class FunctionCompiler
+{
+public:
+  // 'function' must have params and locals filled
+  std::shared_ptr<const FunctionCode> Compile(const FunctionInfo& function,
+                                              FunctionCode code);
+
+private:
+  uint32_t GetIdentifierIndex(const char* name);
+
+  std::shared_ptr<std::vector<std::string>> identifiers =
+    std::make_shared<std::vector<std::string>>();
+  std::unordered_map<std::string, uint32_t> identifierIndices;
+};
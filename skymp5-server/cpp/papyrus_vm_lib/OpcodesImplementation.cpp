@@ -18,18 +18,19 @@ void OpcodesImplementation::ArrayFindElement(VarValue& array, VarValue& result,
                                              VarValue& needValue,
                                              VarValue& startIndex)
 {
+  auto elements = array.GetArray();
 
-  if (array.pArray == nullptr || (int)startIndex < 0 ||
-      (int)startIndex >= array.pArray->size()) {
+  if (elements == nullptr || (int)startIndex < 0 ||
+      (int)startIndex >= elements->size()) {
     result = VarValue(-1);
     return;
   }
 
-  auto res = std::find(array.pArray->begin() + (int)startIndex,
-                       array.pArray->end(), needValue);
+  auto res =
+    std::find(elements->begin() + (int)startIndex, elements->end(), needValue);
 
-  if (res != array.pArray->end()) {
-    result = VarValue(static_cast<int32_t>(res - array.pArray->begin()));
+  if (res != elements->end()) {
+    result = VarValue(static_cast<int32_t>(res - elements->begin()));
   } else {
     result = VarValue(-1);
   }
@@ -40,25 +41,24 @@ void OpcodesImplementation::ArrayRFindElement(VarValue& array,
                                               VarValue& needValue,
                                               VarValue& startIndex)
 {
-  if (array.pArray != nullptr) {
+  if (auto elements = array.GetArray()) {
 
-    int32_t indexForStart = array.pArray->size() - 1;
+    int32_t indexForStart = elements->size() - 1;
 
     if ((int)startIndex < -1)
-      indexForStart = array.pArray->size() + (int)startIndex;
+      indexForStart = elements->size() + (int)startIndex;
 
-    if (indexForStart >= array.pArray->size() || indexForStart < 0) {
+    if (indexForStart >= elements->size() || indexForStart < 0) {
       result = VarValue(-1);
       return;
     }
 
-    auto res =
-      std::find(array.pArray->rbegin() + array.pArray->size() - indexForStart,
-                array.pArray->rend(), needValue);
-    if (res == array.pArray->rend()) {
+    auto res = std::find(elements->rbegin() + elements->size() - indexForStart,
+                         elements->rend(), needValue);
+    if (res == elements->rend()) {
       result = VarValue(-1);
     } else {
-      result = VarValue(static_cast<int32_t>(array.pArray->rend() - res - 1));
+      result = VarValue(static_cast<int32_t>(elements->rend() - res - 1));
     }
   } else {
     result = VarValue(-1);
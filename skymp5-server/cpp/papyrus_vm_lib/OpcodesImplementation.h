@@ -40,7 +40,15 @@ enum Opcodes
   op_Array_GetElement = 0x20,
   op_Array_SetElement = 0x21,
   op_Array_FindElement = 0x22,
-  op_Array_RfindElement = 0x23
+  op_Array_RfindElement = 0x23,
+
+  // Interpreter handlers that never appear in pex files, see
+  // FunctionCompiler.h
+
+  // A comparison and the jmpt/jmpf testing its result
+  op_Cmp_Jmp = 0x24,
+
+  _HandlersEnd
 };
 
 VarValue StrCat(const VarValue& s1, const VarValue& s2, StringTable& table);
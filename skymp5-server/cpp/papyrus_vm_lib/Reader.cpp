@@ -53,6 +53,7 @@ void Reader::CreateScriptStructure(const std::vector<uint8_t>& arrayBytes)
   currentReadPositionInFile = 0;
 
   this->structure = std::make_shared<PexScript>();
+  this->compiler = FunctionCompiler();
 
   FillHeader(structure->header);
 
@@ -64,6 +65,7 @@ void Reader::CreateScriptStructure(const std::vector<uint8_t>& arrayBytes)
   FillDebugInfo(structure->debugInfo);
   FillUserFlagTable(structure->userFlagTable);
   FillObjectTable(structure->objectTable);
+  FillFunctionsByState(*structure);
   sourceStructures.push_back(structure);
 }
 
@@ -172,6 +174,20 @@ void Reader::FillObjectTable(std::vector<Object>& objectTable)
   }
 }
 
+void Reader::FillFunctionsByState(PexScript& pex)
+{
+  for (auto& object : pex.objectTable) {
+    for (auto& state : object.states) {
+      auto& functions = pex.functionsByState[state.name];
+      for (auto& func : state.functions) {
+        // The first function with the name wins
+        functions.emplace(CIString{ func.name.begin(), func.name.end() },
+                          &func.function);
+      }
+    }
+  }
+}
+
 Object Reader::FillObject()
 {
   Object object;
@@ -306,7 +322,7 @@ FunctionInfo Reader::FillFuncInfo()
 
   int countInstructions = Read16_bit();
 
-  info.code = FillFunctionCode(countInstructions);
+  info.code = compiler.Compile(info, FillFunctionCode(countInstructions));
 
   return info;
 }
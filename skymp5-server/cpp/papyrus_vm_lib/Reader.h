@@ -1,4 +1,5 @@
 #pragma once
+#include "FunctionCompiler.h"
 #include "Structures.h"
 
 class Reader
@@ -9,6 +10,8 @@ class Reader
 
   std::shared_ptr<PexScript> structure = nullptr;
 
+  FunctionCompiler compiler;
+
   std::vector<int> numArgumentsForOpcodes = { 0, 3, 3, 3, 3, 3,  3,  3,  3,
                                               3, 2, 2, 2, 2, 2,  3,  3,  3,
                                               3, 3, 1, 2, 2, -4, -3, -4, 1,
@@ -29,6 +32,7 @@ class Reader
   void FillDebugInfo(DebugInfo& debugInfo);
   void FillUserFlagTable(std::vector<UserFlag>& userFlagTable);
   void FillObjectTable(std::vector<Object>& objectTable);
+  void FillFunctionsByState(PexScript& pex);
 
   DebugInfo::DebugFunction FillDebugFunction();
   UserFlag FillUserFlag();
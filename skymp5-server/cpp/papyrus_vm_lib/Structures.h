@@ -1,4 +1,5 @@
 #pragma once
+#include "CIString.h"
 #include "Promise.h"
 #include <cassert>
 #include <functional>
@@ -8,6 +9,7 @@
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class VirtualMachine;
@@ -41,10 +43,16 @@ enum class FunctionType
   GlobalFunction, // 'callstatic' opcode
 };
 
+// 24 bytes: the value itself, a tag and the payload pointer. Values that need
+// heap data (owned strings, arrays, promises, objects kept alive) share a
+// single refcounted payload between copies, others never allocate
 struct VarValue
 {
+  friend class ActivePexInstance; // Interpreter fast paths
 
 private:
+  struct Payload; // VarValue.cpp
+
   union
   {
     IGameObject* id;
@@ -54,12 +62,15 @@ private:
     bool b;
   } data;
 
-  std::shared_ptr<IGameObject> owningObject;
+  Payload* payload = nullptr;
   int32_t stackId = -1;
 
-public:
-  std::string objectType;
+  uint32_t type : 8;
 
+  // Index of the interned name, see GetObjectType
+  uint32_t objectTypeId : 24;
+
+public:
   enum Type : uint8_t
   {
     kType_Object = 0, // 0 null?
@@ -81,9 +92,37 @@ public:
   uint8_t GetType() const { return static_cast<uint8_t>(this->type); }
 
   VarValue()
+    : type(kType_Object)
+    , objectTypeId(0)
   {
     data.id = nullptr;
-    type = Type::kType_Object;
+  }
+
+  VarValue(const VarValue& other)
+    : data(other.data)
+    , payload(other.payload)
+    , stackId(other.stackId)
+    , type(other.type)
+    , objectTypeId(other.objectTypeId)
+  {
+    if (payload)
+      AddRef(payload);
+  }
+
+  VarValue(VarValue&& other) noexcept
+    : data(other.data)
+    , payload(other.payload)
+    , stackId(other.stackId)
+    , type(other.type)
+    , objectTypeId(other.objectTypeId)
+  {
+    other.payload = nullptr;
+  }
+
+  ~VarValue()
+  {
+    if (payload)
+      Release(payload);
   }
 
   explicit VarValue(uint8_t type);
@@ -110,11 +149,18 @@ public:
 
   explicit operator const char*() const { return this->data.string; }
 
-  std::shared_ptr<std::vector<VarValue>> pArray;
+  // Elements of an array value, nullptr if the array is None. Copies of the
+  // value share elements like Papyrus arrays do
+  std::vector<VarValue>* GetArray() const;
+  void SetArray(std::vector<VarValue> elements);
 
-  std::shared_ptr<Viet::Promise<VarValue>> promise;
+  // nullptr unless the value is a promise returned by a latent function
+  Viet::Promise<VarValue>* GetPromise() const;
 
-  std::shared_ptr<std::string> stringHolder;
+  // Declared type of the variable holding the value, used by casts. Not
+  // changed by assignments, see operator=
+  const std::string& GetObjectType() const;
+  void SetObjectType(const std::string& typeName);
 
   int32_t GetMetaStackId() const;
   void SetMetaStackIdHolder(std::shared_ptr<StackIdHolder> stackIdHolder);
@@ -138,6 +184,7 @@ public:
   friend std::ostream& operator<<(std::ostream& os, const VarValue& varValue);
 
   VarValue& operator=(const VarValue& arg2);
+  VarValue& operator=(VarValue&& arg2) noexcept;
 
   VarValue CastToInt() const;
   VarValue CastToFloat() const;
@@ -146,7 +193,18 @@ public:
   void Then(std::function<void(VarValue)> cb);
 
 private:
-  Type type;
+  explicit VarValue(Payload* payload);
+
+  void ResetPayload()
+  {
+    if (payload) {
+      Release(payload);
+      payload = nullptr;
+    }
+  }
+
+  static void AddRef(Payload* payload) noexcept;
+  static void Release(Payload* payload) noexcept;
 };
 
 using NativeFunction =
@@ -157,7 +215,10 @@ class IVariablesHolder
 public:
   virtual ~IVariablesHolder() = default;
 
-  // Must guarantee that no exception would be thrown for '::State' variable
+  // Must guarantee that no exception would be thrown for '::State' variable.
+  // Returned pointers are cached by ActivePexInstance and must stay valid
+  // for the lifetime of the holder. The same name must always resolve to
+  // the same variable
   virtual VarValue* GetVariableByName(const char* name,
                                       const PexScript& pex) = 0;
 };
@@ -203,13 +264,43 @@ struct FunctionCode
     kOp_Invalid,
   };
 
+  // Where an instruction argument is taken from at runtime. Identifiers are
+  // resolved once when the script is loaded, see FunctionCompiler.h
+  struct Operand
+  {
+    enum Kind : uint8_t
+    {
+      kConstant = 0, // The argument itself
+      kSelf,         // Owner of the running instance
+      kLocal,        // Slot 'index' in locals of the running frame
+      kIdentifier,   // Name 'identifiers[index]' resolved by the instance
+    };
+
+    Kind kind = kConstant;
+    uint32_t index = 0;
+  };
+
   struct Instruction
   {
     uint8_t op = 0;
+
+    // Handler the interpreter runs, set by FunctionCompiler. Equals 'op'
+    // unless the instruction is fused with the next one
+    uint8_t handler = 0;
+
     std::vector<VarValue> args;
+    std::vector<Operand> operands; // One per argument
   };
 
   std::vector<Instruction> instructions;
+
+  // Names of identifiers other than locals and 'self', shared by all
+  // functions of a script
+  std::shared_ptr<const std::vector<std::string>> identifiers;
+
+  // Each frame starts with a copy of these: function locals, params, then
+  // temporaries that replace constants the function would overwrite
+  std::vector<VarValue> initialLocals;
 };
 
 struct FunctionInfo
@@ -237,7 +328,9 @@ struct FunctionInfo
   std::vector<ParamInfo> params;
   std::vector<ParamInfo> locals;
 
-  FunctionCode code;
+  // Compiled once when the script is loaded and shared by copies of
+  // FunctionInfo and running frames. Null for functions having no code
+  std::shared_ptr<const FunctionCode> code;
 
   bool IsGlobal() const { return flags & (1 << 0); }
 
@@ -383,6 +476,11 @@ struct PexScript
   std::vector<UserFlag> userFlagTable;
   std::vector<Object> objectTable;
 
+  // Functions of 'objectTable' by state name and function name, filled by
+  // Reader. The default state has an empty name
+  std::unordered_map<std::string, CIMap<const FunctionInfo*>>
+    functionsByState;
+
   std::string source;
   std::string user;
   std::string machine;
@@ -391,8 +489,6 @@ struct PexScript
 class ActivePexInstance
 {
 public:
-  using Local = std::pair<std::string, VarValue>;
-
   ActivePexInstance();
   ActivePexInstance(
     PexScript::Lazy sourcePex,
@@ -400,16 +496,13 @@ public:
     VirtualMachine* parentVM, VarValue activeInstanceOwner,
     std::string childrenName);
 
-  FunctionInfo GetFunctionByName(const char* name,
-                                 std::string stateName) const;
-
-  VarValue& GetVariableValueByName(std::vector<Local>* optional,
-                                   std::string name);
+  // Returns nullptr if the function doesn't exist
+  const FunctionInfo* GetFunctionByName(const char* name,
+                                        const std::string& stateName) const;
 
-  VarValue& GetIndentifierValue(std::vector<Local>& locals, VarValue& value,
-                                bool treatStringsAsIdentifiers = false);
+  VarValue& GetVariableValueByName(const std::string& name);
 
-  VarValue StartFunction(FunctionInfo& function,
+  VarValue StartFunction(const FunctionInfo& function,
                          std::vector<VarValue>& arguments,
                          std::shared_ptr<StackIdHolder> stackIdHolder);
 
@@ -431,19 +524,36 @@ public:
 private:
   struct ExecutionContext;
 
-  std::vector<std::pair<uint8_t, std::vector<VarValue*>>>
-  TransformInstructions(std::vector<FunctionCode::Instruction>& sourceOpCode,
-                        std::shared_ptr<std::vector<Local>> locals);
+  VarValue* GetOperandValue(ExecutionContext& ctx,
+                            const FunctionCode::Instruction& instruction,
+                            size_t i);
 
-  std::shared_ptr<std::vector<ActivePexInstance::Local>> MakeLocals(
-    FunctionInfo& function, std::vector<VarValue>& arguments);
+  VarValue& GetIdentifierValue(
+    const std::shared_ptr<const std::vector<std::string>>& identifiers,
+    uint32_t index);
+
+  std::vector<VarValue> MakeLocals(const FunctionInfo& function,
+                                   std::vector<VarValue>& arguments);
 
   VarValue ExecuteAll(
     ExecutionContext& ctx,
     std::optional<VarValue> previousCallResult = std::nullopt);
 
-  void ExecuteOpCode(ExecutionContext* ctx, uint8_t op,
-                     const std::vector<VarValue*>& arguments);
+  std::vector<VarValue> GetCallArguments(
+    ExecutionContext& ctx, const FunctionCode::Instruction& instruction,
+    size_t first);
+
+  // Call opcodes return false if the frame has been suspended
+  bool CallMethod(ExecutionContext& ctx,
+                  const FunctionCode::Instruction& instruction);
+  bool CallParent(ExecutionContext& ctx,
+                  const FunctionCode::Instruction& instruction);
+  bool CallStatic(ExecutionContext& ctx,
+                  const FunctionCode::Instruction& instruction);
+  void GetPropertyValue(ExecutionContext& ctx,
+                        const FunctionCode::Instruction& instruction);
+  void SetPropertyValue(ExecutionContext& ctx,
+                        const FunctionCode::Instruction& instruction);
 
   bool EnsureCallResultIsSynchronous(const VarValue& callResult,
                                      ExecutionContext* ctx);
@@ -451,8 +561,7 @@ private:
   Object::PropInfo* GetProperty(const ActivePexInstance& scriptInstance,
                                 std::string nameProperty, uint8_t flag);
 
-  void CastObjectToObject(VarValue* result, VarValue* objectType,
-                          std::vector<Local>& locals);
+  void CastObjectToObject(VarValue* result, VarValue* objectType);
 
   bool HasParent(ActivePexInstance* script, std::string castToTypeName);
   bool HasChild(ActivePexInstance* script, std::string castToTypeName);
@@ -475,6 +584,10 @@ private:
   std::shared_ptr<IVariablesHolder> variables;
   std::vector<std::shared_ptr<VarValue>> identifiersValueNameCache;
 
+  // Values of FunctionCode::identifiers, filled on first use
+  std::vector<VarValue*> identifierValues;
+  std::shared_ptr<const std::vector<std::string>> identifierValuesOwner;
+
   uint64_t promiseIdx = 0;
   std::map<uint64_t, std::shared_ptr<Viet::Promise<VarValue>>> promises;
 
@@ -1,8 +1,81 @@
 #include "Structures.h"
 #include "VirtualMachine.h"
 
+#include <atomic>
 #include <cmath>
+#include <deque>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
+#include <variant>
+
+struct VarValue::Payload
+{
+  std::atomic<uint32_t> refCount = 1;
+  std::variant<std::string, std::vector<VarValue>, Viet::Promise<VarValue>,
+               std::shared_ptr<IGameObject>>
+    value;
+};
+
+void VarValue::AddRef(Payload* payload) noexcept
+{
+  payload->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void VarValue::Release(Payload* payload) noexcept
+{
+  if (payload->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete payload;
+  }
+}
+
+namespace {
+// Object type names are few and live as long as the process. Id 0 is ""
+class ObjectTypeNames
+{
+public:
+  static ObjectTypeNames& Get()
+  {
+    static ObjectTypeNames instance;
+    return instance;
+  }
+
+  uint32_t Intern(const std::string& name)
+  {
+    if (name.empty()) {
+      return 0;
+    }
+    std::lock_guard l(m);
+    auto [it, inserted] =
+      ids.emplace(name, static_cast<uint32_t>(names.size()));
+    if (inserted) {
+      if (names.size() >= (1 << 24)) {
+        ids.erase(it);
+        throw std::runtime_error("Too many object type names");
+      }
+      names.push_back(name);
+    }
+    return it->second;
+  }
+
+  const std::string& GetName(uint32_t id)
+  {
+    static const std::string kEmpty;
+    if (id == 0) {
+      return kEmpty;
+    }
+    std::lock_guard l(m);
+    return names[id];
+  }
+
+private:
+  ObjectTypeNames() { names.emplace_back(); }
+
+  std::mutex m;
+  std::deque<std::string> names;
+  std::unordered_map<std::string, uint32_t> ids;
+};
+}
 
 VarValue VarValue::CastToInt() const
 {
@@ -71,7 +144,7 @@ VarValue VarValue::CastToBool() const
     case kType_IntArray:
     case kType_FloatArray:
     case kType_BoolArray:
-      return VarValue(this->pArray && this->pArray->size() > 0);
+      return VarValue(GetArray() && GetArray()->size() > 0);
     default:
       throw std::runtime_error("Wrong type in CastToBool");
   }
@@ -79,13 +152,49 @@ VarValue VarValue::CastToBool() const
 
 void VarValue::Then(std::function<void(VarValue)> cb)
 {
+  auto promise = GetPromise();
   if (!promise) {
     throw std::runtime_error("Not a promise");
   }
   promise->Then(cb);
 }
 
+std::vector<VarValue>* VarValue::GetArray() const
+{
+  return payload ? std::get_if<std::vector<VarValue>>(&payload->value)
+                 : nullptr;
+}
+
+void VarValue::SetArray(std::vector<VarValue> elements)
+{
+  VarValue holder(new Payload{ 1, std::move(elements) });
+  std::swap(payload, holder.payload);
+}
+
+Viet::Promise<VarValue>* VarValue::GetPromise() const
+{
+  return payload ? std::get_if<Viet::Promise<VarValue>>(&payload->value)
+                 : nullptr;
+}
+
+const std::string& VarValue::GetObjectType() const
+{
+  return ObjectTypeNames::Get().GetName(objectTypeId);
+}
+
+void VarValue::SetObjectType(const std::string& typeName)
+{
+  objectTypeId = ObjectTypeNames::Get().Intern(typeName);
+}
+
+VarValue::VarValue(Payload* payload_)
+  : VarValue()
+{
+  payload = payload_;
+}
+
 VarValue::VarValue(uint8_t type)
+  : VarValue()
 {
   static std::string emptyLine;
   switch (type) {
@@ -118,8 +227,8 @@ VarValue::VarValue(uint8_t type)
     case kType_IntArray:
     case kType_FloatArray:
     case kType_BoolArray:
-      this->type = static_cast<Type>(type);
-      this->pArray = nullptr;
+      this->type = type;
+      this->data.id = nullptr;
       break;
 
     default:
@@ -128,59 +237,63 @@ VarValue::VarValue(uint8_t type)
 }
 
 VarValue::VarValue(uint8_t type, const char* value)
+  : VarValue()
 {
   this->type = this->kType_Identifier;
   this->data.string = value;
 }
 
 VarValue::VarValue(IGameObject* object)
+  : VarValue()
 {
   this->type = this->kType_Object;
   this->data.id = object;
 }
 
 VarValue::VarValue(int32_t value)
+  : VarValue()
 {
   this->type = this->kType_Integer;
   this->data.i = value;
 }
 
 VarValue::VarValue(const char* value)
+  : VarValue()
 {
   this->type = this->kType_String;
   this->data.string = value;
 }
 
 VarValue::VarValue(const std::string& value)
+  : VarValue(new Payload{ 1, value })
 {
   this->type = this->kType_String;
-  this->stringHolder.reset(new std::string(value));
-  this->data.string = this->stringHolder->data();
+  this->data.string = std::get<std::string>(payload->value).data();
 }
 
 VarValue::VarValue(double value)
+  : VarValue()
 {
   this->type = this->kType_Float;
   this->data.f = value;
 }
 
 VarValue::VarValue(bool value)
+  : VarValue()
 {
   this->type = this->kType_Bool;
   this->data.b = value;
 }
 
 VarValue::VarValue(Viet::Promise<VarValue> promise)
+  : VarValue(new Payload{ 1, std::move(promise) })
 {
-  this->type = this->kType_Object;
-  this->data.id = nullptr;
-  this->promise.reset(new Viet::Promise<VarValue>(promise));
 }
 
 VarValue::VarValue(std::shared_ptr<IGameObject> object)
-  : VarValue(object.get())
+  : VarValue(new Payload{ 1, object })
 {
-  owningObject = object;
+  this->data.id = object.get();
 }
 
 int32_t VarValue::GetMetaStackId() const
@@ -396,7 +509,7 @@ VarValue VarValue::operator!()
     case kType_FloatArray:
     case kType_BoolArray:
       var.type = this->kType_Bool;
-      var.data.b = (this->pArray->size() < 1);
+      var.data.b = (GetArray()->size() < 1);
       return var;
     default:
       throw std::runtime_error("Wrong type in operator!");
@@ -551,23 +664,23 @@ VarValue& VarValue::operator=(const VarValue& arg2)
   // At the moment when this comment has been written,
   // there was no unit test able to reproduce it.Good luck with debugging.
 
-  data = arg2.data;
-  type = arg2.type;
-  owningObject = arg2.owningObject;
-
-  // TODO: Is this check actually needed?
-  if (arg2.type >= arg2._ArraysStart && arg2.type < arg2._ArraysEnd) {
-    pArray = arg2.pArray;
+  if (arg2.payload) {
+    AddRef(arg2.payload);
   }
-
-  promise = arg2.promise;
-
-  if (arg2.stringHolder) {
-    stringHolder.reset(new std::string(*arg2.stringHolder));
-    data.string = stringHolder->data();
-  } else {
-    stringHolder.reset();
+  if (payload) {
+    Release(payload);
   }
+  data = arg2.data;
+  type = arg2.type;
+  payload = arg2.payload;
+  return *this;
+}
 
+VarValue& VarValue::operator=(VarValue&& arg2) noexcept
+{
+  // Same as copy assignment, objectType and stackId are kept
+  std::swap(payload, arg2.payload);
+  data = arg2.data;
+  type = arg2.type;
   return *this;
 }
@@ -55,15 +55,72 @@ void VirtualMachine::RegisterFunction(const std::string& className,
                                       const FunctionType& type,
                                       const NativeFunction& fn)
 {
+  auto key = MakeNativeKey(GetNameId(className.data()),
+                           GetNameId(functionName.data()));
   switch (type) {
     case FunctionType::GlobalFunction:
-
-      nativeStaticFunctions[ToLower(className)][ToLower(functionName)] = fn;
+      nativeStaticFunctions[key] = fn;
       break;
     case FunctionType::Method:
-      nativeFunctions[ToLower(className)][ToLower(functionName)] = fn;
+      nativeFunctions[key] = fn;
       break;
   }
+  nativeMethodsCache.clear();
+}
+
+uint32_t VirtualMachine::GetNameId(const char* name)
+{
+  CIString ciName = name;
+  auto it = nameIds.find(ciName);
+  if (it != nameIds.end()) {
+    return it->second;
+  }
+  auto id = static_cast<uint32_t>(names.size());
+  nameIds.emplace(std::move(ciName), id);
+  names.push_back(ToLower(name));
+  return id;
+}
+
+uint64_t VirtualMachine::MakeNativeKey(uint32_t classId, uint32_t functionId)
+{
+  return (static_cast<uint64_t>(classId) << 32) | functionId;
+}
+
+const NativeFunction* VirtualMachine::FindNativeMethod(const char* nativeClass,
+                                                       uint32_t methodId,
+                                                       const char** lastClass)
+{
+  const char* base = nativeClass;
+  const NativeFunction* res = nullptr;
+  while (1) {
+    auto f = nativeFunctions.find(MakeNativeKey(GetNameId(base), methodId));
+    if (f != nativeFunctions.end() && f->second) {
+      res = &f->second;
+      break;
+    }
+    auto it = allLoadedScripts.find(base);
+    if (it == allLoadedScripts.end())
+      break;
+    base = it->second.fn()->objectTable[0].parentClassName.data();
+    if (!base[0])
+      break;
+  }
+  if (lastClass) {
+    *lastClass = base;
+  }
+  return res;
+}
+
+const NativeFunction* VirtualMachine::FindNativeMethodCached(
+  const char* nativeClass, uint32_t methodId)
+{
+  auto key = MakeNativeKey(GetNameId(nativeClass), methodId);
+  auto it = nativeMethodsCache.find(key);
+  if (it == nativeMethodsCache.end()) {
+    auto f = FindNativeMethod(nativeClass, methodId);
+    it = nativeMethodsCache.emplace(key, f).first;
+  }
+  return it->second;
 }
 
 void VirtualMachine::AddObject(std::shared_ptr<IGameObject> self,
@@ -91,16 +148,14 @@ void VirtualMachine::SendEvent(std::shared_ptr<IGameObject> self,
                                OnEnter enter)
 {
   for (auto& scriptInstance : self->activePexInstances) {
-    auto name = scriptInstance->GetActiveStateName();
-
     auto fn = scriptInstance->GetFunctionByName(
       eventName, scriptInstance->GetActiveStateName());
-    if (fn.valid) {
+    if (fn) {
       auto stackIdHolder = std::make_shared<StackIdHolder>(*this);
       if (enter)
         enter(*stackIdHolder);
       scriptInstance->StartFunction(
-        fn, const_cast<std::vector<VarValue>&>(arguments), stackIdHolder);
+        *fn, const_cast<std::vector<VarValue>&>(arguments), stackIdHolder);
     }
   }
 }
@@ -112,8 +167,9 @@ void VirtualMachine::SendEvent(ActivePexInstance* instance,
 
   auto fn =
     instance->GetFunctionByName(eventName, instance->GetActiveStateName());
-  if (fn.valid) {
-    instance->StartFunction(fn, const_cast<std::vector<VarValue>&>(arguments),
+  if (fn) {
+    instance->StartFunction(*fn,
+                            const_cast<std::vector<VarValue>&>(arguments),
                             std::make_shared<StackIdHolder>(*this));
   }
 }
@@ -152,40 +208,36 @@ VarValue VirtualMachine::CallMethod(
   }
 
   const char* nativeClass = selfObj->GetParentNativeScript();
-  const char* base = nativeClass;
-  while (1) {
-    if (auto f = nativeFunctions[ToLower(base)][ToLower(methodName)]) {
-      auto self = VarValue(selfObj);
-      self.SetMetaStackIdHolder(stackIdHolder);
-      return f(self, arguments);
-    }
-    auto it = allLoadedScripts.find(base);
-    if (it == allLoadedScripts.end())
-      break;
-    base = it->second.fn()->objectTable[0].parentClassName.data();
-    if (!base[0])
-      break;
+  const uint32_t methodId = GetNameId(methodName);
+  if (auto f = FindNativeMethodCached(nativeClass, methodId)) {
+    auto self = VarValue(selfObj);
+    self.SetMetaStackIdHolder(stackIdHolder);
+    return (*f)(self, arguments);
   }
 
+  static const std::string defaultState;
   for (auto& activeScript : selfObj->activePexInstances) {
-    FunctionInfo functionInfo;
+    const FunctionInfo* functionInfo;
 
     if (!Utils::stricmp(methodName, "GotoState") ||
         !Utils::stricmp(methodName, "GetState")) {
-      functionInfo = activeScript->GetFunctionByName(methodName, "");
+      functionInfo = activeScript->GetFunctionByName(methodName, defaultState);
     } else {
       functionInfo = activeScript->GetFunctionByName(
         methodName, activeScript->GetActiveStateName());
-      if (!functionInfo.valid)
-        functionInfo = activeScript->GetFunctionByName(methodName, "");
+      if (!functionInfo)
+        functionInfo =
+          activeScript->GetFunctionByName(methodName, defaultState);
     }
 
-    if (functionInfo.valid) {
-      return activeScript->StartFunction(functionInfo, arguments,
+    if (functionInfo) {
+      return activeScript->StartFunction(*functionInfo, arguments,
                                          stackIdHolder);
     }
   }
 
+  const char* base = nullptr;
+  FindNativeMethod(nativeClass, methodId, &base);
   std::string e = "Method not found - '";
   e += base;
   e += (base[0] ? "." : "") + std::string(methodName) + "'";
@@ -202,17 +254,18 @@ VarValue VirtualMachine::CallStatic(
   }
 
   VarValue result = VarValue::None();
-  FunctionInfo function;
 
-  auto functionNameLower = ToLower(functionName);
-  auto f = nativeStaticFunctions[ToLower(className)][functionNameLower]
-    ? nativeStaticFunctions[ToLower(className)][functionNameLower]
-    : nativeStaticFunctions[""][functionNameLower];
+  const uint32_t functionId = GetNameId(functionName.data());
+  auto f = nativeStaticFunctions.find(
+    MakeNativeKey(GetNameId(className.data()), functionId));
+  if (f == nativeStaticFunctions.end() || !f->second) {
+    f = nativeStaticFunctions.find(MakeNativeKey(GetNameId(""), functionId));
+  }
 
-  if (f) {
+  if (f != nativeStaticFunctions.end() && f->second) {
     auto self = VarValue::None();
     self.SetMetaStackIdHolder(stackIdHolder);
-    return f(self, arguments);
+    return f->second(self, arguments);
   }
 
   auto classNameCi = CIString{ className.begin(), className.end() };
@@ -221,6 +274,7 @@ VarValue VirtualMachine::CallStatic(
     if (this->missingScriptHandler) {
       if (auto newScript = this->missingScriptHandler(className)) {
         allLoadedScripts[classNameCi] = *newScript;
+        nativeMethodsCache.clear();
       }
     }
     it = allLoadedScripts.find(classNameCi);
@@ -234,16 +288,18 @@ VarValue VirtualMachine::CallStatic(
                                                    VarValue::None(), "");
   }
 
-  function = instance->GetFunctionByName(functionName.c_str(), "");
+  static const std::string defaultState;
+  auto function =
+    instance->GetFunctionByName(functionName.c_str(), defaultState);
 
-  if (function.valid) {
-    if (function.IsNative())
+  if (function) {
+    if (function->IsNative())
       throw std::runtime_error("Function not found - '" +
                                std::string(functionName) + "'");
 
-    result = instance->StartFunction(function, arguments, stackIdHolder);
+    result = instance->StartFunction(*function, arguments, stackIdHolder);
   }
-  if (!function.valid)
+  if (!function)
     throw std::runtime_error("function is not valid");
 
   return result;
@@ -284,14 +340,13 @@ bool VirtualMachine::IsNativeFunctionByNameExisted(
   const std::string& name) const
 {
   for (auto& staticFunction : nativeStaticFunctions) {
-    if (staticFunction.first == name)
+    if (names[staticFunction.first >> 32] == name)
       return true;
   }
 
   for (auto& metod : nativeFunctions) {
-    for (auto& func : metod.second)
-      if (func.first == name)
-        return true;
+    if (names[static_cast<uint32_t>(metod.first)] == name)
+      return true;
   }
 
   return false;
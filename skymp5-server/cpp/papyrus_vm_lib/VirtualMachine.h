@@ -6,6 +6,7 @@
 #include <functional>
 #include <map>
 #include <set>
+#include <unordered_map>
 
 class VirtualMachine;
 
@@ -90,11 +91,34 @@ public:
   ExceptionHandler GetExceptionHandler() const;
 
 private:
+  uint32_t GetNameId(const char* name);
+
+  static uint64_t MakeNativeKey(uint32_t classId, uint32_t functionId);
+
+  // Searches the class and its parents. 'lastClass' receives the last class
+  // searched
+  const NativeFunction* FindNativeMethod(const char* nativeClass,
+                                         uint32_t methodId,
+                                         const char** lastClass = nullptr);
+
+  const NativeFunction* FindNativeMethodCached(const char* nativeClass,
+                                               uint32_t methodId);
+
   CIMap<PexScript::Lazy> allLoadedScripts;
 
-  std::map<std::string, std::map<std::string, NativeFunction>> nativeFunctions,
+  // Case-insensitive names of classes and functions used for native
+  // dispatch have ids. 'names' stores lowercase names by id
+  CIMap<uint32_t> nameIds;
+  std::vector<std::string> names;
+
+  // Keys are made with MakeNativeKey
+  std::unordered_map<uint64_t, NativeFunction> nativeFunctions,
     nativeStaticFunctions;
 
+  // Results of FindNativeMethod, nullptr if not found. Cleared once
+  // functions or scripts are added
+  std::unordered_map<uint64_t, const NativeFunction*> nativeMethodsCache;
+
   std::map<std::string, std::shared_ptr<ActivePexInstance>>
     instancesForStaticCalls;
 
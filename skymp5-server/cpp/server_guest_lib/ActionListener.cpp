@@ -88,13 +88,17 @@ void ActionListener::OnUpdateMovement(const RawMessageData& rawMsgData,
       std::numeric_limits<float>::infinity()
     };
 
-    auto& espmFiles = actor->GetParent()->espmFiles;
+    auto& worldState = *actor->GetParent();
+    auto& espmFiles = worldState.espmFiles;
+    const NavMeshIndex* navMeshIndex =
+      worldState.IsNavMeshValidationEnabled() ? &worldState.GetNavMeshIndex()
+                                              : nullptr;
     if (!MovementValidation::Validate(
           *actor, teleportFlag ? reallyWrongPos : pos,
           FormDesc::FromFormId(worldOrCell, espmFiles),
           isMe ? static_cast<IMessageOutput&>(msgOutput)
                : static_cast<IMessageOutput&>(msgOutputDummy),
-          espmFiles)) {
+          espmFiles, navMeshIndex)) {
       return;
     }
 
@@ -161,7 +165,6 @@ void RecalculateWorn(MpObjectReference& refr)
     return;
   }
   auto& loader = refr.GetParent()->GetEspm();
-  auto& cache = refr.GetParent()->GetEspmCache();
 
   auto ac = dynamic_cast<MpActor*>(&refr);
   if (!ac) {
@@ -189,10 +192,13 @@ void RecalculateWorn(MpObjectReference& refr)
     if (entry.baseId) {
       auto lookupRes = loader.GetBrowser().LookupById(entry.baseId);
       if (auto weap = espm::Convert<espm::WEAP>(lookupRes.rec)) {
-        if (!bestEntry.count ||
-            weap->GetData(cache).weapData->damage > bestDamage) {
+        const auto damage = loader.GetBrowser()
+                              .GetDecodedRecordsCache()
+                              .GetData(weap)
+                              .weapData->damage;
+        if (!bestEntry.count || damage > bestDamage) {
           bestEntry = entry;
-          bestDamage = weap->GetData(cache).weapData->damage;
+          bestDamage = damage;
         }
       }
     }
@@ -375,7 +381,8 @@ void ActionListener::OnCraftItem(const RawMessageData& rawMsgData,
   }
 
   int espmIdx = 0;
-  auto recipeUsed = FindRecipe(br, inputObjects, resultObjectId, &espmIdx);
+  auto recipeUsed = partOne.worldState.GetRecipeIndex().Find(
+    inputObjects, resultObjectId, &espmIdx);
 
   if (!recipeUsed) {
     throw std::runtime_error("Recipe not found");
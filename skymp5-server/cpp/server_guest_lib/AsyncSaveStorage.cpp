@@ -6,17 +6,30 @@ struct AsyncSaveStorage::Impl
   struct UpsertTask
   {
     std::vector<MpChangeForm> changeForms;
+    std::vector<ChangeFormFieldMask> changedFields;
     std::function<void()> callback;
+    std::function<void()> failedCallback;
   };
 
   std::shared_ptr<spdlog::logger> logger;
 
+  // Held by the saver thread while upserting
   struct
   {
     std::shared_ptr<IDatabase> dbImpl;
     std::mutex m;
   } share;
 
+  // Chunks are loaded on the tick thread, so reads don't wait for saving if
+  // the database allows that
+  std::mutex readMutex;
+
+  std::unique_lock<std::mutex> LockForReading()
+  {
+    return std::unique_lock(
+      share.dbImpl->SupportsConcurrentReads() ? readMutex : share.m);
+  }
+
   struct
   {
     std::list<std::exception_ptr> exceptions;
@@ -32,6 +45,7 @@ struct AsyncSaveStorage::Impl
   struct
   {
     std::vector<std::function<void()>> upsertCallbacksToFire;
+    std::vector<std::function<void()>> failedUpsertCallbacksToFire;
     std::mutex m;
   } share4;
 
@@ -71,14 +85,27 @@ void AsyncSaveStorage::SaverThreadMain(Impl* pImpl)
       }
 
       std::vector<std::function<void()>> callbacksToFire;
+      std::vector<std::function<void()>> failedCallbacksToFire;
 
       {
         std::lock_guard l(pImpl->share.m);
         auto was = clock();
         size_t numChangeForms = 0;
         for (auto& t : tasks) {
-          numChangeForms += pImpl->share.dbImpl->Upsert(t.changeForms);
-          callbacksToFire.push_back(t.callback);
+          // A failed task must not prevent other tasks from being saved
+          try {
+            auto& db = *pImpl->share.dbImpl;
+            numChangeForms += t.changedFields.empty()
+              ? db.Upsert(t.changeForms)
+              : db.UpsertPartial(t.changeForms, t.changedFields);
+            callbacksToFire.push_back(t.callback);
+          } catch (...) {
+            if (t.failedCallback) {
+              failedCallbacksToFire.push_back(t.failedCallback);
+            }
+            std::lock_guard l(pImpl->share2.m);
+            pImpl->share2.exceptions.push_back(std::current_exception());
+          }
         }
         if (numChangeForms > 0 && pImpl->logger)
           pImpl->logger->info("Saved {} ChangeForms in {} ticks",
@@ -89,6 +116,8 @@ void AsyncSaveStorage::SaverThreadMain(Impl* pImpl)
         std::lock_guard l(pImpl->share4.m);
         for (auto& cb : callbacksToFire)
           pImpl->share4.upsertCallbacksToFire.push_back(cb);
+        for (auto& cb : failedCallbacksToFire)
+          pImpl->share4.failedUpsertCallbacksToFire.push_back(cb);
       }
     } catch (...) {
       std::lock_guard l(pImpl->share2.m);
@@ -100,15 +129,36 @@ void AsyncSaveStorage::SaverThreadMain(Impl* pImpl)
 
 void AsyncSaveStorage::IterateSync(const IterateSyncCallback& cb)
 {
-  std::lock_guard l(pImpl->share.m);
+  auto l = pImpl->LockForReading();
   pImpl->share.dbImpl->Iterate(cb);
 }
 
-void AsyncSaveStorage::Upsert(const std::vector<MpChangeForm>& changeForms,
-                              const UpsertCallback& cb)
+void AsyncSaveStorage::IterateLocationsSync(
+  const IDatabase::IterateLocationsCallback& cb)
 {
+  auto l = pImpl->LockForReading();
+  pImpl->share.dbImpl->IterateLocations(cb);
+}
+
+void AsyncSaveStorage::IterateByFormDescsSync(
+  const std::vector<FormDesc>& formDescs, const IterateSyncCallback& cb)
+{
+  auto l = pImpl->LockForReading();
+  pImpl->share.dbImpl->IterateByFormDescs(formDescs, cb);
+}
+
+void AsyncSaveStorage::Upsert(
+  const std::vector<MpChangeForm>& changeForms,
+  const std::vector<ChangeFormFieldMask>& changedFields,
+  const UpsertCallback& cb, const UpsertCallback& failedCb)
+{
+  if (!changedFields.empty() && changedFields.size() != changeForms.size()) {
+    throw std::runtime_error("changedFields size mismatch");
+  }
+
   std::lock_guard l(pImpl->share3.m);
-  pImpl->share3.upsertTasks.push_back({ changeForms, cb });
+  pImpl->share3.upsertTasks.push_back(
+    { changeForms, changedFields, cb, failedCb });
 }
 
 uint32_t AsyncSaveStorage::GetNumFinishedUpserts() const
@@ -118,23 +168,34 @@ uint32_t AsyncSaveStorage::GetNumFinishedUpserts() const
 
 void AsyncSaveStorage::Tick()
 {
-  {
-    std::lock_guard l(pImpl->share2.m);
-    if (!pImpl->share2.exceptions.empty()) {
-      auto exceptionPtr = std::move(pImpl->share2.exceptions.front());
-      pImpl->share2.exceptions.pop_front();
-      std::rethrow_exception(exceptionPtr);
-    }
-  }
-
   decltype(pImpl->share4.upsertCallbacksToFire) upsertCallbacksToFire;
+  decltype(pImpl->share4.failedUpsertCallbacksToFire)
+    failedUpsertCallbacksToFire;
   {
     std::lock_guard l(pImpl->share4.m);
     upsertCallbacksToFire = std::move(pImpl->share4.upsertCallbacksToFire);
     pImpl->share4.upsertCallbacksToFire.clear();
+    failedUpsertCallbacksToFire =
+      std::move(pImpl->share4.failedUpsertCallbacksToFire);
+    pImpl->share4.failedUpsertCallbacksToFire.clear();
   }
   for (auto& cb : upsertCallbacksToFire) {
     pImpl->numFinishedUpserts++;
     cb();
   }
+
+  // Failed callbacks go before the error is rethrown so that the caller is
+  // able to retry
+  for (auto& cb : failedUpsertCallbacksToFire) {
+    cb();
+  }
+
+  {
+    std::lock_guard l(pImpl->share2.m);
+    if (!pImpl->share2.exceptions.empty()) {
+      auto exceptionPtr = std::move(pImpl->share2.exceptions.front());
+      pImpl->share2.exceptions.pop_front();
+      std::rethrow_exception(exceptionPtr);
+    }
+  }
 }
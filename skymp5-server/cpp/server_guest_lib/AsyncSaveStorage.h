@@ -12,9 +12,17 @@ public:
                    std::shared_ptr<spdlog::logger> logger = nullptr);
   ~AsyncSaveStorage();
 
+  using ISaveStorage::Upsert;
+
   void IterateSync(const IterateSyncCallback& cb) override;
+  void IterateLocationsSync(
+    const IDatabase::IterateLocationsCallback& cb) override;
+  void IterateByFormDescsSync(const std::vector<FormDesc>& formDescs,
+                              const IterateSyncCallback& cb) override;
   void Upsert(const std::vector<MpChangeForm>& changeForms,
-              const UpsertCallback& cb) override;
+              const std::vector<ChangeFormFieldMask>& changedFields,
+              const UpsertCallback& cb,
+              const UpsertCallback& failedCb) override;
   uint32_t GetNumFinishedUpserts() const override;
   void Tick() override;
 
@@ -23,24 +23,48 @@ public:
     NoRequestSave
   };
 
+  // 'fields' is a mask of ChangeFormField that 'f' may modify
   template <class F>
-  void EditChangeForm(F f, Mode mode = Mode::RequestSave)
+  void EditChangeForm(F f, ChangeFormFieldMask fields,
+                      Mode mode = Mode::RequestSave)
   {
     f(changeForm);
+    changedFields |= fields;
     if (!blockSaving && mode == Mode::RequestSave) {
       lastSaveRequest = std::chrono::system_clock::now();
       ChangeFormGuard_::RequestSave(self);
     }
   }
 
+  template <class F>
+  void EditChangeForm(F f, Mode mode = Mode::RequestSave)
+  {
+    EditChangeForm(f, ChangeFormField::All, mode);
+  }
+
   const T& ChangeForm() const noexcept { return changeForm; }
 
+  // Returns fields edited since the previous call. The caller becomes
+  // responsible for saving them, see SaveScheduler::Restore
+  ChangeFormFieldMask TakeChangedFields() noexcept
+  {
+    auto res = changedFields;
+    changedFields = 0;
+    return res;
+  }
+
+  void SetChangedFields(ChangeFormFieldMask fields) noexcept
+  {
+    changedFields = fields;
+  }
+
   auto GetLastSaveRequestMoment() const { return lastSaveRequest; }
 
   bool blockSaving = false;
 
 private:
   T changeForm;
+  ChangeFormFieldMask changedFields = ChangeFormField::All;
   MpObjectReference* const self;
   std::optional<std::chrono::system_clock::time_point> lastSaveRequest;
 };
@@ -0,0 +1,311 @@
+#include "ChangeFormJournal.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#ifdef WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+namespace {
+int SyncFile(FILE* file)
+{
+#ifdef WIN32
+  return _commit(_fileno(file));
+#else
+  return fsync(fileno(file));
+#endif
+}
+}
+
+struct ChangeFormJournal::Impl
+{
+  std::filesystem::path path;
+  std::shared_ptr<spdlog::logger> logger;
+  std::chrono::milliseconds syncInterval;
+
+  struct
+  {
+    // Segment and change form
+    std::vector<std::pair<uint64_t, MpChangeForm>> changeForms;
+    uint64_t currentSegment = 0;
+
+    // The segment with the latest version of each change form not saved yet
+    std::map<FormDesc, uint64_t> unsavedSegments;
+    std::map<uint64_t, size_t> numUnsaved;
+
+    // Segments with smaller numbers are to be deleted
+    uint64_t deleteBefore = 0;
+    std::mutex m;
+  } share;
+
+  // Lock order: fileMutex, then share.m
+  std::mutex fileMutex;
+  FILE* file = nullptr;
+  uint64_t fileSegment = 0;
+  std::set<uint64_t> segmentsOnDisk;
+
+  std::unique_ptr<std::thread> thr;
+  std::atomic<bool> destroyed = false;
+
+  std::filesystem::path GetSegmentPath(uint64_t segment) const
+  {
+    auto res = path;
+    res += "." + std::to_string(segment);
+    return res;
+  }
+
+  void FindSegments()
+  {
+    auto directory = path.has_parent_path() ? path.parent_path()
+                                            : std::filesystem::path(".");
+    auto prefix = path.filename().string() + ".";
+    for (auto& entry : std::filesystem::directory_iterator(directory)) {
+      auto fileName = entry.path().filename().string();
+      if (fileName.size() <= prefix.size() ||
+          fileName.compare(0, prefix.size(), prefix) != 0) {
+        continue;
+      }
+      auto suffix = fileName.substr(prefix.size());
+      if (suffix.find_first_not_of("0123456789") != std::string::npos) {
+        continue;
+      }
+      segmentsOnDisk.insert(std::stoull(suffix));
+    }
+  }
+
+  void DecrementUnsaved(uint64_t segment)
+  {
+    auto it = share.numUnsaved.find(segment);
+    if (--it->second == 0) {
+      share.numUnsaved.erase(it);
+    }
+  }
+
+  void CloseFile()
+  {
+    if (file) {
+      fclose(file);
+      file = nullptr;
+    }
+  }
+
+  void WriteBuffer(const std::string& buf)
+  {
+    if (fwrite(buf.data(), 1, buf.size(), file) != buf.size() ||
+        fflush(file) != 0 || SyncFile(file) != 0) {
+      throw std::runtime_error("Unable to write change form journal " +
+                               GetSegmentPath(fileSegment).string());
+    }
+  }
+
+  void WriteQueued()
+  {
+    std::lock_guard fileLock(fileMutex);
+
+    std::vector<std::pair<uint64_t, MpChangeForm>> changeForms;
+    uint64_t deleteBefore = 0;
+    {
+      std::lock_guard l(share.m);
+      changeForms = std::move(share.changeForms);
+      share.changeForms.clear();
+      deleteBefore = share.deleteBefore;
+    }
+
+    std::string buf;
+    for (auto& [segment, changeForm] : changeForms) {
+      if (!file || fileSegment != segment) {
+        if (file) {
+          WriteBuffer(buf);
+          buf.clear();
+          CloseFile();
+        }
+        auto segmentPath = GetSegmentPath(segment);
+        file = fopen(segmentPath.string().data(), "ab");
+        if (!file) {
+          throw std::runtime_error("Unable to open change form journal " +
+                                   segmentPath.string());
+        }
+        fileSegment = segment;
+        segmentsOnDisk.insert(segment);
+      }
+      buf += MpChangeForm::ToJson(changeForm).dump();
+      buf += '\n';
+    }
+    if (file && !buf.empty()) {
+      WriteBuffer(buf);
+    }
+
+    // Newer versions of change forms from these segments are synced above
+    while (!segmentsOnDisk.empty()) {
+      auto segment = *segmentsOnDisk.begin();
+      if (segment >= deleteBefore) {
+        break;
+      }
+      if (file && fileSegment == segment) {
+        CloseFile();
+      }
+      std::error_code ec;
+      std::filesystem::remove(GetSegmentPath(segment), ec);
+      if (ec && logger) {
+        logger->error("Unable to remove change form journal {}: {}",
+                      GetSegmentPath(segment).string(), ec.message());
+      }
+      segmentsOnDisk.erase(segmentsOnDisk.begin());
+    }
+  }
+};
+
+ChangeFormJournal::ChangeFormJournal(std::string path,
+                                     std::shared_ptr<spdlog::logger> logger,
+                                     std::chrono::milliseconds syncInterval)
+  : pImpl(new Impl, [](Impl* p) { delete p; })
+{
+  pImpl->path = path;
+  pImpl->logger = logger;
+  pImpl->syncInterval = syncInterval;
+
+  if (pImpl->path.has_parent_path()) {
+    std::filesystem::create_directories(pImpl->path.parent_path());
+  }
+
+  // Segments of the previous run are kept for Replay. Nothing is appended to
+  // them, so a record partially written before a crash stays the last one
+  pImpl->FindSegments();
+  if (!pImpl->segmentsOnDisk.empty()) {
+    pImpl->share.currentSegment = *pImpl->segmentsOnDisk.rbegin() + 1;
+  }
+
+  auto p = pImpl.get();
+  pImpl->thr.reset(new std::thread([p] { WriterThreadMain(p); }));
+}
+
+ChangeFormJournal::~ChangeFormJournal()
+{
+  pImpl->destroyed = true;
+  pImpl->thr->join();
+
+  try {
+    pImpl->WriteQueued();
+  } catch (std::exception& e) {
+    if (pImpl->logger) {
+      pImpl->logger->error("{}", e.what());
+    }
+  }
+  pImpl->CloseFile();
+}
+
+void ChangeFormJournal::WriterThreadMain(Impl* pImpl)
+{
+  while (!pImpl->destroyed) {
+    std::this_thread::sleep_for(pImpl->syncInterval);
+    try {
+      pImpl->WriteQueued();
+    } catch (std::exception& e) {
+      if (pImpl->logger) {
+        pImpl->logger->error("{}", e.what());
+      }
+    }
+  }
+}
+
+void ChangeFormJournal::Append(const MpChangeForm& changeForm)
+{
+  std::lock_guard l(pImpl->share.m);
+  auto current = pImpl->share.currentSegment;
+  pImpl->share.changeForms.push_back({ current, changeForm });
+
+  auto [it, inserted] =
+    pImpl->share.unsavedSegments.try_emplace(changeForm.formDesc, current);
+  if (!inserted) {
+    if (it->second == current) {
+      return;
+    }
+    pImpl->DecrementUnsaved(it->second);
+    it->second = current;
+  }
+  ++pImpl->share.numUnsaved[current];
+}
+
+uint64_t ChangeFormJournal::Rotate()
+{
+  std::lock_guard l(pImpl->share.m);
+  return pImpl->share.currentSegment++;
+}
+
+void ChangeFormJournal::MarkSaved(const std::vector<MpChangeForm>& changeForms,
+                                  uint64_t segment)
+{
+  std::lock_guard l(pImpl->share.m);
+  auto& share = pImpl->share;
+
+  for (auto& changeForm : changeForms) {
+    auto it = share.unsavedSegments.find(changeForm.formDesc);
+    if (it != share.unsavedSegments.end() && it->second <= segment) {
+      pImpl->DecrementUnsaved(it->second);
+      share.unsavedSegments.erase(it);
+    }
+  }
+
+  auto deleteBefore = share.currentSegment;
+  if (!share.numUnsaved.empty()) {
+    deleteBefore = share.numUnsaved.begin()->first;
+  }
+  share.deleteBefore = std::max(share.deleteBefore, deleteBefore);
+}
+
+void ChangeFormJournal::Sync()
+{
+  pImpl->WriteQueued();
+}
+
+void ChangeFormJournal::Replay(const ReplayCallback& callback) const
+{
+  std::lock_guard fileLock(pImpl->fileMutex);
+
+  simdjson::dom::parser parser;
+
+  for (auto segment : pImpl->segmentsOnDisk) {
+    auto segmentPath = pImpl->GetSegmentPath(segment);
+    std::ifstream f(segmentPath, std::ios::binary);
+
+    size_t lineNumber = 0;
+    std::string line;
+    while (std::getline(f, line)) {
+      ++lineNumber;
+      MpChangeForm changeForm;
+      try {
+        auto result = parser.parse(line).value();
+        changeForm = MpChangeForm::JsonToChangeForm(result);
+      } catch (std::exception& e) {
+        // Most likely the server crashed while writing this record
+        if (pImpl->logger) {
+          pImpl->logger->warn("Skipping line {} of change form journal {}: {}",
+                              lineNumber, segmentPath.string(), e.what());
+        }
+        continue;
+      }
+      callback(changeForm);
+    }
+  }
+}
+
+std::vector<std::string> ChangeFormJournal::GetSegmentPaths() const
+{
+  std::lock_guard fileLock(pImpl->fileMutex);
+
+  std::vector<std::string> res;
+  for (auto segment : pImpl->segmentsOnDisk) {
+    res.push_back(pImpl->GetSegmentPath(segment).string());
+  }
+  return res;
+}
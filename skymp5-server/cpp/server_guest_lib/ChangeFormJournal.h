@@ -0,0 +1,64 @@
+#pragma once
+#include "MpChangeForms.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <spdlog/logger.h>
+#include <string>
+#include <vector>
+
+// Append-only log of change forms that are not saved to the database yet.
+// Append is cheap: change forms are serialized and written on a background
+// thread, one fsync per 'syncInterval' (group commit). After a crash, Replay
+// returns change forms that would be lost otherwise.
+//
+// The log is split into segments '<path>.<n>'. Rotate starts a new segment,
+// i.e. when a batch of change forms is sent to the database. Once the batch
+// is saved, MarkSaved lets the journal delete segments containing no change
+// forms that still need saving.
+class ChangeFormJournal
+{
+public:
+  static constexpr std::chrono::milliseconds kDefaultSyncInterval{ 50 };
+
+  using ReplayCallback = std::function<void(const MpChangeForm&)>;
+
+  // logger must support multithreaded writing
+  ChangeFormJournal(std::string path,
+                    std::shared_ptr<spdlog::logger> logger = nullptr,
+                    std::chrono::milliseconds syncInterval =
+                      kDefaultSyncInterval);
+
+  // Writes everything appended before returning
+  ~ChangeFormJournal();
+
+  void Append(const MpChangeForm& changeForm);
+
+  // Returns the segment change forms have been appended to so far. Later
+  // change forms are appended to a new one
+  uint64_t Rotate();
+
+  // 'changeForms' were saved to the database before being appended again
+  // after Rotate returned 'segment'. Segments left with no unsaved change
+  // forms are deleted after writing what has been appended so far
+  void MarkSaved(const std::vector<MpChangeForm>& changeForms,
+                 uint64_t segment);
+
+  // Blocks until everything appended so far is written and synced, and
+  // segments no longer needed are deleted
+  void Sync();
+
+  // Visits change forms written to the journal files in order of appending.
+  // Partially written records are skipped
+  void Replay(const ReplayCallback& callback) const;
+
+  // Segments present on disk, oldest first
+  std::vector<std::string> GetSegmentPaths() const;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl, void (*)(Impl*)> pImpl;
+
+  static void WriterThreadMain(Impl*);
+};
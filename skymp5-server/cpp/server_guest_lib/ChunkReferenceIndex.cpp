@@ -0,0 +1,161 @@
+#include "ChunkReferenceIndex.h"
+#include <GroupUtils.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace {
+uint64_t MakeChunkKey(uint32_t cellOrWorld, int16_t x, int16_t y)
+{
+  return (static_cast<uint64_t>(cellOrWorld) << 32) |
+    (static_cast<uint64_t>(static_cast<uint16_t>(x)) << 16) |
+    static_cast<uint16_t>(y);
+}
+
+struct Reference
+{
+  uint32_t formId = 0;
+  uint64_t chunkKey = 0;
+  bool hasChunk = false;
+
+  // Not counting other plugins overriding the reference
+  bool loadable = false;
+};
+
+Reference ClassifyReference(const espm::CombineBrowser& br,
+                            const espm::RecordHeader* rec,
+                            const espm::IdMapping& mapping,
+                            espm::CompressedFieldsCache& cache)
+{
+  enum
+  {
+    InitiallyDisabled = 0x800
+  };
+
+  Reference res;
+  res.formId = espm::GetMappedId(rec->GetId(), mapping);
+
+  auto refr = reinterpret_cast<const espm::REFR*>(rec);
+  auto data = refr->GetData(cache);
+
+  // The same chunk Browser::GetRecordsAtPos puts the reference to
+  if (data.loc) {
+    const auto x = static_cast<int16_t>(data.loc->pos[0] / 4096);
+    const auto y = static_cast<int16_t>(data.loc->pos[1] / 4096);
+    const auto cellOrWorld =
+      espm::GetMappedId(espm::GetWorldOrCell(br, rec), mapping);
+    res.chunkKey = MakeChunkKey(cellOrWorld, x, y);
+    res.hasChunk = true;
+  }
+
+  // NPC_ references are not loaded yet, see WorldState::AttachEspmRecord
+  auto base = br.LookupById(espm::GetMappedId(data.baseId, mapping));
+  res.loadable = base.rec && base.rec->GetType() != "NPC_" &&
+    !(rec->GetFlags() & InitiallyDisabled) &&
+    IsLoadableReferenceBase(base.rec, cache);
+  return res;
+}
+}
+
+bool IsLoadableReferenceBase(const espm::RecordHeader* base,
+                             espm::CompressedFieldsCache& cache)
+{
+  espm::Type t = base->GetType();
+  return t == "NPC_" || t == "FURN" || t == "ACTI" || espm::IsItem(t) ||
+    t == "DOOR" || t == "CONT" ||
+    (t == "FLOR" &&
+     reinterpret_cast<const espm::FLOR*>(base)->GetData(cache).resultItem) ||
+    (t == "TREE" &&
+     reinterpret_cast<const espm::TREE*>(base)->GetData(cache).resultItem);
+}
+
+ChunkReferenceIndex::ChunkReferenceIndex(const espm::CombineBrowser& br,
+                                         size_t numThreads)
+{
+  // REFR index of Browser contains ACHR records too
+  const auto recordsByFile = br.GetRecordsByType("REFR");
+
+  std::vector<std::pair<size_t, const espm::RecordHeader*>> records;
+  for (size_t i = 0; i < recordsByFile.size(); ++i) {
+    for (auto rec : *recordsByFile[i]) {
+      records.push_back({ i, rec });
+    }
+  }
+
+  std::vector<Reference> references(records.size());
+  std::atomic<size_t> nextRecord = 0;
+  std::atomic<bool> failed = false;
+  std::exception_ptr exception;
+  std::mutex exceptionMutex;
+
+  auto work = [&] {
+    espm::CompressedFieldsCache cache(16 * 1024 * 1024, &br.GetCache());
+    while (!failed) {
+      const size_t i = nextRecord++;
+      if (i >= records.size()) {
+        break;
+      }
+      try {
+        auto [fileIdx, rec] = records[i];
+        references[i] =
+          ClassifyReference(br, rec, *br.GetCombMapping(fileIdx), cache);
+      } catch (...) {
+        std::lock_guard l(exceptionMutex);
+        if (!failed.exchange(true)) {
+          exception = std::current_exception();
+        }
+      }
+    }
+  };
+
+  if (numThreads == 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  numThreads = std::min(numThreads, records.size());
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < numThreads; ++i) {
+    threads.emplace_back(work);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+
+  // WorldState::LoadForm loads a reference if any plugin's version passes
+  spp::sparse_hash_set<uint32_t> loadable;
+  for (auto& reference : references) {
+    if (reference.loadable) {
+      loadable.insert(reference.formId);
+    }
+  }
+
+  for (auto& reference : references) {
+    if (!reference.hasChunk || !loadable.count(reference.formId)) {
+      continue;
+    }
+    auto& chunk = referencesByChunk[reference.chunkKey];
+    if (std::find(chunk.begin(), chunk.end(), reference.formId) ==
+        chunk.end()) {
+      chunk.push_back(reference.formId);
+      ++numReferences;
+    }
+  }
+}
+
+const std::vector<uint32_t>& ChunkReferenceIndex::GetReferencesAtPos(
+  uint32_t cellOrWorld, int16_t cellX, int16_t cellY) const
+{
+  static const std::vector<uint32_t> kEmpty;
+  auto it = referencesByChunk.find(MakeChunkKey(cellOrWorld, cellX, cellY));
+  return it == referencesByChunk.end() ? kEmpty : it->second;
+}
+
+size_t ChunkReferenceIndex::GetNumReferences() const noexcept
+{
+  return numReferences;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <Combiner.h>
+#include <cstdint>
+#include <sparsepp/spp.h>
+#include <vector>
+
+// Whether references to 'base' may be loaded as forms by WorldState
+bool IsLoadableReferenceBase(const espm::RecordHeader* base,
+                             espm::CompressedFieldsCache& cache);
+
+// References of all plugins merged per chunk. Only references WorldState
+// loads are kept, so chunk loading doesn't look up every static object
+class ChunkReferenceIndex
+{
+public:
+  // References are classified in 'numThreads' worker threads, 0 means one
+  // per hardware thread
+  explicit ChunkReferenceIndex(const espm::CombineBrowser& br,
+                               size_t numThreads = 0);
+
+  // Form ids of references placed at the chunk by any plugin, in load order
+  const std::vector<uint32_t>& GetReferencesAtPos(uint32_t cellOrWorld,
+                                                  int16_t cellX,
+                                                  int16_t cellY) const;
+
+  size_t GetNumReferences() const noexcept;
+
+private:
+  spp::sparse_hash_map<uint64_t, std::vector<uint32_t>> referencesByChunk;
+  size_t numReferences = 0;
+};
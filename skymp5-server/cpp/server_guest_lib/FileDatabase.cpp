@@ -6,26 +6,52 @@ struct FileDatabase::Impl
 {
   const std::filesystem::path changeFormsDirectory;
   const std::shared_ptr<spdlog::logger> logger;
+  const std::filesystem::path metadataDirectory;
+
+  std::filesystem::path GetFilePath(const FormDesc& formDesc) const
+  {
+    return changeFormsDirectory / (formDesc.ToString('_') + ".json");
+  }
+
+  void ParseFile(const std::filesystem::path& filePath,
+                 simdjson::dom::parser& parser,
+                 const IterateCallback& iterateCallback) const;
 };
 
+void FileDatabase::Impl::ParseFile(
+  const std::filesystem::path& filePath, simdjson::dom::parser& parser,
+  const IterateCallback& iterateCallback) const
+{
+  try {
+    std::ifstream t(filePath);
+    std::string jsonDump((std::istreambuf_iterator<char>(t)),
+                         std::istreambuf_iterator<char>());
+
+    auto result = parser.parse(jsonDump).value();
+    iterateCallback(MpChangeForm::JsonToChangeForm(result));
+  } catch (std::exception& e) {
+    logger->error("Parsing of {} failed with {}", filePath.string(),
+                  e.what());
+  }
+}
+
 FileDatabase::FileDatabase(std::string directory_,
                            std::shared_ptr<spdlog::logger> logger_)
 {
   std::filesystem::path p = directory_;
   p /= "changeForms";
 
-  pImpl.reset(new Impl{ p, logger_ });
+  pImpl.reset(
+    new Impl{ p, logger_, std::filesystem::path(directory_) / "metadata" });
   std::filesystem::create_directories(p);
 }
 
 size_t FileDatabase::Upsert(const std::vector<MpChangeForm>& changeForms)
 {
-  auto p = pImpl->changeFormsDirectory;
   size_t nUpserted = 0;
 
   for (auto& changeForm : changeForms) {
-    std::string fileName = changeForm.formDesc.ToString('_') + ".json";
-    auto filePath = p / fileName;
+    auto filePath = pImpl->GetFilePath(changeForm.formDesc);
     std::ofstream f(filePath);
     if (f) {
       f << MpChangeForm::ToJson(changeForm).dump(2);
@@ -54,16 +80,49 @@ void FileDatabase::Iterate(const IterateCallback& iterateCallback)
   }
 
   for (auto& entry : std::filesystem::directory_iterator(p)) {
-    try {
-      std::ifstream t(entry.path());
-      std::string jsonDump((std::istreambuf_iterator<char>(t)),
-                           std::istreambuf_iterator<char>());
-
-      auto result = parser.parse(jsonDump).value();
-      iterateCallback(MpChangeForm::JsonToChangeForm(result));
-    } catch (std::exception& e) {
-      pImpl->logger->error("Parsing of {} failed with {}",
-                           entry.path().string(), e.what());
+    pImpl->ParseFile(entry.path(), parser, iterateCallback);
+  }
+}
+
+void FileDatabase::IterateByFormDescs(const std::vector<FormDesc>& formDescs,
+                                      const IterateCallback& iterateCallback)
+{
+  simdjson::dom::parser parser;
+
+  for (auto& formDesc : formDescs) {
+    auto filePath = pImpl->GetFilePath(formDesc);
+    if (std::filesystem::exists(filePath)) {
+      pImpl->ParseFile(filePath, parser, iterateCallback);
+    }
+  }
+}
+
+std::optional<std::string> FileDatabase::GetMetadata(const std::string& key)
+{
+  std::ifstream t(pImpl->metadataDirectory / key, std::ios::binary);
+  if (!t) {
+    return std::nullopt;
+  }
+  return std::string((std::istreambuf_iterator<char>(t)),
+                     std::istreambuf_iterator<char>());
+}
+
+void FileDatabase::SetMetadata(const std::string& key,
+                               const std::string& value)
+{
+  std::filesystem::create_directories(pImpl->metadataDirectory);
+
+  // Written to a temporary file first so that a crash never leaves a
+  // truncated value
+  auto filePath = pImpl->metadataDirectory / key;
+  auto tmpPath = filePath;
+  tmpPath += ".tmp";
+  {
+    std::ofstream f(tmpPath, std::ios::binary);
+    f << value;
+    if (!f) {
+      throw std::runtime_error("Unable to write " + tmpPath.string());
     }
   }
+  std::filesystem::rename(tmpPath, filePath);
 }
@@ -10,6 +10,10 @@ public:
 
   size_t Upsert(const std::vector<MpChangeForm>& changeForms) override;
   void Iterate(const IterateCallback& iterateCallback) override;
+  void IterateByFormDescs(const std::vector<FormDesc>& formDescs,
+                          const IterateCallback& iterateCallback) override;
+  std::optional<std::string> GetMetadata(const std::string& key) override;
+  void SetMetadata(const std::string& key, const std::string& value) override;
 
 private:
   struct Impl;
@@ -1,20 +1,32 @@
 #include "FindRecipe.h"
 #include <algorithm>
 
-bool RecipeMatches(const espm::IdMapping* mapping, const espm::COBJ* recipe,
-                   const Inventory& inputObjects, uint32_t resultObjectId)
+namespace {
+bool IsTemper(const espm::COBJ::Data& recipeData)
 {
-  espm::CompressedFieldsCache dummyCache;
-  auto recipeData = recipe->GetData(dummyCache);
-
   enum
   {
     ArmorTable = 0xadb78,
     SharpeningWheel = 0x88108
   };
-  const bool isTemper = recipeData.benchKeywordId == ArmorTable ||
+  return recipeData.benchKeywordId == ArmorTable ||
     recipeData.benchKeywordId == SharpeningWheel;
-  if (isTemper) {
+}
+
+bool IsOverridden(const espm::CombineBrowser& br,
+                  const espm::IdMapping* mapping, espm::RecordHeader* rec)
+{
+  return br.LookupById(espm::GetMappedId(rec->GetId(), *mapping)).rec != rec;
+}
+}
+
+bool RecipeMatches(const espm::IdMapping* mapping, const espm::COBJ* recipe,
+                   const Inventory& inputObjects, uint32_t resultObjectId,
+                   espm::CompressedFieldsCache& cache)
+{
+  auto recipeData = recipe->GetData(cache);
+
+  if (IsTemper(recipeData)) {
     return false;
   }
 
@@ -46,8 +58,10 @@ espm::COBJ* FindRecipe(const espm::CombineBrowser& br,
     auto it = std::find_if(espmLocalRecipes->begin(), espmLocalRecipes->end(),
                            [&](espm::RecordHeader* rec) {
                              auto recipe = reinterpret_cast<espm::COBJ*>(rec);
-                             return RecipeMatches(
-                               mapping, recipe, inputObjects, resultObjectId);
+                             return RecipeMatches(mapping, recipe,
+                                                  inputObjects, resultObjectId,
+                                                  br.GetCache()) &&
+                               !IsOverridden(br, mapping, rec);
                            });
     if (it != espmLocalRecipes->end()) {
       recipeUsed = reinterpret_cast<espm::COBJ*>(*it);
@@ -58,3 +72,60 @@ espm::COBJ* FindRecipe(const espm::CombineBrowser& br,
   }
   return recipeUsed;
 }
+
+RecipeIndex::RecipeIndex(const espm::CombineBrowser& br)
+{
+  auto allRecipes = br.GetRecordsByType("COBJ");
+
+  for (size_t i = 0; i < allRecipes.size(); ++i) {
+    auto mapping = br.GetCombMapping(i);
+    for (auto rec : *allRecipes[i]) {
+      if (IsOverridden(br, mapping, rec)) {
+        continue;
+      }
+
+      auto recipe = reinterpret_cast<espm::COBJ*>(rec);
+      auto recipeData = recipe->GetData(br.GetCache());
+      if (IsTemper(recipeData)) {
+        continue;
+      }
+
+      Recipe entry;
+      entry.recipe = recipe;
+      entry.espmIdx = static_cast<int>(i);
+      for (auto& inputObject : recipeData.inputObjects) {
+        entry.inputObjects.push_back(
+          { espm::GetMappedId(inputObject.formId, *mapping),
+            inputObject.count });
+      }
+
+      auto resultObjectId =
+        espm::GetMappedId(recipeData.outputObjectFormId, *mapping);
+      recipesByResult[resultObjectId].push_back(std::move(entry));
+    }
+  }
+}
+
+espm::COBJ* RecipeIndex::Find(const Inventory& inputObjects,
+                              uint32_t resultObjectId,
+                              int* optionalOutEspmIdx) const
+{
+  auto it = recipesByResult.find(resultObjectId);
+  if (it == recipesByResult.end()) {
+    return nullptr;
+  }
+
+  for (auto& recipe : it->second) {
+    bool matches = std::all_of(
+      recipe.inputObjects.begin(), recipe.inputObjects.end(),
+      [&](const Inventory::Entry& entry) {
+        return inputObjects.GetItemCount(entry.baseId) == entry.count;
+      });
+    if (matches) {
+      if (optionalOutEspmIdx)
+        *optionalOutEspmIdx = recipe.espmIdx;
+      return recipe.recipe;
+    }
+  }
+  return nullptr;
+}
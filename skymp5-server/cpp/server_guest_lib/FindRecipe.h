@@ -2,10 +2,36 @@
 #include "Inventory.h"
 #include "Loader.h"
 #include <cstdint>
+#include <sparsepp/spp.h>
+#include <vector>
 
 bool RecipeMatches(const espm::IdMapping* mapping, const espm::COBJ* recipe,
-                   const Inventory& inputObjects, uint32_t resultObjectId);
+                   const Inventory& inputObjects, uint32_t resultObjectId,
+                   espm::CompressedFieldsCache& cache);
 
+// Scans all recipes. Recipes overridden by later plugins are skipped
 espm::COBJ* FindRecipe(const espm::CombineBrowser& br,
                        const Inventory& inputObjects, uint32_t resultObjectId,
                        int* optionalOutEspmIdx = nullptr);
+
+// Same as FindRecipe, but only recipes with the requested result object are
+// checked. Input objects of recipes are mapped to combined form ids once
+class RecipeIndex
+{
+public:
+  explicit RecipeIndex(const espm::CombineBrowser& br);
+
+  espm::COBJ* Find(const Inventory& inputObjects, uint32_t resultObjectId,
+                   int* optionalOutEspmIdx = nullptr) const;
+
+private:
+  struct Recipe
+  {
+    espm::COBJ* recipe = nullptr;
+    int espmIdx = 0;
+    std::vector<Inventory::Entry> inputObjects;
+  };
+
+  // In the order FindRecipe checks them
+  spp::sparse_hash_map<uint32_t, std::vector<Recipe>> recipesByResult;
+};
@@ -55,9 +55,9 @@ float BaseActorValues::GetValue(espm::ActorValue av)
 BaseActorValues GetBaseActorValues(WorldState* worldState, uint32_t baseId,
                                    uint32_t raceIdOverride)
 {
-  auto npcData = espm::GetData<espm::NPC_>(baseId, worldState);
+  const auto& npcData = espm::GetData<espm::NPC_>(baseId, worldState);
   uint32_t raceID = raceIdOverride ? raceIdOverride : npcData.race;
-  auto raceData = espm::GetData<espm::RACE>(raceID, worldState);
+  const auto& raceData = espm::GetData<espm::RACE>(raceID, worldState);
 
   return { raceData.startingHealth + npcData.healthOffset,
            raceData.startingMagicka + npcData.magickaOffset,
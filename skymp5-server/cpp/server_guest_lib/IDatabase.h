@@ -1,12 +1,27 @@
 #pragma once
 #include "MpChangeForms.h"
 #include <functional>
+#include <optional>
+#include <set>
+#include <string>
 
 class IDatabase
 {
 public:
   using IterateCallback = std::function<void(const MpChangeForm&)>;
 
+  // Change form fields needed to decide when the change form is loaded
+  struct ChangeFormLocation
+  {
+    FormDesc formDesc;
+    FormDesc worldOrCellDesc;
+    NiPoint3 position;
+    int32_t profileId = -1;
+  };
+
+  using IterateLocationsCallback =
+    std::function<void(const ChangeFormLocation&)>;
+
   virtual ~IDatabase() = default;
 
   // Returns numbers of change forms inserted or updated successfully (Suitable
@@ -14,5 +29,54 @@ public:
   // saving succeed.
   virtual size_t Upsert(const std::vector<MpChangeForm>& changeForms) = 0;
 
+  // Same as Upsert, but only fields from the ChangeFormField mask of each
+  // change form have changed since the previous save. A change form may still
+  // be missing in the database, then it must be written entirely. Databases
+  // storing whole documents do not override this
+  virtual size_t UpsertPartial(
+    const std::vector<MpChangeForm>& changeForms,
+    const std::vector<ChangeFormFieldMask>& changedFields)
+  {
+    return Upsert(changeForms);
+  }
+
   virtual void Iterate(const IterateCallback& iterateCallback) = 0;
+
+  // Should be cheaper than Iterate. The default implementation isn't
+  virtual void IterateLocations(const IterateLocationsCallback& callback)
+  {
+    Iterate([&](const MpChangeForm& changeForm) {
+      callback({ changeForm.formDesc, changeForm.worldOrCellDesc,
+                 changeForm.position, changeForm.profileId });
+    });
+  }
+
+  // Visits change forms with the specified FormDescs, missing ones are
+  // ignored. The default implementation scans the whole database
+  virtual void IterateByFormDescs(const std::vector<FormDesc>& formDescs,
+                                  const IterateCallback& iterateCallback)
+  {
+    std::set<FormDesc> requested(formDescs.begin(), formDescs.end());
+    Iterate([&](const MpChangeForm& changeForm) {
+      if (requested.count(changeForm.formDesc)) {
+        iterateCallback(changeForm);
+      }
+    });
+  }
+
+  // True if reading methods may run while Upsert runs on another thread.
+  // Reads are never concurrent with each other. Otherwise AsyncSaveStorage
+  // waits for the save in progress before reading
+  virtual bool SupportsConcurrentReads() const { return false; }
+
+  // Small named values stored besides change forms, i.e. the state of
+  // MigrationDatabase. Databases not overriding these don't persist anything
+  virtual std::optional<std::string> GetMetadata(const std::string& key)
+  {
+    return std::nullopt;
+  }
+
+  virtual void SetMetadata(const std::string& key, const std::string& value)
+  {
+  }
 };
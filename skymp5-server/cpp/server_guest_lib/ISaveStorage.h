@@ -1,4 +1,5 @@
 #pragma once
+#include "IDatabase.h"
 #include "MpChangeForms.h"
 #include <cstdint>
 #include <functional>
@@ -13,8 +14,28 @@ public:
   using UpsertCallback = std::function<void()>;
 
   virtual void IterateSync(const IterateSyncCallback& cb) = 0;
+
+  // See IDatabase::IterateLocations and IDatabase::IterateByFormDescs
+  virtual void IterateLocationsSync(
+    const IDatabase::IterateLocationsCallback& cb) = 0;
+  virtual void IterateByFormDescsSync(const std::vector<FormDesc>& formDescs,
+                                      const IterateSyncCallback& cb) = 0;
+
+  // 'changedFields' is either empty or contains a ChangeFormField mask for
+  // each change form. Empty means that change forms are saved entirely.
+  // 'failedCb' (may be empty) is called instead of 'cb' if the change forms
+  // may have not been saved, the error itself is rethrown from Tick
   virtual void Upsert(const std::vector<MpChangeForm>& changeForms,
-                      const UpsertCallback& cb) = 0;
+                      const std::vector<ChangeFormFieldMask>& changedFields,
+                      const UpsertCallback& cb,
+                      const UpsertCallback& failedCb) = 0;
+
+  void Upsert(const std::vector<MpChangeForm>& changeForms,
+              const UpsertCallback& cb)
+  {
+    Upsert(changeForms, {}, cb, nullptr);
+  }
+
   virtual uint32_t GetNumFinishedUpserts() const = 0;
   virtual void Tick() = 0;
 };
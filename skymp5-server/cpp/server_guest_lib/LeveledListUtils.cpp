@@ -1,67 +1,164 @@
 #include "LeveledListUtils.h"
+#include <algorithm>
 #include <random>
 
-std::vector<LeveledListUtils::Entry> LeveledListUtils::EvaluateList(
-  const espm::CombineBrowser& br, const espm::LookupResult& lookupRes,
-  uint32_t pcLevel, uint8_t* chanceNoneOverride)
+namespace {
+// SplitMix64, much cheaper to create and to seed than std::mt19937
+class FastRandom
 {
-  espm::CompressedFieldsCache dummyCache;
+public:
+  explicit FastRandom(uint64_t seed)
+    : state(seed)
+  {
+  }
 
-  auto leveledList = espm::Convert<espm::LVLI>(lookupRes.rec);
-  if (!leveledList) {
-    return {};
+  void Seed(uint64_t seed) { state = seed; }
+
+  uint64_t Next()
+  {
+    uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
   }
-  auto data = leveledList->GetData(dummyCache);
 
-  std::vector<Entry> res;
+  // [0, 1)
+  double NextDouble() { return (Next() >> 11) * 0x1.0p-53; }
+
+  // [0, n)
+  size_t NextIndex(size_t n)
+  {
+    return static_cast<size_t>(((Next() >> 32) * n) >> 32);
+  }
 
-  int chanceNone = data.chanceNoneGlobalId ? 100 : data.chanceNone;
+private:
+  uint64_t state = 0;
+};
+
+uint64_t MakeRandomSeed()
+{
+  std::random_device rd;
+  return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+thread_local FastRandom g_random(MakeRandomSeed());
+
+using CompiledEntry = LeveledListUtils::CompiledList::CompiledEntry;
+
+template <class F>
+void EvaluateCompiledList(const LeveledListUtils::CompiledList& list,
+                          uint32_t pcLevel, uint8_t* chanceNoneOverride,
+                          const F& f)
+{
+  int chanceNone = list.chanceNone;
   if (chanceNoneOverride)
     chanceNone = *chanceNoneOverride;
 
-  std::random_device rd;
-  std::mt19937 mt(rd());
-  std::uniform_real_distribution<double> dist(0.0, 100.0);
-
-  bool none = dist(mt) < chanceNone;
-  if (!none) {
-    std::vector<const espm::LVLI::Entry*> entriesAllowed;
-    for (size_t i = 0; i < data.numEntries; ++i) {
-      if (!pcLevel || data.entries[i].level <= pcLevel)
-        entriesAllowed.push_back(&data.entries[i]);
-    }
+  bool none = g_random.NextDouble() * 100.0 < chanceNone;
+  if (none) {
+    return;
+  }
+
+  auto begin = list.entries.begin();
+  auto end = list.entries.end();
+  if (pcLevel) {
+    end = std::upper_bound(begin, end, pcLevel,
+                           [](uint32_t level, const CompiledEntry& entry) {
+                             return level < entry.level;
+                           });
+  }
+  const size_t numAllowed = end - begin;
+
+  bool useRandomEntry = !(list.leveledItemFlags & espm::LVLI::UseAll);
+  if (useRandomEntry && numAllowed > 0) {
+    f(begin[g_random.NextIndex(numAllowed)]);
+  } else {
+    std::for_each(begin, end, f);
+  }
+}
+}
+
+LeveledListUtils::CompiledLists::CompiledLists(const espm::CombineBrowser& br_)
+  : br(br_)
+{
+}
+
+const LeveledListUtils::CompiledList* LeveledListUtils::CompiledLists::Get(
+  const espm::LookupResult& lookupRes)
+{
+  auto leveledList = espm::Convert<espm::LVLI>(lookupRes.rec);
+  if (!leveledList) {
+    return nullptr;
+  }
+
+  auto it = lists.find(lookupRes.rec);
+  if (it != lists.end()) {
+    return it->second.get();
+  }
+
+  auto data = leveledList->GetData(br.GetCache());
 
-    bool useRandomEntry = !(data.leveledItemFlags & espm::LVLI::UseAll);
-    if (useRandomEntry && !entriesAllowed.empty()) {
-      std::uniform_int_distribution<int> dist(0, entriesAllowed.size() - 1);
-      auto entry = entriesAllowed[dist(mt)];
+  auto list = std::make_unique<CompiledList>();
+  list->chanceNone = data.chanceNoneGlobalId ? 100 : data.chanceNone;
+  list->leveledItemFlags = data.leveledItemFlags;
+  list->entries.reserve(data.numEntries);
+  for (size_t i = 0; i < data.numEntries; ++i) {
+    CompiledEntry entry;
+    entry.level = data.entries[i].level;
+    entry.formId = lookupRes.ToGlobalId(data.entries[i].formId);
+    entry.count = data.entries[i].count;
 
-      uint32_t formId = lookupRes.ToGlobalId(entry->formId);
-      res.push_back({ formId, entry->count });
+    auto entryLookupRes = br.LookupById(entry.formId);
+    if (!entryLookupRes.rec) {
+      entry.kind = CompiledList::EntryKind::Missing;
+    } else if (entryLookupRes.rec->GetType() == espm::LVLI::kType) {
+      entry.kind = CompiledList::EntryKind::LeveledList;
     } else {
-      for (auto entry : entriesAllowed) {
-        uint32_t formId = lookupRes.ToGlobalId(entry->formId);
-        res.push_back({ formId, entry->count });
-      }
+      entry.kind = CompiledList::EntryKind::Item;
     }
+    list->entries.push_back(entry);
   }
+  std::stable_sort(list->entries.begin(), list->entries.end(),
+                   [](const CompiledEntry& lhs, const CompiledEntry& rhs) {
+                     return lhs.level < rhs.level;
+                   });
+
+  return lists.emplace(lookupRes.rec, std::move(list)).first->second.get();
+}
+
+const espm::CombineBrowser& LeveledListUtils::CompiledLists::GetBrowser()
+  const noexcept
+{
+  return br;
+}
+
+void LeveledListUtils::SetRandomSeed(uint64_t seed)
+{
+  g_random.Seed(seed);
+}
+
+std::vector<LeveledListUtils::Entry> LeveledListUtils::EvaluateList(
+  const CompiledList& list, uint32_t pcLevel, uint8_t* chanceNoneOverride)
+{
+  std::vector<Entry> res;
+  EvaluateCompiledList(list, pcLevel, chanceNoneOverride,
+                       [&](const CompiledEntry& entry) {
+                         res.push_back({ entry.formId, entry.count });
+                       });
   return res;
 }
 
 std::map<uint32_t, uint32_t> LeveledListUtils::EvaluateListRecurse(
-  const espm::CombineBrowser& br, const espm::LookupResult& lookupRes,
+  CompiledLists& lists, const espm::LookupResult& lookupRes,
   uint32_t countMult, uint32_t pcLevel, uint8_t* chanceNoneOverride)
 {
-  espm::CompressedFieldsCache dummyCache;
-
-  auto leveledList = espm::Convert<espm::LVLI>(lookupRes.rec);
-  bool calcForEach = leveledList &&
-    (leveledList->GetData(dummyCache).leveledItemFlags & espm::LVLI::Each);
+  auto list = lists.Get(lookupRes);
+  bool calcForEach = list && (list->leveledItemFlags & espm::LVLI::Each);
 
   if (calcForEach && countMult != 1) {
     std::map<uint32_t, uint32_t> res;
     for (uint32_t i = 0; i < countMult; ++i) {
-      auto stepRes = EvaluateListRecurse(br, lookupRes, 1, pcLevel);
+      auto stepRes = EvaluateListRecurse(lists, lookupRes, 1, pcLevel);
       for (auto& p : stepRes) {
         res[p.first] += p.second;
       }
@@ -70,23 +167,30 @@ std::map<uint32_t, uint32_t> LeveledListUtils::EvaluateListRecurse(
   }
 
   std::map<uint32_t, uint32_t> res;
-  auto firstEvalRes = EvaluateList(br, lookupRes, pcLevel, chanceNoneOverride);
-  for (auto& e : firstEvalRes) {
-    auto eLookupRes = br.LookupById(e.formId);
-    if (!eLookupRes.rec) {
-      continue;
-    }
-    if (eLookupRes.rec->GetType() == espm::LVLI::kType) {
-      auto childRes = EvaluateListRecurse(br, eLookupRes, 1, pcLevel);
-      for (auto& p : childRes) {
-        res[p.first] += p.second;
-      }
-
-    } else {
-      res[e.formId] += e.count;
-    }
+  if (!list) {
+    return res;
   }
 
+  EvaluateCompiledList(
+    *list, pcLevel, chanceNoneOverride, [&](const CompiledEntry& entry) {
+      switch (entry.kind) {
+        case CompiledList::EntryKind::Missing:
+          break;
+        case CompiledList::EntryKind::LeveledList: {
+          auto childLookupRes = lists.GetBrowser().LookupById(entry.formId);
+          auto childRes =
+            EvaluateListRecurse(lists, childLookupRes, 1, pcLevel);
+          for (auto& p : childRes) {
+            res[p.first] += p.second;
+          }
+          break;
+        }
+        case CompiledList::EntryKind::Item:
+          res[entry.formId] += entry.count;
+          break;
+      }
+    });
+
   if (countMult != 1 && !calcForEach) {
     for (auto& p : res) {
       p.second *= countMult;
@@ -95,3 +199,22 @@ std::map<uint32_t, uint32_t> LeveledListUtils::EvaluateListRecurse(
 
   return res;
 }
+
+std::vector<LeveledListUtils::Entry> LeveledListUtils::EvaluateList(
+  const espm::CombineBrowser& br, const espm::LookupResult& lookupRes,
+  uint32_t pcLevel, uint8_t* chanceNoneOverride)
+{
+  CompiledLists lists(br);
+  auto list = lists.Get(lookupRes);
+  return list ? EvaluateList(*list, pcLevel, chanceNoneOverride)
+              : std::vector<Entry>();
+}
+
+std::map<uint32_t, uint32_t> LeveledListUtils::EvaluateListRecurse(
+  const espm::CombineBrowser& br, const espm::LookupResult& lookupRes,
+  uint32_t countMult, uint32_t pcLevel, uint8_t* chanceNoneOverride)
+{
+  CompiledLists lists(br);
+  return EvaluateListRecurse(lists, lookupRes, countMult, pcLevel,
+                             chanceNoneOverride);
+}
@@ -2,6 +2,8 @@
 #include <cstdint>
 #include <espm.h>
 #include <map>
+#include <memory>
+#include <sparsepp/spp.h>
 #include <vector>
 
 #include <Combiner.h>
@@ -13,6 +15,62 @@ struct Entry
   uint32_t count = 0;
 };
 
+// Leveled list prepared for evaluation: entries have global form ids and are
+// sorted by level, so entries allowed for a level are a prefix
+struct CompiledList
+{
+  enum class EntryKind : uint8_t
+  {
+    Missing,
+    Item,
+    LeveledList
+  };
+
+  struct CompiledEntry
+  {
+    uint32_t level = 0;
+    uint32_t formId = 0;
+    uint32_t count = 0;
+    EntryKind kind = EntryKind::Missing;
+  };
+
+  uint8_t chanceNone = 0;
+  uint8_t leveledItemFlags = 0;
+  std::vector<CompiledEntry> entries;
+};
+
+// Compiles leveled lists on first use and keeps them. Not thread-safe
+class CompiledLists
+{
+public:
+  explicit CompiledLists(const espm::CombineBrowser& br);
+
+  // Returns nullptr if 'lookupRes' is not a leveled list
+  const CompiledList* Get(const espm::LookupResult& lookupRes);
+
+  const espm::CombineBrowser& GetBrowser() const noexcept;
+
+private:
+  const espm::CombineBrowser& br;
+  spp::sparse_hash_map<const espm::RecordHeader*,
+                       std::unique_ptr<const CompiledList>>
+    lists;
+};
+
+// Lists are evaluated with a fast thread-local generator that is seeded
+// randomly. Seeding makes evaluation deterministic for the calling thread
+void SetRandomSeed(uint64_t seed);
+
+std::vector<Entry> EvaluateList(const CompiledList& list,
+                                uint32_t pcLevel = 0,
+                                uint8_t* chanceNoneOverride = nullptr);
+
+std::map<uint32_t, uint32_t> EvaluateListRecurse(
+  CompiledLists& lists, const espm::LookupResult& lookupRes,
+  uint32_t countMult = 1, uint32_t pcLevel = 0,
+  uint8_t* chanceNoneOverride = nullptr);
+
+// Same as above, but compile lists on each call
 std::vector<Entry> EvaluateList(const espm::CombineBrowser& br,
                                 const espm::LookupResult& lookupRes,
                                 uint32_t pcLevel = 0,
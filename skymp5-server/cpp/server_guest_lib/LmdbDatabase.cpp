@@ -0,0 +1,266 @@
+#include "LmdbDatabase.h"
+#include <filesystem>
+#include <lmdb.h>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+
+namespace {
+void ThrowIfFailed(int rc, const char* what)
+{
+  if (rc != MDB_SUCCESS) {
+    throw std::runtime_error(std::string(what) + " failed with " +
+                             mdb_strerror(rc));
+  }
+}
+
+class ScopedTxn
+{
+public:
+  ScopedTxn(MDB_env* env, unsigned int flags)
+  {
+    ThrowIfFailed(mdb_txn_begin(env, nullptr, flags, &txn), "mdb_txn_begin");
+  }
+
+  ~ScopedTxn()
+  {
+    if (txn) {
+      mdb_txn_abort(txn);
+    }
+  }
+
+  int Commit()
+  {
+    auto rc = mdb_txn_commit(txn);
+    txn = nullptr; // The transaction is freed even if commit failed
+    return rc;
+  }
+
+  MDB_txn* Get() const noexcept { return txn; }
+
+private:
+  MDB_txn* txn = nullptr;
+};
+
+class ScopedCursor
+{
+public:
+  ScopedCursor(MDB_txn* txn, MDB_dbi dbi)
+  {
+    ThrowIfFailed(mdb_cursor_open(txn, dbi, &cursor), "mdb_cursor_open");
+  }
+
+  ~ScopedCursor() { mdb_cursor_close(cursor); }
+
+  MDB_cursor* Get() const noexcept { return cursor; }
+
+private:
+  MDB_cursor* cursor = nullptr;
+};
+}
+
+struct LmdbDatabase::Impl
+{
+  const std::filesystem::path directory;
+  const std::shared_ptr<spdlog::logger> logger;
+  size_t mapSize = 0;
+  MDB_env* env = nullptr;
+
+  // The map can't be resized while read transactions are open
+  std::shared_mutex resizeMutex;
+  MDB_dbi dbi = 0;
+  MDB_dbi metadataDbi = 0;
+
+  // Named databases are listed in the unnamed one, change form iteration
+  // skips this key
+  static constexpr const char* kMetadataDbName = "metadata";
+
+  ~Impl()
+  {
+    if (env) {
+      mdb_env_close(env);
+    }
+  }
+
+  // Returns false if the map is full and the caller should retry
+  bool TryUpsert(const std::vector<std::string>& keys,
+                 const std::vector<std::string>& values);
+
+  void ParseValue(const MDB_val& value, simdjson::dom::parser& parser,
+                  const IterateCallback& iterateCallback) const;
+};
+
+LmdbDatabase::LmdbDatabase(std::string directory_,
+                           std::shared_ptr<spdlog::logger> logger_,
+                           size_t mapSize_)
+{
+  pImpl.reset(new Impl{ directory_, logger_ });
+  pImpl->mapSize = mapSize_;
+
+  std::filesystem::create_directories(pImpl->directory);
+
+  ThrowIfFailed(mdb_env_create(&pImpl->env), "mdb_env_create");
+  ThrowIfFailed(mdb_env_set_mapsize(pImpl->env, pImpl->mapSize),
+                "mdb_env_set_mapsize");
+  ThrowIfFailed(mdb_env_set_maxdbs(pImpl->env, 1), "mdb_env_set_maxdbs");
+
+  // MDB_NOTLS: AsyncSaveStorage reads and writes from different threads
+  ThrowIfFailed(mdb_env_open(pImpl->env, pImpl->directory.string().data(),
+                             MDB_NOTLS, 0664),
+                "mdb_env_open");
+
+  ScopedTxn txn(pImpl->env, 0);
+  ThrowIfFailed(mdb_dbi_open(txn.Get(), nullptr, 0, &pImpl->dbi),
+                "mdb_dbi_open");
+  ThrowIfFailed(mdb_dbi_open(txn.Get(), Impl::kMetadataDbName, MDB_CREATE,
+                             &pImpl->metadataDbi),
+                "mdb_dbi_open");
+  ThrowIfFailed(txn.Commit(), "mdb_txn_commit");
+}
+
+size_t LmdbDatabase::Upsert(const std::vector<MpChangeForm>& changeForms)
+{
+  std::vector<std::string> keys, values;
+  keys.reserve(changeForms.size());
+  values.reserve(changeForms.size());
+  for (auto& changeForm : changeForms) {
+    keys.push_back(MakeKey(changeForm.formDesc));
+    values.push_back(MpChangeForm::ToJson(changeForm).dump());
+  }
+
+  while (!pImpl->TryUpsert(keys, values)) {
+    std::unique_lock l(pImpl->resizeMutex);
+    pImpl->mapSize *= 2;
+    ThrowIfFailed(mdb_env_set_mapsize(pImpl->env, pImpl->mapSize),
+                  "mdb_env_set_mapsize");
+    if (pImpl->logger) {
+      pImpl->logger->info("LMDB map size increased to {} bytes",
+                          pImpl->mapSize);
+    }
+  }
+
+  return changeForms.size();
+}
+
+bool LmdbDatabase::Impl::TryUpsert(const std::vector<std::string>& keys,
+                                   const std::vector<std::string>& values)
+{
+  ScopedTxn txn(env, 0);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    MDB_val key{ keys[i].size(), const_cast<char*>(keys[i].data()) };
+    MDB_val value{ values[i].size(), const_cast<char*>(values[i].data()) };
+    auto rc = mdb_put(txn.Get(), dbi, &key, &value, 0);
+    if (rc == MDB_MAP_FULL) {
+      return false;
+    }
+    ThrowIfFailed(rc, "mdb_put");
+  }
+
+  // Commit may also run out of space while writing dirty pages
+  auto rc = txn.Commit();
+  if (rc == MDB_MAP_FULL) {
+    return false;
+  }
+  ThrowIfFailed(rc, "mdb_txn_commit");
+  return true;
+}
+
+void LmdbDatabase::Iterate(const IterateCallback& iterateCallback)
+{
+  std::shared_lock l(pImpl->resizeMutex);
+  ScopedTxn txn(pImpl->env, MDB_RDONLY);
+  ScopedCursor cursor(txn.Get(), pImpl->dbi);
+
+  simdjson::dom::parser parser;
+
+  MDB_val key, value;
+  int rc = mdb_cursor_get(cursor.Get(), &key, &value, MDB_FIRST);
+  const std::string_view metadataDbName = Impl::kMetadataDbName;
+  while (rc == MDB_SUCCESS) {
+    std::string_view keyView(static_cast<const char*>(key.mv_data),
+                             key.mv_size);
+    if (keyView != metadataDbName) {
+      pImpl->ParseValue(value, parser, iterateCallback);
+    }
+    rc = mdb_cursor_get(cursor.Get(), &key, &value, MDB_NEXT);
+  }
+
+  if (rc != MDB_NOTFOUND) {
+    ThrowIfFailed(rc, "mdb_cursor_get");
+  }
+}
+
+void LmdbDatabase::IterateByFormDescs(const std::vector<FormDesc>& formDescs,
+                                      const IterateCallback& iterateCallback)
+{
+  std::shared_lock l(pImpl->resizeMutex);
+  ScopedTxn txn(pImpl->env, MDB_RDONLY);
+
+  simdjson::dom::parser parser;
+
+  for (auto& formDesc : formDescs) {
+    auto keyStr = MakeKey(formDesc);
+    MDB_val key{ keyStr.size(), keyStr.data() }, value;
+    int rc = mdb_get(txn.Get(), pImpl->dbi, &key, &value);
+    if (rc == MDB_NOTFOUND) {
+      continue;
+    }
+    ThrowIfFailed(rc, "mdb_get");
+    pImpl->ParseValue(value, parser, iterateCallback);
+  }
+}
+
+void LmdbDatabase::Impl::ParseValue(
+  const MDB_val& value, simdjson::dom::parser& parser,
+  const IterateCallback& iterateCallback) const
+{
+  try {
+    auto result =
+      parser.parse(static_cast<const char*>(value.mv_data), value.mv_size)
+        .value();
+    iterateCallback(MpChangeForm::JsonToChangeForm(result));
+  } catch (std::exception& e) {
+    if (logger) {
+      logger->error("Parsing of a change form failed with {}", e.what());
+    }
+  }
+}
+
+std::optional<std::string> LmdbDatabase::GetMetadata(const std::string& key)
+{
+  std::shared_lock l(pImpl->resizeMutex);
+  ScopedTxn txn(pImpl->env, MDB_RDONLY);
+
+  MDB_val keyVal{ key.size(), const_cast<char*>(key.data()) }, value;
+  int rc = mdb_get(txn.Get(), pImpl->metadataDbi, &keyVal, &value);
+  if (rc == MDB_NOTFOUND) {
+    return std::nullopt;
+  }
+  ThrowIfFailed(rc, "mdb_get");
+  return std::string(static_cast<const char*>(value.mv_data), value.mv_size);
+}
+
+void LmdbDatabase::SetMetadata(const std::string& key,
+                               const std::string& value)
+{
+  ScopedTxn txn(pImpl->env, 0);
+
+  MDB_val keyVal{ key.size(), const_cast<char*>(key.data()) };
+  MDB_val valueVal{ value.size(), const_cast<char*>(value.data()) };
+  ThrowIfFailed(mdb_put(txn.Get(), pImpl->metadataDbi, &keyVal, &valueVal, 0),
+                "mdb_put");
+  ThrowIfFailed(txn.Commit(), "mdb_txn_commit");
+}
+
+std::string LmdbDatabase::MakeKey(const FormDesc& formDesc)
+{
+  // Big-endian id first, then the file name. Byte-wise comparison of such
+  // keys gives the same order as FormDesc::operator<
+  std::string res(4, '\0');
+  res[0] = static_cast<char>((formDesc.shortFormId >> 24) & 0xff);
+  res[1] = static_cast<char>((formDesc.shortFormId >> 16) & 0xff);
+  res[2] = static_cast<char>((formDesc.shortFormId >> 8) & 0xff);
+  res[3] = static_cast<char>(formDesc.shortFormId & 0xff);
+  res += formDesc.file;
+  return res;
+}
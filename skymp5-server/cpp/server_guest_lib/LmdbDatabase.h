@@ -0,0 +1,35 @@
+#pragma once
+#include "IDatabase.h"
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+
+// Embedded transactional key-value storage on top of LMDB. Keys are
+// serialized FormDescs ordered the same way as FormDesc::operator<, so
+// Iterate visits change forms in FormDesc order. Metadata is kept in a
+// separate named database.
+class LmdbDatabase : public IDatabase
+{
+public:
+  static constexpr size_t kDefaultMapSize = 1024ull * 1024ull * 1024ull;
+
+  LmdbDatabase(std::string directory_, std::shared_ptr<spdlog::logger> logger_,
+               size_t mapSize_ = kDefaultMapSize);
+
+  // All change forms are written in one transaction
+  size_t Upsert(const std::vector<MpChangeForm>& changeForms) override;
+  void Iterate(const IterateCallback& iterateCallback) override;
+  void IterateByFormDescs(const std::vector<FormDesc>& formDescs,
+                          const IterateCallback& iterateCallback) override;
+  std::optional<std::string> GetMetadata(const std::string& key) override;
+  void SetMetadata(const std::string& key, const std::string& value) override;
+
+  // Readers don't block the writer, see MDB_NOTLS
+  bool SupportsConcurrentReads() const override { return true; }
+
+  static std::string MakeKey(const FormDesc& formDesc);
+
+private:
+  struct Impl;
+  std::shared_ptr<Impl> pImpl;
+};
@@ -1,16 +1,74 @@
 #include "MigrationDatabase.h"
+#include <algorithm>
 #include <set>
+#include <unordered_map>
+
+namespace {
+// Set of FormDescs taking 8 bytes per element. File names are interned,
+// elements are packed into (fileIndex << 32 | shortFormId) and kept sorted
+class CompactFormDescSet
+{
+public:
+  void Insert(const FormDesc& formDesc)
+  {
+    auto [it, inserted] =
+      fileIndices.try_emplace(formDesc.file, fileIndices.size());
+    packed.push_back(Pack(it->second, formDesc.shortFormId));
+    sorted = false;
+  }
+
+  bool Contains(const FormDesc& formDesc)
+  {
+    auto it = fileIndices.find(formDesc.file);
+    if (it == fileIndices.end()) {
+      return false;
+    }
+    if (!sorted) {
+      std::sort(packed.begin(), packed.end());
+      sorted = true;
+    }
+    return std::binary_search(packed.begin(), packed.end(),
+                              Pack(it->second, formDesc.shortFormId));
+  }
+
+private:
+  static uint64_t Pack(uint64_t fileIndex, uint32_t shortFormId)
+  {
+    return (fileIndex << 32) | shortFormId;
+  }
+
+  std::unordered_map<std::string, uint32_t> fileIndices;
+  std::vector<uint64_t> packed;
+  bool sorted = true;
+};
+}
 
 struct MigrationDatabase::Impl
 {
   std::shared_ptr<IDatabase> newDatabase;
   std::shared_ptr<IDatabase> oldDatabase;
+
+  // 0 means no bulk copy
+  size_t bulkCopyBatchSize = 0;
+  ProgressCallback onProgress;
+  bool bulkCopyFinished = false;
 };
 
 MigrationDatabase::MigrationDatabase(std::shared_ptr<IDatabase> newDatabase,
                                      std::shared_ptr<IDatabase> oldDatabase)
+  : MigrationDatabase(newDatabase, oldDatabase, 0)
 {
-  pImpl.reset(new Impl{ newDatabase, oldDatabase });
+}
+
+MigrationDatabase::MigrationDatabase(std::shared_ptr<IDatabase> newDatabase,
+                                     std::shared_ptr<IDatabase> oldDatabase,
+                                     size_t bulkCopyBatchSize,
+                                     ProgressCallback onProgress)
+{
+  pImpl.reset(new Impl{ newDatabase, oldDatabase, bulkCopyBatchSize,
+                        onProgress });
+  pImpl->bulkCopyFinished =
+    pImpl->newDatabase->GetMetadata(kBulkCopyFinishedKey).has_value();
 }
 
 size_t MigrationDatabase::Upsert(const std::vector<MpChangeForm>& changeForms)
@@ -20,16 +78,110 @@ size_t MigrationDatabase::Upsert(const std::vector<MpChangeForm>& changeForms)
 
 void MigrationDatabase::Iterate(const IterateCallback& iterateCallback)
 {
-  std::set<FormDesc> alreadyMigrated;
+  if (pImpl->bulkCopyFinished) {
+    return pImpl->newDatabase->Iterate(iterateCallback);
+  }
+
+  CompactFormDescSet alreadyMigrated;
 
   pImpl->newDatabase->Iterate([&](const MpChangeForm& changeForm) {
     iterateCallback(changeForm);
-    alreadyMigrated.insert(changeForm.formDesc);
+    alreadyMigrated.Insert(changeForm.formDesc);
   });
 
+  const bool bulkCopy = pImpl->bulkCopyBatchSize > 0;
+
+  Progress progress;
+  std::vector<MpChangeForm> batch;
+
+  auto flush = [&] {
+    if (batch.empty()) {
+      return;
+    }
+    pImpl->newDatabase->Upsert(batch);
+    progress.numCopied += batch.size();
+    batch.clear();
+    if (pImpl->onProgress) {
+      pImpl->onProgress(progress);
+    }
+  };
+
   pImpl->oldDatabase->Iterate([&](const MpChangeForm& changeForm) {
-    if (!alreadyMigrated.count(changeForm.formDesc)) {
-      iterateCallback(changeForm);
+    if (alreadyMigrated.Contains(changeForm.formDesc)) {
+      ++progress.numSkipped;
+      return;
+    }
+    iterateCallback(changeForm);
+    if (bulkCopy) {
+      batch.push_back(changeForm);
+      if (batch.size() >= pImpl->bulkCopyBatchSize) {
+        flush();
+      }
     }
   });
+
+  if (bulkCopy) {
+    flush();
+    if (pImpl->onProgress && progress.numCopied == 0) {
+      pImpl->onProgress(progress);
+    }
+    pImpl->newDatabase->SetMetadata(kBulkCopyFinishedKey, "1");
+    pImpl->bulkCopyFinished = true;
+  }
+}
+
+void MigrationDatabase::IterateByFormDescs(
+  const std::vector<FormDesc>& formDescs,
+  const IterateCallback& iterateCallback)
+{
+  if (pImpl->bulkCopyFinished) {
+    return pImpl->newDatabase->IterateByFormDescs(formDescs, iterateCallback);
+  }
+
+  std::set<FormDesc> found;
+  pImpl->newDatabase->IterateByFormDescs(
+    formDescs, [&](const MpChangeForm& changeForm) {
+      iterateCallback(changeForm);
+      found.insert(changeForm.formDesc);
+    });
+
+  std::vector<FormDesc> notFound;
+  for (auto& formDesc : formDescs) {
+    if (!found.count(formDesc)) {
+      notFound.push_back(formDesc);
+    }
+  }
+
+  if (!notFound.empty()) {
+    pImpl->oldDatabase->IterateByFormDescs(notFound, iterateCallback);
+  }
+}
+
+std::optional<std::string> MigrationDatabase::GetMetadata(
+  const std::string& key)
+{
+  return pImpl->newDatabase->GetMetadata(key);
+}
+
+void MigrationDatabase::SetMetadata(const std::string& key,
+                                    const std::string& value)
+{
+  pImpl->newDatabase->SetMetadata(key, value);
+}
+
+bool MigrationDatabase::SupportsConcurrentReads() const
+{
+  if (pImpl->bulkCopyFinished) {
+    return pImpl->newDatabase->SupportsConcurrentReads();
+  }
+
+  // Unfinished bulk copy writes from Iterate
+  return pImpl->bulkCopyBatchSize == 0 &&
+    pImpl->newDatabase->SupportsConcurrentReads() &&
+    pImpl->oldDatabase->SupportsConcurrentReads();
+}
+
+bool MigrationDatabase::IsBulkCopyFinished() const noexcept
+{
+  return pImpl->bulkCopyFinished;
 }
@@ -1,13 +1,49 @@
 #pragma once
 #include "IDatabase.h"
+#include <functional>
 
 class MigrationDatabase : public IDatabase
 {
 public:
+  struct Progress
+  {
+    size_t numCopied = 0;
+
+    // Change forms from the old database already present in the new one
+    size_t numSkipped = 0;
+  };
+
+  using ProgressCallback = std::function<void(const Progress&)>;
+
+  static constexpr size_t kDefaultBulkCopyBatchSize = 1000;
+
+  // Metadata key set in the new database once the bulk copy is finished
+  static constexpr const char* kBulkCopyFinishedKey =
+    "migrationBulkCopyFinished";
+
+  // Reads both databases on every Iterate, writes to the new one only. If
+  // a bulk copy has been finished before, reads the new database only
   MigrationDatabase(std::shared_ptr<IDatabase> newDatabase,
                     std::shared_ptr<IDatabase> oldDatabase);
+
+  // The first Iterate copies change forms missing in the new database from
+  // the old one in batches of 'bulkCopyBatchSize'. 'onProgress' is called
+  // after each batch. Later calls read the new database only, the same
+  // after a restart since the new database remembers the copy is finished
+  MigrationDatabase(std::shared_ptr<IDatabase> newDatabase,
+                    std::shared_ptr<IDatabase> oldDatabase,
+                    size_t bulkCopyBatchSize,
+                    ProgressCallback onProgress = nullptr);
+
   size_t Upsert(const std::vector<MpChangeForm>& changeForms) override;
   void Iterate(const IterateCallback& iterateCallback) override;
+  void IterateByFormDescs(const std::vector<FormDesc>& formDescs,
+                          const IterateCallback& iterateCallback) override;
+  std::optional<std::string> GetMetadata(const std::string& key) override;
+  void SetMetadata(const std::string& key, const std::string& value) override;
+  bool SupportsConcurrentReads() const override;
+
+  bool IsBulkCopyFinished() const noexcept;
 
 private:
   struct Impl;
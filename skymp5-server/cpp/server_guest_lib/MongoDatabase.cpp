@@ -9,6 +9,8 @@
 #include <bsoncxx/json.hpp>
 #include <mongocxx/client.hpp>
 #include <mongocxx/instance.hpp>
+#include <mongocxx/options/find.hpp>
+#include <mongocxx/options/update.hpp>
 #include <mongocxx/stdx.hpp>
 #include <mongocxx/uri.hpp>
 #include <nlohmann/json.hpp>
@@ -19,10 +21,46 @@ struct MongoDatabase::Impl
   const std::string name;
 
   const char* const collectionName = "changeForms";
+  const char* const metadataCollectionName = "metadata";
 
-  std::shared_ptr<mongocxx::client> client;
-  std::shared_ptr<mongocxx::database> db;
-  std::shared_ptr<mongocxx::collection> changeFormsCollection;
+  // A client must not be used by multiple threads at once, reads happen
+  // while AsyncSaveStorage writes on its own thread
+  struct Connection
+  {
+    std::shared_ptr<mongocxx::client> client;
+    std::shared_ptr<mongocxx::database> db;
+    std::shared_ptr<mongocxx::collection> changeFormsCollection;
+    std::shared_ptr<mongocxx::collection> metadataCollection;
+  };
+
+  Connection writeConnection;
+  Connection readConnection;
+
+  Connection Connect() const
+  {
+    Connection res;
+    res.client.reset(new mongocxx::client(mongocxx::uri(uri.data())));
+    res.db.reset(new mongocxx::database((*res.client)[name]));
+    res.changeFormsCollection.reset(
+      new mongocxx::collection((*res.db)[collectionName]));
+    res.metadataCollection.reset(
+      new mongocxx::collection((*res.db)[metadataCollectionName]));
+    return res;
+  }
+
+  void Find(const nlohmann::json& filter,
+            const IterateCallback& iterateCallback)
+  {
+    simdjson::dom::parser p;
+
+    auto cursor = readConnection.changeFormsCollection->find(
+      bsoncxx::from_json(filter.dump()));
+    for (auto& documentView : cursor) {
+      auto document = p.parse(bsoncxx::to_json(documentView)).value();
+      auto changeForm = MpChangeForm::JsonToChangeForm(document);
+      iterateCallback(changeForm);
+    }
+  }
 };
 
 MongoDatabase::MongoDatabase(std::string uri_, std::string name_)
@@ -31,45 +69,156 @@ MongoDatabase::MongoDatabase(std::string uri_, std::string name_)
 
   pImpl.reset(new Impl{ uri_, name_ });
 
-  pImpl->client.reset(new mongocxx::client(mongocxx::uri(pImpl->uri.data())));
-  pImpl->db.reset(new mongocxx::database((*pImpl->client)[pImpl->name]));
-  pImpl->changeFormsCollection.reset(
-    new mongocxx::collection((*pImpl->db)[pImpl->collectionName]));
+  pImpl->writeConnection = pImpl->Connect();
+  pImpl->readConnection = pImpl->Connect();
+
+  // Upserts and IterateByFormDescs look up documents by formDesc. Does
+  // nothing if the index already exists
+  auto index = nlohmann::json::object();
+  index["formDesc"] = 1;
+  pImpl->writeConnection.changeFormsCollection->create_index(
+    bsoncxx::from_json(index.dump()));
 }
 
 size_t MongoDatabase::Upsert(const std::vector<MpChangeForm>& changeForms)
 {
-  auto bulk = pImpl->changeFormsCollection->create_bulk_write();
-  for (auto& changeForm : changeForms) {
-    auto jChangeForm = MpChangeForm::ToJson(changeForm);
+  return UpsertPartial(changeForms, {});
+}
+
+size_t MongoDatabase::UpsertPartial(
+  const std::vector<MpChangeForm>& changeForms,
+  const std::vector<ChangeFormFieldMask>& changedFields)
+{
+  auto bulk =
+    pImpl->writeConnection.changeFormsCollection->create_bulk_write();
+  size_t numOperations = 0;
+  for (size_t i = 0; i < changeForms.size(); ++i) {
+    auto& changeForm = changeForms[i];
+
+    auto fields =
+      changedFields.empty() ? ChangeFormField::All : changedFields[i];
+    if (fields == 0) {
+      continue;
+    }
 
     auto filter = nlohmann::json::object();
     filter["formDesc"] = changeForm.formDesc.ToString();
 
+    // Unchanged fields are only written if the document is created, so that
+    // a change form missing in the database is never saved partially
     auto upd = nlohmann::json::object();
-    upd["$set"] = jChangeForm;
+    upd["$set"] = MpChangeForm::ToJson(changeForm, fields);
+    if (fields != ChangeFormField::All) {
+      upd["$setOnInsert"] =
+        MpChangeForm::ToJson(changeForm, ChangeFormField::All & ~fields);
+    }
 
     bulk.append(mongocxx::model::update_one(
                   { std::move(bsoncxx::from_json(filter.dump())),
                     std::move(bsoncxx::from_json(upd.dump())) })
                   .upsert(true));
+    ++numOperations;
   }
 
-  (void)bulk.execute();
+  if (numOperations > 0) {
+    (void)bulk.execute();
+  }
   return changeForms.size(); // Should take data from mongo instead?
 }
 
 void MongoDatabase::Iterate(const IterateCallback& iterateCallback)
 {
+  auto emptyFilter = nlohmann::json::object();
+  pImpl->Find(emptyFilter, iterateCallback);
+}
+
+void MongoDatabase::IterateLocations(const IterateLocationsCallback& callback)
+{
+  static const JsonPointer formDesc("formDesc"),
+    worldOrCellDesc("worldOrCellDesc"), position("position"),
+    profileId("profileId");
+
   auto emptyFilter = nlohmann::json::object();
   auto emptyFilterBson = bsoncxx::from_json(emptyFilter.dump());
 
+  auto projection = nlohmann::json::object();
+  projection["_id"] = 0;
+  for (auto field : { "formDesc", "worldOrCellDesc", "position",
+                      "profileId" }) {
+    projection[field] = 1;
+  }
+
+  mongocxx::options::find options;
+  options.projection(bsoncxx::from_json(projection.dump()));
+
   simdjson::dom::parser p;
 
-  auto cursor = pImpl->changeFormsCollection->find(std::move(emptyFilterBson));
+  auto cursor = pImpl->readConnection.changeFormsCollection->find(
+    std::move(emptyFilterBson), options);
   for (auto& documentView : cursor) {
     auto document = p.parse(bsoncxx::to_json(documentView)).value();
-    auto changeForm = MpChangeForm::JsonToChangeForm(document);
-    iterateCallback(changeForm);
+
+    ChangeFormLocation location;
+    const char* tmp;
+    simdjson::dom::element jPosition;
+
+    ReadEx(document, formDesc, &tmp);
+    location.formDesc = FormDesc::FromString(tmp);
+    ReadEx(document, worldOrCellDesc, &tmp);
+    location.worldOrCellDesc = FormDesc::FromString(tmp);
+    ReadEx(document, position, &jPosition);
+    for (int i = 0; i < 3; ++i) {
+      ReadEx(jPosition, i, &location.position[i]);
+    }
+    ReadEx(document, profileId, &location.profileId);
+
+    callback(location);
+  }
+}
+
+void MongoDatabase::IterateByFormDescs(const std::vector<FormDesc>& formDescs,
+                                       const IterateCallback& iterateCallback)
+{
+  if (formDescs.empty()) {
+    return;
+  }
+
+  auto formDescStrings = nlohmann::json::array();
+  for (auto& formDesc : formDescs) {
+    formDescStrings.push_back(formDesc.ToString());
+  }
+
+  auto filter = nlohmann::json::object();
+  filter["formDesc"] = { { "$in", formDescStrings } };
+  pImpl->Find(filter, iterateCallback);
+}
+
+std::optional<std::string> MongoDatabase::GetMetadata(const std::string& key)
+{
+  auto filter = nlohmann::json::object();
+  filter["_id"] = key;
+
+  auto document = pImpl->readConnection.metadataCollection->find_one(
+    bsoncxx::from_json(filter.dump()));
+  if (!document) {
+    return std::nullopt;
   }
+  auto j = nlohmann::json::parse(bsoncxx::to_json(document->view()));
+  return j.at("value").get<std::string>();
+}
+
+void MongoDatabase::SetMetadata(const std::string& key,
+                                const std::string& value)
+{
+  auto filter = nlohmann::json::object();
+  filter["_id"] = key;
+
+  auto upd = nlohmann::json::object();
+  upd["$set"] = { { "value", value } };
+
+  mongocxx::options::update options;
+  options.upsert(true);
+  pImpl->writeConnection.metadataCollection->update_one(
+    bsoncxx::from_json(filter.dump()), bsoncxx::from_json(upd.dump()),
+    options);
 }
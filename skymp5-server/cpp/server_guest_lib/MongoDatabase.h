@@ -7,7 +7,18 @@ class MongoDatabase : public IDatabase
 public:
   MongoDatabase(std::string uri_, std::string name_);
   size_t Upsert(const std::vector<MpChangeForm>& changeForms) override;
+  size_t UpsertPartial(
+    const std::vector<MpChangeForm>& changeForms,
+    const std::vector<ChangeFormFieldMask>& changedFields) override;
   void Iterate(const IterateCallback& iterateCallback) override;
+  void IterateLocations(const IterateLocationsCallback& callback) override;
+  void IterateByFormDescs(const std::vector<FormDesc>& formDescs,
+                          const IterateCallback& iterateCallback) override;
+  std::optional<std::string> GetMetadata(const std::string& key) override;
+  void SetMetadata(const std::string& key, const std::string& value) override;
+
+  // Reads use their own connection
+  bool SupportsConcurrentReads() const override { return true; }
 
 private:
   struct Impl;
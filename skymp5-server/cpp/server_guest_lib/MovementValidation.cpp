@@ -1,5 +1,6 @@
 #include "MovementValidation.h"
 #include "FormDesc.h"
+#include "NavMeshIndex.h"
 #include "NetworkingInterface.h"
 #include "NiPoint3.h"
 #include <nlohmann/json.hpp>
@@ -9,15 +10,25 @@ bool MovementValidation::Validate(const IWorldObject& worldObject,
                                   const NiPoint3& newPos,
                                   const FormDesc& newCellOrWorld,
                                   IMessageOutput& tgt,
-                                  const std::vector<std::string>& espmFiles)
+                                  const std::vector<std::string>& espmFiles,
+                                  const NavMeshIndex* navMeshIndex)
 {
   const auto& currentPos = worldObject.GetPos();
   const auto& currentRot = worldObject.GetAngle();
   const auto& currentCellOrWorld = worldObject.GetCellOrWorld();
 
   float maxDistance = 4096;
-  if (currentCellOrWorld != newCellOrWorld ||
-      (currentPos - newPos).Length() >= maxDistance) {
+  bool valid = !(currentCellOrWorld != newCellOrWorld ||
+                 (currentPos - newPos).Length() >= maxDistance);
+
+  if (valid && navMeshIndex) {
+    const auto cellOrWorld = newCellOrWorld.ToFormId(espmFiles);
+    valid = !navMeshIndex->HasNavMeshes(cellOrWorld) ||
+      navMeshIndex->FindNearestPoint(cellOrWorld, newPos,
+                                     kMaxDistanceToNavMesh);
+  }
+
+  if (!valid) {
     std::string s;
     s += Networking::MinPacketId;
     s += nlohmann::json{
@@ -5,8 +5,14 @@
 #include <string>
 #include <vector>
 
+class NavMeshIndex;
+
 namespace MovementValidation {
+// Farther from navmeshes movement is rejected if 'navMeshIndex' is passed
+constexpr float kMaxDistanceToNavMesh = 2048;
+
 bool Validate(const IWorldObject& worldObject, const NiPoint3& newPos,
               const FormDesc& newCellOrWorld, IMessageOutput& tgt,
-              const std::vector<std::string>& espmFiles);
+              const std::vector<std::string>& espmFiles,
+              const NavMeshIndex* navMeshIndex = nullptr);
 }
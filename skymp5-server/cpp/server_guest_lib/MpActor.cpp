@@ -11,6 +11,12 @@
 #include <random>
 #include <string>
 
+namespace {
+constexpr ChangeFormFieldMask kPercentagesFields =
+  ChangeFormField::HealthPercentage | ChangeFormField::MagickaPercentage |
+  ChangeFormField::StaminaPercentage;
+}
+
 struct MpActor::Impl : public ChangeFormGuard<MpChangeForm>
 {
   Impl(MpChangeForm changeForm_, MpObjectReference* self_)
@@ -36,23 +42,27 @@ MpActor::MpActor(const LocationalData& locationalData_,
 void MpActor::SetRaceMenuOpen(bool isOpen)
 {
   pImpl->EditChangeForm(
-    [&](MpChangeForm& changeForm) { changeForm.isRaceMenuOpen = isOpen; });
+    [&](MpChangeForm& changeForm) { changeForm.isRaceMenuOpen = isOpen; },
+    ChangeFormField::IsRaceMenuOpen);
 }
 
 void MpActor::SetAppearance(const Appearance* newAppearance)
 {
-  pImpl->EditChangeForm([&](MpChangeForm& changeForm) {
-    if (newAppearance)
-      changeForm.appearanceDump = newAppearance->ToJson();
-    else
-      changeForm.appearanceDump.clear();
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeForm& changeForm) {
+      if (newAppearance)
+        changeForm.appearanceDump = newAppearance->ToJson();
+      else
+        changeForm.appearanceDump.clear();
+    },
+    ChangeFormField::AppearanceDump);
 }
 
 void MpActor::SetEquipment(const std::string& jsonString)
 {
   pImpl->EditChangeForm(
-    [&](MpChangeForm& changeForm) { changeForm.equipmentDump = jsonString; });
+    [&](MpChangeForm& changeForm) { changeForm.equipmentDump = jsonString; },
+    ChangeFormField::EquipmentDump);
 }
 
 void MpActor::VisitProperties(const PropertiesVisitor& visitor,
@@ -153,6 +163,11 @@ void MpActor::RemoveEventSink(std::shared_ptr<DestroyEventSink> sink)
   destroyEventSinks.erase(sink);
 }
 
+ChangeFormFieldMask MpActor::TakeChangedFields()
+{
+  return MpObjectReference::TakeChangedFields() | pImpl->TakeChangedFields();
+}
+
 MpChangeForm MpActor::GetChangeForm() const
 {
   auto res = MpObjectReference::GetChangeForm();
@@ -190,6 +205,11 @@ void MpActor::ApplyChangeForm(const MpChangeForm& newChangeForm)
         cf.isRaceMenuOpen = true;
     },
     Impl::Mode::NoRequestSave);
+
+  // The change form comes from the database
+  pImpl->SetChangedFields(newChangeForm.appearanceDump.empty()
+                            ? ChangeFormField::IsRaceMenuOpen
+                            : 0);
 }
 
 uint32_t MpActor::NextSnippetIndex(
@@ -221,11 +241,13 @@ void MpActor::SetPercentages(float healthPercentage, float magickaPercentage,
     Kill(aggressor);
     return;
   }
-  pImpl->EditChangeForm([&](MpChangeForm& changeForm) {
-    changeForm.healthPercentage = healthPercentage;
-    changeForm.magickaPercentage = magickaPercentage;
-    changeForm.staminaPercentage = staminaPercentage;
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeForm& changeForm) {
+      changeForm.healthPercentage = healthPercentage;
+      changeForm.magickaPercentage = magickaPercentage;
+      changeForm.staminaPercentage = staminaPercentage;
+    },
+    kPercentagesFields);
 }
 
 void MpActor::NetSetPercentages(
@@ -353,12 +375,14 @@ void MpActor::SendAndSetDeathState(bool isDead, bool shouldTeleport)
   std::string respawnMsg = GetDeathStateMsg(position, isDead, shouldTeleport);
   SendToUser(respawnMsg.data(), respawnMsg.size(), true);
 
-  pImpl->EditChangeForm([&](MpChangeForm& changeForm) {
-    changeForm.isDead = isDead;
-    changeForm.healthPercentage = attribute;
-    changeForm.magickaPercentage = attribute;
-    changeForm.staminaPercentage = attribute;
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeForm& changeForm) {
+      changeForm.isDead = isDead;
+      changeForm.healthPercentage = attribute;
+      changeForm.magickaPercentage = attribute;
+      changeForm.staminaPercentage = attribute;
+    },
+    ChangeFormField::IsDead | kPercentagesFields);
   if (shouldTeleport) {
     SetCellOrWorldObsolete(position.cellOrWorldDesc);
     SetPos(position.pos);
@@ -542,7 +566,8 @@ void MpActor::Teleport(const LocationalData& position)
 void MpActor::SetSpawnPoint(const LocationalData& position)
 {
   pImpl->EditChangeForm(
-    [&](MpChangeForm& changeForm) { changeForm.spawnPoint = position; });
+    [&](MpChangeForm& changeForm) { changeForm.spawnPoint = position; },
+    ChangeFormField::SpawnPoint);
 }
 
 LocationalData MpActor::GetSpawnPoint() const
@@ -558,7 +583,8 @@ const float MpActor::GetRespawnTime() const
 void MpActor::SetRespawnTime(float time)
 {
   pImpl->EditChangeForm(
-    [&](MpChangeForm& changeForm) { changeForm.spawnDelay = time; });
+    [&](MpChangeForm& changeForm) { changeForm.spawnDelay = time; },
+    ChangeFormField::SpawnDelay);
 }
 
 void MpActor::SetIsDead(bool isDead)
@@ -52,6 +52,7 @@ public:
 
   MpChangeForm GetChangeForm() const override;
   void ApplyChangeForm(const MpChangeForm& changeForm) override;
+  ChangeFormFieldMask TakeChangedFields() override;
 
   uint32_t NextSnippetIndex(
     std::optional<Viet::Promise<VarValue>> promise = std::nullopt);
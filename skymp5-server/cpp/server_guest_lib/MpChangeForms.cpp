@@ -1,55 +1,102 @@
 #include "MpChangeForms.h"
 #include "JsonUtils.h"
 
-nlohmann::json MpChangeForm::ToJson(const MpChangeForm& changeForm)
+nlohmann::json MpChangeForm::ToJson(const MpChangeForm& changeForm,
+                                    ChangeFormFieldMask fields)
 {
   auto res = nlohmann::json::object();
-  res["recType"] = static_cast<int>(changeForm.recType);
-  res["formDesc"] = changeForm.formDesc.ToString();
-  res["baseDesc"] = changeForm.baseDesc.ToString();
-  res["position"] = { changeForm.position[0], changeForm.position[1],
-                      changeForm.position[2] };
-  res["angle"] = { changeForm.angle[0], changeForm.angle[1],
-                   changeForm.angle[2] };
-  res["worldOrCellDesc"] = changeForm.worldOrCellDesc.ToString();
-  res["inv"] = changeForm.inv.ToJson();
-  res["isHarvested"] = changeForm.isHarvested;
-  res["isOpen"] = changeForm.isOpen;
-  res["baseContainerAdded"] = changeForm.baseContainerAdded;
-  res["nextRelootDatetime"] = changeForm.nextRelootDatetime;
-  res["isDisabled"] = changeForm.isDisabled;
-  res["profileId"] = changeForm.profileId;
-  res["isRaceMenuOpen"] = changeForm.isRaceMenuOpen;
-  res["dynamicFields"] = changeForm.dynamicFields.GetAsJson();
-
-  if (changeForm.appearanceDump.empty()) {
-    res["appearanceDump"] = nullptr;
-  } else {
-    res["appearanceDump"] = nlohmann::json::parse(changeForm.appearanceDump);
-  }
-
-  if (changeForm.equipmentDump.empty()) {
-    res["equipmentDump"] = nullptr;
-  } else {
-    res["equipmentDump"] = nlohmann::json::parse(changeForm.equipmentDump);
-  }
-
-  res["healthPercentage"] = changeForm.healthPercentage;
-  res["magickaPercentage"] = changeForm.magickaPercentage;
-  res["staminaPercentage"] = changeForm.staminaPercentage;
-
-  res["isDead"] = changeForm.isDead;
-
-  res["spawnPoint_pos"] = { changeForm.spawnPoint.pos[0],
-                            changeForm.spawnPoint.pos[1],
-                            changeForm.spawnPoint.pos[2] };
-  res["spawnPoint_rot"] = { changeForm.spawnPoint.rot[0],
-                            changeForm.spawnPoint.rot[1],
-                            changeForm.spawnPoint.rot[2] };
-  res["spawnPoint_cellOrWorldDesc"] =
-    changeForm.spawnPoint.cellOrWorldDesc.ToString();
-
-  res["spawnDelay"] = changeForm.spawnDelay;
+  if (fields & ChangeFormField::RecType) {
+    res["recType"] = static_cast<int>(changeForm.recType);
+  }
+  if (fields & ChangeFormField::FormDesc) {
+    res["formDesc"] = changeForm.formDesc.ToString();
+  }
+  if (fields & ChangeFormField::BaseDesc) {
+    res["baseDesc"] = changeForm.baseDesc.ToString();
+  }
+  if (fields & ChangeFormField::Position) {
+    res["position"] = { changeForm.position[0], changeForm.position[1],
+                        changeForm.position[2] };
+  }
+  if (fields & ChangeFormField::Angle) {
+    res["angle"] = { changeForm.angle[0], changeForm.angle[1],
+                     changeForm.angle[2] };
+  }
+  if (fields & ChangeFormField::WorldOrCellDesc) {
+    res["worldOrCellDesc"] = changeForm.worldOrCellDesc.ToString();
+  }
+  if (fields & ChangeFormField::Inv) {
+    res["inv"] = changeForm.inv.ToJson();
+  }
+  if (fields & ChangeFormField::IsHarvested) {
+    res["isHarvested"] = changeForm.isHarvested;
+  }
+  if (fields & ChangeFormField::IsOpen) {
+    res["isOpen"] = changeForm.isOpen;
+  }
+  if (fields & ChangeFormField::BaseContainerAdded) {
+    res["baseContainerAdded"] = changeForm.baseContainerAdded;
+  }
+  if (fields & ChangeFormField::NextRelootDatetime) {
+    res["nextRelootDatetime"] = changeForm.nextRelootDatetime;
+  }
+  if (fields & ChangeFormField::IsDisabled) {
+    res["isDisabled"] = changeForm.isDisabled;
+  }
+  if (fields & ChangeFormField::ProfileId) {
+    res["profileId"] = changeForm.profileId;
+  }
+  if (fields & ChangeFormField::IsRaceMenuOpen) {
+    res["isRaceMenuOpen"] = changeForm.isRaceMenuOpen;
+  }
+  if (fields & ChangeFormField::DynamicFields) {
+    res["dynamicFields"] = changeForm.dynamicFields.GetAsJson();
+  }
+
+  if (fields & ChangeFormField::AppearanceDump) {
+    if (changeForm.appearanceDump.empty()) {
+      res["appearanceDump"] = nullptr;
+    } else {
+      res["appearanceDump"] = nlohmann::json::parse(changeForm.appearanceDump);
+    }
+  }
+
+  if (fields & ChangeFormField::EquipmentDump) {
+    if (changeForm.equipmentDump.empty()) {
+      res["equipmentDump"] = nullptr;
+    } else {
+      res["equipmentDump"] = nlohmann::json::parse(changeForm.equipmentDump);
+    }
+  }
+
+  if (fields & ChangeFormField::HealthPercentage) {
+    res["healthPercentage"] = changeForm.healthPercentage;
+  }
+  if (fields & ChangeFormField::MagickaPercentage) {
+    res["magickaPercentage"] = changeForm.magickaPercentage;
+  }
+  if (fields & ChangeFormField::StaminaPercentage) {
+    res["staminaPercentage"] = changeForm.staminaPercentage;
+  }
+
+  if (fields & ChangeFormField::IsDead) {
+    res["isDead"] = changeForm.isDead;
+  }
+
+  if (fields & ChangeFormField::SpawnPoint) {
+    res["spawnPoint_pos"] = { changeForm.spawnPoint.pos[0],
+                              changeForm.spawnPoint.pos[1],
+                              changeForm.spawnPoint.pos[2] };
+    res["spawnPoint_rot"] = { changeForm.spawnPoint.rot[0],
+                              changeForm.spawnPoint.rot[1],
+                              changeForm.spawnPoint.rot[2] };
+    res["spawnPoint_cellOrWorldDesc"] =
+      changeForm.spawnPoint.cellOrWorldDesc.ToString();
+  }
+
+  if (fields & ChangeFormField::SpawnDelay) {
+    res["spawnDelay"] = changeForm.spawnDelay;
+  }
   return res;
 }
 
@@ -15,6 +15,41 @@
 class MpObjectReference;
 class WorldState;
 
+// Top-level fields of a change form. Masks of these are carried through the
+// save pipeline so that databases can update only the fields that changed
+namespace ChangeFormField {
+enum : uint32_t
+{
+  RecType = 1u << 0,
+  FormDesc = 1u << 1,
+  BaseDesc = 1u << 2,
+  Position = 1u << 3,
+  Angle = 1u << 4,
+  WorldOrCellDesc = 1u << 5,
+  Inv = 1u << 6,
+  IsHarvested = 1u << 7,
+  IsOpen = 1u << 8,
+  BaseContainerAdded = 1u << 9,
+  NextRelootDatetime = 1u << 10,
+  IsDisabled = 1u << 11,
+  ProfileId = 1u << 12,
+  IsRaceMenuOpen = 1u << 13,
+  IsDead = 1u << 14,
+  AppearanceDump = 1u << 15,
+  EquipmentDump = 1u << 16,
+  HealthPercentage = 1u << 17,
+  MagickaPercentage = 1u << 18,
+  StaminaPercentage = 1u << 19,
+  SpawnPoint = 1u << 20,
+  SpawnDelay = 1u << 21,
+  DynamicFields = 1u << 22,
+
+  All = (1u << 23) - 1
+};
+}
+
+using ChangeFormFieldMask = uint32_t;
+
 class MpChangeFormREFR
 {
 public:
@@ -73,7 +108,10 @@ public:
       spawnDelay);
   }
 
-  static nlohmann::json ToJson(const MpChangeForm& changeForm);
+  // Only fields from 'fields' mask are written
+  static nlohmann::json ToJson(
+    const MpChangeForm& changeForm,
+    ChangeFormFieldMask fields = ChangeFormField::All);
   static MpChangeForm JsonToChangeForm(simdjson::dom::element& element);
 };
 
@@ -69,12 +69,6 @@ private:
   const uint32_t refId;
 };
 
-namespace {
-std::pair<int16_t, int16_t> GetGridPos(const NiPoint3& pos) noexcept
-{
-  return { int16_t(pos.x / 4096), int16_t(pos.y / 4096) };
-}
-}
 
 struct AnimGraphHolder
 {
@@ -156,6 +150,11 @@ const uint32_t& MpObjectReference::GetBaseId() const
   return baseId;
 }
 
+const std::string& MpObjectReference::GetBaseType() const
+{
+  return baseType;
+}
+
 const Inventory& MpObjectReference::GetInventory() const
 {
   return pImpl->ChangeForm().inv;
@@ -279,7 +278,7 @@ void MpObjectReference::SetPos(const NiPoint3& newPos)
 
   pImpl->EditChangeForm(
     [&newPos](MpChangeFormREFR& changeForm) { changeForm.position = newPos; },
-    Mode(IsLocationSavingNeeded()));
+    ChangeFormField::Position, Mode(IsLocationSavingNeeded()));
 
   if (oldGridPos != newGridPos || !everSubscribedOrListened)
     ForceSubscriptionsUpdate();
@@ -356,15 +355,17 @@ void MpObjectReference::SetAngle(const NiPoint3& newAngle)
 {
   pImpl->EditChangeForm(
     [&](MpChangeFormREFR& changeForm) { changeForm.angle = newAngle; },
-    Mode(IsLocationSavingNeeded()));
+    ChangeFormField::Angle, Mode(IsLocationSavingNeeded()));
 }
 
 void MpObjectReference::SetHarvested(bool harvested)
 {
   if (harvested != pImpl->ChangeForm().isHarvested) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.isHarvested = harvested;
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) {
+        changeForm.isHarvested = harvested;
+      },
+      ChangeFormField::IsHarvested);
     SendPropertyToListeners("isHarvested", harvested);
   }
 }
@@ -373,7 +374,8 @@ void MpObjectReference::SetOpen(bool open)
 {
   if (open != pImpl->ChangeForm().isOpen) {
     pImpl->EditChangeForm(
-      [&](MpChangeFormREFR& changeForm) { changeForm.isOpen = open; });
+      [&](MpChangeFormREFR& changeForm) { changeForm.isOpen = open; },
+      ChangeFormField::IsOpen);
     SendPropertyToListeners("isOpen", open);
   }
 }
@@ -429,7 +431,8 @@ void MpObjectReference::Disable()
     return;
 
   pImpl->EditChangeForm(
-    [&](MpChangeFormREFR& changeForm) { changeForm.isDisabled = true; });
+    [&](MpChangeFormREFR& changeForm) { changeForm.isDisabled = true; },
+    ChangeFormField::IsDisabled);
   RemoveFromGrid();
 }
 
@@ -439,7 +442,8 @@ void MpObjectReference::Enable()
     return;
 
   pImpl->EditChangeForm(
-    [&](MpChangeFormREFR& changeForm) { changeForm.isDisabled = false; });
+    [&](MpChangeFormREFR& changeForm) { changeForm.isDisabled = false; },
+    ChangeFormField::IsDisabled);
   ForceSubscriptionsUpdate();
 }
 
@@ -520,9 +524,11 @@ void MpObjectReference::SetProperty(const std::string& propertyName,
                                     bool isVisibleByOwner,
                                     bool isVisibleByNeighbor)
 {
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.dynamicFields.Set(propertyName, newValueChakra);
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) {
+      changeForm.dynamicFields.Set(propertyName, newValueChakra);
+    },
+    ChangeFormField::DynamicFields);
   if (isVisibleByNeighbor) {
     SendPropertyToListeners(propertyName.data(), newValue);
   } else if (isVisibleByOwner) {
@@ -546,6 +552,7 @@ void MpObjectReference::SetPosAndAngleSilent(const NiPoint3& pos,
       changeForm.position = pos;
       changeForm.angle = rot;
     },
+    ChangeFormField::Position | ChangeFormField::Angle,
     Impl::Mode::NoRequestSave);
 }
 
@@ -561,19 +568,23 @@ void MpObjectReference::SetAnimationVariableBool(const char* name, bool value)
 
 void MpObjectReference::SetInventory(const Inventory& inv)
 {
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.baseContainerAdded = true;
-    changeForm.inv = inv;
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) {
+      changeForm.baseContainerAdded = true;
+      changeForm.inv = inv;
+    },
+    ChangeFormField::BaseContainerAdded | ChangeFormField::Inv);
   SendInventoryUpdate();
 }
 
 void MpObjectReference::AddItem(uint32_t baseId, uint32_t count)
 {
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.baseContainerAdded = true;
-    changeForm.inv.AddItem(baseId, count);
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) {
+      changeForm.baseContainerAdded = true;
+      changeForm.inv.AddItem(baseId, count);
+    },
+    ChangeFormField::BaseContainerAdded | ChangeFormField::Inv);
   SendInventoryUpdate();
 
   auto baseItem = VarValue(static_cast<int32_t>(baseId));
@@ -587,10 +598,12 @@ void MpObjectReference::AddItem(uint32_t baseId, uint32_t count)
 void MpObjectReference::AddItems(const std::vector<Inventory::Entry>& entries)
 {
   if (entries.size() > 0) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.baseContainerAdded = true;
-      changeForm.inv.AddItems(entries);
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) {
+        changeForm.baseContainerAdded = true;
+        changeForm.inv.AddItems(entries);
+      },
+      ChangeFormField::BaseContainerAdded | ChangeFormField::Inv);
     SendInventoryUpdate();
   }
 
@@ -613,9 +626,9 @@ void MpObjectReference::RemoveItem(uint32_t baseId, uint32_t count,
 void MpObjectReference::RemoveItems(
   const std::vector<Inventory::Entry>& entries, MpObjectReference* target)
 {
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.inv.RemoveItems(entries);
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) { changeForm.inv.RemoveItems(entries); },
+    ChangeFormField::Inv);
 
   if (target)
     target->AddItems(entries);
@@ -635,7 +648,7 @@ void MpObjectReference::RelootContainer()
     [&](MpChangeFormREFR& changeForm) {
       changeForm.baseContainerAdded = false;
     },
-    Impl::Mode::NoRequestSave);
+    ChangeFormField::BaseContainerAdded, Impl::Mode::NoRequestSave);
   EnsureBaseContainerAdded(*GetParent()->espm);
 }
 
@@ -648,7 +661,8 @@ void MpObjectReference::RegisterProfileId(int32_t profileId)
     throw std::runtime_error("Already has a valid profileId");
 
   pImpl->EditChangeForm(
-    [&](MpChangeFormREFR& changeForm) { changeForm.profileId = profileId; });
+    [&](MpChangeFormREFR& changeForm) { changeForm.profileId = profileId; },
+    ChangeFormField::ProfileId);
   GetParent()->actorIdByProfileId[profileId].insert(GetFormId());
 }
 
@@ -710,6 +724,12 @@ const std::set<MpObjectReference*>& MpObjectReference::GetListeners() const
   return listeners ? *listeners : g_emptyListeners;
 }
 
+std::pair<int16_t, int16_t> MpObjectReference::GetGridPos(
+  const NiPoint3& pos) noexcept
+{
+  return { int16_t(pos.x / 4096), int16_t(pos.y / 4096) };
+}
+
 const std::set<MpObjectReference*>& MpObjectReference::GetEmitters() const
 {
   static const std::set<MpObjectReference*> g_emptyEmitters;
@@ -723,10 +743,12 @@ void MpObjectReference::RequestReloot(
     time = GetRelootTime();
 
   if (!pImpl->ChangeForm().nextRelootDatetime) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.nextRelootDatetime = std::chrono::system_clock::to_time_t(
-        std::chrono::system_clock::now() + GetRelootTime());
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) {
+        changeForm.nextRelootDatetime = std::chrono::system_clock::to_time_t(
+          std::chrono::system_clock::now() + GetRelootTime());
+      },
+      ChangeFormField::NextRelootDatetime);
 
     GetParent()->RequestReloot(*this, *time);
   }
@@ -735,9 +757,9 @@ void MpObjectReference::RequestReloot(
 void MpObjectReference::DoReloot()
 {
   if (pImpl->ChangeForm().nextRelootDatetime) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.nextRelootDatetime = 0;
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) { changeForm.nextRelootDatetime = 0; },
+      ChangeFormField::NextRelootDatetime);
     SetOpen(false);
     SetHarvested(false);
     RelootContainer();
@@ -755,6 +777,11 @@ MpObjectReference::GetNextRelootMoment() const
   return res;
 }
 
+ChangeFormFieldMask MpObjectReference::TakeChangedFields()
+{
+  return pImpl->TakeChangedFields();
+}
+
 MpChangeForm MpObjectReference::GetChangeForm() const
 {
   MpChangeForm res;
@@ -812,6 +839,10 @@ void MpObjectReference::ApplyChangeForm(const MpChangeForm& changeForm)
       f.nextRelootDatetime = 0;
     },
     Impl::Mode::NoRequestSave);
+
+  // The change form comes from the database, so the only field that differs
+  // from the saved document is 'nextRelootDatetime'
+  pImpl->SetChangedFields(ChangeFormField::NextRelootDatetime);
   if (changeForm.nextRelootDatetime) {
     auto tp =
       std::chrono::system_clock::from_time_t(changeForm.nextRelootDatetime);
@@ -850,9 +881,11 @@ void MpObjectReference::SetCellOrWorldObsolete(const FormDesc& newWorldOrCell)
     gridIterator->second.grid->Forget(this);
   }
 
-  pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-    changeForm.worldOrCellDesc = newWorldOrCell;
-  });
+  pImpl->EditChangeForm(
+    [&](MpChangeFormREFR& changeForm) {
+      changeForm.worldOrCellDesc = newWorldOrCell;
+    },
+    ChangeFormField::WorldOrCellDesc);
 }
 
 void MpObjectReference::VisitNeighbours(const Visitor& visitor)
@@ -917,7 +950,7 @@ void MpObjectReference::Init(WorldState* parent, uint32_t formId,
       changeForm.formDesc =
         FormDesc::FromFormId(formId, GetParent()->espmFiles);
     },
-    mode);
+    ChangeFormField::FormDesc, mode);
 }
 
 bool MpObjectReference::IsLocationSavingNeeded() const
@@ -949,16 +982,15 @@ void MpObjectReference::ProcessActivate(MpObjectReference& activationSource)
   if (t == espm::TREE::kType || t == espm::FLOR::kType || espm::IsItem(t)) {
     if (!IsHarvested()) {
       auto mapping = loader.GetBrowser().GetCombMapping(base.fileIdx);
+      auto& decodedRecordsCache = loader.GetBrowser().GetDecodedRecordsCache();
       uint32_t resultItem = 0;
       if (t == espm::TREE::kType) {
-        espm::FLOR::Data data;
-        data =
-          espm::Convert<espm::TREE>(base.rec)->GetData(compressedFieldsCache);
+        auto& data =
+          decodedRecordsCache.GetData(espm::Convert<espm::TREE>(base.rec));
         resultItem = espm::GetMappedId(data.resultItem, *mapping);
       } else if (t == espm::FLOR::kType) {
-        espm::FLOR::Data data;
-        data =
-          espm::Convert<espm::FLOR>(base.rec)->GetData(compressedFieldsCache);
+        auto& data =
+          decodedRecordsCache.GetData(espm::Convert<espm::FLOR>(base.rec));
         resultItem = espm::GetMappedId(data.resultItem, *mapping);
       } else {
         resultItem = espm::GetMappedId(base.rec->GetId(), *mapping);
@@ -1233,7 +1265,8 @@ void MpObjectReference::AddContainerObject(
   auto leveledItem = espm::Convert<espm::LVLI>(formLookupRes.rec);
   if (leveledItem) {
     auto map = LeveledListUtils::EvaluateListRecurse(
-      espm.GetBrowser(), formLookupRes, 1, pcLevel, chanceNoneOverride.get());
+      GetParent()->GetLeveledLists(), formLookupRes, 1, pcLevel,
+      chanceNoneOverride.get());
     for (auto& p : map)
       (*itemsToAdd)[p.first] += p.second;
   } else
@@ -1283,9 +1316,11 @@ void MpObjectReference::EnsureBaseContainerAdded(espm::Loader& espm)
   AddItems(entries);
 
   if (!pImpl->ChangeForm().baseContainerAdded) {
-    pImpl->EditChangeForm([&](MpChangeFormREFR& changeForm) {
-      changeForm.baseContainerAdded = true;
-    });
+    pImpl->EditChangeForm(
+      [&](MpChangeFormREFR& changeForm) {
+        changeForm.baseContainerAdded = true;
+      },
+      ChangeFormField::BaseContainerAdded);
   }
 }
 
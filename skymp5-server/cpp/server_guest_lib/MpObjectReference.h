@@ -68,6 +68,7 @@ public:
   const NiPoint3& GetAngle() const override;
   const FormDesc& GetCellOrWorld() const override;
   const uint32_t& GetBaseId() const;
+  const std::string& GetBaseType() const;
   const Inventory& GetInventory() const;
   const bool& IsHarvested() const;
   const bool& IsOpen() const;
@@ -136,6 +137,9 @@ public:
   const std::set<MpObjectReference*>& GetListeners() const;
   const std::set<MpObjectReference*>& GetEmitters() const;
 
+  // Chunk coordinates of a position
+  static std::pair<int16_t, int16_t> GetGridPos(const NiPoint3& pos) noexcept;
+
   // uses default reloot time if nullopt passed
   void RequestReloot(
     std::optional<std::chrono::system_clock::duration> time = std::nullopt);
@@ -145,6 +149,9 @@ public:
 
   virtual MpChangeForm GetChangeForm() const;
   virtual void ApplyChangeForm(const MpChangeForm& changeForm);
+
+  // Returns fields of the change form changed since the previous call
+  virtual ChangeFormFieldMask TakeChangedFields();
   const DynamicFields& GetDynamicFields() const;
 
   // This method removes ObjectReference from a current grid and doesn't attach
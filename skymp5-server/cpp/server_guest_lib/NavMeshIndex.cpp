@@ -0,0 +1,298 @@
+#include "NavMeshIndex.h"
+#include <Combiner.h>
+#include <algorithm>
+#include <cmath>
+#include <sparsepp/spp.h>
+#include <vector>
+
+namespace {
+constexpr float kBucketSize = 256.f;
+
+struct Triangle
+{
+  NiPoint3 a, b, c;
+};
+
+int32_t ToBucket(float v)
+{
+  return static_cast<int32_t>(std::floor(v / kBucketSize));
+}
+
+uint64_t MakeBucketKey(int32_t x, int32_t y)
+{
+  return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) |
+    static_cast<uint32_t>(y);
+}
+
+// Real-Time Collision Detection by Christer Ericson, 5.1.5
+NiPoint3 ClosestPointOnTriangle(const NiPoint3& p, const Triangle& t)
+{
+  const NiPoint3 ab = t.b - t.a, ac = t.c - t.a, ap = p - t.a;
+  const float d1 = ab * ap, d2 = ac * ap;
+  if (d1 <= 0.f && d2 <= 0.f) {
+    return t.a;
+  }
+
+  const NiPoint3 bp = p - t.b;
+  const float d3 = ab * bp, d4 = ac * bp;
+  if (d3 >= 0.f && d4 <= d3) {
+    return t.b;
+  }
+
+  const float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+    return t.a + ab * (d1 / (d1 - d3));
+  }
+
+  const NiPoint3 cp = p - t.c;
+  const float d5 = ab * cp, d6 = ac * cp;
+  if (d6 >= 0.f && d5 <= d6) {
+    return t.c;
+  }
+
+  const float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+    return t.a + ac * (d2 / (d2 - d6));
+  }
+
+  const float va = d3 * d6 - d5 * d4;
+  if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) {
+    return t.b + (t.c - t.b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+  }
+
+  const float denom = 1.f / (va + vb + vc);
+  return t.a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Returns the height of the triangle at x, y if the point is inside of the
+// triangle projected onto the XY plane
+std::optional<float> HeightAt(const Triangle& t, float x, float y)
+{
+  const float det =
+    (t.b.y - t.c.y) * (t.a.x - t.c.x) + (t.c.x - t.b.x) * (t.a.y - t.c.y);
+  if (std::abs(det) < 1e-6f) {
+    return std::nullopt; // Vertical or degenerate
+  }
+  const float l1 =
+    ((t.b.y - t.c.y) * (x - t.c.x) + (t.c.x - t.b.x) * (y - t.c.y)) / det;
+  const float l2 =
+    ((t.c.y - t.a.y) * (x - t.c.x) + (t.a.x - t.c.x) * (y - t.c.y)) / det;
+  const float l3 = 1.f - l1 - l2;
+
+  constexpr float kEpsilon = -1e-4f;
+  if (l1 < kEpsilon || l2 < kEpsilon || l3 < kEpsilon) {
+    return std::nullopt;
+  }
+  return l1 * t.a.z + l2 * t.b.z + l3 * t.c.z;
+}
+}
+
+struct NavMeshIndex::Impl
+{
+  struct Space
+  {
+    std::vector<Triangle> triangles;
+    spp::sparse_hash_map<uint64_t, std::vector<uint32_t>> buckets;
+  };
+
+  spp::sparse_hash_map<uint32_t, Space> spaces;
+  size_t numTriangles = 0;
+
+  const Space* FindSpace(uint32_t cellOrWorld) const
+  {
+    auto it = spaces.find(cellOrWorld);
+    return it == spaces.end() ? nullptr : &it->second;
+  }
+
+  template <class F>
+  static void ForEachTriangle(const Space& space, int32_t x, int32_t y,
+                              const F& f)
+  {
+    auto it = space.buckets.find(MakeBucketKey(x, y));
+    if (it == space.buckets.end()) {
+      return;
+    }
+    for (auto triangleIdx : it->second) {
+      f(space.triangles[triangleIdx]);
+    }
+  }
+
+  // Visits buckets at Chebyshev distance 'ring' from the bucket x, y that
+  // are within minX, minY, maxX, maxY
+  template <class F>
+  static void ForEachTriangleInRing(const Space& space, int32_t x, int32_t y,
+                                    int32_t ring, int32_t minX, int32_t minY,
+                                    int32_t maxX, int32_t maxY, const F& f)
+  {
+    auto visit = [&](int32_t bucketX, int32_t bucketY) {
+      if (bucketX >= minX && bucketX <= maxX && bucketY >= minY &&
+          bucketY <= maxY) {
+        ForEachTriangle(space, bucketX, bucketY, f);
+      }
+    };
+    if (ring == 0) {
+      visit(x, y);
+      return;
+    }
+    for (int32_t i = -ring; i <= ring; ++i) {
+      visit(x + i, y - ring);
+      visit(x + i, y + ring);
+    }
+    for (int32_t i = -ring + 1; i <= ring - 1; ++i) {
+      visit(x - ring, y + i);
+      visit(x + ring, y + i);
+    }
+  }
+};
+
+NavMeshIndex::NavMeshIndex()
+  : pImpl(std::make_shared<Impl>())
+{
+}
+
+NavMeshIndex::NavMeshIndex(const espm::CombineBrowser& br)
+  : NavMeshIndex()
+{
+  // Preloaded navmeshes are taken from the browser cache, others are only
+  // needed here
+  espm::CompressedFieldsCache cache(0, &br.GetCache());
+
+  br.ForEachRecord([&](const espm::LookupResult& lookupRes) {
+    auto navMesh = espm::Convert<espm::NAVM>(lookupRes.rec);
+    if (!navMesh) {
+      return;
+    }
+
+    auto data = navMesh->GetData(cache);
+    if (!data.vertices) {
+      return;
+    }
+
+    // Exterior navmeshes are bound to worldspaces, interior ones to cells
+    const uint32_t cellOrWorld = lookupRes.ToGlobalId(
+      data.worldSpaceId ? data.worldSpaceId : data.cellOrGridPos.cellId);
+
+    const auto vertices = data.vertices->begin();
+    const auto numVertices = data.vertices->end() - vertices;
+    auto toPoint = [&](int16_t i) {
+      return NiPoint3(vertices[i][0], vertices[i][1], vertices[i][2]);
+    };
+
+    for (uint32_t i = 0; i < data.numTriangles; ++i) {
+      auto& t = data.triangles[i];
+      const bool valid =
+        std::all_of(std::begin(t.vertices), std::end(t.vertices),
+                    [&](int16_t v) { return v >= 0 && v < numVertices; });
+      if (valid) {
+        AddTriangle(cellOrWorld, toPoint(t.vertices[0]),
+                    toPoint(t.vertices[1]), toPoint(t.vertices[2]));
+      }
+    }
+
+    // Decompressed navmeshes are not needed anymore
+    cache.Clear();
+  });
+}
+
+void NavMeshIndex::AddTriangle(uint32_t cellOrWorld, const NiPoint3& a,
+                               const NiPoint3& b, const NiPoint3& c)
+{
+  auto& space = pImpl->spaces[cellOrWorld];
+  const auto triangleIdx = static_cast<uint32_t>(space.triangles.size());
+  space.triangles.push_back({ a, b, c });
+  ++pImpl->numTriangles;
+
+  const int32_t minX = ToBucket(std::min({ a.x, b.x, c.x }));
+  const int32_t minY = ToBucket(std::min({ a.y, b.y, c.y }));
+  const int32_t maxX = ToBucket(std::max({ a.x, b.x, c.x }));
+  const int32_t maxY = ToBucket(std::max({ a.y, b.y, c.y }));
+  for (int32_t x = minX; x <= maxX; ++x) {
+    for (int32_t y = minY; y <= maxY; ++y) {
+      space.buckets[MakeBucketKey(x, y)].push_back(triangleIdx);
+    }
+  }
+}
+
+bool NavMeshIndex::HasNavMeshes(uint32_t cellOrWorld) const
+{
+  return pImpl->FindSpace(cellOrWorld) != nullptr;
+}
+
+size_t NavMeshIndex::GetNumTriangles() const noexcept
+{
+  return pImpl->numTriangles;
+}
+
+std::optional<NiPoint3> NavMeshIndex::FindNearestPoint(
+  uint32_t cellOrWorld, const NiPoint3& pos, float maxDistance) const
+{
+  auto space = pImpl->FindSpace(cellOrWorld);
+  if (!space) {
+    return std::nullopt;
+  }
+
+  const int32_t minX = ToBucket(pos.x - maxDistance);
+  const int32_t minY = ToBucket(pos.y - maxDistance);
+  const int32_t maxX = ToBucket(pos.x + maxDistance);
+  const int32_t maxY = ToBucket(pos.y + maxDistance);
+  const int32_t x = ToBucket(pos.x), y = ToBucket(pos.y);
+  const int32_t maxRing =
+    std::max({ x - minX, maxX - x, y - minY, maxY - y });
+
+  std::optional<NiPoint3> res;
+  float minSqrDistance = maxDistance * maxDistance;
+  auto visit = [&](const Triangle& t) {
+    auto point = ClosestPointOnTriangle(pos, t);
+    const float sqrDistance = (point - pos).SqrLength();
+    if (sqrDistance <= minSqrDistance) {
+      minSqrDistance = sqrDistance;
+      res = point;
+    }
+  };
+
+  // Searching outwards from the bucket of pos. The nearest point lies in a
+  // bucket its triangle is added to, so once it is closer than any bucket
+  // outside of rings visited so far, farther rings can't contain a closer one
+  for (int32_t ring = 0; ring <= maxRing; ++ring) {
+    Impl::ForEachTriangleInRing(*space, x, y, ring, minX, minY, maxX, maxY,
+                                visit);
+    const float minDistanceOutside =
+      std::min({ pos.x - (x - ring) * kBucketSize,
+                 (x + ring + 1) * kBucketSize - pos.x,
+                 pos.y - (y - ring) * kBucketSize,
+                 (y + ring + 1) * kBucketSize - pos.y });
+    if (res && minSqrDistance <= minDistanceOutside * minDistanceOutside) {
+      break;
+    }
+  }
+  return res;
+}
+
+std::optional<float> NavMeshIndex::FindHeight(uint32_t cellOrWorld,
+                                              const NiPoint3& pos,
+                                              float maxVerticalDistance) const
+{
+  auto space = pImpl->FindSpace(cellOrWorld);
+  if (!space) {
+    return std::nullopt;
+  }
+
+  std::optional<float> res;
+  float minDistance = maxVerticalDistance;
+  const int32_t x = ToBucket(pos.x), y = ToBucket(pos.y);
+  Impl::ForEachTriangle(*space, x, y, [&](const Triangle& t) {
+    auto height = HeightAt(t, pos.x, pos.y);
+    if (height && std::abs(*height - pos.z) <= minDistance) {
+      minDistance = std::abs(*height - pos.z);
+      res = height;
+    }
+  });
+  return res;
+}
+
+bool NavMeshIndex::IsOnWalkableSurface(uint32_t cellOrWorld,
+                                       const NiPoint3& pos,
+                                       float maxVerticalDistance) const
+{
+  return FindHeight(cellOrWorld, pos, maxVerticalDistance).has_value();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "NiPoint3.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace espm {
+class CombineBrowser;
+}
+
+// Triangles of navmeshes bucketed into a uniform grid per cell or worldspace
+// for fast point queries. 'cellOrWorld' is a form id of an interior cell or
+// a worldspace
+class NavMeshIndex
+{
+public:
+  NavMeshIndex();
+
+  // Adds triangles of all navmeshes
+  explicit NavMeshIndex(const espm::CombineBrowser& br);
+
+  void AddTriangle(uint32_t cellOrWorld, const NiPoint3& a, const NiPoint3& b,
+                   const NiPoint3& c);
+
+  bool HasNavMeshes(uint32_t cellOrWorld) const;
+  size_t GetNumTriangles() const noexcept;
+
+  // Returns the nearest point of navmeshes within 'maxDistance'. The search
+  // stops early if a point is found near pos, otherwise the cost grows with
+  // the square of 'maxDistance'
+  std::optional<NiPoint3> FindNearestPoint(uint32_t cellOrWorld,
+                                           const NiPoint3& pos,
+                                           float maxDistance) const;
+
+  // Returns the height of the navmesh surface at pos.x, pos.y that is the
+  // closest to pos.z, but not farther than 'maxVerticalDistance'
+  std::optional<float> FindHeight(uint32_t cellOrWorld, const NiPoint3& pos,
+                                  float maxVerticalDistance) const;
+
+  bool IsOnWalkableSurface(uint32_t cellOrWorld, const NiPoint3& pos,
+                           float maxVerticalDistance) const;
+
+private:
+  struct Impl;
+  std::shared_ptr<Impl> pImpl;
+};
@@ -1,5 +1,6 @@
 #include "PartOne.h"
 #include "ActionListener.h"
+#include "ChangeFormJournal.h"
 #include "Exceptions.h"
 #include "FormCallbacks.h"
 #include "IdManager.h"
@@ -246,29 +247,82 @@ void PartOne::AttachEspm(espm::Loader* espm)
   worldState.AttachEspm(espm, [this] { return CreateFormCallbacks(); });
 }
 
-void PartOne::AttachSaveStorage(std::shared_ptr<ISaveStorage> saveStorage)
+void PartOne::AttachSaveStorage(
+  std::shared_ptr<ISaveStorage> saveStorage,
+  std::shared_ptr<ChangeFormJournal> changeFormJournal)
 {
   worldState.AttachSaveStorage(saveStorage);
 
   clock_t was = clock();
 
+  std::map<FormDesc, MpChangeForm> journaled;
+  if (changeFormJournal) {
+    changeFormJournal->Replay([&](const MpChangeForm& changeForm) {
+      journaled[changeForm.formDesc] = changeForm;
+    });
+  }
+
   int n = 0;
   int numPlayerCharacters = 0;
-  saveStorage->IterateSync([&](MpChangeForm changeForm) {
-    // Do not let players become NPCs
+  // Do not let players become NPCs
+  auto disablePlayerCharacter = [](MpChangeForm& changeForm) {
     if (changeForm.profileId != -1 && !changeForm.isDisabled) {
       changeForm.isDisabled = true;
     }
+  };
 
+  auto load = [&](MpChangeForm changeForm) {
+    disablePlayerCharacter(changeForm);
     n++;
     worldState.LoadChangeForm(changeForm, CreateFormCallbacks());
     if (changeForm.profileId >= 0)
       ++numPlayerCharacters;
-  });
+  };
+
+  if (worldState.IsLoadingChangeFormsOnDemand()) {
+    // Player characters and ESM references are loaded now, everything else
+    // is loaded with chunks
+    std::vector<FormDesc> loadNow;
+    saveStorage->IterateLocationsSync(
+      [&](const IDatabase::ChangeFormLocation& location) {
+        if (journaled.count(location.formDesc)) {
+          return;
+        }
+        auto formId = location.formDesc.ToFormId(worldState.espmFiles);
+        if (location.profileId >= 0 || formId < 0xff000000) {
+          loadNow.push_back(location.formDesc);
+        } else {
+          worldState.AddUnloadedChangeForm(location.formDesc,
+                                           location.worldOrCellDesc,
+                                           location.position);
+        }
+      });
+    saveStorage->IterateByFormDescsSync(loadNow, load);
+  } else {
+    saveStorage->IterateSync([&](const MpChangeForm& changeForm) {
+      if (!journaled.count(changeForm.formDesc)) {
+        load(changeForm);
+      }
+    });
+  }
+
+  // Journaled again so that segments of the previous run can be deleted once
+  // these change forms are saved
+  for (auto& [formDesc, changeForm] : journaled) {
+    disablePlayerCharacter(changeForm);
+    load(changeForm);
+    worldState.RequestSave(changeForm);
+    changeFormJournal->Append(changeForm);
+  }
+
+  worldState.AttachChangeFormJournal(changeFormJournal);
 
   pImpl->logger->info("AttachSaveStorage took {} ticks, loaded {} ChangeForms "
-                      "(Including {} player characters)",
-                      clock() - was, n, numPlayerCharacters);
+                      "(Including {} player characters, {} from journal), "
+                      "{} ChangeForms will be loaded on demand",
+                      clock() - was, n, numPlayerCharacters,
+                      journaled.size(),
+                      worldState.GetNumUnloadedChangeForms());
 }
 
 espm::Loader& PartOne::GetEspm() const
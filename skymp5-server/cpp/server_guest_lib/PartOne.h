@@ -19,6 +19,7 @@
 using ProfileId = int32_t;
 
 class IActionListener;
+class ChangeFormJournal;
 struct HitData;
 
 class PartOne
@@ -65,7 +66,11 @@ public:
   void SetEnabled(uint32_t actorFormId, bool enabled);
 
   void AttachEspm(espm::Loader* espm);
-  void AttachSaveStorage(std::shared_ptr<ISaveStorage> saveStorage);
+  // Change forms from the journal replace ones from the save storage and are
+  // saved again
+  void AttachSaveStorage(
+    std::shared_ptr<ISaveStorage> saveStorage,
+    std::shared_ptr<ChangeFormJournal> changeFormJournal = nullptr);
   espm::Loader& GetEspm() const;
   bool HasEspm() const;
   void AttachLogger(std::shared_ptr<spdlog::logger> logger);
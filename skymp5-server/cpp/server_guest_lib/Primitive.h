@@ -10,7 +10,8 @@ class Primitive
 public:
   static std::vector<NiPoint3> GetVertices(NiPoint3 pos, NiPoint3 rotRad,
                                            NiPoint3 boundsDiv2);
-  static std::vector<NiPoint3> GetVertices(const espm::REFR* refr);
+  static std::vector<NiPoint3> GetVertices(
+    const espm::REFR* refr, espm::CompressedFieldsCache& cache);
   static GeoProc::GeoPolygonProc CreateGeoPolygonProc(
     const std::vector<NiPoint3>& vertices);
   static bool IsInside(const NiPoint3& point,
@@ -0,0 +1,217 @@
+#include "SaveScheduler.h"
+
+struct SaveScheduler::Budget
+{
+  size_t records = 0;
+  size_t bytes = 0;
+};
+
+SaveScheduler::SaveScheduler() = default;
+
+SaveScheduler::SaveScheduler(const Settings& settings_)
+  : settings(settings_)
+{
+}
+
+void SaveScheduler::SetSettings(const Settings& settings_)
+{
+  settings = settings_;
+}
+
+const SaveScheduler::Settings& SaveScheduler::GetSettings() const noexcept
+{
+  return settings;
+}
+
+void SaveScheduler::Push(uint32_t formId, const MpChangeForm& changeForm,
+                         ChangeFormFieldMask changedFields, Priority priority,
+                         const Clock::time_point& now)
+{
+  auto it = entries.find(formId);
+  if (it == entries.end()) {
+    Entry entry;
+    entry.changeForm = changeForm;
+    entry.changedFields = changedFields;
+    entry.priority = priority;
+    entry.firstRequestMoment = now;
+    entry.estimatedSize = EstimateSize(changeForm);
+    it = entries.insert({ formId, std::move(entry) }).first;
+    Enqueue(formId, it->second);
+    return;
+  }
+
+  auto& entry = it->second;
+  entry.changeForm = changeForm;
+  entry.changedFields |= changedFields;
+  entry.estimatedSize = EstimateSize(changeForm);
+
+  // A reference may only be promoted, i.e. a container turned into something
+  // else must not lose its place in the queue
+  if (static_cast<size_t>(priority) < static_cast<size_t>(entry.priority)) {
+    queues[static_cast<size_t>(entry.priority)].erase(entry.queueIt);
+    entry.priority = priority;
+    Enqueue(formId, entry);
+  }
+}
+
+bool SaveScheduler::Erase(uint32_t formId)
+{
+  auto it = entries.find(formId);
+  if (it == entries.end()) {
+    return false;
+  }
+  queues[static_cast<size_t>(it->second.priority)].erase(it->second.queueIt);
+  entries.erase(it);
+  return true;
+}
+
+bool SaveScheduler::IsPending(uint32_t formId) const
+{
+  return entries.count(formId) > 0;
+}
+
+size_t SaveScheduler::GetNumPending() const noexcept
+{
+  return entries.size();
+}
+
+bool SaveScheduler::Empty() const noexcept
+{
+  return entries.empty();
+}
+
+SaveScheduler::Batch SaveScheduler::PopBatch(const Clock::time_point& now)
+{
+  Batch res;
+
+  if (entries.empty()) {
+    return res;
+  }
+
+  if (lastBatchMoment &&
+      now - *lastBatchMoment < settings.minBatchInterval) {
+    return res;
+  }
+
+  Budget budget;
+
+  // Stale change forms first, then everything else in order of priority
+  for (size_t i = 0; i < kNumPriorities; ++i) {
+    auto priority = static_cast<Priority>(i);
+    while (!queues[i].empty()) {
+      auto& entry = entries.at(queues[i].front());
+      if (now - entry.firstRequestMoment < settings.maxStaleness[i]) {
+        break;
+      }
+      if (!TakeFront(priority, budget, res)) {
+        break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < kNumPriorities; ++i) {
+    auto priority = static_cast<Priority>(i);
+    while (!queues[i].empty() && TakeFront(priority, budget, res)) {
+    }
+  }
+
+  lastBatchMoment = now;
+  return res;
+}
+
+void SaveScheduler::Restore(const Batch& batch)
+{
+  for (size_t i = 0; i < batch.formIds.size(); ++i) {
+    const auto formId = batch.formIds[i];
+    const auto& firstRequestMoment = batch.firstRequestMoments[i];
+    auto it = entries.find(formId);
+    if (it == entries.end()) {
+      Push(formId, batch.changeForms[i], batch.changedFields[i],
+           batch.priorities[i], firstRequestMoment);
+      continue;
+    }
+
+    auto& entry = it->second;
+    entry.changedFields |= batch.changedFields[i];
+    if (firstRequestMoment < entry.firstRequestMoment) {
+      queues[static_cast<size_t>(entry.priority)].erase(entry.queueIt);
+      entry.firstRequestMoment = firstRequestMoment;
+      Enqueue(formId, entry);
+    }
+  }
+}
+
+bool SaveScheduler::TakeFront(Priority priority, Budget& budget, Batch& out)
+{
+  auto& queue = queues[static_cast<size_t>(priority)];
+  auto it = entries.find(queue.front());
+  auto& entry = it->second;
+
+  // The first change form is always taken, otherwise a change form bigger
+  // than the whole budget would never be saved
+  if (budget.records > 0) {
+    if (settings.maxRecordsPerBatch &&
+        budget.records + 1 > settings.maxRecordsPerBatch) {
+      return false;
+    }
+    if (settings.maxBytesPerBatch &&
+        budget.bytes + entry.estimatedSize > settings.maxBytesPerBatch) {
+      return false;
+    }
+  }
+
+  budget.records++;
+  budget.bytes += entry.estimatedSize;
+
+  out.changeForms.push_back(std::move(entry.changeForm));
+  out.changedFields.push_back(entry.changedFields);
+  out.formIds.push_back(it->first);
+  out.priorities.push_back(priority);
+  out.firstRequestMoments.push_back(entry.firstRequestMoment);
+  queue.pop_front();
+  entries.erase(it);
+  return true;
+}
+
+void SaveScheduler::Enqueue(uint32_t formId, Entry& entry)
+{
+  // Usually the newest entry, so searching from the end
+  auto& queue = queues[static_cast<size_t>(entry.priority)];
+  auto pos = queue.end();
+  while (pos != queue.begin()) {
+    auto prev = std::prev(pos);
+    if (entries.at(*prev).firstRequestMoment <= entry.firstRequestMoment) {
+      break;
+    }
+    pos = prev;
+  }
+  entry.queueIt = queue.insert(pos, formId);
+}
+
+SaveScheduler::Priority SaveScheduler::Classify(
+  const MpChangeForm& changeForm, const std::string& baseType)
+{
+  if (changeForm.profileId >= 0) {
+    return Priority::PlayerCharacter;
+  }
+
+  if (changeForm.recType == MpChangeForm::ACHR || baseType == "CONT" ||
+      baseType == "DOOR" || baseType == "NPC_") {
+    return Priority::Interactive;
+  }
+
+  return Priority::Cosmetic;
+}
+
+size_t SaveScheduler::EstimateSize(const MpChangeForm& changeForm)
+{
+  // Fixed-size fields and formDesc strings of a typical json dump
+  constexpr size_t kBaseSize = 512;
+  constexpr size_t kInventoryEntrySize = 64;
+  constexpr size_t kDynamicFieldSize = 64;
+
+  return kBaseSize + changeForm.appearanceDump.size() +
+    changeForm.equipmentDump.size() +
+    changeForm.inv.entries.size() * kInventoryEntrySize +
+    changeForm.dynamicFields.GetAsJson().size() * kDynamicFieldSize;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "MpChangeForms.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Decides which pending change forms go to the next save batch. Player
+// characters go first, then interactive references (containers, doors,
+// actors), then everything else. A batch is limited by a record and byte
+// budget. Change forms pending for longer than 'maxStaleness' of their class
+// are flushed before anything else so that low priorities never starve.
+// Default settings disable all limits: everything pending is flushed at once.
+class SaveScheduler
+{
+public:
+  enum class Priority
+  {
+    PlayerCharacter = 0,
+    Interactive = 1,
+    Cosmetic = 2
+  };
+
+  static constexpr size_t kNumPriorities = 3;
+
+  using Clock = std::chrono::system_clock;
+
+  struct Settings
+  {
+    // 0 means unlimited
+    size_t maxRecordsPerBatch = 0;
+
+    // 0 means unlimited. Bytes are estimated, see EstimateSize
+    size_t maxBytesPerBatch = 0;
+
+    // Minimum time between two batches
+    Clock::duration minBatchInterval = Clock::duration::zero();
+
+    // Indexed by Priority
+    std::array<Clock::duration, kNumPriorities> maxStaleness = {
+      std::chrono::seconds(1), std::chrono::seconds(10),
+      std::chrono::seconds(60)
+    };
+  };
+
+  SaveScheduler();
+  explicit SaveScheduler(const Settings& settings);
+
+  void SetSettings(const Settings& settings);
+  const Settings& GetSettings() const noexcept;
+
+  struct Batch
+  {
+    std::vector<MpChangeForm> changeForms;
+
+    // ChangeFormField masks, one per change form
+    std::vector<ChangeFormFieldMask> changedFields;
+
+    // Needed to put the batch back, see Restore
+    std::vector<uint32_t> formIds;
+    std::vector<Priority> priorities;
+    std::vector<Clock::time_point> firstRequestMoments;
+  };
+
+  // Replaces the pending change form if any, changed fields are merged.
+  // Staleness is measured from the first request that is not saved yet
+  void Push(uint32_t formId, const MpChangeForm& changeForm,
+            ChangeFormFieldMask changedFields, Priority priority,
+            const Clock::time_point& now);
+
+  bool Erase(uint32_t formId);
+  bool IsPending(uint32_t formId) const;
+  size_t GetNumPending() const noexcept;
+  bool Empty() const noexcept;
+
+  // Returns an empty batch if 'minBatchInterval' hasn't passed yet
+  Batch PopBatch(const Clock::time_point& now);
+
+  // Puts a batch that failed to save back. Change forms pushed after the
+  // batch was popped are newer and kept, only changed fields are merged.
+  // Staleness is still measured from the first request, so failing saves
+  // don't postpone stale change forms
+  void Restore(const Batch& batch);
+
+  static Priority Classify(const MpChangeForm& changeForm,
+                           const std::string& baseType);
+
+  // Cheap approximation of the serialized change form size. We do not want to
+  // serialize change forms on the game thread just to measure them
+  static size_t EstimateSize(const MpChangeForm& changeForm);
+
+private:
+  struct Entry
+  {
+    MpChangeForm changeForm;
+    ChangeFormFieldMask changedFields = 0;
+    Priority priority = Priority::Cosmetic;
+    Clock::time_point firstRequestMoment;
+    size_t estimatedSize = 0;
+    std::list<uint32_t>::iterator queueIt;
+  };
+
+  struct Budget;
+
+  bool TakeFront(Priority priority, Budget& budget, Batch& out);
+
+  // Inserts the entry into the queue of its priority ordered by first request
+  // moment. The entry must not be in a queue
+  void Enqueue(uint32_t formId, Entry& entry);
+
+  Settings settings;
+  std::unordered_map<uint32_t, Entry> entries;
+
+  // Form ids in order of first request, one queue per priority
+  std::array<std::list<uint32_t>, kNumPriorities> queues;
+
+  std::optional<Clock::time_point> lastBatchMoment;
+};
@@ -147,11 +147,12 @@ void ScriptVariablesHolder::CastProperty(const espm::CombineBrowser& br,
   if (prop.propertyType >= espm::PropertyType::ObjectArray &&
       prop.propertyType <= espm::PropertyType::BoolArray) {
     VarValue v(static_cast<uint8_t>(prop.propertyType));
-    v.pArray.reset(new std::vector<VarValue>);
+    std::vector<VarValue> elements;
     for (auto& entry : prop.array) {
-      v.pArray->push_back(CastPrimitivePropertyValue(
+      elements.push_back(CastPrimitivePropertyValue(
         br, *scriptsCache, entry, GetElementType(prop.propertyType)));
     }
+    v.SetArray(std::move(elements));
     *out = v;
     return;
   }
@@ -1,12 +1,17 @@
 #include "WorldState.h"
+#include "ChangeFormJournal.h"
+#include "ChunkReferenceIndex.h"
+#include "FindRecipe.h"
 #include "FormCallbacks.h"
 #include "GroupUtils.h"
 #include "HeuristicPolicy.h"
+#include "LeveledListUtils.h"
 #include "ISaveStorage.h"
 #include "MpActor.h"
 #include "MpChangeForms.h"
 #include "MpFormGameObject.h"
 #include "MpObjectReference.h"
+#include "NavMeshIndex.h"
 #include "PapyrusActor.h"
 #include "PapyrusDebug.h"
 #include "PapyrusForm.h"
@@ -17,6 +22,7 @@
 #include "PapyrusSkymp.h"
 #include "PapyrusUtility.h"
 #include "Reader.h"
+#include "SaveScheduler.h"
 #include "ScopedTask.h"
 #include "ScriptStorage.h"
 #include "Timer.h"
@@ -41,20 +47,35 @@ inline NiPoint3 GetRot(const espm::REFR::LocationalData* locationalData)
 
 struct WorldState::Impl
 {
-  std::unordered_map<uint32_t, MpChangeForm> changes;
+  SaveScheduler saveScheduler;
   std::shared_ptr<ISaveStorage> saveStorage;
+  std::shared_ptr<ChangeFormJournal> changeFormJournal;
   std::shared_ptr<IScriptStorage> scriptStorage;
   bool saveStorageBusy = false;
+
+  // Put back into the scheduler if the upsert fails
+  SaveScheduler::Batch batchInFlight;
   std::shared_ptr<VirtualMachine> vm;
   uint32_t nextId = 0xff000000;
   std::shared_ptr<HeuristicPolicy> policy;
   std::unordered_map<uint32_t, MpChangeForm> changeFormsForDeferredLoad;
+
+  // Change forms that are in the save storage but not loaded yet
+  using ChunkKey = std::tuple<uint32_t, int16_t, int16_t>;
+  bool loadChangeFormsOnDemand = false;
+  std::map<ChunkKey, std::vector<uint32_t>> unloadedChangeFormsByChunk;
+  std::unordered_map<uint32_t, ChunkKey> unloadedChangeForms;
   bool chunkLoadingInProgress = false;
   bool formLoadingInProgress = false;
   std::map<std::string, std::chrono::system_clock::duration>
     relootTimeForTypes;
   std::vector<std::unique_ptr<IPapyrusClassBase>> classes;
   Viet::Timer timer;
+  std::unique_ptr<RecipeIndex> recipeIndex;
+  std::unique_ptr<LeveledListUtils::CompiledLists> leveledLists;
+  std::unique_ptr<NavMeshIndex> navMeshIndex;
+  std::unique_ptr<ChunkReferenceIndex> chunkReferenceIndex;
+  bool navMeshValidationEnabled = false;
 };
 
 WorldState::WorldState()
@@ -77,8 +98,13 @@ void WorldState::AttachEspm(espm::Loader* espm_,
 {
   espm = espm_;
   formCallbacksFactory = formCallbacksFactory_;
-  espmCache.reset(new espm::CompressedFieldsCache);
+  espmCache.reset(
+    new espm::CompressedFieldsCache(0, &espm->GetBrowser().GetCache()));
   espmFiles = espm->GetFileNames();
+  pImpl->recipeIndex.reset();
+  pImpl->leveledLists.reset();
+  pImpl->navMeshIndex.reset();
+  pImpl->chunkReferenceIndex.reset();
 }
 
 void WorldState::AttachSaveStorage(std::shared_ptr<ISaveStorage> saveStorage)
@@ -86,6 +112,12 @@ void WorldState::AttachSaveStorage(std::shared_ptr<ISaveStorage> saveStorage)
   pImpl->saveStorage = saveStorage;
 }
 
+void WorldState::AttachChangeFormJournal(
+  std::shared_ptr<ChangeFormJournal> changeFormJournal)
+{
+  pImpl->changeFormJournal = changeFormJournal;
+}
+
 void WorldState::AttachScriptStorage(
   std::shared_ptr<IScriptStorage> scriptStorage)
 {
@@ -136,6 +168,12 @@ void WorldState::Tick()
   TickReloot(now);
   TickSaveStorage(now);
   TickTimers(now);
+
+  // Nothing uses fields of records loaded during the previous ticks
+  if (espm) {
+    espmCache->ReleaseEvicted();
+    espm->GetBrowser().GetCache().ReleaseEvicted();
+  }
 }
 
 void WorldState::LoadChangeForm(const MpChangeForm& changeForm,
@@ -196,10 +234,10 @@ void WorldState::LoadChangeForm(const MpChangeForm& changeForm,
   // https://github.com/skyrim-multiplayer/issue-tracker/issues/64
 
   // So we expect that RequestSave does nothing in this case:
-  assert(pImpl->changes.count(formId) == 0);
+  assert(!pImpl->saveScheduler.IsPending(formId));
 
   // For Release configuration we just manually remove formId from changes
-  pImpl->changes.erase(formId);
+  pImpl->saveScheduler.Erase(formId);
 }
 
 void WorldState::RequestReloot(MpObjectReference& ref,
@@ -212,10 +250,25 @@ void WorldState::RequestReloot(MpObjectReference& ref,
 void WorldState::RequestSave(MpObjectReference& ref)
 {
   if (!pImpl->formLoadingInProgress) {
-    pImpl->changes[ref.GetFormId()] = ref.GetChangeForm();
+    auto changeForm = ref.GetChangeForm();
+    auto changedFields = ref.TakeChangedFields();
+    auto priority = SaveScheduler::Classify(changeForm, ref.GetBaseType());
+    pImpl->saveScheduler.Push(ref.GetFormId(), changeForm, changedFields,
+                              priority, std::chrono::system_clock::now());
+    if (pImpl->changeFormJournal) {
+      pImpl->changeFormJournal->Append(changeForm);
+    }
   }
 }
 
+void WorldState::RequestSave(const MpChangeForm& changeForm)
+{
+  auto priority = SaveScheduler::Classify(changeForm, "");
+  pImpl->saveScheduler.Push(changeForm.formDesc.ToFormId(espmFiles),
+                            changeForm, ChangeFormField::All, priority,
+                            std::chrono::system_clock::now());
+}
+
 void WorldState::RegisterForSingleUpdate(const VarValue& self, float seconds)
 {
   SetTimer(seconds).Then([self](Viet::Void) {
@@ -240,6 +293,14 @@ const std::shared_ptr<MpForm>& WorldState::LookupFormById(uint32_t formId)
         it = forms.find(formId);
         return it == forms.end() ? kNullForm : it->second;
       }
+    } else if (!pImpl->formLoadingInProgress) {
+      auto unloadedIt = pImpl->unloadedChangeForms.find(formId);
+      if (unloadedIt != pImpl->unloadedChangeForms.end()) {
+        auto [cellOrWorld, cellX, cellY] = unloadedIt->second;
+        LoadChunkChangeForms(cellOrWorld, cellX, cellY);
+        it = forms.find(formId);
+        return it == forms.end() ? kNullForm : it->second;
+      }
     }
     return kNullForm;
   }
@@ -262,12 +323,7 @@ bool WorldState::AttachEspmRecord(const espm::CombineBrowser& br,
   }
 
   espm::Type t = base.rec->GetType();
-  if (t != "NPC_" && t != "FURN" && t != "ACTI" && !espm::IsItem(t) &&
-      t != "DOOR" && t != "CONT" &&
-      (t != "FLOR" ||
-       !reinterpret_cast<espm::FLOR*>(base.rec)->GetData(cache).resultItem) &&
-      (t != "TREE" ||
-       !reinterpret_cast<espm::TREE*>(base.rec)->GetData(cache).resultItem))
+  if (!IsLoadableReferenceBase(base.rec, cache))
     return false;
 
   // TODO: Load disabled references
@@ -381,7 +437,8 @@ void WorldState::TickReloot(const std::chrono::system_clock::time_point& now)
   }
 }
 
-void WorldState::TickSaveStorage(const std::chrono::system_clock::time_point&)
+void WorldState::TickSaveStorage(
+  const std::chrono::system_clock::time_point& now)
 {
   if (!pImpl->saveStorage) {
     return;
@@ -389,19 +446,40 @@ void WorldState::TickSaveStorage(const std::chrono::system_clock::time_point&)
 
   pImpl->saveStorage->Tick();
 
-  auto& changes = pImpl->changes;
-  if (!pImpl->saveStorageBusy && !changes.empty()) {
+  auto& saveScheduler = pImpl->saveScheduler;
+
+  if (!pImpl->saveStorageBusy && !saveScheduler.Empty()) {
+    auto batch = saveScheduler.PopBatch(now);
+    if (batch.changeForms.empty()) {
+      return;
+    }
     pImpl->saveStorageBusy = true;
-    std::vector<MpChangeForm> changeForms;
-    changeForms.reserve(changes.size());
-    for (auto [formId, changeForm] : changes) {
-      changeForms.push_back(changeForm);
+    pImpl->batchInFlight = std::move(batch);
+
+    // The batch contains the latest versions of change forms appended to the
+    // journal so far
+    uint64_t journalSegment = 0;
+    if (pImpl->changeFormJournal) {
+      journalSegment = pImpl->changeFormJournal->Rotate();
     }
-    changes.clear();
 
     auto pImpl_ = pImpl;
-    pImpl->saveStorage->Upsert(changeForms,
-                               [pImpl_] { pImpl_->saveStorageBusy = false; });
+    auto& inFlight = pImpl->batchInFlight;
+    pImpl->saveStorage->Upsert(
+      inFlight.changeForms, inFlight.changedFields,
+      [pImpl_, journalSegment] {
+        pImpl_->saveStorageBusy = false;
+        if (pImpl_->changeFormJournal) {
+          pImpl_->changeFormJournal->MarkSaved(
+            pImpl_->batchInFlight.changeForms, journalSegment);
+        }
+        pImpl_->batchInFlight = SaveScheduler::Batch();
+      },
+      [pImpl_] {
+        pImpl_->saveStorageBusy = false;
+        pImpl_->saveScheduler.Restore(pImpl_->batchInFlight);
+        pImpl_->batchInFlight = SaveScheduler::Batch();
+      });
   }
 }
 
@@ -426,26 +504,26 @@ void WorldState::SendPapyrusEvent(MpForm* form, const char* eventName,
 const std::set<MpObjectReference*>& WorldState::GetReferencesAtPosition(
   uint32_t cellOrWorld, int16_t cellX, int16_t cellY)
 {
-  if (espm && !pImpl->chunkLoadingInProgress) {
+  const bool hasUnloadedChangeForms =
+    !pImpl->unloadedChangeFormsByChunk.empty();
+
+  if ((espm || hasUnloadedChangeForms) && !pImpl->chunkLoadingInProgress) {
     Viet::ScopedTask<bool> task([](bool& st) { st = false; },
                                 pImpl->chunkLoadingInProgress);
     pImpl->chunkLoadingInProgress = true;
 
-    auto& br = espm->GetBrowser();
     for (int16_t x = cellX - 1; x <= cellX + 1; ++x) {
       for (int16_t y = cellY - 1; y <= cellY + 1; ++y) {
         const bool loaded = grids[cellOrWorld].loadedChunks[x][y];
         if (!loaded) {
-          for (size_t i = 0; i < espmFiles.size(); ++i) {
-            auto combMapping = br.GetCombMapping(i);
-            auto rawMapping = br.GetRawMapping(i);
-            uint32_t mappedCellOrWorld =
-              espm::GetMappedId(cellOrWorld, *rawMapping);
-            auto records = br.GetRecordsAtPos(mappedCellOrWorld, x, y);
-            for (auto rec : *records[i]) {
-              auto mappedId = espm::GetMappedId(rec->GetId(), *combMapping);
-              assert(mappedId < 0xff000000);
-              LoadForm(mappedId);
+          if (hasUnloadedChangeForms) {
+            LoadChunkChangeForms(cellOrWorld, x, y);
+          }
+          if (espm) {
+            for (auto formId : GetChunkReferenceIndex().GetReferencesAtPos(
+                   cellOrWorld, x, y)) {
+              assert(formId < 0xff000000);
+              LoadForm(formId);
             }
           }
           // Do not keep "loaded" reference here since LoadForm would
@@ -496,6 +574,50 @@ espm::CompressedFieldsCache& WorldState::GetEspmCache()
   return *espmCache;
 }
 
+const RecipeIndex& WorldState::GetRecipeIndex()
+{
+  if (!pImpl->recipeIndex) {
+    pImpl->recipeIndex.reset(new RecipeIndex(GetEspm().GetBrowser()));
+  }
+  return *pImpl->recipeIndex;
+}
+
+LeveledListUtils::CompiledLists& WorldState::GetLeveledLists()
+{
+  if (!pImpl->leveledLists) {
+    pImpl->leveledLists.reset(
+      new LeveledListUtils::CompiledLists(GetEspm().GetBrowser()));
+  }
+  return *pImpl->leveledLists;
+}
+
+const NavMeshIndex& WorldState::GetNavMeshIndex()
+{
+  if (!pImpl->navMeshIndex) {
+    pImpl->navMeshIndex.reset(new NavMeshIndex(GetEspm().GetBrowser()));
+  }
+  return *pImpl->navMeshIndex;
+}
+
+const ChunkReferenceIndex& WorldState::GetChunkReferenceIndex()
+{
+  if (!pImpl->chunkReferenceIndex) {
+    pImpl->chunkReferenceIndex.reset(
+      new ChunkReferenceIndex(GetEspm().GetBrowser()));
+  }
+  return *pImpl->chunkReferenceIndex;
+}
+
+void WorldState::SetNavMeshValidationEnabled(bool enabled)
+{
+  pImpl->navMeshValidationEnabled = enabled;
+}
+
+bool WorldState::IsNavMeshValidationEnabled() const noexcept
+{
+  return pImpl->navMeshValidationEnabled;
+}
+
 IScriptStorage* WorldState::GetScriptStorage() const
 {
   return pImpl->scriptStorage.get();
@@ -629,7 +751,9 @@ const std::set<uint32_t>& WorldState::GetActorsByProfileId(
 
 uint32_t WorldState::GenerateFormId()
 {
-  while (LookupFormById(pImpl->nextId)) {
+  // Checking unloaded change forms first, we don't want to load them here
+  while (pImpl->unloadedChangeForms.count(pImpl->nextId) ||
+         LookupFormById(pImpl->nextId)) {
     ++pImpl->nextId;
   }
   return pImpl->nextId++;
@@ -641,6 +765,75 @@ void WorldState::SetRelootTime(std::string recordType,
   pImpl->relootTimeForTypes[recordType] = dur;
 }
 
+void WorldState::SetSaveSchedulerSettings(
+  const SaveScheduler::Settings& settings)
+{
+  pImpl->saveScheduler.SetSettings(settings);
+}
+
+size_t WorldState::GetNumPendingChangeForms() const
+{
+  return pImpl->saveScheduler.GetNumPending();
+}
+
+void WorldState::SetLoadChangeFormsOnDemand(bool enabled)
+{
+  pImpl->loadChangeFormsOnDemand = enabled;
+}
+
+bool WorldState::IsLoadingChangeFormsOnDemand() const
+{
+  return pImpl->loadChangeFormsOnDemand;
+}
+
+void WorldState::AddUnloadedChangeForm(const FormDesc& formDesc,
+                                       const FormDesc& worldOrCellDesc,
+                                       const NiPoint3& position)
+{
+  auto formId = formDesc.ToFormId(espmFiles);
+  auto gridPos = MpObjectReference::GetGridPos(position);
+  Impl::ChunkKey key(worldOrCellDesc.ToFormId(espmFiles), gridPos.first,
+                     gridPos.second);
+
+  if (pImpl->unloadedChangeForms.emplace(formId, key).second) {
+    pImpl->unloadedChangeFormsByChunk[key].push_back(formId);
+  }
+}
+
+size_t WorldState::GetNumUnloadedChangeForms() const
+{
+  return pImpl->unloadedChangeForms.size();
+}
+
+void WorldState::LoadChunkChangeForms(uint32_t cellOrWorld, int16_t cellX,
+                                      int16_t cellY)
+{
+  auto it = pImpl->unloadedChangeFormsByChunk.find(
+    Impl::ChunkKey(cellOrWorld, cellX, cellY));
+  if (it == pImpl->unloadedChangeFormsByChunk.end()) {
+    return;
+  }
+
+  std::vector<FormDesc> formDescs;
+  formDescs.reserve(it->second.size());
+  for (auto formId : it->second) {
+    pImpl->unloadedChangeForms.erase(formId);
+    formDescs.push_back(FormDesc::FromFormId(formId, espmFiles));
+  }
+  pImpl->unloadedChangeFormsByChunk.erase(it);
+
+  if (!pImpl->saveStorage) {
+    return;
+  }
+
+  auto callbacks =
+    formCallbacksFactory ? formCallbacksFactory() : FormCallbacks::DoNothing();
+  pImpl->saveStorage->IterateByFormDescsSync(
+    formDescs, [&](const MpChangeForm& changeForm) {
+      LoadChangeForm(changeForm, callbacks);
+    });
+}
+
 std::optional<std::chrono::system_clock::duration> WorldState::GetRelootTime(
   std::string recordType) const
 {
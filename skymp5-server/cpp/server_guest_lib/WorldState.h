@@ -6,6 +6,7 @@
 #include "MpObjectReference.h"
 #include "NiPoint3.h"
 #include "PartOneListener.h"
+#include "SaveScheduler.h"
 #include "VirtualMachine.h"
 #include <Loader.h>
 #include <MakeID.h>
@@ -29,7 +30,15 @@ class MpActor;
 class FormCallbacks;
 class MpChangeForm;
 class ISaveStorage;
+class ChangeFormJournal;
 class IScriptStorage;
+class RecipeIndex;
+class NavMeshIndex;
+class ChunkReferenceIndex;
+
+namespace LeveledListUtils {
+class CompiledLists;
+}
 
 class WorldState
 {
@@ -48,6 +57,8 @@ public:
   void AttachEspm(espm::Loader* espm,
                   const FormCallbacksFactory& formCallbacksFactory);
   void AttachSaveStorage(std::shared_ptr<ISaveStorage> saveStorage);
+  void AttachChangeFormJournal(
+    std::shared_ptr<ChangeFormJournal> changeFormJournal);
   void AttachScriptStorage(std::shared_ptr<IScriptStorage> scriptStorage);
 
   void AddForm(std::unique_ptr<MpForm> form, uint32_t formId,
@@ -64,6 +75,10 @@ public:
 
   void RequestSave(MpObjectReference& ref);
 
+  // For change forms that may be not loaded as references, i.e. replayed
+  // from ChangeFormJournal
+  void RequestSave(const MpChangeForm& changeForm);
+
   void RegisterForSingleUpdate(const VarValue& self, float seconds);
 
   Viet::Promise<Viet::Void> SetTimer(float seconds);
@@ -146,6 +161,16 @@ public:
   espm::Loader& GetEspm() const;
   bool HasEspm() const;
   espm::CompressedFieldsCache& GetEspmCache();
+
+  // Built on the first call after AttachEspm
+  const RecipeIndex& GetRecipeIndex();
+  LeveledListUtils::CompiledLists& GetLeveledLists();
+  const NavMeshIndex& GetNavMeshIndex();
+  const ChunkReferenceIndex& GetChunkReferenceIndex();
+
+  // Movement far from navmeshes is rejected if enabled. Disabled by default
+  void SetNavMeshValidationEnabled(bool enabled);
+  bool IsNavMeshValidationEnabled() const noexcept;
   IScriptStorage* GetScriptStorage() const;
   VirtualMachine& GetPapyrusVm();
   const std::set<uint32_t>& GetActorsByProfileId(int32_t profileId) const;
@@ -154,6 +179,19 @@ public:
                      std::chrono::system_clock::duration dur);
   std::optional<std::chrono::system_clock::duration> GetRelootTime(
     std::string recordType) const;
+  void SetSaveSchedulerSettings(const SaveScheduler::Settings& settings);
+  size_t GetNumPendingChangeForms() const;
+
+  // If enabled, PartOne::AttachSaveStorage loads only player characters and
+  // ESM references with change forms. Other change forms are registered with
+  // AddUnloadedChangeForm and loaded from the save storage when their chunk
+  // is loaded or when they're looked up by id
+  void SetLoadChangeFormsOnDemand(bool enabled);
+  bool IsLoadingChangeFormsOnDemand() const;
+  void AddUnloadedChangeForm(const FormDesc& formDesc,
+                             const FormDesc& worldOrCellDesc,
+                             const NiPoint3& position);
+  size_t GetNumUnloadedChangeForms() const;
 
   std::vector<std::string> espmFiles;
   std::unordered_map<int32_t, std::set<uint32_t>> actorIdByProfileId;
@@ -195,6 +233,9 @@ private:
 
   bool LoadForm(uint32_t formId);
 
+  void LoadChunkChangeForms(uint32_t cellOrWorld, int16_t cellX,
+                            int16_t cellY);
+
   void TickReloot(const std::chrono::system_clock::time_point& now);
   void TickSaveStorage(const std::chrono::system_clock::time_point& now);
   void TickTimers(const std::chrono::system_clock::time_point& now);
@@ -49,7 +49,8 @@ TES5DamageFormulaImpl::TES5DamageFormulaImpl(const MpActor& aggressor_,
 
 float TES5DamageFormulaImpl::GetBaseWeaponDamage() const
 {
-  auto weapData = espm::GetData<espm::WEAP>(hitData.source, espmProvider);
+  const auto& weapData =
+    espm::GetData<espm::WEAP>(hitData.source, espmProvider);
   if (!weapData.weapData) {
     throw std::runtime_error(
       fmt::format("no weapData for {:#x}", hitData.source));
@@ -82,13 +83,13 @@ float TES5DamageFormulaImpl::CalcArmorRatingComponent(
   if (opponentEquipmentEntry.extra.worn != Inventory::Worn::None &&
       espm::GetRecordType(opponentEquipmentEntry.baseId, espmProvider) ==
         espm::ARMO::kType) {
-    auto armorData =
+    const auto& armorData =
       espm::GetData<espm::ARMO>(opponentEquipmentEntry.baseId, espmProvider);
     // TODO(#458): take other components into account
     auto ac = static_cast<float>(armorData.baseRatingX100) / 100;
     if (armorData.enchantmentFormId) {
       // TODO(#632) refactor this effect with actor effect system
-      auto enchantmentData =
+      const auto& enchantmentData =
         espm::GetData<espm::ENCH>(armorData.enchantmentFormId, espmProvider);
       ac += CalcMagicEffects(enchantmentData.effects);
     }
@@ -1,13 +1,17 @@
 #include "FileInfo.h"
 
 #include <cassert>
+#include <filesystem>
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <stdexcept>
 #include <vector>
 
 #include <zlib.h>
 
-FileInfoResult FileInfo(const std::string& path)
+namespace {
+FileInfoResult CalculateFileInfo(const std::string& path)
 {
   const static size_t kBlockSize = 512 << 10;
   std::vector<char> buf(kBlockSize);
@@ -34,3 +38,41 @@ FileInfoResult FileInfo(const std::string& path)
 
   return { hash, size };
 }
+
+struct CachedFileInfo
+{
+  uintmax_t size = 0;
+  std::filesystem::file_time_type modificationTime;
+  FileInfoResult result;
+};
+
+std::mutex g_cacheMutex;
+std::map<std::string, CachedFileInfo> g_cache;
+}
+
+// Plugins are verified on every connection, so results are reused while the
+// file's size and modification time stay the same
+FileInfoResult FileInfo(const std::string& path)
+{
+  std::error_code sizeError, timeError;
+  const auto size = std::filesystem::file_size(path, sizeError);
+  const auto modificationTime =
+    std::filesystem::last_write_time(path, timeError);
+  const bool cacheable = !sizeError && !timeError;
+
+  if (cacheable) {
+    std::lock_guard l(g_cacheMutex);
+    auto it = g_cache.find(path);
+    if (it != g_cache.end() && it->second.size == size &&
+        it->second.modificationTime == modificationTime) {
+      return it->second.result;
+    }
+  }
+
+  const auto result = CalculateFileInfo(path);
+  if (cacheable) {
+    std::lock_guard l(g_cacheMutex);
+    g_cache[path] = { size, modificationTime, result };
+  }
+  return result;
+}
@@ -0,0 +1,134 @@
+#include "ChangeFormJournal.h"
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+std::string GetJournalPath()
+{
+  return (std::filesystem::temp_directory_path() / "skymp_journal_test" /
+          "journal.jsonl")
+    .string();
+}
+
+void RemoveJournal()
+{
+  std::filesystem::remove_all(std::filesystem::temp_directory_path() /
+                              "skymp_journal_test");
+}
+
+MpChangeForm MakeJournalChangeForm(uint32_t id, NiPoint3 pos = { 0, 0, 0 })
+{
+  MpChangeForm res;
+  res.formDesc = { id, "" };
+  res.position = pos;
+  return res;
+}
+
+std::vector<MpChangeForm> ReplayAll(const ChangeFormJournal& journal)
+{
+  std::vector<MpChangeForm> res;
+  journal.Replay(
+    [&](const MpChangeForm& changeForm) { res.push_back(changeForm); });
+  return res;
+}
+}
+
+TEST_CASE("ChangeFormJournal replays appended change forms after restart",
+          "[ChangeFormJournal]")
+{
+  RemoveJournal();
+
+  {
+    ChangeFormJournal journal(GetJournalPath());
+    journal.Append(MakeJournalChangeForm(1));
+    journal.Append(MakeJournalChangeForm(1, { 1, 2, 3 }));
+    journal.Sync();
+    journal.Rotate();
+    journal.Append(MakeJournalChangeForm(2));
+  }
+
+  ChangeFormJournal journal(GetJournalPath());
+  REQUIRE(journal.GetSegmentPaths().size() == 2);
+  REQUIRE(ReplayAll(journal) ==
+          std::vector<MpChangeForm>{ MakeJournalChangeForm(1),
+                                     MakeJournalChangeForm(1, { 1, 2, 3 }),
+                                     MakeJournalChangeForm(2) });
+}
+
+TEST_CASE("ChangeFormJournal deletes segments once change forms are saved",
+          "[ChangeFormJournal]")
+{
+  RemoveJournal();
+
+  ChangeFormJournal journal(GetJournalPath());
+  journal.Append(MakeJournalChangeForm(1));
+  journal.Append(MakeJournalChangeForm(2));
+  auto segment = journal.Rotate();
+  journal.Append(MakeJournalChangeForm(3));
+  journal.Sync();
+  REQUIRE(journal.GetSegmentPaths().size() == 2);
+
+  journal.MarkSaved({ MakeJournalChangeForm(1), MakeJournalChangeForm(2) },
+                    segment);
+  journal.Sync();
+
+  REQUIRE(journal.GetSegmentPaths().size() == 1);
+  REQUIRE(ReplayAll(journal) ==
+          std::vector<MpChangeForm>{ MakeJournalChangeForm(3) });
+}
+
+TEST_CASE("ChangeFormJournal keeps segments with unsaved change forms",
+          "[ChangeFormJournal]")
+{
+  RemoveJournal();
+
+  ChangeFormJournal journal(GetJournalPath());
+  journal.Append(MakeJournalChangeForm(1));
+  journal.Append(MakeJournalChangeForm(2));
+  auto segment = journal.Rotate();
+
+  // The batch with the first change form failed to save, the second one
+  // hasn't been sent yet
+  journal.Sync();
+  REQUIRE(ReplayAll(journal).size() == 2);
+
+  // Saved, but appended again after rotation
+  journal.Append(MakeJournalChangeForm(2, { 1, 2, 3 }));
+  journal.MarkSaved({ MakeJournalChangeForm(1), MakeJournalChangeForm(2) },
+                    segment);
+  journal.Sync();
+
+  REQUIRE(ReplayAll(journal) ==
+          std::vector<MpChangeForm>{ MakeJournalChangeForm(2, { 1, 2, 3 }) });
+
+  segment = journal.Rotate();
+  journal.MarkSaved({ MakeJournalChangeForm(2, { 1, 2, 3 }) }, segment);
+  journal.Sync();
+  REQUIRE(journal.GetSegmentPaths().empty());
+}
+
+TEST_CASE("ChangeFormJournal skips partially written records",
+          "[ChangeFormJournal]")
+{
+  RemoveJournal();
+
+  std::string segmentPath;
+  {
+    ChangeFormJournal journal(GetJournalPath());
+    journal.Append(MakeJournalChangeForm(1));
+    journal.Sync();
+    segmentPath = journal.GetSegmentPaths().at(0);
+  }
+  {
+    std::ofstream(segmentPath, std::ios::app) << R"({"formDesc":)";
+  }
+
+  ChangeFormJournal journal(GetJournalPath());
+  journal.Append(MakeJournalChangeForm(2));
+  journal.Sync();
+
+  REQUIRE(ReplayAll(journal) ==
+          std::vector<MpChangeForm>{ MakeJournalChangeForm(1),
+                                     MakeJournalChangeForm(2) });
+}
@@ -3,6 +3,8 @@
 
 #include "FindRecipe.h"
 #include "PacketParser.h"
+#include <chrono>
+#include <iostream>
 
 using Catch::Matchers::Contains;
 
@@ -152,14 +154,73 @@ TEST_CASE("DLC Hearthfires recipes are working", "[Craft][espm]")
 {
   PartOne& p = GetPartOne();
 
-  REQUIRE(RecipeMatches(p.GetEspm().GetBrowser().GetCombMapping(3),
+  auto& br = p.GetEspm().GetBrowser();
+  REQUIRE(RecipeMatches(br.GetCombMapping(3),
                         espm::Convert<espm::COBJ>(
-                          p.GetEspm().GetBrowser().LookupById(0x0300306d).rec),
-                        Inventory().AddItem(0x0005ACE4, 1),
-                        0x300300F) == true);
+                          br.LookupById(0x0300306d).rec),
+                        Inventory().AddItem(0x0005ACE4, 1), 0x300300F,
+                        br.GetCache()) == true);
 
   auto form = FindRecipe(p.GetEspm().GetBrowser(),
                          Inventory().AddItem(0x0005ACE4, 1), 0x300300F);
   REQUIRE(form);
   REQUIRE(form->GetId() == 0x0200306d);
 }
+
+TEST_CASE("RecipeIndex benchmark", "[Craft][espm][Benchmarks]")
+{
+  PartOne& p = GetPartOne();
+  auto& br = p.GetEspm().GetBrowser();
+
+  const std::vector<std::pair<Inventory, uint32_t>> requests = {
+    { Inventory().AddItem(0x5ace4, 1).AddItem(0x800e4, 3).AddItem(0x5ace5, 4),
+      0x1398a },
+    { Inventory().AddItem(0x0005ACE4, 1), 0x300300F },
+    { Inventory()
+        .AddItem(0x0005ACE4, 1)
+        .AddItem(0x0401CD7C, 2)
+        .AddItem(0x00034CDD, 10),
+      0x04037564 },
+    { Inventory().AddItem(0x5ace4, 1), 0xd8d4e }
+  };
+
+  auto was = std::chrono::steady_clock::now();
+  RecipeIndex index(br);
+  auto indexBuildTime = std::chrono::steady_clock::now() - was;
+
+  for (auto& [inputObjects, resultObjectId] : requests) {
+    int espmIdx = -1, espmIdxIndexed = -1;
+    REQUIRE(FindRecipe(br, inputObjects, resultObjectId, &espmIdx) ==
+            index.Find(inputObjects, resultObjectId, &espmIdxIndexed));
+    REQUIRE(espmIdx == espmIdxIndexed);
+  }
+
+  constexpr int kNumPasses = 100;
+  auto measure = [&](auto f) {
+    auto was = std::chrono::steady_clock::now();
+    for (int i = 0; i < kNumPasses; ++i) {
+      for (auto& [inputObjects, resultObjectId] : requests) {
+        f(inputObjects, resultObjectId);
+      }
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - was)
+      .count();
+  };
+
+  auto scan = measure([&](const Inventory& inputObjects, uint32_t id) {
+    return FindRecipe(br, inputObjects, id);
+  });
+  auto indexed = measure([&](const Inventory& inputObjects, uint32_t id) {
+    return index.Find(inputObjects, id);
+  });
+
+  std::cout << kNumPasses * requests.size()
+            << " recipe lookups: scanning took " << scan
+            << " microseconds, index took " << indexed
+            << " microseconds (built in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                 indexBuildTime)
+                 .count()
+            << " microseconds)" << std::endl;
+}
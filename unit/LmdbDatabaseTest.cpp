@@ -0,0 +1,114 @@
+#include "LmdbDatabase.h"
+#include "FileDatabase.h"
+#include "MigrationDatabase.h"
+#include "TestUtils.hpp"
+#include <catch2/catch.hpp>
+
+namespace {
+std::shared_ptr<IDatabase> MakeLmdbDatabase(const char* directory)
+{
+  if (std::filesystem::exists(directory)) {
+    std::filesystem::remove_all(directory);
+  }
+
+  // Tiny map size to exercise automatic growing
+  return std::make_shared<LmdbDatabase>(directory, spdlog::default_logger(),
+                                        64 * 1024);
+}
+
+MpChangeForm MakeLmdbChangeForm(const char* descStr,
+                                NiPoint3 pos = { 0, 0, 0 })
+{
+  MpChangeForm res;
+  res.formDesc = FormDesc::FromString(descStr);
+  res.position = pos;
+  return res;
+}
+
+std::vector<MpChangeForm> GetAllChangeFormsOrdered(
+  std::shared_ptr<IDatabase> db)
+{
+  std::vector<MpChangeForm> res;
+  db->Iterate(
+    [&](const MpChangeForm& changeForm) { res.push_back(changeForm); });
+  return res;
+}
+}
+
+TEST_CASE("LmdbDatabase upserts and iterates in FormDesc order",
+          "[LmdbDatabase]")
+{
+  auto db = MakeLmdbDatabase("unit/data/lmdb");
+
+  REQUIRE(db->Upsert({ MakeLmdbChangeForm("100"),
+                       MakeLmdbChangeForm("2:Skyrim.esm"),
+                       MakeLmdbChangeForm("2") }) == 3);
+  REQUIRE(db->Upsert({ MakeLmdbChangeForm("100", { 1, 2, 3 }) }) == 1);
+
+  auto all = GetAllChangeFormsOrdered(db);
+  REQUIRE(all.size() == 3);
+  REQUIRE(all[0].formDesc == FormDesc::FromString("2"));
+  REQUIRE(all[1].formDesc == FormDesc::FromString("2:Skyrim.esm"));
+  REQUIRE(all[2] == MakeLmdbChangeForm("100", { 1, 2, 3 }));
+}
+
+TEST_CASE("LmdbDatabase grows its map size", "[LmdbDatabase]")
+{
+  auto db = MakeLmdbDatabase("unit/data/lmdb");
+
+  std::vector<MpChangeForm> changeForms;
+  for (uint32_t i = 0; i < 2000; ++i) {
+    changeForms.push_back(MakeLmdbChangeForm("0"));
+    changeForms.back().formDesc.shortFormId = i;
+  }
+  REQUIRE(db->Upsert(changeForms) == changeForms.size());
+  REQUIRE(GetAllChangeFormsOrdered(db) == changeForms);
+}
+
+TEST_CASE("LmdbDatabase keeps data after reopening", "[LmdbDatabase]")
+{
+  MakeLmdbDatabase("unit/data/lmdb")->Upsert({ MakeLmdbChangeForm("1") });
+
+  auto db = std::make_shared<LmdbDatabase>("unit/data/lmdb",
+                                           spdlog::default_logger());
+  REQUIRE(GetAllChangeFormsOrdered(db) ==
+          std::vector<MpChangeForm>{ MakeLmdbChangeForm("1") });
+}
+
+TEST_CASE("Moves data from FileDatabase to LmdbDatabase", "[LmdbDatabase]")
+{
+  auto directory = "unit/data/file";
+  if (std::filesystem::exists(directory)) {
+    std::filesystem::remove_all(directory);
+  }
+  auto oldDatabase =
+    std::make_shared<FileDatabase>(directory, spdlog::default_logger());
+  oldDatabase->Upsert({ MakeLmdbChangeForm("0"), MakeLmdbChangeForm("1") });
+
+  auto newDatabase = MakeLmdbDatabase("unit/data/lmdb");
+  newDatabase->Upsert({ MakeLmdbChangeForm("1", { 1, 2, 3 }) });
+
+  auto db = std::make_shared<MigrationDatabase>(newDatabase, oldDatabase);
+
+  auto all = GetAllChangeFormsOrdered(db);
+  REQUIRE(std::set<MpChangeForm>(all.begin(), all.end()) ==
+          std::set<MpChangeForm>({ MakeLmdbChangeForm("0"),
+                                   MakeLmdbChangeForm("1", { 1, 2, 3 }) }));
+}
+
+TEST_CASE("LmdbDatabase finds change forms by FormDesc", "[LmdbDatabase]")
+{
+  auto db = MakeLmdbDatabase("unit/data/lmdb");
+  db->Upsert({ MakeLmdbChangeForm("1"), MakeLmdbChangeForm("2"),
+               MakeLmdbChangeForm("3") });
+
+  std::vector<MpChangeForm> found;
+  db->IterateByFormDescs(
+    { FormDesc::FromString("3"), FormDesc::FromString("4"),
+      FormDesc::FromString("1") },
+    [&](const MpChangeForm& changeForm) { found.push_back(changeForm); });
+
+  REQUIRE(found ==
+          std::vector<MpChangeForm>{ MakeLmdbChangeForm("3"),
+                                     MakeLmdbChangeForm("1") });
+}
@@ -50,3 +50,67 @@ TEST_CASE("Moves data from one database from another", "[MigrationDatabase]")
               CreateChangeForm_("2"), CreateChangeForm_("3"),
               CreateChangeForm_("4") }));
 }
+
+TEST_CASE("Copies data from one database to another in batches",
+          "[MigrationDatabase]")
+{
+  auto oldDatabase = MakeDatabase("unit/data/a");
+  oldDatabase->Upsert({ CreateChangeForm_("0"), CreateChangeForm_("1"),
+                        CreateChangeForm_("2"), CreateChangeForm_("3") });
+
+  auto newDatabase = MakeDatabase("unit/data/b");
+  newDatabase->Upsert({ CreateChangeForm_("0", { 1, 2, 3 }) });
+
+  std::vector<size_t> numCopied;
+  size_t numSkipped = 0;
+  auto db = std::make_shared<MigrationDatabase>(
+    newDatabase, oldDatabase, 2,
+    [&](const MigrationDatabase::Progress& progress) {
+      numCopied.push_back(progress.numCopied);
+      numSkipped = progress.numSkipped;
+    });
+
+  auto expected = std::set<MpChangeForm>(
+    { CreateChangeForm_("0", { 1, 2, 3 }), CreateChangeForm_("1"),
+      CreateChangeForm_("2"), CreateChangeForm_("3") });
+
+  REQUIRE(!db->IsBulkCopyFinished());
+  REQUIRE(GetAllChangeForms(db) == expected);
+  REQUIRE(db->IsBulkCopyFinished());
+  REQUIRE(numCopied == std::vector<size_t>{ 2, 3 });
+  REQUIRE(numSkipped == 1);
+  REQUIRE(GetAllChangeForms(newDatabase) == expected);
+
+  // The old database isn't read anymore
+  oldDatabase->Upsert({ CreateChangeForm_("4") });
+  REQUIRE(GetAllChangeForms(db) == expected);
+}
+
+TEST_CASE("Finished bulk copy isn't repeated after a restart",
+          "[MigrationDatabase]")
+{
+  auto oldDatabase = MakeDatabase("unit/data/a");
+  oldDatabase->Upsert({ CreateChangeForm_("0"), CreateChangeForm_("1") });
+
+  auto newDatabase = MakeDatabase("unit/data/b");
+  auto db = std::make_shared<MigrationDatabase>(newDatabase, oldDatabase, 2);
+  GetAllChangeForms(db);
+  REQUIRE(db->IsBulkCopyFinished());
+
+  // Restart with reopened databases
+  oldDatabase = std::make_shared<FileDatabase>("unit/data/a",
+                                               spdlog::default_logger());
+  newDatabase = std::make_shared<FileDatabase>("unit/data/b",
+                                               spdlog::default_logger());
+  oldDatabase->Upsert({ CreateChangeForm_("2") });
+
+  db = std::make_shared<MigrationDatabase>(newDatabase, oldDatabase, 2);
+  REQUIRE(db->IsBulkCopyFinished());
+  REQUIRE(GetAllChangeForms(db) ==
+          std::set<MpChangeForm>(
+            { CreateChangeForm_("0"), CreateChangeForm_("1") }));
+
+  // Without bulk copy enabled the old database isn't read either
+  db = std::make_shared<MigrationDatabase>(newDatabase, oldDatabase);
+  REQUIRE(GetAllChangeForms(db).size() == 2);
+}
@@ -0,0 +1,110 @@
+#include <catch2/catch.hpp>
+
+#include "DummyMessageOutput.h"
+#include "DummyWorldObject.h"
+#include "MovementValidation.h"
+#include "NavMeshIndex.h"
+
+namespace {
+constexpr uint32_t kWorld = 0x3c;
+constexpr uint32_t kCell = 0x1234;
+
+// 1000x1000 floor at z = 0 in the world and a ramp from z = 0 to z = 100 in
+// the cell with a ceiling at z = 300
+NavMeshIndex MakeNavMeshIndex()
+{
+  NavMeshIndex index;
+  index.AddTriangle(kWorld, { 0, 0, 0 }, { 1000, 0, 0 }, { 1000, 1000, 0 });
+  index.AddTriangle(kWorld, { 0, 0, 0 }, { 1000, 1000, 0 }, { 0, 1000, 0 });
+  index.AddTriangle(kCell, { 0, 0, 0 }, { 100, 0, 100 }, { 100, 100, 100 });
+  index.AddTriangle(kCell, { 0, 0, 300 }, { 100, 0, 300 },
+                    { 100, 100, 300 });
+  return index;
+}
+}
+
+TEST_CASE("NavMeshIndex finds heights of navmeshes", "[NavMeshIndex]")
+{
+  auto index = MakeNavMeshIndex();
+  REQUIRE(index.GetNumTriangles() == 4);
+  REQUIRE(index.HasNavMeshes(kWorld));
+  REQUIRE(!index.HasNavMeshes(0xdead));
+
+  REQUIRE(index.FindHeight(kWorld, { 500, 300, 10 }, 100) == 0.f);
+  REQUIRE(index.FindHeight(kWorld, { 500, 300, 10 }, 5) == std::nullopt);
+  REQUIRE(index.FindHeight(kWorld, { -1, 300, 0 }, 100) == std::nullopt);
+
+  // The surface closest to z is chosen
+  auto height = index.FindHeight(kCell, { 50, 25, 60 }, 1000);
+  REQUIRE(height);
+  REQUIRE(*height == Approx(50.f));
+  REQUIRE(index.FindHeight(kCell, { 50, 25, 250 }, 1000) == Approx(300.f));
+
+  REQUIRE(index.IsOnWalkableSurface(kWorld, { 999, 999, 20 }, 32));
+  REQUIRE(!index.IsOnWalkableSurface(kWorld, { 999, 999, 200 }, 32));
+  REQUIRE(!index.IsOnWalkableSurface(kCell, { 500, 500, 0 }, 32));
+}
+
+TEST_CASE("NavMeshIndex finds nearest points of navmeshes", "[NavMeshIndex]")
+{
+  auto index = MakeNavMeshIndex();
+
+  auto point = index.FindNearestPoint(kWorld, { 500, 500, 80 }, 100);
+  REQUIRE(point);
+  REQUIRE(*point == NiPoint3(500, 500, 0));
+
+  point = index.FindNearestPoint(kWorld, { 1030, -40, 0 }, 100);
+  REQUIRE(point);
+  REQUIRE(point->x == Approx(1000.f));
+  REQUIRE(point->y == Approx(0.f).margin(1e-3));
+
+  REQUIRE(index.FindNearestPoint(kWorld, { 1200, 500, 0 }, 100) ==
+          std::nullopt);
+  REQUIRE(index.FindNearestPoint(kCell, { 0, 0, 0 }, 100) ==
+          NiPoint3(0, 0, 0));
+
+  // Found several buckets away
+  point = index.FindNearestPoint(kWorld, { 2500, 500, 0 }, 2048);
+  REQUIRE(point);
+  REQUIRE(point->x == Approx(1000.f));
+  REQUIRE(point->y == Approx(500.f));
+}
+
+TEST_CASE("NavMeshIndex finds the nearest point in farther buckets",
+          "[NavMeshIndex]")
+{
+  NavMeshIndex index;
+
+  // The near triangle is in the bucket of the query point but far below it,
+  // the far one is in the neighbouring bucket at the same height
+  index.AddTriangle(kWorld, { 10, 10, -500 }, { 250, 10, -500 },
+                    { 10, 250, -500 });
+  index.AddTriangle(kWorld, { 300, 10, 0 }, { 500, 10, 0 }, { 300, 250, 0 });
+
+  auto point = index.FindNearestPoint(kWorld, { 250, 100, 0 }, 2048);
+  REQUIRE(point);
+  REQUIRE(*point == NiPoint3(300, 100, 0));
+}
+
+TEST_CASE("Movement far from navmeshes is rejected", "[MovementValidation]")
+{
+  auto index = MakeNavMeshIndex();
+  DummyWorldObject obj({ 500, 500, 0 }, { 0, 0, 0 }, FormDesc::Tamriel());
+  DummyMessageOutput messageOutput;
+
+  REQUIRE(MovementValidation::Validate(obj, { 1500, 500, 0 },
+                                       FormDesc::Tamriel(), messageOutput,
+                                       { "Skyrim.esm" }, &index));
+  REQUIRE(messageOutput.messages.empty());
+
+  REQUIRE(!MovementValidation::Validate(obj, { 500, 500, 3000 },
+                                        FormDesc::Tamriel(), messageOutput,
+                                        { "Skyrim.esm" }, &index));
+  REQUIRE(messageOutput.messages.size() == 1);
+
+  // No navmeshes to validate against
+  NavMeshIndex emptyIndex;
+  REQUIRE(MovementValidation::Validate(obj, { 500, 500, 3000 },
+                                       FormDesc::Tamriel(), messageOutput,
+                                       { "Skyrim.esm" }, &emptyIndex));
+}
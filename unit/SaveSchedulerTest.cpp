@@ -0,0 +1,212 @@
+#include "SaveScheduler.h"
+#include <catch2/catch.hpp>
+
+namespace {
+MpChangeForm MakeChangeForm(uint32_t id, int32_t profileId = -1)
+{
+  MpChangeForm res;
+  res.formDesc = { id, "" };
+  res.profileId = profileId;
+  return res;
+}
+
+std::vector<uint32_t> GetIds(const SaveScheduler::Batch& batch)
+{
+  std::vector<uint32_t> res;
+  for (auto& changeForm : batch.changeForms) {
+    res.push_back(changeForm.formDesc.shortFormId);
+  }
+  return res;
+}
+}
+
+TEST_CASE("SaveScheduler flushes everything with default settings",
+          "[SaveScheduler]")
+{
+  SaveScheduler scheduler;
+  auto now = std::chrono::system_clock::now();
+
+  scheduler.Push(1, MakeChangeForm(1), ChangeFormField::All,
+                 SaveScheduler::Priority::Cosmetic, now);
+  scheduler.Push(2, MakeChangeForm(2), ChangeFormField::All,
+                 SaveScheduler::Priority::Interactive, now);
+  scheduler.Push(1, MakeChangeForm(1), ChangeFormField::All,
+                 SaveScheduler::Priority::Cosmetic, now);
+
+  REQUIRE(scheduler.GetNumPending() == 2);
+  REQUIRE(GetIds(scheduler.PopBatch(now)) == std::vector<uint32_t>{ 2, 1 });
+  REQUIRE(scheduler.Empty());
+}
+
+TEST_CASE("SaveScheduler respects priorities and record budget",
+          "[SaveScheduler]")
+{
+  SaveScheduler::Settings settings;
+  settings.maxRecordsPerBatch = 2;
+  SaveScheduler scheduler(settings);
+  auto now = std::chrono::system_clock::now();
+
+  scheduler.Push(1, MakeChangeForm(1), ChangeFormField::All,
+                 SaveScheduler::Priority::Cosmetic, now);
+  scheduler.Push(2, MakeChangeForm(2), ChangeFormField::All,
+                 SaveScheduler::Priority::Interactive, now);
+  scheduler.Push(3, MakeChangeForm(3, 100), ChangeFormField::All,
+                 SaveScheduler::Priority::PlayerCharacter, now);
+
+  REQUIRE(GetIds(scheduler.PopBatch(now)) == std::vector<uint32_t>{ 3, 2 });
+  REQUIRE(GetIds(scheduler.PopBatch(now)) == std::vector<uint32_t>{ 1 });
+  REQUIRE(scheduler.Empty());
+}
+
+TEST_CASE("SaveScheduler flushes stale change forms first",
+          "[SaveScheduler]")
+{
+  SaveScheduler::Settings settings;
+  settings.maxRecordsPerBatch = 1;
+  settings.maxStaleness[static_cast<size_t>(
+    SaveScheduler::Priority::Cosmetic)] = std::chrono::seconds(5);
+  SaveScheduler scheduler(settings);
+  auto now = std::chrono::system_clock::now();
+
+  scheduler.Push(1, MakeChangeForm(1), ChangeFormField::All,
+                 SaveScheduler::Priority::Cosmetic, now);
+  scheduler.Push(2, MakeChangeForm(2), ChangeFormField::All,
+                 SaveScheduler::Priority::Interactive,
+                 now + std::chrono::seconds(6));
+
+  auto later = now + std::chrono::seconds(6);
+  REQUIRE(GetIds(scheduler.PopBatch(later)) == std::vector<uint32_t>{ 1 });
+  REQUIRE(GetIds(scheduler.PopBatch(later)) == std::vector<uint32_t>{ 2 });
+}
+
+TEST_CASE("SaveScheduler respects byte budget and batch interval",
+          "[SaveScheduler]")
+{
+  auto changeForm = MakeChangeForm(1);
+  auto size = SaveScheduler::EstimateSize(changeForm);
+
+  SaveScheduler::Settings settings;
+  settings.maxBytesPerBatch = size + size / 2;
+  settings.minBatchInterval = std::chrono::seconds(1);
+  SaveScheduler scheduler(settings);
+  auto now = std::chrono::system_clock::now();
+
+  for (uint32_t i = 1; i <= 3; ++i) {
+    scheduler.Push(i, MakeChangeForm(i), ChangeFormField::All,
+                   SaveScheduler::Priority::Cosmetic, now);
+  }
+
+  REQUIRE(GetIds(scheduler.PopBatch(now)) == std::vector<uint32_t>{ 1 });
+  REQUIRE(scheduler.PopBatch(now).changeForms.empty());
+
+  auto later = now + std::chrono::seconds(1);
+  REQUIRE(GetIds(scheduler.PopBatch(later)) == std::vector<uint32_t>{ 2 });
+}
+
+TEST_CASE("SaveScheduler classifies change forms", "[SaveScheduler]")
+{
+  REQUIRE(SaveScheduler::Classify(MakeChangeForm(1, 5), "NPC_") ==
+          SaveScheduler::Priority::PlayerCharacter);
+  REQUIRE(SaveScheduler::Classify(MakeChangeForm(1), "CONT") ==
+          SaveScheduler::Priority::Interactive);
+  REQUIRE(SaveScheduler::Classify(MakeChangeForm(1), "DOOR") ==
+          SaveScheduler::Priority::Interactive);
+  REQUIRE(SaveScheduler::Classify(MakeChangeForm(1), "FLOR") ==
+          SaveScheduler::Priority::Cosmetic);
+}
+
+TEST_CASE("SaveScheduler merges changed fields of pending change forms",
+          "[SaveScheduler]")
+{
+  SaveScheduler scheduler;
+  auto now = std::chrono::system_clock::now();
+
+  scheduler.Push(1, MakeChangeForm(1), ChangeFormField::Position,
+                 SaveScheduler::Priority::Cosmetic, now);
+  scheduler.Push(1, MakeChangeForm(1), ChangeFormField::Angle,
+                 SaveScheduler::Priority::Cosmetic, now);
+
+  auto batch = scheduler.PopBatch(now);
+  REQUIRE(batch.changedFields ==
+          std::vector<ChangeFormFieldMask>{ ChangeFormField::Position |
+                                            ChangeFormField::Angle });
+}
+
+TEST_CASE("SaveScheduler restores batches that failed to save",
+          "[SaveScheduler]")
+{
+  SaveScheduler scheduler;
+  auto now = std::chrono::system_clock::now();
+
+  scheduler.Push(1, MakeChangeForm(1), ChangeFormField::Position,
+                 SaveScheduler::Priority::Cosmetic, now);
+  scheduler.Push(2, MakeChangeForm(2), ChangeFormField::Inv,
+                 SaveScheduler::Priority::Interactive, now);
+  auto batch = scheduler.PopBatch(now);
+  REQUIRE(scheduler.Empty());
+
+  // Pushed while the batch is being saved
+  auto newer = MakeChangeForm(1);
+  newer.isDisabled = true;
+  scheduler.Push(1, newer, ChangeFormField::IsDisabled,
+                 SaveScheduler::Priority::Cosmetic, now);
+
+  scheduler.Restore(batch);
+  auto restored = scheduler.PopBatch(now);
+  REQUIRE(GetIds(restored) == std::vector<uint32_t>{ 2, 1 });
+  REQUIRE(restored.changedFields ==
+          std::vector<ChangeFormFieldMask>{
+            ChangeFormField::Inv,
+            ChangeFormField::Position | ChangeFormField::IsDisabled });
+  REQUIRE(restored.changeForms[1].isDisabled);
+}
+
+TEST_CASE("SaveScheduler keeps staleness of restored change forms",
+          "[SaveScheduler]")
+{
+  SaveScheduler::Settings settings;
+  settings.maxRecordsPerBatch = 1;
+  settings.maxStaleness[static_cast<size_t>(
+    SaveScheduler::Priority::Cosmetic)] = std::chrono::seconds(5);
+  SaveScheduler scheduler(settings);
+  auto now = std::chrono::system_clock::now();
+
+  scheduler.Push(1, MakeChangeForm(1), ChangeFormField::All,
+                 SaveScheduler::Priority::Cosmetic, now);
+  auto batch = scheduler.PopBatch(now);
+  REQUIRE(GetIds(batch) == std::vector<uint32_t>{ 1 });
+
+  // Pushed again while the batch is being saved, then the batch fails
+  auto later = now + std::chrono::seconds(4);
+  scheduler.Push(1, MakeChangeForm(1), ChangeFormField::Position,
+                 SaveScheduler::Priority::Cosmetic, later);
+  scheduler.Push(2, MakeChangeForm(2), ChangeFormField::All,
+                 SaveScheduler::Priority::Interactive, later);
+  scheduler.Restore(batch);
+
+  // Stale at the original deadline despite the newer request
+  auto deadline = now + std::chrono::seconds(5);
+  REQUIRE(GetIds(scheduler.PopBatch(deadline)) == std::vector<uint32_t>{ 1 });
+  REQUIRE(GetIds(scheduler.PopBatch(deadline)) == std::vector<uint32_t>{ 2 });
+
+  // Restored without a newer request
+  scheduler.Push(3, MakeChangeForm(3), ChangeFormField::All,
+                 SaveScheduler::Priority::Cosmetic, deadline);
+  batch = scheduler.PopBatch(deadline);
+  scheduler.Push(4, MakeChangeForm(4), ChangeFormField::All,
+                 SaveScheduler::Priority::Interactive, deadline);
+  scheduler.Restore(batch);
+  auto nextDeadline = deadline + std::chrono::seconds(5);
+  REQUIRE(GetIds(scheduler.PopBatch(nextDeadline)) ==
+          std::vector<uint32_t>{ 3 });
+}
+
+TEST_CASE("MpChangeForm::ToJson writes only requested fields",
+          "[SaveScheduler]")
+{
+  auto json = MpChangeForm::ToJson(
+    MakeChangeForm(1), ChangeFormField::Position | ChangeFormField::IsDead);
+  REQUIRE(json.size() == 2);
+  REQUIRE(json.count("position") == 1);
+  REQUIRE(json.count("isDead") == 1);
+}
@@ -1,9 +1,11 @@
 #include "TestUtils.hpp"
 
 #include "AsyncSaveStorage.h"
+#include "ChangeFormJournal.h"
 #include "FileDatabase.h"
 #include "MpChangeForms.h"
 #include <filesystem>
+#include <future>
 
 std::shared_ptr<ISaveStorage> MakeSaveStorage()
 {
@@ -172,3 +174,194 @@ TEST_CASE("Changes are transferred to SaveStorage", "[save]")
   WaitForNextUpsert(*st, p.worldState);
   REQUIRE(ISaveStorageUtils::CountSync(*st) == 1);
 }
+
+namespace {
+class FailingDatabase : public IDatabase
+{
+public:
+  explicit FailingDatabase(std::shared_ptr<IDatabase> db_)
+    : db(db_)
+  {
+  }
+
+  size_t Upsert(const std::vector<MpChangeForm>& changeForms) override
+  {
+    if (failing) {
+      throw std::runtime_error("Upsert failed");
+    }
+    return db->Upsert(changeForms);
+  }
+
+  void Iterate(const IterateCallback& iterateCallback) override
+  {
+    db->Iterate(iterateCallback);
+  }
+
+  std::atomic<bool> failing = true;
+
+private:
+  const std::shared_ptr<IDatabase> db;
+};
+}
+
+TEST_CASE("Change forms that failed to save are saved again", "[save]")
+{
+  std::filesystem::remove_all("unit/data");
+  auto db = std::make_shared<FailingDatabase>(
+    std::make_shared<FileDatabase>("unit/data", spdlog::default_logger()));
+  auto st = std::make_shared<AsyncSaveStorage>(db);
+
+  PartOne p;
+  p.AttachSaveStorage(st);
+  p.CreateActor(0xffaaaeee, { 1, 1, 1 }, 1, 0x3c);
+
+  bool failed = false;
+  for (int i = 0; !failed; ++i) {
+    REQUIRE(i < 2000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    try {
+      p.worldState.Tick();
+    } catch (std::exception& e) {
+      REQUIRE(std::string(e.what()) == "Upsert failed");
+      failed = true;
+    }
+  }
+  REQUIRE(p.worldState.GetNumPendingChangeForms() == 1);
+  REQUIRE(ISaveStorageUtils::CountSync(*st) == 0);
+
+  db->failing = false;
+  WaitForNextUpsert(*st, p.worldState);
+  REQUIRE(ISaveStorageUtils::CountSync(*st) == 1);
+}
+
+namespace {
+class BlockingDatabase : public IDatabase
+{
+public:
+  explicit BlockingDatabase(std::shared_ptr<IDatabase> db_)
+    : db(db_)
+  {
+  }
+
+  size_t Upsert(const std::vector<MpChangeForm>& changeForms) override
+  {
+    upserting = true;
+    while (blocked) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return db->Upsert(changeForms);
+  }
+
+  void Iterate(const IterateCallback& iterateCallback) override
+  {
+    db->Iterate(iterateCallback);
+  }
+
+  bool SupportsConcurrentReads() const override { return true; }
+
+  std::atomic<bool> blocked = true;
+  std::atomic<bool> upserting = false;
+
+private:
+  const std::shared_ptr<IDatabase> db;
+};
+}
+
+TEST_CASE("Reads don't wait for saving if the database allows that",
+          "[save]")
+{
+  std::filesystem::remove_all("unit/data");
+  auto db = std::make_shared<BlockingDatabase>(
+    std::make_shared<FileDatabase>("unit/data", spdlog::default_logger()));
+  auto st = std::make_shared<AsyncSaveStorage>(db);
+
+  st->Upsert({ CreateChangeForm("ff000001") }, [] {});
+  while (!db->upserting) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  auto read = std::async(std::launch::async, [&] {
+    return ISaveStorageUtils::CountSync(*st);
+  });
+  bool finished =
+    read.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+  db->blocked = false;
+
+  REQUIRE(finished);
+  REQUIRE(read.get() == 0);
+}
+
+TEST_CASE("Change forms of created references are loaded on demand", "[save]")
+{
+  auto st = MakeSaveStorage();
+
+  // Created references are stored without the 0xff prefix
+  auto refr = CreateChangeForm("1");
+  refr.position = { 5000, 5000, 0 };
+  refr.worldOrCellDesc = FormDesc::Tamriel();
+  auto player = CreateChangeForm("2");
+  player.recType = MpChangeForm::ACHR;
+  player.profileId = 7;
+  UpsertSync(*st, { refr, player });
+
+  PartOne p;
+  p.worldState.SetLoadChangeFormsOnDemand(true);
+  p.AttachSaveStorage(st);
+
+  // Player characters are loaded immediately
+  REQUIRE(p.worldState.LookupFormById(0xff000002) != nullptr);
+  REQUIRE(p.worldState.GetNumUnloadedChangeForms() == 1);
+
+  // Ids of unloaded change forms are not reused
+  REQUIRE(p.worldState.GenerateFormId() == 0xff000000);
+  REQUIRE(p.worldState.GenerateFormId() == 0xff000003);
+  REQUIRE(p.worldState.GetNumUnloadedChangeForms() == 1);
+
+  // Loads neighbour chunks including (1, 1)
+  p.worldState.GetReferencesAtPosition(0x3c, 0, 0);
+  REQUIRE(p.worldState.GetNumUnloadedChangeForms() == 0);
+  REQUIRE(p.worldState.GetFormAt<MpObjectReference>(0xff000001).GetPos() ==
+          NiPoint3(5000, 5000, 0));
+}
+
+TEST_CASE("Journaled player characters are saved disabled", "[save]")
+{
+  const auto journalDirectory =
+    std::filesystem::temp_directory_path() / "skymp_journal_replay_test";
+  std::filesystem::remove_all(journalDirectory);
+  const auto journalPath = (journalDirectory / "journal.jsonl").string();
+
+  auto player = CreateChangeForm("2");
+  player.recType = MpChangeForm::ACHR;
+  player.profileId = 7;
+  {
+    ChangeFormJournal journal(journalPath);
+    journal.Append(player);
+  }
+
+  auto st = MakeSaveStorage();
+  auto journal = std::make_shared<ChangeFormJournal>(journalPath);
+  PartOne p;
+  p.AttachSaveStorage(st, journal);
+  REQUIRE(p.worldState.GetFormAt<MpActor>(0xff000002).IsDisabled());
+
+  // Journaled again disabled
+  journal->Sync();
+  std::vector<MpChangeForm> journaled;
+  journal->Replay([&](const MpChangeForm& changeForm) {
+    journaled.push_back(changeForm);
+  });
+  REQUIRE(journaled.size() == 2);
+  REQUIRE(journaled.back().isDisabled);
+
+  WaitForNextUpsert(*st, p.worldState);
+  std::vector<MpChangeForm> saved;
+  st->IterateSync([&](const MpChangeForm& changeForm) {
+    saved.push_back(changeForm);
+  });
+  REQUIRE(saved.size() == 1);
+  REQUIRE(saved[0].isDisabled);
+
+  journal.reset();
+  std::filesystem::remove_all(journalDirectory);
+}
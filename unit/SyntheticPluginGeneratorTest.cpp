@@ -0,0 +1,187 @@
+#include <ChunkReferenceIndex.h>
+#include <Combiner.h>
+#include <GroupUtils.h>
+#include <LeveledListUtils.h>
+#include <Loader.h>
+#include <NavMeshIndex.h>
+#include <SyntheticPlugins.h>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace {
+espm::SyntheticPluginSettings MakeSmallSettings()
+{
+  espm::SyntheticPluginSettings settings;
+  settings.numCellsPerSide = 4;
+  settings.numReferencesPerCell = 8;
+  settings.numItems = 20;
+  settings.numStatics = 5;
+  settings.numLeveledLists = 10;
+  settings.numContainers = 6;
+  settings.numRecipes = 12;
+  settings.numCompressedItems = 5;
+  settings.seed = 1;
+  return settings;
+}
+
+template <class F>
+int64_t MeasureMs(F f)
+{
+  auto was = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now() - was)
+    .count();
+}
+}
+
+TEST_CASE("Synthetic plugins are deterministic and readable",
+          "[SyntheticPlugins]")
+{
+  const auto settings = MakeSmallSettings();
+  auto overrideSettings = settings;
+  overrideSettings.seed = 2;
+
+  auto master = espm::GenerateSyntheticMaster(settings);
+  auto plugin = espm::GenerateSyntheticOverride(
+    overrideSettings, "Synthetic.esm", settings, 50);
+  REQUIRE(espm::GenerateSyntheticMaster(settings) == master);
+  REQUIRE(espm::GenerateSyntheticOverride(overrideSettings, "Synthetic.esm",
+                                          settings, 50) == plugin);
+
+  espm::Browser masterBr(master.data(), master.size());
+  espm::Browser pluginBr(plugin.data(), plugin.size());
+  espm::Combiner combiner;
+  combiner.AddSource(&masterBr, "Synthetic.esm");
+  combiner.AddSource(&pluginBr, "SyntheticOverride1.esp");
+  auto combineBrowser = combiner.Combine();
+  auto& br = *combineBrowser;
+
+  const espm::SyntheticPluginLayout layout(settings);
+  const espm::SyntheticPluginLayout pluginLayout(overrideSettings, 1,
+                                                 &settings);
+  const uint32_t worldId = layout.GetWorldId(0);
+  const int32_t min = layout.GetMinCellCoord();
+  REQUIRE(min == -2);
+
+  auto refrs = br.GetRecordsByType("REFR");
+  REQUIRE(refrs[0]->size() == 16 * 8);
+  REQUIRE(refrs[1]->size() > 16 * 8);
+
+  // Chunks are not cells: positions are truncated towards zero
+  espm::CompressedFieldsCache cache;
+  size_t numMasterReferences = 0;
+  for (int32_t y = min; y < min + 4; ++y) {
+    for (int32_t x = min; x < min + 4; ++x) {
+      numMasterReferences += br.GetRecordsAtPos(worldId, x, y)[0]->size();
+
+      espm::CellOrGridPos pos;
+      pos.pos.x = static_cast<int16_t>(x);
+      pos.pos.y = static_cast<int16_t>(y);
+      REQUIRE(br.FindNavMeshes(worldId, pos).second == 1);
+
+      const auto newReference =
+        br.LookupById(pluginLayout.GetReferenceId(0, x, y, 0));
+      REQUIRE(newReference.fileIdx == 1);
+      REQUIRE(espm::GetWorldOrCell(br, newReference.rec) == worldId);
+    }
+  }
+  REQUIRE(numMasterReferences == 16 * 8);
+
+  auto item = br.LookupById(layout.firstItem);
+  REQUIRE(item.rec->GetType() == "MISC");
+  REQUIRE(std::string(item.rec->GetEditorId(cache)) == "SynthItem000801");
+  REQUIRE(br.LookupById(pluginLayout.firstItem).fileIdx == 1);
+
+  LeveledListUtils::CompiledLists lists(br);
+  LeveledListUtils::SetRandomSeed(1);
+  for (uint32_t i = 0; i < settings.numLeveledLists; ++i) {
+    auto list = br.LookupById(layout.firstLeveledList + i);
+    REQUIRE(list.rec->GetType() == "LVLI");
+    for (auto [formId, count] :
+         LeveledListUtils::EvaluateListRecurse(lists, list)) {
+      REQUIRE(br.LookupById(formId).rec->GetType() == "MISC");
+    }
+  }
+
+  auto recipe = espm::Convert<espm::COBJ>(
+    br.LookupById(pluginLayout.firstRecipe).rec);
+  REQUIRE(recipe);
+  REQUIRE(recipe->GetData(cache).benchKeywordId ==
+          pluginLayout.workbenchKeyword);
+
+  REQUIRE(NavMeshIndex(br).GetNumTriangles() == 16 * 32);
+  REQUIRE(ChunkReferenceIndex(br).GetNumReferences() > 0);
+}
+
+TEST_CASE("Synthetic load order benchmark",
+          "[SyntheticPlugins][Benchmarks]")
+{
+  constexpr uint32_t kNumOverrides = 8;
+
+  espm::SyntheticPluginSettings settings;
+  settings.numWorldspaces = 2;
+  settings.numCellsPerSide = 64;
+  settings.numItems = 20000;
+  settings.numCompressedItems = 5000;
+  settings.numLeveledLists = 5000;
+  settings.numContainers = 5000;
+  settings.numRecipes = 10000;
+
+  const auto dir =
+    espm::fs::temp_directory_path() / "skymp_synthetic_load_order";
+  espm::fs::remove_all(dir);
+  espm::fs::create_directories(dir);
+  std::vector<espm::fs::path> paths = { dir / "Synthetic.esm" };
+  auto generateMs = MeasureMs([&] {
+    auto master = espm::GenerateSyntheticMaster(settings);
+    std::ofstream(paths[0], std::ios::binary)
+      .write(master.data(), master.size());
+    for (uint32_t i = 1; i <= kNumOverrides; ++i) {
+      auto pluginSettings = settings;
+      pluginSettings.numReferencesPerCell = 4;
+      pluginSettings.seed = i;
+      auto plugin = espm::GenerateSyntheticOverride(
+        pluginSettings, "Synthetic.esm", settings, 10);
+      paths.push_back(dir /
+                      ("SyntheticOverride" + std::to_string(i) + ".esp"));
+      std::ofstream(paths.back(), std::ios::binary)
+        .write(plugin.data(), plugin.size());
+    }
+  });
+
+  std::unique_ptr<espm::Loader> loader;
+  auto loadMs = MeasureMs([&] { loader.reset(new espm::Loader(paths)); });
+  auto& br = loader->GetBrowser();
+
+  std::unique_ptr<ChunkReferenceIndex> index;
+  auto indexMs =
+    MeasureMs([&] { index.reset(new ChunkReferenceIndex(br)); });
+
+  const espm::SyntheticPluginLayout layout(settings);
+  const int32_t min = layout.GetMinCellCoord();
+  size_t numReferences = 0;
+  auto lookupMs = MeasureMs([&] {
+    for (uint32_t world = 0; world < settings.numWorldspaces; ++world) {
+      for (int32_t y = min; y < min + 64; ++y) {
+        for (int32_t x = min; x < min + 64; ++x) {
+          numReferences +=
+            index->GetReferencesAtPos(layout.GetWorldId(world), x, y).size();
+        }
+      }
+    }
+  });
+  REQUIRE(numReferences == index->GetNumReferences());
+
+  std::cout << "Synthetic load order of " << paths.size()
+            << " plugins: generated in " << generateMs << " ms, loaded in "
+            << loadMs << " ms, " << numReferences
+            << " loadable references indexed in " << indexMs
+            << " ms and listed in " << lookupMs << " ms" << std::endl;
+
+  index.reset();
+  loader.reset();
+  espm::fs::remove_all(dir);
+}
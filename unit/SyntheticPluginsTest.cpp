@@ -0,0 +1,983 @@
+#include <ChunkReferenceIndex.h>
+#include <Combiner.h>
+#include <DecodedRecordsCache.h>
+#include <LeveledListUtils.h>
+#include <Loader.h>
+#include <NavMeshIndex.h>
+#include <PluginWriter.h>
+#include <PreloadCompressedFields.h>
+#include <ZlibUtils.h>
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace {
+std::string GetPluginName(size_t i)
+{
+  return "Plugin" + std::to_string(i) + ".esp";
+}
+
+// Plugin 'index' depends on all previous plugins. It adds 'numNew' records
+// and overrides 'numOverrides' records of the first plugin
+std::vector<char> MakePlugin(size_t index, uint32_t numNew,
+                             uint32_t numOverrides)
+{
+  espm::PluginWriter w;
+
+  w.BeginRecord("TES4", 0);
+  const char hedr[12] = { 0 };
+  w.WriteField("HEDR", hedr, sizeof(hedr));
+  for (size_t m = 0; m < index; ++m) {
+    auto master = GetPluginName(m);
+    const uint64_t data = 0;
+    w.WriteField("MAST", master.data(),
+                 static_cast<uint16_t>(master.size() + 1));
+    w.WriteField("DATA", &data, sizeof(data));
+  }
+  w.EndRecord();
+
+  const uint32_t ownIndex = static_cast<uint32_t>(index) << 24;
+  for (uint32_t i = 0; i < numNew; ++i) {
+    w.BeginRecord("MISC", ownIndex + 0x800 + i);
+    w.EndRecord();
+  }
+
+  // Plugins override different, partially intersecting ranges
+  const uint32_t first =
+    (static_cast<uint32_t>(index) * numOverrides / 2) % numNew;
+  for (uint32_t i = 0; index > 0 && i < numOverrides; ++i) {
+    w.BeginRecord("MISC", 0x800 + first + i);
+    w.EndRecord();
+  }
+
+  return w.GetBuffer();
+}
+
+uint32_t MakeLabel(const char* type)
+{
+  uint32_t res;
+  memcpy(&res, type, sizeof(res));
+  return res;
+}
+
+// Cell 0x100 with reference 0x200, constructible object 0x300
+std::vector<char> MakePluginWithGroups()
+{
+  espm::PluginWriter w;
+
+  w.BeginRecord("TES4", 0);
+  const char hedr[12] = { 0 };
+  w.WriteField("HEDR", hedr, sizeof(hedr));
+  w.EndRecord();
+
+  w.BeginGroup(MakeLabel("CELL"), espm::GroupType::TOP);
+  w.BeginRecord("CELL", 0x100);
+  w.EndRecord();
+  w.BeginGroup(0x100, espm::GroupType::CELL_CHILDREN);
+  w.BeginGroup(0x100, espm::GroupType::CELL_TEMPORARY_CHILDREN);
+  w.BeginRecord("REFR", 0x200);
+  const uint32_t baseId = 0x300;
+  w.WriteField("NAME", &baseId, sizeof(baseId));
+  const float posRot[6] = { 5000.f, -5000.f, 0.f, 0.f, 0.f, 0.f };
+  w.WriteField("DATA", posRot, sizeof(posRot));
+  w.EndRecord();
+  w.EndGroup();
+  w.EndGroup();
+  w.EndGroup();
+
+  w.BeginGroup(MakeLabel("COBJ"), espm::GroupType::TOP);
+  w.BeginRecord("COBJ", 0x300);
+  w.EndRecord();
+  w.EndGroup();
+
+  return w.GetBuffer();
+}
+
+std::string GetEditorIdForTest(uint32_t id)
+{
+  return "Record" + std::to_string(id) + std::string(1000, 'x');
+}
+
+// 'numRecords' compressed records with long editor ids
+std::vector<char> MakeCompressedPlugin(uint32_t numRecords)
+{
+  espm::PluginWriter w;
+
+  w.BeginRecord("TES4", 0);
+  const char hedr[12] = { 0 };
+  w.WriteField("HEDR", hedr, sizeof(hedr));
+  w.EndRecord();
+
+  for (uint32_t id = 0x800; id < 0x800 + numRecords; ++id) {
+    auto editorId = GetEditorIdForTest(id);
+    espm::PluginWriter fields;
+    fields.WriteField("EDID", editorId.data(),
+                      static_cast<uint16_t>(editorId.size() + 1));
+    w.WriteCompressedRecord("MISC", id, 0, fields);
+  }
+
+  return w.GetBuffer();
+}
+
+// Directory in the system temp directory, removed with its contents when
+// the test ends
+class TempDirectory
+{
+public:
+  explicit TempDirectory(const char* name)
+    : path(espm::fs::temp_directory_path() / name)
+  {
+    espm::fs::remove_all(path);
+    espm::fs::create_directories(path);
+  }
+
+  ~TempDirectory()
+  {
+    std::error_code ec;
+    espm::fs::remove_all(path, ec);
+  }
+
+  const espm::fs::path path;
+};
+
+void WritePlugins(const espm::fs::path& dir,
+                  const std::vector<std::vector<char>>& contents,
+                  std::vector<espm::fs::path>& outPaths)
+{
+  espm::fs::create_directories(dir);
+  outPaths.clear();
+  for (size_t i = 0; i < contents.size(); ++i) {
+    outPaths.push_back(dir / GetPluginName(i));
+    std::ofstream(outPaths.back(), std::ios::binary)
+      .write(contents[i].data(), contents[i].size());
+  }
+}
+
+struct LoadOrder
+{
+  LoadOrder(size_t numPlugins, uint32_t numNew, uint32_t numOverrides)
+  {
+    for (size_t i = 0; i < numPlugins; ++i) {
+      contents.push_back(MakePlugin(i, numNew, numOverrides));
+    }
+    for (size_t i = 0; i < numPlugins; ++i) {
+      browsers.emplace_back(
+        new espm::Browser(contents[i].data(), contents[i].size()));
+      combiner.AddSource(browsers.back().get(), GetPluginName(i).data());
+    }
+    combineBrowser = combiner.Combine();
+  }
+
+  // What LookupByIdAll did before the combined index: probe every browser
+  std::vector<espm::LookupResult> LookupByIdAllScan(uint32_t combFormId)
+  {
+    std::vector<espm::LookupResult> res;
+    for (size_t i = 0; i < browsers.size(); ++i) {
+      auto toRaw = combineBrowser->GetRawMapping(i);
+      const uint32_t rawFormId = espm::GetMappedId(combFormId, *toRaw);
+      if (rawFormId >= 0xff000000) {
+        continue;
+      }
+      if (auto rec = browsers[i]->LookupById(rawFormId)) {
+        res.push_back({ combineBrowser.get(), rec, static_cast<uint8_t>(i) });
+      }
+    }
+    return res;
+  }
+
+  std::vector<std::vector<char>> contents;
+  std::vector<std::unique_ptr<espm::Browser>> browsers;
+  espm::Combiner combiner;
+  std::unique_ptr<espm::CombineBrowser> combineBrowser;
+};
+
+std::vector<std::pair<espm::RecordHeader*, uint8_t>> ToPairs(
+  const std::vector<espm::LookupResult>& results)
+{
+  std::vector<std::pair<espm::RecordHeader*, uint8_t>> res;
+  for (auto& r : results) {
+    res.push_back({ r.rec, r.fileIdx });
+  }
+  return res;
+}
+
+std::vector<uint32_t> GetAllCombinedIds(size_t numPlugins, uint32_t numNew)
+{
+  std::vector<uint32_t> res;
+  for (size_t i = 0; i < numPlugins; ++i) {
+    for (uint32_t j = 0; j < numNew; ++j) {
+      res.push_back((static_cast<uint32_t>(i) << 24) + 0x800 + j);
+    }
+  }
+  return res;
+}
+}
+
+TEST_CASE("CombineBrowser finds overrides in load order", "[CombineBrowser]")
+{
+  LoadOrder loadOrder(4, 10, 4);
+  auto& br = *loadOrder.combineBrowser;
+
+  // Overridden by plugins 1 and 2 (ranges 2..5 and 4..7)
+  auto all = br.LookupByIdAll(0x804);
+  REQUIRE(all.size() == 3);
+  REQUIRE(all[0].fileIdx == 0);
+  REQUIRE(all[1].fileIdx == 1);
+  REQUIRE(all[2].fileIdx == 2);
+  REQUIRE(br.LookupById(0x804).fileIdx == 2);
+  REQUIRE(br.LookupById(0x804).rec == all[2].rec);
+
+  REQUIRE(br.LookupById(0x03000800).fileIdx == 3);
+  REQUIRE(br.LookupByIdAll(0x03000800).size() == 1);
+
+  REQUIRE(br.LookupById(0x04000800).rec == nullptr);
+  REQUIRE(br.LookupByIdAll(0x04000800).empty());
+  REQUIRE(br.LookupById(0x03001000).rec == nullptr);
+}
+
+TEST_CASE("CombineBrowser lookup benchmark", "[CombineBrowser][Benchmarks]")
+{
+  constexpr size_t kNumPlugins = 60;
+  constexpr uint32_t kNumNew = 5000;
+  constexpr uint32_t kNumOverrides = 500;
+
+  LoadOrder loadOrder(kNumPlugins, kNumNew, kNumOverrides);
+  auto& br = *loadOrder.combineBrowser;
+  const auto ids = GetAllCombinedIds(kNumPlugins, kNumNew);
+
+  for (auto id : ids) {
+    auto expected = loadOrder.LookupByIdAllScan(id);
+    REQUIRE(!expected.empty());
+    REQUIRE(ToPairs(br.LookupByIdAll(id)) == ToPairs(expected));
+    REQUIRE(br.LookupById(id).rec == expected.back().rec);
+    REQUIRE(br.LookupById(id).fileIdx == expected.back().fileIdx);
+  }
+
+  auto measure = [&](auto f) {
+    auto was = std::chrono::steady_clock::now();
+    size_t numFound = 0;
+    for (auto id : ids) {
+      numFound += f(id);
+    }
+    REQUIRE(numFound == ids.size());
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - was)
+      .count();
+  };
+
+  auto scan = measure([&](uint32_t id) {
+    return loadOrder.LookupByIdAllScan(id).empty() ? 0 : 1;
+  });
+  auto index = measure(
+    [&](uint32_t id) { return br.LookupByIdAll(id).empty() ? 0 : 1; });
+
+  std::cout << ids.size() << " lookups in " << kNumPlugins
+            << " plugins: scanning browsers took " << scan
+            << " microseconds, combined index took " << index
+            << " microseconds" << std::endl;
+}
+
+TEST_CASE("Loader parses plugins concurrently and reports progress in order",
+          "[Loader]")
+{
+  constexpr size_t kNumPlugins = 8;
+
+  std::vector<std::vector<char>> contents;
+  for (size_t i = 0; i < kNumPlugins; ++i) {
+    contents.push_back(MakePlugin(i, 100, 10));
+  }
+  const TempDirectory tempDirectory("skymp_synthetic_plugins");
+  const auto& dir = tempDirectory.path;
+  std::vector<espm::fs::path> paths;
+  WritePlugins(dir, contents, paths);
+
+  std::vector<std::string> progress;
+  espm::Loader loader(
+    paths,
+    [&](std::string fileName, float, float, uintmax_t) {
+      progress.push_back(fileName);
+    },
+    espm::Loader::BufferType::AllocatedBuffer, 4);
+
+  std::vector<std::string> expectedProgress;
+  for (size_t i = 0; i < kNumPlugins; ++i) {
+    expectedProgress.push_back(GetPluginName(i));
+  }
+  REQUIRE(progress == expectedProgress);
+
+  auto& br = loader.GetBrowser();
+  REQUIRE(br.LookupById(0x07000800).fileIdx == 7);
+  REQUIRE(br.LookupByIdAll(0x80f).size() == 3);
+
+  REQUIRE_THROWS(espm::Loader({ dir / "NonExistent.esp" }, nullptr,
+                              espm::Loader::BufferType::AllocatedBuffer, 4));
+}
+
+TEST_CASE("Browser restores indices from SaveIndex", "[Browser]")
+{
+  auto content = MakePluginWithGroups();
+  espm::Browser parsed(content.data(), content.size());
+  auto index = parsed.SaveIndex();
+  espm::Browser restored(content.data(), content.size(), index.data(),
+                         index.size());
+
+  REQUIRE(restored.GetNumRecords() == parsed.GetNumRecords());
+  for (uint32_t id : { 0x0, 0x100, 0x200, 0x300 }) {
+    auto rec = restored.LookupById(id);
+    REQUIRE(rec);
+    REQUIRE(rec == parsed.LookupById(id));
+    auto parentGroups = parsed.GetParentGroupsOptional(rec);
+    auto restoredParentGroups = restored.GetParentGroupsOptional(rec);
+    REQUIRE(!parentGroups == !restoredParentGroups);
+    if (parentGroups) {
+      REQUIRE(*parentGroups == *restoredParentGroups);
+      for (auto group : *parentGroups) {
+        REQUIRE(restored.GetSubsEnsured(group) ==
+                parsed.GetSubsEnsured(group));
+      }
+    }
+  }
+  REQUIRE(parsed.GetParentGroupsEnsured(parsed.LookupById(0x200)).size() ==
+          3);
+
+  // The closest group before the record is a nested group of another TOP
+  REQUIRE(parsed.GetParentGroupsEnsured(parsed.LookupById(0x300)).size() ==
+          1);
+  REQUIRE(!parsed.GetParentGroupsOptional(parsed.LookupById(0x0)));
+
+  // CELL and its CELL_CHILDREN group
+  auto cellTop = parsed.GetParentGroupsEnsured(parsed.LookupById(0x100))[0];
+  auto cellTopSubs = parsed.GetSubsEnsured(cellTop);
+  REQUIRE(std::distance(cellTopSubs.begin(), cellTopSubs.end()) == 2);
+
+  REQUIRE(parsed.GetMemoryUsage().GetTotal() > 0);
+  REQUIRE(restored.GetMemoryUsage().groups ==
+          parsed.GetMemoryUsage().groups);
+
+  REQUIRE(parsed.GetRecordsAtPos(0x100, 1, -1).size() == 1);
+  REQUIRE(restored.GetRecordsAtPos(0x100, 1, -1) ==
+          parsed.GetRecordsAtPos(0x100, 1, -1));
+  REQUIRE(restored.GetRecordsByType("REFR") ==
+          parsed.GetRecordsByType("REFR"));
+  REQUIRE(restored.GetRecordsByType("COBJ").size() == 1);
+
+  auto truncated = index;
+  truncated.pop_back();
+  REQUIRE_THROWS(espm::Browser(content.data(), content.size(),
+                               truncated.data(), truncated.size()));
+  REQUIRE_THROWS(espm::Browser(content.data(), content.size() - 1,
+                               index.data(), index.size()));
+}
+
+TEST_CASE("Loader reuses and repairs the index cache", "[Loader]")
+{
+  const TempDirectory tempDirectory("skymp_synthetic_plugins_cached");
+  const auto& dir = tempDirectory.path;
+  const auto cacheDir = dir / "cache";
+  std::vector<espm::fs::path> paths;
+  WritePlugins(dir, { MakePlugin(0, 100, 10), MakePluginWithGroups() },
+               paths);
+
+  auto load = [&] {
+    return std::make_unique<espm::Loader>(
+      paths, nullptr, espm::Loader::BufferType::AllocatedBuffer, 2, cacheDir);
+  };
+
+  auto check = [&](espm::Loader& loader) {
+    auto& br = loader.GetBrowser();
+    REQUIRE(br.LookupById(0x800).fileIdx == 0);
+    REQUIRE(br.LookupById(0x01000200).fileIdx == 1);
+    REQUIRE(br.GetRecordsAtPos(0x100, 1, -1).size() == 2);
+    REQUIRE(br.GetRecordsAtPos(0x100, 1, -1)[1]->size() == 1);
+  };
+
+  auto listCache = [&] {
+    std::vector<std::string> res;
+    for (auto& p : espm::fs::directory_iterator(cacheDir)) {
+      if (p.path().extension() == ".idx") {
+        res.push_back(p.path().filename().string());
+      }
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+  };
+
+  check(*load());
+  const auto cacheFiles = listCache();
+  REQUIRE(cacheFiles.size() == 2);
+
+  auto loader = load();
+  check(*loader);
+  REQUIRE(listCache() == cacheFiles);
+
+  for (auto& [fileName, info] : loader->GetFilesInfo()) {
+    auto expected = fmt::format("{}.{}.{:08x}.idx", fileName, info.size,
+                                info.crc32);
+    REQUIRE(std::count(cacheFiles.begin(), cacheFiles.end(), expected) == 1);
+
+    std::ifstream f(cacheDir / (fileName + ".crc32"));
+    std::string crc32Cache((std::istreambuf_iterator<char>(f)),
+                           std::istreambuf_iterator<char>());
+    REQUIRE(crc32Cache.find(fmt::format(" {:08x}", info.crc32)) !=
+            std::string::npos);
+  }
+
+  // Cached CRC32 of a file with another size is ignored
+  const auto crc32CachePath =
+    cacheDir / (paths[0].filename().string() + ".crc32");
+  std::ofstream(crc32CachePath) << "1 1 deadbeef\n";
+  check(*load());
+  REQUIRE(listCache() == cacheFiles);
+
+  // Damaged cache file is replaced
+  std::ofstream(cacheDir / cacheFiles[0], std::ios::binary) << "garbage";
+  check(*load());
+  REQUIRE(espm::fs::file_size(cacheDir / cacheFiles[0]) > 7);
+
+  // Cache of a changed file is replaced
+  WritePlugins(dir, { MakePlugin(0, 101, 10), MakePluginWithGroups() },
+               paths);
+  check(*load());
+  REQUIRE(listCache().size() == 2);
+  REQUIRE(listCache() != cacheFiles);
+}
+
+TEST_CASE("CalculateHashcode combines CRC32 of chunks", "[Loader]")
+{
+  std::vector<char> buf(50 * 1024 * 1024 + 3);
+  std::mt19937 rng(1);
+  for (auto& ch : buf) {
+    ch = static_cast<char>(rng());
+  }
+  REQUIRE(espm::CalculateHashcode(buf.data(), buf.size()) ==
+          ZlibGetCRC32Checksum(buf.data(), buf.size()));
+  REQUIRE(espm::CalculateHashcode(buf.data(), 100) ==
+          ZlibGetCRC32Checksum(buf.data(), 100));
+}
+
+TEST_CASE("CompressedFieldsCache decompresses each record once",
+          "[CompressedFieldsCache]")
+{
+  constexpr uint32_t kNumRecords = 100;
+  auto content = MakeCompressedPlugin(kNumRecords);
+  espm::Browser br(content.data(), content.size());
+  espm::CompressedFieldsCache cache;
+
+  for (int pass = 0; pass < 2; ++pass) {
+    for (uint32_t id = 0x800; id < 0x800 + kNumRecords; ++id) {
+      REQUIRE(br.LookupById(id)->GetEditorId(cache) ==
+              GetEditorIdForTest(id));
+    }
+  }
+
+  auto stats = cache.GetStats();
+  REQUIRE(stats.numMisses == kNumRecords);
+  REQUIRE(stats.numHits == kNumRecords);
+  REQUIRE(stats.numEvictions == 0);
+  REQUIRE(stats.numEntries == kNumRecords);
+  REQUIRE(stats.numBytes > kNumRecords * 1000);
+
+  cache.Clear();
+  REQUIRE(cache.GetStats().numEntries == 0);
+  REQUIRE(cache.GetStats().numBytes == 0);
+}
+
+TEST_CASE("CompressedFieldsCache evicts least recently used records",
+          "[CompressedFieldsCache]")
+{
+  constexpr uint32_t kNumRecords = 100;
+  auto content = MakeCompressedPlugin(kNumRecords);
+  espm::Browser br(content.data(), content.size());
+
+  espm::CompressedFieldsCache cache(20 * 1024);
+  for (uint32_t id = 0x800; id < 0x800 + kNumRecords; ++id) {
+    REQUIRE(br.LookupById(id)->GetEditorId(cache) == GetEditorIdForTest(id));
+  }
+
+  auto stats = cache.GetStats();
+  REQUIRE(stats.numMisses == kNumRecords);
+  REQUIRE(stats.numEntries < kNumRecords);
+  REQUIRE(stats.numEntries + stats.numEvictions == kNumRecords);
+
+  // Each of 16 shards keeps at least the most recently used entry
+  REQUIRE(stats.numBytes <= 20 * 1024 + 16 * 1100);
+
+  // The last record is the most recently used one
+  const auto last = br.LookupById(0x800 + kNumRecords - 1);
+  REQUIRE(last->GetEditorId(cache) ==
+          GetEditorIdForTest(0x800 + kNumRecords - 1));
+  REQUIRE(cache.GetStats().numHits == 1);
+
+  cache.SetMaxBytes(1);
+  REQUIRE(cache.GetStats().numEntries <= 16);
+}
+
+TEST_CASE("CompressedFieldsCache frees evicted fields on ReleaseEvicted",
+          "[CompressedFieldsCache]")
+{
+  constexpr uint32_t kNumRecords = 100;
+  auto content = MakeCompressedPlugin(kNumRecords);
+  espm::Browser br(content.data(), content.size());
+  espm::CompressedFieldsCache cache(1);
+
+  const char* firstEditorId = br.LookupById(0x800)->GetEditorId(cache);
+  for (uint32_t id = 0x801; id < 0x800 + kNumRecords; ++id) {
+    br.LookupById(id)->GetEditorId(cache);
+  }
+  REQUIRE(cache.GetStats().numEvictions > 0);
+  REQUIRE(cache.GetStats().numEvictedBytes > 0);
+
+  // Evicted, but not freed yet
+  REQUIRE(firstEditorId == GetEditorIdForTest(0x800));
+
+  cache.ReleaseEvicted();
+  REQUIRE(cache.GetStats().numEvictedBytes == 0);
+  REQUIRE(cache.GetStats().numEntries > 0);
+}
+
+TEST_CASE("CompressedFieldsCache is thread-safe", "[CompressedFieldsCache]")
+{
+  constexpr uint32_t kNumRecords = 100;
+  auto content = MakeCompressedPlugin(kNumRecords);
+  espm::Browser br(content.data(), content.size());
+  espm::CompressedFieldsCache cache(20 * 1024);
+
+  std::atomic<int> numMismatches = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (int pass = 0; pass < 20; ++pass) {
+        for (uint32_t i = 0; i < kNumRecords; ++i) {
+          const uint32_t id = 0x800 + (i * (t + 1)) % kNumRecords;
+
+          // Fields of entries evicted by other threads stay valid until
+          // ReleaseEvicted
+          const char* editorId = br.LookupById(id)->GetEditorId(cache);
+          if (editorId != GetEditorIdForTest(id)) {
+            ++numMismatches;
+          }
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE(numMismatches == 0);
+  auto stats = cache.GetStats();
+  REQUIRE(stats.numHits + stats.numMisses == 4 * 20 * kNumRecords);
+}
+
+TEST_CASE("DecodedRecordsCache decodes each record once",
+          "[DecodedRecordsCache]")
+{
+  espm::PluginWriter w;
+  w.BeginRecord("TES4", 0);
+  const char hedr[12] = { 0 };
+  w.WriteField("HEDR", hedr, sizeof(hedr));
+  w.EndRecord();
+
+  espm::PluginWriter fields;
+  fields.WriteField("EDID", "Flora", 6);
+  const uint32_t resultItem = 0x1234;
+  fields.WriteField("PFIG", &resultItem, sizeof(resultItem));
+  w.WriteCompressedRecord("FLOR", 0x800, 0, fields);
+
+  espm::Browser br(w.GetBuffer().data(), w.GetBuffer().size());
+  auto flor = espm::Convert<espm::FLOR>(br.LookupById(0x800));
+  REQUIRE(flor);
+
+  espm::DecodedRecordsCache cache;
+  static_assert(espm::DecodedRecordsCache::kIsSupported<espm::FLOR>);
+  static_assert(!espm::DecodedRecordsCache::kIsSupported<espm::TES4>);
+
+  std::vector<const espm::FLOR::Data*> results(8);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < results.size(); ++i) {
+    threads.emplace_back([&, i] { results[i] = &cache.GetData(flor); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto& data = cache.GetData(flor);
+  REQUIRE(std::string(data.editorId) == "Flora");
+  REQUIRE(data.resultItem == 0x1234);
+  REQUIRE(std::count(results.begin(), results.end(), &data) ==
+          results.size());
+}
+
+TEST_CASE("FindField looks up fields of plain and compressed records",
+          "[RecordHeader]")
+{
+  espm::PluginWriter fields;
+  fields.WriteField("EDID", "Container", 10);
+  const std::string longField(70000, 'y');
+  fields.WriteField("DATA", longField.data(),
+                    static_cast<uint32_t>(longField.size()));
+  for (uint32_t i = 0; i < 3; ++i) {
+    fields.WriteField("CNTO", &i, sizeof(i));
+  }
+
+  espm::PluginWriter w;
+  w.BeginRecord("TES4", 0);
+  const char hedr[12] = { 0 };
+  w.WriteField("HEDR", hedr, sizeof(hedr));
+  w.EndRecord();
+  w.BeginRecord("CONT", 0x800);
+  w.WriteField("EDID", "Container", 10);
+  w.WriteField("DATA", longField.data(),
+               static_cast<uint32_t>(longField.size()));
+  for (uint32_t i = 0; i < 3; ++i) {
+    w.WriteField("CNTO", &i, sizeof(i));
+  }
+  w.EndRecord();
+  w.WriteCompressedRecord("CONT", 0x801, 0, fields);
+
+  espm::Browser br(w.GetBuffer().data(), w.GetBuffer().size());
+  espm::CompressedFieldsCache cache;
+
+  for (uint32_t id : { 0x800, 0x801 }) {
+    auto rec = br.LookupById(id);
+    REQUIRE(rec);
+
+    // The second pass uses the index built by the first one
+    for (int pass = 0; pass < 2; ++pass) {
+      REQUIRE(std::string(rec->GetEditorId(cache)) == "Container");
+      REQUIRE(!rec->FindField("FULL", cache));
+      REQUIRE(rec->FindFields("FULL", cache).empty());
+
+      auto data = rec->FindField("DATA", cache);
+      REQUIRE(data.size == longField.size());
+      REQUIRE(std::string(data.data, data.size) == longField);
+      REQUIRE(rec->FindField("XXXX", cache).size == 4);
+
+      auto cnto = rec->FindFields("CNTO", cache);
+      REQUIRE(cnto.size() == 3);
+      for (uint32_t i = 0; i < 3; ++i) {
+        REQUIRE(*reinterpret_cast<const uint32_t*>(cnto[i].data) == i);
+      }
+    }
+  }
+}
+
+namespace {
+void WriteLeveledList(espm::PluginWriter& w, uint32_t id, uint8_t flags,
+                      const std::vector<std::array<uint32_t, 3>>& entries)
+{
+  w.BeginRecord("LVLI", id);
+  const uint8_t chanceNone = 0;
+  w.WriteField("LVLD", &chanceNone, 1);
+  w.WriteField("LVLF", &flags, 1);
+  const auto numEntries = static_cast<uint8_t>(entries.size());
+  w.WriteField("LLCT", &numEntries, 1);
+  for (auto& levelFormIdCount : entries) {
+    w.WriteField("LVLO", levelFormIdCount.data(), 12);
+  }
+  w.EndRecord();
+}
+}
+
+TEST_CASE("Compiled leveled lists are evaluated deterministically",
+          "[LeveledListUtils]")
+{
+  espm::PluginWriter w;
+  w.BeginRecord("TES4", 0);
+  const char hedr[12] = { 0 };
+  w.WriteField("HEDR", hedr, sizeof(hedr));
+  w.EndRecord();
+  for (uint32_t id = 0x800; id < 0x804; ++id) {
+    w.BeginRecord("MISC", id);
+    w.EndRecord();
+  }
+  // Entries are not sorted by level, 0x900 is a missing form
+  WriteLeveledList(w, 0xa00, 0,
+                   { { 5, 0x800, 1 }, { 1, 0x801, 2 }, { 3, 0x802, 3 } });
+  WriteLeveledList(w, 0xa01, espm::LVLI::UseAll,
+                   { { 1, 0xa00, 1 }, { 1, 0x803, 4 }, { 1, 0x900, 1 } });
+
+  espm::Browser br(w.GetBuffer().data(), w.GetBuffer().size());
+  espm::Combiner combiner;
+  combiner.AddSource(&br, "Plugin.esp");
+  auto combineBrowser = combiner.Combine();
+
+  LeveledListUtils::CompiledLists lists(*combineBrowser);
+  auto list = lists.Get(combineBrowser->LookupById(0xa00));
+  REQUIRE(list);
+  REQUIRE(lists.Get(combineBrowser->LookupById(0xa00)) == list);
+  REQUIRE(lists.Get(combineBrowser->LookupById(0x800)) == nullptr);
+  REQUIRE(list->entries.size() == 3);
+  REQUIRE(list->entries[0].level == 1);
+  REQUIRE(list->entries[1].level == 3);
+  REQUIRE(list->entries[2].level == 5);
+
+  // Only the level 1 entry is allowed
+  for (int i = 0; i < 100; ++i) {
+    auto res = LeveledListUtils::EvaluateList(*list, 1);
+    REQUIRE(res.size() == 1);
+    REQUIRE(res[0].formId == 0x801);
+    REQUIRE(res[0].count == 2);
+  }
+
+  auto evaluate = [&] {
+    std::vector<std::map<uint32_t, uint32_t>> res;
+    for (int i = 0; i < 100; ++i) {
+      res.push_back(LeveledListUtils::EvaluateListRecurse(
+        lists, combineBrowser->LookupById(0xa01), 2));
+    }
+    return res;
+  };
+
+  LeveledListUtils::SetRandomSeed(123);
+  auto first = evaluate();
+  LeveledListUtils::SetRandomSeed(123);
+  REQUIRE(evaluate() == first);
+
+  std::map<uint32_t, uint32_t> totals;
+  for (auto& res : first) {
+    REQUIRE(res.size() == 2);
+    REQUIRE(res[0x803] == 8);
+    for (auto& [formId, count] : res) {
+      totals[formId] += count;
+    }
+  }
+  REQUIRE(totals.size() == 4);
+}
+
+TEST_CASE("PreloadCompressedFields decompresses records in advance",
+          "[CompressedFieldsCache]")
+{
+  constexpr uint32_t kNumRecords = 100;
+  auto content = MakeCompressedPlugin(kNumRecords);
+  espm::Browser br(content.data(), content.size());
+  espm::Combiner combiner;
+  combiner.AddSource(&br, "Plugin.esp");
+  auto combineBrowser = combiner.Combine();
+
+  espm::CompressedFieldsCache cache;
+  const size_t numBytes = espm::PreloadCompressedFields(
+    *combineBrowser, { "MISC", "NPC_" }, cache, 0, 4);
+  REQUIRE(numBytes == cache.GetStats().numBytes);
+  REQUIRE(cache.GetStats().numEntries == kNumRecords);
+
+  // Already cached
+  REQUIRE(espm::PreloadCompressedFields(*combineBrowser, { "MISC" }, cache,
+                                        0, 4) == 0);
+
+  const auto numMisses = cache.GetStats().numMisses;
+  for (uint32_t id = 0x800; id < 0x800 + kNumRecords; ++id) {
+    REQUIRE(combineBrowser->LookupById(id).rec->GetEditorId(cache) ==
+            GetEditorIdForTest(id));
+  }
+  REQUIRE(cache.GetStats().numMisses == numMisses);
+
+  // Each record is over 1000 bytes, so the budget allows a few of them
+  espm::CompressedFieldsCache limitedCache;
+  espm::PreloadCompressedFields(*combineBrowser, { "MISC" }, limitedCache,
+                                5000, 1);
+  REQUIRE(limitedCache.GetStats().numEntries == 5);
+}
+
+TEST_CASE("Preloaded fields are pinned and shared with child caches",
+          "[CompressedFieldsCache]")
+{
+  constexpr uint32_t kNumRecords = 100;
+  auto content = MakeCompressedPlugin(kNumRecords);
+  espm::Browser br(content.data(), content.size());
+  espm::Combiner combiner;
+  combiner.AddSource(&br, "Plugin.esp");
+  auto combineBrowser = combiner.Combine();
+
+  espm::CompressedFieldsCache cache(1);
+  const size_t numBytes = espm::PreloadCompressedFields(
+    *combineBrowser, { "MISC" }, cache, 0, 4);
+  REQUIRE(cache.GetStats().numPinnedBytes == numBytes);
+
+  // The limit applies to other entries only
+  cache.SetMaxBytes(1);
+  REQUIRE(cache.GetStats().numEntries == kNumRecords);
+  REQUIRE(cache.GetStats().numEvictions == 0);
+
+  espm::CompressedFieldsCache childCache(1, &cache);
+  const char* editorId =
+    combineBrowser->LookupById(0x800).rec->GetEditorId(childCache);
+  REQUIRE(editorId ==
+          combineBrowser->LookupById(0x800).rec->GetEditorId(cache));
+
+  // Not decompressed again and not counted as a miss of the parent
+  REQUIRE(cache.GetStats().numMisses == 0);
+  REQUIRE(childCache.GetStats().numMisses == 1);
+  REQUIRE(childCache.GetStats().numPinnedBytes == 0);
+}
+
+TEST_CASE("NavMeshIndex reads triangles of NAVM records", "[NavMeshIndex]")
+{
+  std::vector<char> nvnm;
+  const uint32_t header[4] = { 12, 0, 0x3c, 0 }; // version, ?, world, grid
+  nvnm.insert(nvnm.end(), reinterpret_cast<const char*>(header),
+              reinterpret_cast<const char*>(header + 4));
+  const int32_t numVertices = 4;
+  const float vertices[4][3] = {
+    { 0, 0, 10 }, { 100, 0, 10 }, { 100, 100, 10 }, { 0, 100, 10 }
+  };
+  const int32_t numTriangles = 3;
+  espm::NAVM::Triangle triangles[3];
+  triangles[0].vertices[0] = 0;
+  triangles[0].vertices[1] = 1;
+  triangles[0].vertices[2] = 2;
+  triangles[1].vertices[0] = 0;
+  triangles[1].vertices[1] = 2;
+  triangles[1].vertices[2] = 3;
+  triangles[2].vertices[0] = 0;
+  triangles[2].vertices[1] = 1;
+  triangles[2].vertices[2] = 4; // Out of range, skipped
+  auto append = [&](const void* data, size_t size) {
+    auto p = reinterpret_cast<const char*>(data);
+    nvnm.insert(nvnm.end(), p, p + size);
+  };
+  append(&numVertices, sizeof(numVertices));
+  append(vertices, sizeof(vertices));
+  append(&numTriangles, sizeof(numTriangles));
+  append(triangles, sizeof(triangles));
+
+  espm::PluginWriter w;
+  w.BeginRecord("TES4", 0);
+  const char hedr[12] = { 0 };
+  w.WriteField("HEDR", hedr, sizeof(hedr));
+  w.EndRecord();
+  w.BeginRecord("NAVM", 0x800);
+  w.WriteField("NVNM", nvnm.data(), static_cast<uint32_t>(nvnm.size()));
+  w.EndRecord();
+
+  espm::Browser br(w.GetBuffer().data(), w.GetBuffer().size());
+  espm::Combiner combiner;
+  combiner.AddSource(&br, "Plugin.esp");
+  auto combineBrowser = combiner.Combine();
+
+  auto navMesh = espm::Convert<espm::NAVM>(br.LookupById(0x800));
+  REQUIRE(navMesh);
+  espm::CompressedFieldsCache cache;
+  REQUIRE(navMesh->GetData(cache).numTriangles == 3);
+
+  NavMeshIndex index(*combineBrowser);
+  REQUIRE(index.GetNumTriangles() == 2);
+  REQUIRE(index.FindHeight(0x3c, { 10, 90, 0 }, 100) == 10.f);
+  REQUIRE(index.FindHeight(0x3c, { 90, 10, 0 }, 100) == 10.f);
+}
+
+TEST_CASE("NAVM records with malformed NVNM fields have no vertices",
+          "[NavMeshIndex]")
+{
+  // Header without the number of vertices and the number of vertices
+  // exceeding the field
+  std::vector<char> shortNvnm(16, 0), truncatedNvnm(32, 0);
+  const int32_t numVertices = 2;
+  memcpy(truncatedNvnm.data() + 16, &numVertices, sizeof(numVertices));
+
+  espm::PluginWriter w;
+  w.BeginRecord("TES4", 0);
+  const char hedr[12] = { 0 };
+  w.WriteField("HEDR", hedr, sizeof(hedr));
+  w.EndRecord();
+  w.BeginRecord("NAVM", 0x800);
+  w.WriteField("NVNM", shortNvnm.data(),
+               static_cast<uint32_t>(shortNvnm.size()));
+  w.EndRecord();
+  w.BeginRecord("NAVM", 0x801);
+  w.WriteField("NVNM", truncatedNvnm.data(),
+               static_cast<uint32_t>(truncatedNvnm.size()));
+  w.EndRecord();
+
+  espm::Browser br(w.GetBuffer().data(), w.GetBuffer().size());
+  espm::CompressedFieldsCache cache;
+  for (uint32_t id : { 0x800, 0x801 }) {
+    auto navMesh = espm::Convert<espm::NAVM>(br.LookupById(id));
+    REQUIRE(navMesh);
+    auto data = navMesh->GetData(cache);
+    REQUIRE(!data.vertices);
+    REQUIRE(data.numTriangles == 0);
+  }
+}
+
+namespace {
+void WriteReference(espm::PluginWriter& w, uint32_t id, uint32_t baseId,
+                    float x, float y, uint32_t flags = 0)
+{
+  w.BeginRecord("REFR", id, flags);
+  w.WriteField("NAME", &baseId, sizeof(baseId));
+  const float posRot[6] = { x, y, 0.f, 0.f, 0.f, 0.f };
+  w.WriteField("DATA", posRot, sizeof(posRot));
+  w.EndRecord();
+}
+}
+
+TEST_CASE("ChunkReferenceIndex merges loadable references of all plugins",
+          "[ChunkReferenceIndex]")
+{
+  constexpr uint32_t kInitiallyDisabled = 0x800;
+  const char hedr[12] = { 0 };
+
+  espm::PluginWriter master;
+  master.BeginRecord("TES4", 0);
+  master.WriteField("HEDR", hedr, sizeof(hedr));
+  master.EndRecord();
+  master.BeginRecord("MISC", 0x300);
+  master.EndRecord();
+  master.BeginRecord("STAT", 0x301);
+  master.EndRecord();
+  master.BeginGroup(MakeLabel("CELL"), espm::GroupType::TOP);
+  master.BeginRecord("CELL", 0x100);
+  master.EndRecord();
+  master.BeginGroup(0x100, espm::GroupType::CELL_CHILDREN);
+  master.BeginGroup(0x100, espm::GroupType::CELL_TEMPORARY_CHILDREN);
+  WriteReference(master, 0x200, 0x300, 5000.f, -5000.f);
+  WriteReference(master, 0x201, 0x301, 5000.f, -5000.f);
+  WriteReference(master, 0x202, 0x300, 5000.f, -5000.f, kInitiallyDisabled);
+  master.EndGroup();
+  master.EndGroup();
+  master.EndGroup();
+
+  // Enables and moves 0x202, adds 0x01000200
+  espm::PluginWriter plugin;
+  plugin.BeginRecord("TES4", 0);
+  plugin.WriteField("HEDR", hedr, sizeof(hedr));
+  const std::string masterName = "Master.esm";
+  const uint64_t data = 0;
+  plugin.WriteField("MAST", masterName.data(),
+                    static_cast<uint16_t>(masterName.size() + 1));
+  plugin.WriteField("DATA", &data, sizeof(data));
+  plugin.EndRecord();
+  plugin.BeginGroup(MakeLabel("CELL"), espm::GroupType::TOP);
+  plugin.BeginRecord("CELL", 0x100);
+  plugin.EndRecord();
+  plugin.BeginGroup(0x100, espm::GroupType::CELL_CHILDREN);
+  plugin.BeginGroup(0x100, espm::GroupType::CELL_TEMPORARY_CHILDREN);
+  WriteReference(plugin, 0x202, 0x300, -5000.f, 5000.f);
+  WriteReference(plugin, 0x01000200, 0x300, 5000.f, -5000.f);
+  plugin.EndGroup();
+  plugin.EndGroup();
+  plugin.EndGroup();
+
+  espm::Browser masterBr(master.GetBuffer().data(), master.GetBuffer().size());
+  espm::Browser pluginBr(plugin.GetBuffer().data(), plugin.GetBuffer().size());
+  espm::Combiner combiner;
+  combiner.AddSource(&masterBr, masterName.data());
+  combiner.AddSource(&pluginBr, "Plugin.esp");
+  auto combineBrowser = combiner.Combine();
+
+  ChunkReferenceIndex index(*combineBrowser, 2);
+  REQUIRE(index.GetNumReferences() == 4);
+  REQUIRE(index.GetReferencesAtPos(0x100, 1, -1) ==
+          std::vector<uint32_t>{ 0x200, 0x202, 0x01000200 });
+  REQUIRE(index.GetReferencesAtPos(0x100, -1, 1) ==
+          std::vector<uint32_t>{ 0x202 });
+  REQUIRE(index.GetReferencesAtPos(0x100, 0, 0).empty());
+  REQUIRE(index.GetReferencesAtPos(0x3c, 1, -1).empty());
+}
@@ -208,8 +208,9 @@ TEST_CASE("String assign", "[VarValue]")
   VarValue x(std::string("123"));
   VarValue y;
   y = x;
-  *x.stringHolder = "456";
+  x = VarValue(std::string("456"));
   REQUIRE(static_cast<const char*>(y) == std::string("123"));
+  REQUIRE(static_cast<const char*>(x) == std::string("456"));
 }
 
 TEST_CASE("Mixed arithmetics", "[VarValue]")
@@ -228,8 +229,7 @@ TEST_CASE("Cast to string", "[VarValue]")
   REQUIRE(CastToString(VarValue(4278190080.0)) == VarValue("4278190080"));
 
   VarValue arr((uint8_t)VarValue::kType_ObjectArray);
-  arr.pArray.reset(new std::vector<VarValue>);
-  arr.pArray->resize(2, VarValue::None());
+  arr.SetArray(std::vector<VarValue>(2, VarValue::None()));
   REQUIRE(CastToString(arr) == VarValue("[None, None]"));
 }
 
@@ -239,3 +239,25 @@ TEST_CASE("operator==", "[VarValue]")
   REQUIRE(VarValue("123") != VarValue(123));
   REQUIRE(VarValue("123") != VarValue(999));
 }
+
+TEST_CASE("Compact layout", "[VarValue]")
+{
+  REQUIRE(sizeof(VarValue) <= 24);
+
+  VarValue arr((uint8_t)VarValue::kType_IntArray);
+  REQUIRE(arr.GetArray() == nullptr);
+  arr.SetArray(std::vector<VarValue>(1, VarValue(0)));
+
+  // Arrays are shared by reference, the declared type stays with variables
+  VarValue copy((uint8_t)VarValue::kType_IntArray);
+  copy.SetObjectType("Int[]");
+  copy = arr;
+  copy.GetArray()->at(0) = VarValue(5);
+  REQUIRE(arr.GetArray()->at(0) == VarValue(5));
+  REQUIRE(copy.GetObjectType() == "Int[]");
+  REQUIRE(arr.GetObjectType() == "");
+
+  copy = VarValue::None();
+  REQUIRE(copy.GetArray() == nullptr);
+  REQUIRE(arr.GetArray()->size() == 1);
+}
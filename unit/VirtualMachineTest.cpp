@@ -4,6 +4,8 @@
 #include "Reader.h"
 #include "ScriptVariablesHolder.h"
 #include "VirtualMachine.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <ctime>
 #include <filesystem>
@@ -228,3 +230,119 @@ TEST_CASE("Test nested latent calls", "[VirtualMachine]")
 
   REQUIRE(result == VarValue(6));
 }
+
+TEST_CASE("Identifiers are resolved when a script is loaded",
+          "[VirtualMachine]")
+{
+  Reader reader(
+    { fs::absolute(BUILT_PEX_DIR "/OpcodesTest.pex").generic_string() });
+  auto pex = reader.GetSourceStructures().at(0);
+
+  auto& states = pex->objectTable.at(0).states;
+  auto state = std::find_if(states.begin(), states.end(),
+                            [](auto& state) { return state.name.empty(); });
+  REQUIRE(state != states.end());
+  auto func =
+    std::find_if(state->functions.begin(), state->functions.end(),
+                 [](auto& f) { return f.name == "IdentifierResolutionTest"; });
+  REQUIRE(func != state->functions.end());
+
+  // 'Int foo = 1' followed by 'Foo()' call: the local must not shadow the
+  // called function name. The string table is case-insensitive, so both are
+  // 'Foo' in the pex
+  REQUIRE(func->function.code);
+  auto& code = *func->function.code;
+  REQUIRE(code.identifiers);
+  bool foundCall = false, foundLocal = false;
+  for (auto& instruction : code.instructions) {
+    REQUIRE(instruction.operands.size() == instruction.args.size());
+    for (size_t i = 0; i < instruction.args.size(); ++i) {
+      auto& arg = instruction.args[i];
+      auto& operand = instruction.operands[i];
+      if (arg.GetType() != VarValue::kType_Identifier) {
+        REQUIRE(operand.kind == FunctionCode::Operand::kConstant);
+        continue;
+      }
+      std::string name = static_cast<const char*>(arg);
+      if (instruction.op == FunctionCode::kOp_CallMethod && i == 0) {
+        REQUIRE(operand.kind == FunctionCode::Operand::kConstant);
+        foundCall = foundCall || name == "Foo";
+      } else if (name == "Foo") {
+        REQUIRE(operand.kind == FunctionCode::Operand::kLocal);
+        REQUIRE(func->function.params.at(operand.index).name == "Foo");
+        foundLocal = true;
+      } else if (operand.kind == FunctionCode::Operand::kIdentifier) {
+        REQUIRE(code.identifiers->at(operand.index) == name);
+      }
+    }
+  }
+  REQUIRE(foundCall);
+  REQUIRE(foundLocal);
+}
+
+TEST_CASE("Native methods are dispatched by class hierarchy",
+          "[VirtualMachine]")
+{
+  auto vm = CreateVirtualMachine();
+
+  class OpcodesTestObject : public IGameObject
+  {
+  public:
+    const char* GetParentNativeScript() override { return "OpcodesTest"; }
+  };
+  auto object = std::make_shared<OpcodesTestObject>();
+  vm->AddObject(object, {});
+
+  auto makeFn = [](int32_t res) {
+    return [res](VarValue, std::vector<VarValue>) { return VarValue(res); };
+  };
+
+  // OpcodesTest extends AAATestObject
+  vm->RegisterFunction("AAATestObject", "NativeMethod", FunctionType::Method,
+                       makeFn(1));
+  std::vector<VarValue> args;
+  REQUIRE(vm->CallMethod(object.get(), "nativemethod", args) == VarValue(1));
+
+  vm->RegisterFunction("opcodestest", "NativeMethod", FunctionType::Method,
+                       makeFn(2));
+  REQUIRE(vm->CallMethod(object.get(), "NativeMethod", args) == VarValue(2));
+
+  REQUIRE_THROWS_WITH(vm->CallMethod(object.get(), "MissingMethod", args),
+                      "Method not found - 'MissingMethod'");
+}
+
+TEST_CASE("Interpreter benchmark", "[VirtualMachine][Benchmarks]")
+{
+  // Small enough for sums of loop counters to fit Int
+  constexpr int32_t kIterations = 50000;
+
+  auto vm = CreateVirtualMachine();
+  auto holder = std::make_shared<MyScriptVariablesHolder>("BenchmarkTest");
+  vm->AddObject(holder->testObject, { { "BenchmarkTest", holder } });
+
+  double arithmeticResult = 0.0;
+  for (int32_t i = 0; i < kIterations; ++i) {
+    arithmeticResult = arithmeticResult * 0.5 + (i % 7) - 1.5;
+  }
+  const auto sumResult =
+    static_cast<int32_t>(int64_t(kIterations) * (kIterations - 1) / 2);
+
+  auto measure = [&](const char* name, bool isGlobal, VarValue expected) {
+    std::vector<VarValue> args = { VarValue(kIterations) };
+    auto was = std::chrono::steady_clock::now();
+    auto res = isGlobal
+      ? vm->CallStatic("BenchmarkTest", name, args)
+      : vm->CallMethod(holder->testObject.get(), name, args);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - was)
+                .count();
+    REQUIRE(res == expected);
+    std::cout << "BenchmarkTest." << name << ": " << ns / kIterations
+              << " ns per iteration" << std::endl;
+  };
+
+  measure("Loop", true, VarValue(sumResult));
+  measure("Arithmetic", true, VarValue(arithmeticResult));
+  measure("Calls", true, VarValue(sumResult));
+  measure("Properties", false, VarValue(kIterations));
+}